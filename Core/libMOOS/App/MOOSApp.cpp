@@ -198,6 +198,10 @@ void CMOOSApp::PrintDefaultCommandLineSwitches()
 	std::cout<<"  --moos_max_app_tick=<number>: max frequency of application (if relevant) \n";
 	std::cout<<"  --moos_comms_tick=<number>  : frequency of comms (if relevant) \n";
     std::cout<<"  --moos_tw_delay_factor=<num>: comms delay as % of time warp (if relevant) \n";
+    std::cout<<"  --moos_compression_threshold=<num>: compress packets bigger than this (bytes) \n";
+    std::cout<<"  --moos_p2p_threshold=<num>  : send binary data this big (bytes) direct to subscribers \n";
+    std::cout<<"  --moos_write_batch_delay=<num>: when busy wait up to this long (us) to batch outgoing mail \n";
+    std::cout<<"  --moos_write_batch_bytes=<num>: but stop waiting once this much (bytes) is ready \n";
 
 
 
@@ -212,6 +216,8 @@ void CMOOSApp::PrintDefaultCommandLineSwitches()
 	std::cout<<"  --moos_filter_command       : enable command message filtering \n";
 	std::cout<<"  --moos_no_sort_mail         : don't sort mail by time \n";
 	std::cout<<"  --moos_no_comms             : don't start communications \n";
+	std::cout<<"  --moos_shared_memory        : use shared memory to talk to a local DB \n";
+	std::cout<<"  --moos_latency_audit        : multicast mail latency histograms (see atm) \n";
 	std::cout<<"  --moos_quiet                : don't print banner information \n";
 	std::cout<<"  --moos_quit_on_iterate_fail : quit if iterate fails \n";
 	std::cout<<"  --moos_no_colour            : disable colour printing \n";
@@ -1073,9 +1079,9 @@ bool CMOOSApp::Notify(const std::string & sVar,const std::vector<unsigned char>
 
 
 /** Register for notification in changes of named variable*/
-bool CMOOSApp::Register(const std::string & sVar,double dfInterval)
+bool CMOOSApp::Register(const std::string & sVar,double dfInterval,bool bLatestOnly)
 {
-	return m_Comms.Register(sVar,dfInterval);
+	return m_Comms.Register(sVar,dfInterval,bLatestOnly);
 }
 
 /** Register with wildcards based on application and variable patterns (* and ? allowed)*/
@@ -1150,6 +1156,32 @@ bool CMOOSApp::ConfigureComms()
     m_CommandLineParser.GetOption("--moos_comms_tick",m_nCommsFreq);
     m_nCommsFreq = m_nCommsFreq <0 ? 1 : m_nCommsFreq;
 
+    //should big packets be compressed on their way to the DB?
+    unsigned int nCompressionThreshold = 0;
+    GetParameterFromCommandLineOrConfigurationFile("moos_compression_threshold",nCompressionThreshold);
+    m_MissionReader.GetConfigurationParam("COMPRESSIONTHRESHOLD",nCompressionThreshold);
+    m_Comms.SetCompressionThreshold(nCompressionThreshold);
+
+    //should we try to talk to a DB on this machine through shared memory?
+    m_Comms.SetSharedMemory(GetFlagFromCommandLineOrConfigurationFile("moos_shared_memory"));
+
+    //should we tell atm how long our mail takes to arrive?
+    m_Comms.EnableLatencyAudit(GetFlagFromCommandLineOrConfigurationFile("moos_latency_audit"));
+
+#ifdef ASYNCHRONOUS_CLIENT
+    //should big binary data skip the DB on its way to subscribers?
+    unsigned int nPeerToPeerThreshold = 0;
+    GetParameterFromCommandLineOrConfigurationFile("moos_p2p_threshold",nPeerToPeerThreshold);
+    m_Comms.SetPeerToPeerThreshold(nPeerToPeerThreshold);
+
+    //should busy bursts of mail be gathered into fewer packets?
+    double dfWriteBatchDelay = 0.0;
+    unsigned int nWriteBatchBytes = 16384;
+    GetParameterFromCommandLineOrConfigurationFile("moos_write_batch_delay",dfWriteBatchDelay);
+    GetParameterFromCommandLineOrConfigurationFile("moos_write_batch_bytes",nWriteBatchBytes);
+    m_Comms.SetWriteBatching(dfWriteBatchDelay*1e-6,nWriteBatchBytes);
+#endif
+
     //register a callback for On Connect
     m_Comms.SetOnConnectCallBack(MOOSAPP_OnConnect,this);
     
@@ -1499,6 +1531,15 @@ std::string CMOOSApp::MakeStatusString()
 
     ssStatus<<"MOOSName="<<GetAppName()<<",";
 
+#ifdef ASYNCHRONOUS_CLIENT
+    //how well is write batching doing?
+    ssStatus<<"PktsSent="<<m_Comms.GetNumPktsSent()<<",";
+    ssStatus<<"MsgsSent="<<m_Comms.GetNumMsgsSent()<<",";
+    ssStatus<<"BatchWaits="<<m_Comms.GetNumBatchWaits()<<",";
+    ssStatus<<"FullBatches="<<m_Comms.GetNumFullBatches()<<",";
+    ssStatus<<"BatchWaitTime="<<m_Comms.GetBatchWaitTime()<<",";
+#endif
+
     ssStatus<<"Publishing=\"";
     std::copy(Published.begin(),Published.end(),std::ostream_iterator<string>(ssStatus,","));
 	ssStatus<<"\",";
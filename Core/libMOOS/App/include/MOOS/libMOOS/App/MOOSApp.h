@@ -283,8 +283,9 @@ protected:
 
     /** Register for notification in changes of named variable
     @param sVar name of variable of interest
-    @param dfInterval minimum time between notifications in seconds*/
-    bool Register(const std::string & sVar,double dfInterval=0.0);
+    @param dfInterval minimum time between notifications in seconds
+    @param bLatestOnly only be sent the most recent change waiting when we call in*/
+    bool Register(const std::string & sVar,double dfInterval=0.0,bool bLatestOnly=false);
 
     /** Register for notification in changes of variables which match variable and source patterns
      *
@@ -85,20 +85,24 @@ bool ActiveMailQueue::Stop()
 
 bool ActiveMailQueue::Push(const CMOOSMsg & M)
 {
-	queue_.Push(M);
+	queue_.Push(MOOS::CompactMsg(M));
 	return true;
 }
 
 bool ActiveMailQueue::DoWork()
 {
+	//handed to the callbacks - reused so its strings keep their storage
+	CMOOSMsg M;
+	MOOS::CompactMsg Queued;
 	while(!thread_.IsQuitRequested())
     {
-		CMOOSMsg M;
 		while(queue_.IsEmpty())
 		{
 			queue_.WaitForPush(1000);
 		}
-		queue_.Pull(M);
+		if(!queue_.Pull(Queued))
+			continue;
+		Queued.ToMsg(M);
 
 		switch(M.GetType())
 		{
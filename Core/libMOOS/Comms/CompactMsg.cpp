@@ -0,0 +1,304 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * CompactMsg.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/CompactMsg.h"
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <map>
+#include <new>
+#include <algorithm>
+
+namespace
+{
+//the pool of interned strings. Blocks in it are never freed
+CMOOSLock g_PoolLock;
+std::map<std::string,void*> g_Pool;
+
+unsigned int Hash(const char * pData, unsigned int nSize)
+{
+    //FNV-1a
+    unsigned int h = 2166136261u;
+    for(unsigned int i = 0;i<nSize;i++)
+    {
+        h ^= (unsigned char)pData[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+#if __cplusplus >= 201103L
+//each thread remembers the last few strings it interned so asking again
+//for a name it uses all the time needs no lock
+const unsigned int kThreadCacheSize = 64;
+struct ThreadCacheEntry
+{
+    const char * pData;
+    unsigned int nSize;
+    void * pBlock;
+};
+thread_local ThreadCacheEntry t_Cache[kThreadCacheSize];
+#endif
+}
+
+namespace MOOS
+{
+
+SharedString::SharedString():m_nSize(0)
+{
+    m_Store.Inline[0] = '\0';
+}
+
+SharedString::SharedString(const char * pData, unsigned int nSize)
+{
+    Init(pData,nSize);
+}
+
+SharedString::SharedString(const std::string & s)
+{
+    Init(s.data(),(unsigned int)s.size());
+}
+
+void SharedString::Init(const char * pData, unsigned int nSize)
+{
+    m_nSize = nSize;
+    if(IsInline())
+    {
+        if(nSize>0)
+            memcpy(m_Store.Inline,pData,nSize);
+        m_Store.Inline[nSize] = '\0';
+    }
+    else
+    {
+        m_Store.pBlock = MakeBlock(pData,nSize,false);
+    }
+}
+
+SharedString::SharedString(const SharedString & Other)
+    :m_nSize(Other.m_nSize),m_Store(Other.m_Store)
+{
+    Acquire();
+}
+
+SharedString & SharedString::operator=(const SharedString & Other)
+{
+    SharedString Copy(Other);
+    swap(Copy);
+    return *this;
+}
+
+SharedString::~SharedString()
+{
+    Release();
+}
+
+#if __cplusplus >= 201103L
+SharedString::SharedString(SharedString && Other)
+    :m_nSize(Other.m_nSize),m_Store(Other.m_Store)
+{
+    Other.m_nSize = 0;
+    Other.m_Store.Inline[0] = '\0';
+}
+
+SharedString & SharedString::operator=(SharedString && Other)
+{
+    swap(Other);
+    return *this;
+}
+#endif
+
+void SharedString::swap(SharedString & Other)
+{
+    std::swap(m_nSize,Other.m_nSize);
+    std::swap(m_Store,Other.m_Store);
+}
+
+bool SharedString::operator==(const SharedString & Other) const
+{
+    if(m_nSize!=Other.m_nSize)
+        return false;
+    if(!IsInline() && m_Store.pBlock==Other.m_Store.pBlock)
+        return true;
+    return memcmp(data(),Other.data(),m_nSize)==0;
+}
+
+void SharedString::Acquire()
+{
+    if(!IsInline() && !m_Store.pBlock->bInterned)
+        ++m_Store.pBlock->Refs;
+}
+
+void SharedString::Release()
+{
+    if(IsInline() || m_Store.pBlock->bInterned)
+        return;
+    if(--m_Store.pBlock->Refs==0)
+    {
+        m_Store.pBlock->Refs.~AtomicCounter();
+        free(m_Store.pBlock);
+    }
+}
+
+SharedString::Block * SharedString::MakeBlock(const char * pData, unsigned int nSize, bool bInterned)
+{
+    void * pMem = malloc(offsetof(Block,Data)+nSize+1);
+    if(pMem==NULL)
+        throw std::bad_alloc();
+
+    Block * pBlock = static_cast<Block*>(pMem);
+    new (&pBlock->Refs) Poco::AtomicCounter(1);
+    pBlock->bInterned = bInterned;
+    memcpy(pBlock->Data,pData,nSize);
+    pBlock->Data[nSize] = '\0';
+    return pBlock;
+}
+
+SharedString SharedString::Intern(const std::string & s)
+{
+    return Intern(s.data(),(unsigned int)s.size());
+}
+
+SharedString SharedString::Intern(const char * pData, unsigned int nSize)
+{
+    //short strings are already as cheap as they can be and
+    //long ones would just fill the pool
+    if(nSize<=kInlineSize || nSize>MOOS_SHARED_STRING_MAX_INTERN_LENGTH)
+        return SharedString(pData,nSize);
+
+    SharedString Result;
+    Result.m_nSize = nSize;
+
+#if __cplusplus >= 201103L
+    ThreadCacheEntry & rEntry = t_Cache[Hash(pData,nSize)%kThreadCacheSize];
+    if(rEntry.pBlock!=NULL && rEntry.nSize==nSize && memcmp(rEntry.pData,pData,nSize)==0)
+    {
+        Result.m_Store.pBlock = static_cast<Block*>(rEntry.pBlock);
+        return Result;
+    }
+#endif
+
+    Block * pBlock = NULL;
+    {
+        MOOS::ScopedLock L(g_PoolLock);
+        std::string sName(pData,nSize);
+        std::map<std::string,void*>::iterator q = g_Pool.find(sName);
+        if(q!=g_Pool.end())
+        {
+            pBlock = static_cast<Block*>(q->second);
+        }
+        else if(g_Pool.size()<MOOS_SHARED_STRING_POOL_SIZE)
+        {
+            pBlock = MakeBlock(pData,nSize,true);
+            g_Pool[sName] = pBlock;
+        }
+    }
+
+    if(pBlock==NULL)
+    {
+        //the pool is full
+        Result.m_Store.pBlock = MakeBlock(pData,nSize,false);
+        return Result;
+    }
+
+#if __cplusplus >= 201103L
+    rEntry.pData = pBlock->Data;
+    rEntry.nSize = nSize;
+    rEntry.pBlock = pBlock;
+#endif
+
+    Result.m_Store.pBlock = pBlock;
+    return Result;
+}
+
+unsigned int SharedString::GetNumInterned()
+{
+    MOOS::ScopedLock L(g_PoolLock);
+    return (unsigned int)g_Pool.size();
+}
+
+
+CompactMsg::CompactMsg()
+    :m_cMsgType(MOOS_NULL_MSG),
+     m_cDataType(MOOS_DOUBLE),
+     m_nID(-1),
+     m_dfTime(-1),
+     m_dfVal(-1),
+     m_dfVal2(-1)
+{
+}
+
+CompactMsg::CompactMsg(const CMOOSMsg & Msg)
+    :m_cMsgType(Msg.m_cMsgType),
+     m_cDataType(Msg.m_cDataType),
+     m_nID(Msg.m_nID),
+     m_dfTime(Msg.m_dfTime),
+     m_dfVal(Msg.m_dfVal),
+     m_dfVal2(Msg.m_dfVal2),
+     m_Key(SharedString::Intern(Msg.m_sKey)),
+     m_Val(Msg.m_sVal),
+     m_Src(SharedString::Intern(Msg.m_sSrc)),
+     m_SrcAux(Msg.m_sSrcAux),
+     m_Community(SharedString::Intern(Msg.m_sOriginatingCommunity))
+{
+}
+
+CompactMsg::CompactMsg(const MsgView & View)
+    :m_cMsgType(View.m_cMsgType),
+     m_cDataType(View.m_cDataType),
+     m_nID(View.m_nID),
+     m_dfTime(View.m_dfTime),
+     m_dfVal(View.m_dfVal),
+     m_dfVal2(View.m_dfVal2),
+     m_Key(SharedString::Intern(View.m_Key.data(),View.m_Key.size())),
+     m_Val(View.m_Val.data(),View.m_Val.size()),
+     m_Src(SharedString::Intern(View.m_Src.data(),View.m_Src.size())),
+     m_SrcAux(View.m_SrcAux.data(),View.m_SrcAux.size()),
+     m_Community(SharedString::Intern(View.m_Community.data(),View.m_Community.size()))
+{
+}
+
+void CompactMsg::ToMsg(CMOOSMsg & Msg) const
+{
+    Msg.m_nID = m_nID;
+    Msg.m_cMsgType = m_cMsgType;
+    Msg.m_cDataType = m_cDataType;
+    Msg.m_dfTime = m_dfTime;
+    Msg.m_dfVal = m_dfVal;
+    Msg.m_dfVal2 = m_dfVal2;
+    m_Key.AssignTo(Msg.m_sKey);
+    m_Val.AssignTo(Msg.m_sVal);
+    m_Src.AssignTo(Msg.m_sSrc);
+    m_SrcAux.AssignTo(Msg.m_sSrcAux);
+    m_Community.AssignTo(Msg.m_sOriginatingCommunity);
+}
+
+}
@@ -1,5 +1,12 @@
 #include "MOOS/libMOOS/Comms/EndToEndAudit.h"
 
+#include <map>
+#include <cstring>
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#endif
+
 ///////////////////////////////////////////////////////////////////////////
 //
 //   This file is part of the MOOS project
@@ -27,6 +34,164 @@ namespace MOOS{
 static const std::string kDefaultEndToEndAuditMulticastChannel = "224.1.1.8";
 static const int kDefaultEndToEndAuditMulticastPort = 4000;
 
+//the first bytes of every summary datagram
+static const char kLatencySummaryMagic[] = "MOOSLAT1";
+static const size_t kLatencySummaryMagicSize = sizeof(kLatencySummaryMagic)-1;
+
+#if __cplusplus >= 201103L
+//each cell is written by one thread and read by the publisher
+typedef std::atomic<uint32_t> AuditCount;
+typedef std::atomic<uint64_t> AuditTotal;
+
+template<class T, class V> static void Bump(T & counter, V n){
+    counter.store(counter.load(std::memory_order_relaxed)+n,std::memory_order_relaxed);
+}
+template<class T> static uint64_t Read(const T & counter){
+    return counter.load(std::memory_order_relaxed);
+}
+
+//pages of counts are made by the recording thread and found by the publisher
+template<class T> struct AuditPtr{
+    typedef std::atomic<T*> type;
+};
+template<class T> static T * Load(const std::atomic<T*> & p){
+    return p.load(std::memory_order_acquire);
+}
+template<class T> static void Store(std::atomic<T*> & p, T * value){
+    p.store(value,std::memory_order_release);
+}
+
+static std::atomic<uint64_t> next_audit_id(1);
+
+//the audits which are alive (by id so a dead audit can never be mistaken
+//for a new one) for exiting threads to hand their recorders back to
+static CMOOSLock & LiveAuditsLock(){
+    static CMOOSLock lock;
+    return lock;
+}
+static std::map<uint64_t, EndToEndAudit*> & LiveAudits(){
+    static std::map<uint64_t, EndToEndAudit*> audits;
+    return audits;
+}
+#else
+//without atomics everything happens under the audit lock
+typedef uint32_t AuditCount;
+typedef uint64_t AuditTotal;
+
+template<class T, class V> static void Bump(T & counter, V n){
+    counter+=n;
+}
+template<class T> static uint64_t Read(const T & counter){
+    return counter;
+}
+
+template<class T> struct AuditPtr{
+    typedef T* type;
+};
+template<class T> static T * Load(T * const & p){
+    return p;
+}
+template<class T> static void Store(T * & p, T * value){
+    p = value;
+}
+#endif
+
+struct EndToEndAudit::Cell{
+    //counts are kept in pages of two doublings' worth of buckets, made
+    //as they are needed, so a cell only takes room for the latencies
+    //actually seen
+    enum{
+        kPageBuckets = 2*LatencyHistogram::kSubBuckets,
+        kNumPages = (LatencyHistogram::kNumBuckets+kPageBuckets-1)/kPageBuckets
+    };
+
+    struct Page{
+        Page(){
+            for(unsigned int i = 0;i<kPageBuckets;i++){
+                counts[i] = 0;
+                published[i] = 0;
+            }
+        }
+
+        AuditCount counts[kPageBuckets];
+
+        //what has already been published - only the publisher touches
+        //these. 32 bit counts may wrap but the differences are still right
+        uint32_t published[kPageBuckets];
+    };
+
+    Cell(const std::string & source,
+         const std::string & name,
+         const std::string & destination)
+        :source_client(source),
+         message_name(name),
+         destination_client(destination),
+         published_sum(0),
+         published_bytes(0){
+        for(unsigned int i = 0;i<kNumPages;i++)
+            Store(pages[i],(Page*)NULL);
+        sum = 0;
+        bytes = 0;
+    }
+
+    ~Cell(){
+        for(unsigned int i = 0;i<kNumPages;i++)
+            delete Load(pages[i]);
+    }
+
+    std::string source_client;
+    std::string message_name;
+    std::string destination_client;
+
+    AuditPtr<Page>::type pages[kNumPages];
+    AuditTotal sum;
+    AuditTotal bytes;
+
+    uint64_t published_sum;
+    uint64_t published_bytes;
+};
+
+struct EndToEndAudit::Recorder{
+    Recorder():retired(false){}
+    ~Recorder(){
+        for(unsigned int i = 0;i<all_cells.size();i++)
+            delete all_cells[i];
+    }
+
+    //cells by variable name then source - only the owning thread uses this
+    typedef std::map<std::string, std::map<std::string, Cell*> > CELL_MAP;
+    CELL_MAP cells;
+
+    //the same cells for the publisher, and whether the owning thread has
+    //gone (both under the audit lock)
+    std::vector<Cell*> all_cells;
+    bool retired;
+};
+
+#if __cplusplus >= 201103L
+struct EndToEndAudit::ThreadRecorders{
+    //the recorder this thread uses for each audit
+    std::map<uint64_t, Recorder*> recorders;
+
+    ~ThreadRecorders(){
+        //this thread is exiting so its recorders are finished with (the
+        //audits which are still alive decide when to let them go)
+        MOOS::ScopedLock lock(LiveAuditsLock());
+        std::map<uint64_t, Recorder*>::iterator q;
+        for(q = recorders.begin();q!=recorders.end();++q){
+            std::map<uint64_t, EndToEndAudit*>::iterator a = LiveAudits().find(q->first);
+            if(a!=LiveAudits().end())
+                a->second->Retire(q->second);
+        }
+    }
+};
+
+EndToEndAudit::ThreadRecorders & EndToEndAudit::ThisThreadsRecorders(){
+    static thread_local ThreadRecorders recorders;
+    return recorders;
+}
+#endif
+
 
 void EndToEndAudit::MessageStatistic::ToString(std::string & out){
     MOOSAddValToString(out,"src",source_client);
@@ -49,15 +214,127 @@ void EndToEndAudit::MessageStatistic::FromString(const std::string & in){
 }
 
 
+/**************************************************************************/
+static void WriteString(std::string & out, const std::string & s){
+    LatencyHistogram::WriteVarint(out,s.size());
+    out.append(s);
+}
+
+static bool ReadString(const std::string & in, size_t & pos, std::string & s){
+    uint64_t n;
+    if(!LatencyHistogram::ReadVarint(in,pos,n) || n>in.size()-pos)
+        return false;
+    s.assign(in,pos,(size_t)n);
+    pos+=(size_t)n;
+    return true;
+}
+
+void EndToEndAudit::LatencySummary::Encode(std::vector<std::string> & datagrams,
+                                           unsigned int max_datagram) const{
+    std::string header(kLatencySummaryMagic,kLatencySummaryMagicSize);
+    WriteString(header,destination_client);
+    LatencyHistogram::WriteVarint(header,time<0 ? 0 : (uint64_t)time);
+    LatencyHistogram::WriteVarint(header,(uint64_t)(cpu_load<0 ? 0 : cpu_load*100.0+0.5));
+
+    std::vector<std::string> bodies(1);
+    std::vector<unsigned int> counts(1,0);
+    std::string channel;
+    std::vector<Channel>::const_iterator q;
+    for(q = channels.begin();q!=channels.end();++q){
+        channel.clear();
+        WriteString(channel,q->source_client);
+        WriteString(channel,q->message_name);
+        LatencyHistogram::WriteVarint(channel,q->bytes);
+        q->latency.Encode(channel);
+
+        //header, count (at most a few bytes) and channels
+        if(counts.back()>0 &&
+                header.size()+10+bodies.back().size()+channel.size()>max_datagram){
+            bodies.push_back(std::string());
+            counts.push_back(0);
+        }
+        bodies.back().append(channel);
+        counts.back()++;
+    }
+
+    for(unsigned int i = 0;i<bodies.size();i++){
+        datagrams.push_back(header);
+        LatencyHistogram::WriteVarint(datagrams.back(),counts[i]);
+        datagrams.back().append(bodies[i]);
+    }
+}
+
+bool EndToEndAudit::LatencySummary::Decode(const std::string & datagram){
+    channels.clear();
+    if(datagram.compare(0,kLatencySummaryMagicSize,kLatencySummaryMagic)!=0)
+        return false;
+
+    size_t pos = kLatencySummaryMagicSize;
+    uint64_t t,load,n;
+    if(!ReadString(datagram,pos,destination_client) ||
+            !LatencyHistogram::ReadVarint(datagram,pos,t) ||
+            !LatencyHistogram::ReadVarint(datagram,pos,load) ||
+            !LatencyHistogram::ReadVarint(datagram,pos,n)){
+        return false;
+    }
+    time = (int64_t)t;
+    cpu_load = load/100.0;
+
+    //each channel takes at least a few bytes
+    if(n>datagram.size())
+        return false;
+
+    channels.resize((size_t)n);
+    for(unsigned int i = 0;i<channels.size();i++){
+        Channel & c = channels[i];
+        if(!ReadString(datagram,pos,c.source_client) ||
+                !ReadString(datagram,pos,c.message_name) ||
+                !LatencyHistogram::ReadVarint(datagram,pos,c.bytes) ||
+                !c.latency.Decode(datagram,pos)){
+            channels.clear();
+            return false;
+        }
+    }
+    return pos==datagram.size();
+}
+
+
 /**************************************************************************/
 EndToEndAudit::EndToEndAudit(){
+#if __cplusplus >= 201103L
+    id_ = next_audit_id++;
+    MOOS::ScopedLock lock(LiveAuditsLock());
+    LiveAudits()[id_] = this;
+#else
+    id_ = 0;
+#endif
+    started_ = false;
+}
 
+/**************************************************************************/
+EndToEndAudit::~EndToEndAudit(){
+    if(started_)
+        transmit_thread_.Stop();
 
+#if __cplusplus >= 201103L
+    //threads which exit from now on needn't tell us
+    {
+        MOOS::ScopedLock lock(LiveAuditsLock());
+        LiveAudits().erase(id_);
+    }
+#endif
+
+    for(unsigned int i = 0;i<recorders_.size();i++)
+        delete recorders_[i];
 }
 
 /**************************************************************************/
 void EndToEndAudit::Start(){
 
+    if(started_)
+        return;
+    started_ = true;
+
     multicaster_.Configure(kDefaultEndToEndAuditMulticastChannel,
                            kDefaultEndToEndAuditMulticastPort);
     multicaster_.Run(true,false);
@@ -65,49 +342,180 @@ void EndToEndAudit::Start(){
     transmit_thread_.Start();
 }
 
+/**************************************************************************/
+EndToEndAudit::Recorder & EndToEndAudit::RecorderForThisThread(){
+#if __cplusplus >= 201103L
+    Recorder * & recorder = ThisThreadsRecorders().recorders[id_];
+    if(recorder==NULL){
+        Recorder * new_recorder = new Recorder;
+        MOOS::ScopedLock lock(audit_lock_);
+        recorders_.push_back(new_recorder);
+        recorder = new_recorder;
+    }
+    return *recorder;
+#else
+    if(recorders_.empty())
+        recorders_.push_back(new Recorder);
+    return *recorders_.front();
+#endif
+}
+
+/**************************************************************************/
+void EndToEndAudit::Retire(Recorder * recorder){
+    MOOS::ScopedLock lock(audit_lock_);
+    recorder->retired = true;
+}
+
 /**************************************************************************/
 void EndToEndAudit::AddForAudit(const CMOOSMsg & msg,
                                 const std::string  & client_name,
                                 double time_now){
 
-    MessageStatistic ms;
-    ms.source_client = msg.GetSource();
-    ms.destination_client =client_name;
-    ms.receive_time = int64_t(time_now*1e6);
-    ms.source_time = int64_t(msg.GetTime()*1e6);
-    ms.message_name = msg.GetKey();
-    ms.message_size=msg.GetSizeInBytesWhenSerialised();
-    proc_info_.GetPercentageCPULoad(ms.cpu_load);
-
+#if __cplusplus < 201103L
     MOOS::ScopedLock lock(audit_lock_);
-    message_statistics_.push_back(ms);
+#endif
 
-}
+    Recorder & recorder = RecorderForThisThread();
+
+    //finding the cell copies nothing unless it is new
+    std::map<std::string, Cell*> & sources = recorder.cells[msg.GetKey()];
+    std::map<std::string, Cell*>::iterator q = sources.find(msg.GetSource());
+    if(q==sources.end()){
+        Cell * cell = new Cell(msg.GetSource(),msg.GetKey(),client_name);
+        {
+#if __cplusplus >= 201103L
+            MOOS::ScopedLock lock(audit_lock_);
+#endif
+            recorder.all_cells.push_back(cell);
+        }
+        q = sources.insert(std::make_pair(msg.GetSource(),cell)).first;
+    }
 
+    Cell & cell = *q->second;
+    int64_t latency = int64_t((time_now-msg.GetTime())*1e6);
+    unsigned int bucket = LatencyHistogram::BucketFor(latency);
+    Cell::Page * page = Load(cell.pages[bucket/Cell::kPageBuckets]);
+    if(page==NULL){
+        page = new Cell::Page;
+        Store(cell.pages[bucket/Cell::kPageBuckets],page);
+    }
+    Bump(page->counts[bucket%Cell::kPageBuckets],1);
+    if(latency>0)
+        Bump(cell.sum,latency);
+    Bump(cell.bytes,msg.GetSizeInBytesWhenSerialised());
+}
 
 /**************************************************************************/
-bool EndToEndAudit::TransmitWorker(){
+void EndToEndAudit::Collect(std::vector<LatencySummary> & summaries){
 
-    while(!transmit_thread_.IsQuitRequested()){
-        MOOSPause(1000);
-        MessageStatistics message_stats_to_send;
-        {
-            MOOS::ScopedLock lock(audit_lock_);
-            message_stats_to_send.swap(message_statistics_);
+    //the recorders whose threads have gone are read one last time
+    std::vector<Cell*> cells;
+    std::vector<Recorder*> retired;
+    {
+        MOOS::ScopedLock lock(audit_lock_);
+        std::vector<Recorder*> live;
+        for(unsigned int i = 0;i<recorders_.size();i++){
+            Recorder * recorder = recorders_[i];
+            cells.insert(cells.end(),recorder->all_cells.begin(),recorder->all_cells.end());
+            if(recorder->retired)
+                retired.push_back(recorder);
+            else
+                live.push_back(recorder);
         }
+        recorders_.swap(live);
+    }
 
-        if(message_stats_to_send.empty()){
+#if __cplusplus < 201103L
+    MOOS::ScopedLock lock(audit_lock_);
+#endif
+
+    double cpu_load = 0.0;
+    proc_info_.GetPercentageCPULoad(cpu_load);
+    int64_t time_now = int64_t(MOOSLocalTime()*1e6);
+
+    //cells different threads keep for the same channel are summed
+    typedef std::pair<std::string, std::string> CHANNEL_KEY;
+    std::map<std::string, unsigned int> by_destination;
+    std::vector<std::map<CHANNEL_KEY, unsigned int> > by_channel;
+
+    std::vector<Cell*>::iterator q;
+    for(q = cells.begin();q!=cells.end();++q){
+        Cell & cell = **q;
+        LatencyHistogram latency;
+        for(unsigned int p = 0;p<Cell::kNumPages;p++){
+            Cell::Page * page = Load(cell.pages[p]);
+            if(page==NULL)
+                continue;
+            for(unsigned int i = 0;i<Cell::kPageBuckets;i++){
+                uint32_t count = (uint32_t)Read(page->counts[i]);
+                uint32_t delta = count-page->published[i];
+                if(delta!=0){
+                    latency.AddToBucket(p*Cell::kPageBuckets+i,delta);
+                    page->published[i] = count;
+                }
+            }
+        }
+        if(latency.GetCount()==0)
             continue;
+
+        uint64_t sum = Read(cell.sum);
+        uint64_t bytes = Read(cell.bytes);
+        latency.AddToSum(sum-cell.published_sum);
+        uint64_t new_bytes = bytes-cell.published_bytes;
+        cell.published_sum = sum;
+        cell.published_bytes = bytes;
+
+        std::map<std::string, unsigned int>::iterator d;
+        d = by_destination.find(cell.destination_client);
+        if(d==by_destination.end()){
+            d = by_destination.insert(std::make_pair(cell.destination_client,
+                                                     (unsigned int)summaries.size())).first;
+            summaries.push_back(LatencySummary());
+            summaries.back().destination_client = cell.destination_client;
+            summaries.back().time = time_now;
+            summaries.back().cpu_load = cpu_load;
+            by_channel.resize(summaries.size());
         }
 
-        MessageStatistics::iterator q;
-        for(q = message_stats_to_send.begin();
-            q!=message_stats_to_send.end();
-            ++q){
-               std::string message;
-               q->ToString(message);
-               multicaster_.Write(message);
+        LatencySummary & summary = summaries[d->second];
+        std::map<CHANNEL_KEY, unsigned int> & channels = by_channel[d->second];
+        CHANNEL_KEY key(cell.source_client,cell.message_name);
+        std::map<CHANNEL_KEY, unsigned int>::iterator c = channels.find(key);
+        if(c==channels.end()){
+            c = channels.insert(std::make_pair(key,(unsigned int)summary.channels.size())).first;
+            summary.channels.push_back(LatencySummary::Channel());
+            summary.channels.back().source_client = cell.source_client;
+            summary.channels.back().message_name = cell.message_name;
+            summary.channels.back().bytes = 0;
         }
+
+        LatencySummary::Channel & channel = summary.channels[c->second];
+        channel.latency.Merge(latency);
+        channel.bytes+=new_bytes;
+    }
+
+    for(unsigned int i = 0;i<retired.size();i++)
+        delete retired[i];
+}
+
+
+/**************************************************************************/
+bool EndToEndAudit::TransmitWorker(){
+
+    while(!transmit_thread_.IsQuitRequested()){
+
+        for(int i = 0;i<10 && !transmit_thread_.IsQuitRequested();i++)
+            MOOSPause(100);
+
+        std::vector<LatencySummary> summaries;
+        Collect(summaries);
+
+        std::vector<std::string> datagrams;
+        for(unsigned int i = 0;i<summaries.size();i++)
+            summaries[i].Encode(datagrams);
+
+        for(unsigned int i = 0;i<datagrams.size();i++)
+            multicaster_.Write(datagrams[i]);
     }
     return true;
 }
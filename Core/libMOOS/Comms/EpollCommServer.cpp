@@ -0,0 +1,464 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * EpollCommServer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifdef __linux__
+
+#include "MOOS/libMOOS/Comms/EpollCommServer.h"
+#include "MOOS/libMOOS/Comms/XPCTcpSocket.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
+#include "MOOS/libMOOS/Utils/ConsoleColours.h"
+#include "MOOS/libMOOS/Utils/ThreadPriority.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+const int kMaxEventsPerWait = 64;
+const int kWaitTimeoutMS = 1000;
+const int kMaxSegmentsPerSend = 64;
+
+bool WouldBlock(int nError)
+{
+    return nError==EAGAIN || nError==EWOULDBLOCK || nError==EINTR;
+}
+}
+
+namespace MOOS
+{
+
+EpollCommServer::EpollCommServer(unsigned int nLoops)
+{
+    nLoops = std::max(nLoops,1u);
+    for(unsigned int i = 0;i<nLoops;i++)
+        m_Loops.push_back(new EventLoop);
+}
+
+EpollCommServer::~EpollCommServer()
+{
+    Stop();
+}
+
+bool EpollCommServer::Stop()
+{
+    //let the threaded server close everything down first
+    bool bResult = ThreadedCommServer::Stop();
+
+    for(unsigned int i = 0;i<m_Loops.size();i++)
+        m_Loops[i]->Stop();
+
+    return bResult;
+}
+
+bool EpollCommServer::SupportsSharedMemoryClients()
+{
+    return false;
+}
+
+/**
+ * hand a new client to the least busy event loop
+ */
+ThreadedCommServer::SharedClientThread EpollCommServer::MakeClientThread(const std::string & sName,
+        XPCTcpSocket & NewClientSocket,
+        bool bAsync,
+        double dfConsolidationTime)
+{
+    SharedEventLoop pLoop = m_Loops.front();
+    for(unsigned int i = 1;i<m_Loops.size();i++)
+    {
+        if(m_Loops[i]->Size()<pLoop->Size())
+            pLoop = m_Loops[i];
+    }
+
+    pLoop->Start(m_bBoostIOThreads);
+
+    return new Connection(sName,
+            NewClientSocket,
+            m_SharedDataListFromClient,
+            bAsync,
+            dfConsolidationTime,
+            m_dfClientTimeout,
+            pLoop);
+}
+
+
+
+
+EpollCommServer::Connection::Connection(const std::string & sName,
+        XPCTcpSocket & ClientSocket,
+        SHARED_PKT_LIST & SharedDataIncoming,
+        bool bAsync,
+        double dfConsolidationPeriodMS,
+        double dfClientTimeout,
+        SharedEventLoop pLoop):
+            ClientThread(sName,ClientSocket,SharedDataIncoming,bAsync,dfConsolidationPeriodMS,dfClientTimeout,false),
+            m_pLoop(pLoop),
+            m_pPktRx(CMOOSCommPkt::Make(m_pPktPool)),
+            m_nWriteOffset(0),
+            m_dfLastGoodComms(MOOSLocalTime(false)),
+            m_bClosed(false)
+{
+}
+
+EpollCommServer::Connection::~Connection()
+{
+    Kill();
+}
+
+int EpollCommServer::Connection::GetFD()
+{
+    return m_ClientSocket.iGetSocketFd();
+}
+
+bool EpollCommServer::Connection::Start()
+{
+    return m_pLoop->Add(this);
+}
+
+bool EpollCommServer::Connection::Kill()
+{
+    m_pLoop->Remove(this);
+    return true;
+}
+
+bool EpollCommServer::Connection::SendToClient(ClientThreadSharedData & OutGoing)
+{
+    MOOS::ScopedLock L(m_WriteLock);
+
+    if(m_bClosed)
+        return false;
+
+    m_WriteQueue.push_back(OutGoing._pPkt);
+
+    //if there was already something waiting the loop is waiting for
+    //the socket to become writable and will send this too
+    if(m_WriteQueue.size()>1)
+        return true;
+
+    //if this fails the loop will notice the socket has gone
+    if(!FlushWrites())
+        return false;
+
+    if(!m_WriteQueue.empty())
+        m_pLoop->WatchWritable(this,true);
+
+    return true;
+}
+
+bool EpollCommServer::Connection::OnWritable()
+{
+    MOOS::ScopedLock L(m_WriteLock);
+
+    if(!FlushWrites())
+        return false;
+
+    if(m_WriteQueue.empty())
+        m_pLoop->WatchWritable(this,false);
+
+    return true;
+}
+
+bool EpollCommServer::Connection::FlushWrites()
+{
+    while(!m_WriteQueue.empty())
+    {
+        CMOOSCommPkt & Pkt = *m_WriteQueue.front();
+
+        //big payloads may not have been copied into the packet so gather
+        //what's left of it from wherever it lies
+        std::vector<CMOOSCommPkt::WireSegment> Segments;
+        Pkt.GetWireSegments(Segments,m_nWriteOffset);
+
+        struct iovec IOV[kMaxSegmentsPerSend];
+        struct msghdr Msg;
+        memset(&Msg,0,sizeof(Msg));
+        Msg.msg_iov = IOV;
+        Msg.msg_iovlen = std::min((int)Segments.size(),kMaxSegmentsPerSend);
+        for(unsigned int i = 0;i<Msg.msg_iovlen;i++)
+        {
+            IOV[i].iov_base = (void*)Segments[i].pData;
+            IOV[i].iov_len = Segments[i].nLength;
+        }
+
+        ssize_t nSent = sendmsg(GetFD(),&Msg,MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if(nSent<0)
+            return WouldBlock(errno);
+
+        m_nWriteOffset+=nSent;
+        if(m_nWriteOffset==Pkt.GetStreamLength())
+        {
+            m_WriteQueue.pop_front();
+            m_nWriteOffset = 0;
+        }
+    }
+    return true;
+}
+
+bool EpollCommServer::Connection::OnReadable()
+{
+    //read until the socket is dry
+    while(true)
+    {
+        int nRqd = m_pPktRx->GetBytesRequired();
+        if(nRqd<=0)
+            return false;
+
+        if(!m_RxBuffer.IsEmpty())
+        {
+            //packets already read ahead
+            if(!m_RxBuffer.Drain(*m_pPktRx))
+                return false;
+        }
+        else if((unsigned int)nRqd<m_RxBuffer.Capacity())
+        {
+            //take whatever the socket has - maybe many packets
+            ssize_t nRxd = recv(GetFD(),m_RxBuffer.WritePtr(),m_RxBuffer.Space(),MSG_DONTWAIT);
+
+            if(nRxd==0)
+                return false;
+
+            if(nRxd<0)
+                return WouldBlock(errno);
+
+            m_RxBuffer.OnBytesRead(nRxd);
+            m_dfLastGoodComms = MOOSLocalTime(false);
+            continue;
+        }
+        else
+        {
+            //the bulk of a big packet goes straight in
+            ssize_t nRxd = recv(GetFD(),m_pPktRx->NextWrite(),nRqd,MSG_DONTWAIT);
+
+            if(nRxd==0)
+                return false;
+
+            if(nRxd<0)
+                return WouldBlock(errno);
+
+            if(!m_pPktRx->OnBytesWritten(m_pPktRx->NextWrite(),nRxd))
+                return false;
+
+            m_dfLastGoodComms = MOOSLocalTime(false);
+        }
+
+        if(m_pPktRx->GetStreamLength()>(int)sizeof(int) && m_pPktRx->GetBytesRequired()==0)
+        {
+            //a whole packet - send it up the chain and start another
+            if(m_bCompactWire && !m_pPktRx->ReadCompact(m_RxDictionary))
+                return false;
+
+            ClientThreadSharedData SDUpChain;
+            SDUpChain._sClientName = m_sClientName;
+            SDUpChain._Status = ClientThreadSharedData::PKT_READ;
+            SDUpChain._pPkt = m_pPktRx;
+
+            m_ClientSocket.SetReadTime(MOOS::Time());
+
+            m_SharedDataIncoming.Push(SDUpChain);
+
+            m_pPktRx = CMOOSCommPkt::Make(m_pPktPool);
+        }
+    }
+}
+
+bool EpollCommServer::Connection::IsSilent(double dfTimeNow)
+{
+    return dfTimeNow-m_dfLastGoodComms>m_dfClientTimeout;
+}
+
+void EpollCommServer::Connection::OnClosed()
+{
+    m_WriteLock.Lock();
+    m_bClosed = true;
+    m_WriteQueue.clear();
+    m_WriteLock.UnLock();
+
+    ClientThreadSharedData SD(m_sClientName,ClientThreadSharedData::CONNECTION_CLOSED);
+    m_SharedDataIncoming.Push(SD);
+}
+
+
+
+
+EpollCommServer::EventLoop::EventLoop():m_bBoost(false)
+{
+    m_nEpollFD = epoll_create(kMaxEventsPerWait);
+    if(m_nEpollFD<0)
+        MOOSTrace("EpollCommServer failed to create epoll set : %s\n",strerror(errno));
+
+    m_Thread.Initialise(LoopEntry,this);
+    m_Thread.Name("EpollCommServer::EventLoop");
+}
+
+EpollCommServer::EventLoop::~EventLoop()
+{
+    Stop();
+    if(m_nEpollFD>=0)
+        close(m_nEpollFD);
+}
+
+bool EpollCommServer::EventLoop::Start(bool bBoost)
+{
+    if(m_Thread.IsThreadRunning())
+        return true;
+
+    m_bBoost = bBoost;
+    return m_Thread.Start();
+}
+
+bool EpollCommServer::EventLoop::Stop()
+{
+    return m_Thread.Stop();
+}
+
+unsigned int EpollCommServer::EventLoop::Size()
+{
+    MOOS::ScopedLock L(m_Lock);
+    return m_Connections.size();
+}
+
+bool EpollCommServer::EventLoop::Add(Connection * pConnection)
+{
+    MOOS::ScopedLock L(m_Lock);
+
+    struct epoll_event Event;
+    memset(&Event,0,sizeof(Event));
+    Event.events = EPOLLIN;
+    Event.data.ptr = pConnection;
+
+    if(epoll_ctl(m_nEpollFD,EPOLL_CTL_ADD,pConnection->GetFD(),&Event)!=0)
+        return MOOSFail("EpollCommServer cannot watch client %s : %s\n",
+                pConnection->GetClientName().c_str(),
+                strerror(errno));
+
+    m_Connections.insert(pConnection);
+    return true;
+}
+
+void EpollCommServer::EventLoop::Remove(Connection * pConnection)
+{
+    MOOS::ScopedLock L(m_Lock);
+
+    //the socket may already have gone but if we still know about the
+    //connection it has not
+    if(m_Connections.erase(pConnection)!=0)
+        epoll_ctl(m_nEpollFD,EPOLL_CTL_DEL,pConnection->GetFD(),NULL);
+}
+
+bool EpollCommServer::EventLoop::WatchWritable(Connection * pConnection, bool bWatch)
+{
+    struct epoll_event Event;
+    memset(&Event,0,sizeof(Event));
+    Event.events = bWatch ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    Event.data.ptr = pConnection;
+
+    return epoll_ctl(m_nEpollFD,EPOLL_CTL_MOD,pConnection->GetFD(),&Event)==0;
+}
+
+void EpollCommServer::EventLoop::Close(Connection * pConnection)
+{
+    //stop watching before anyone gets the chance to close the socket
+    m_Connections.erase(pConnection);
+    epoll_ctl(m_nEpollFD,EPOLL_CTL_DEL,pConnection->GetFD(),NULL);
+
+    pConnection->OnClosed();
+}
+
+bool EpollCommServer::EventLoop::Loop()
+{
+    if(m_bBoost)
+        MOOS::BoostThisThread();
+
+    struct epoll_event Events[kMaxEventsPerWait];
+    double dfLastSilenceCheck = MOOSLocalTime(false);
+
+    while(!m_Thread.IsQuitRequested())
+    {
+        int nEvents = epoll_wait(m_nEpollFD,Events,kMaxEventsPerWait,kWaitTimeoutMS);
+
+        if(nEvents<0 && errno!=EINTR)
+            return MOOSFail("EpollCommServer::EventLoop epoll_wait fails : %s\n",strerror(errno));
+
+        MOOS::ScopedLock L(m_Lock);
+
+        for(int i = 0;i<nEvents;i++)
+        {
+            Connection * pConnection = static_cast<Connection*>(Events[i].data.ptr);
+
+            //it may have been removed since we were woken
+            if(m_Connections.find(pConnection)==m_Connections.end())
+                continue;
+
+            bool bOK = true;
+            if(Events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                bOK = pConnection->OnReadable();
+
+            if(bOK && (Events[i].events & EPOLLOUT))
+                bOK = pConnection->OnWritable();
+
+            if(!bOK)
+                Close(pConnection);
+        }
+
+        //once a second look for clients who have gone quiet
+        double dfNow = MOOSLocalTime(false);
+        if(dfNow-dfLastSilenceCheck>1.0)
+        {
+            dfLastSilenceCheck = dfNow;
+
+            std::vector<Connection*> Silent;
+            std::set<Connection*>::iterator q;
+            for(q = m_Connections.begin();q!=m_Connections.end();++q)
+            {
+                if((*q)->IsSilent(dfNow))
+                    Silent.push_back(*q);
+            }
+
+            for(unsigned int j = 0;j<Silent.size();j++)
+            {
+                std::cout<<MOOS::ConsoleColours::Red();
+                std::cout<<"Disconnecting \""<<Silent[j]->GetClientName()<<"\" after a long silence\n";
+                std::cout<<MOOS::ConsoleColours::reset();
+                Close(Silent[j]);
+            }
+        }
+    }
+
+    return true;
+}
+
+}
+
+#endif // __linux__
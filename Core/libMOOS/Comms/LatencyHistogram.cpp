@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * LatencyHistogram.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/LatencyHistogram.h"
+
+namespace
+{
+unsigned int HighestBit(uint64_t n)
+{
+    unsigned int nBit = 0;
+    while(n>>=1)
+        nBit++;
+    return nBit;
+}
+}
+
+namespace MOOS
+{
+
+LatencyHistogram::LatencyHistogram()
+    :m_nCount(0),m_nSum(0)
+{
+}
+
+unsigned int LatencyHistogram::BucketFor(int64_t nMicroSeconds)
+{
+    if(nMicroSeconds<kSubBuckets)
+        return nMicroSeconds<0 ? 0 : (unsigned int)nMicroSeconds;
+
+    uint64_t n = (uint64_t)nMicroSeconds;
+    unsigned int nBit = HighestBit(n);
+    if(nBit>=kMaxValueBits)
+        return kNumBuckets-1;
+
+    //which power of two and how far along it
+    unsigned int nShift = nBit-kSubBucketBits;
+    return (nShift+1)*kSubBuckets+(unsigned int)((n>>nShift)-kSubBuckets);
+}
+
+uint64_t LatencyHistogram::BucketLowest(unsigned int nBucket)
+{
+    if(nBucket<kSubBuckets)
+        return nBucket;
+    unsigned int nShift = nBucket/kSubBuckets-1;
+    return (uint64_t)(kSubBuckets+nBucket%kSubBuckets)<<nShift;
+}
+
+uint64_t LatencyHistogram::BucketHighest(unsigned int nBucket)
+{
+    if(nBucket<kSubBuckets)
+        return nBucket;
+    unsigned int nShift = nBucket/kSubBuckets-1;
+    return BucketLowest(nBucket)+((uint64_t)1<<nShift)-1;
+}
+
+void LatencyHistogram::Record(int64_t nMicroSeconds, uint64_t nCount)
+{
+    if(nCount==0)
+        return;
+    m_Counts[BucketFor(nMicroSeconds)]+=nCount;
+    m_nCount+=nCount;
+    if(nMicroSeconds>0)
+        m_nSum+=(uint64_t)nMicroSeconds*nCount;
+}
+
+uint64_t LatencyHistogram::GetBucketCount(unsigned int nBucket) const
+{
+    COUNTS::const_iterator q = m_Counts.find(nBucket);
+    return q==m_Counts.end() ? 0 : q->second;
+}
+
+void LatencyHistogram::AddToBucket(unsigned int nBucket, uint64_t nCount)
+{
+    if(nBucket>=kNumBuckets || nCount==0)
+        return;
+    m_Counts[nBucket]+=nCount;
+    m_nCount+=nCount;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double dfPercent) const
+{
+    if(m_nCount==0)
+        return 0;
+
+    //the rank of the value we want (1 based)
+    uint64_t nRank = (uint64_t)(dfPercent/100.0*m_nCount+0.5);
+    if(nRank<1)
+        nRank = 1;
+
+    uint64_t nSeen = 0;
+    COUNTS::const_iterator q;
+    for(q = m_Counts.begin();q!=m_Counts.end();++q)
+    {
+        nSeen+=q->second;
+        if(nSeen>=nRank)
+            return BucketHighest(q->first);
+    }
+    return GetMax();
+}
+
+uint64_t LatencyHistogram::GetMax() const
+{
+    return m_Counts.empty() ? 0 : BucketHighest(m_Counts.rbegin()->first);
+}
+
+double LatencyHistogram::GetMean() const
+{
+    return m_nCount==0 ? 0.0 : double(m_nSum)/double(m_nCount);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram & Other)
+{
+    COUNTS::const_iterator q;
+    for(q = Other.m_Counts.begin();q!=Other.m_Counts.end();++q)
+        m_Counts[q->first]+=q->second;
+    m_nCount+=Other.m_nCount;
+    m_nSum+=Other.m_nSum;
+}
+
+void LatencyHistogram::Clear()
+{
+    m_Counts.clear();
+    m_nCount = 0;
+    m_nSum = 0;
+}
+
+void LatencyHistogram::WriteVarint(std::string & sOut, uint64_t nValue)
+{
+    while(nValue>=0x80)
+    {
+        sOut.push_back((char)((nValue & 0x7F) | 0x80));
+        nValue>>=7;
+    }
+    sOut.push_back((char)nValue);
+}
+
+bool LatencyHistogram::ReadVarint(const std::string & sIn, size_t & nPos, uint64_t & nValue)
+{
+    nValue = 0;
+    for(unsigned int nShift = 0;nShift<64;nShift+=7)
+    {
+        if(nPos>=sIn.size())
+            return false;
+        unsigned char c = (unsigned char)sIn[nPos++];
+        nValue |= (uint64_t)(c & 0x7F)<<nShift;
+        if((c & 0x80)==0)
+            return true;
+    }
+    return false;
+}
+
+void LatencyHistogram::Encode(std::string & sOut) const
+{
+    //the sum then (gap, count) pairs for each occupied bucket
+    WriteVarint(sOut,m_nSum);
+    WriteVarint(sOut,m_Counts.size());
+
+    unsigned int nLast = 0;
+    COUNTS::const_iterator q;
+    for(q = m_Counts.begin();q!=m_Counts.end();++q)
+    {
+        WriteVarint(sOut,q->first-nLast);
+        WriteVarint(sOut,q->second);
+        nLast = q->first;
+    }
+}
+
+bool LatencyHistogram::Decode(const std::string & sIn, size_t & nPos)
+{
+    Clear();
+
+    uint64_t nSum,nOccupied;
+    if(!ReadVarint(sIn,nPos,nSum) || !ReadVarint(sIn,nPos,nOccupied))
+        return false;
+    if(nOccupied>kNumBuckets)
+        return false;
+
+    uint64_t nBucket = 0;
+    for(uint64_t i = 0;i<nOccupied;i++)
+    {
+        uint64_t nGap,nCount;
+        if(!ReadVarint(sIn,nPos,nGap) || !ReadVarint(sIn,nPos,nCount))
+            return false;
+        nBucket+=nGap;
+        if(nBucket>=kNumBuckets)
+            return false;
+        AddToBucket((unsigned int)nBucket,nCount);
+    }
+    m_nSum = nSum;
+    return true;
+}
+
+}
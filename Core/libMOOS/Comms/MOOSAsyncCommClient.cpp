@@ -35,6 +35,8 @@
 #include <iostream>
 #include <iomanip>
 #include <cassert>
+#include <ctime>
+#include <algorithm>
 
 #include "MOOS/libMOOS/Utils/MOOSUtils.h"
 #include "MOOS/libMOOS/Utils/MOOSException.h"
@@ -57,6 +59,9 @@ ThreadPrint  gMOOSAsyncCommsClientPrinter(std::cerr);
 
 #define TIMING_MESSAGE_PERIOD 1.0
 
+//how long to post a variable the long way after the DB refused a stub for it
+#define P2P_REFUSAL_PERIOD 5.0
+
 
 bool AsyncCommsReaderDispatch(void * pParam) {
     MOOSAsyncCommClient *pMe = (MOOSAsyncCommClient*) pParam;
@@ -69,11 +74,27 @@ bool AsyncCommsWriterDispatch(void * pParam) {
     return pMe->WritingLoop();
 }
 
+bool AsyncCommsPeerMailDispatch(MOOSMSG_LIST & Mail, void * pParam) {
+    MOOSAsyncCommClient *pMe = (MOOSAsyncCommClient*) pParam;
+    return pMe->OnPeerMail(Mail);
+}
+
 ///default constructor
 MOOSAsyncCommClient::MOOSAsyncCommClient() {
     m_dfLastTimingMessage = 0.0;
     m_dfOutGoingDelay = 0.0;
     m_bPostNewestToFront = false;
+    m_nPeerToPeerThreshold = 0;
+    m_dfWriteBatchDelay = 0.0;
+    m_nWriteBatchBytes = 0;
+    m_nOutGoingBytes = 0;
+    m_dfLastWriteTime = 0.0;
+    m_nPktsSent = 0;
+    m_nBatchWaits = 0;
+    m_nFullBatches = 0;
+    m_nBatchWaitMicroSeconds = 0;
+    m_PeerLinks.SetMailCallBack(AsyncCommsPeerMailDispatch, this);
+    m_bFollowsStubs = true;
 
 //    SetCommsControlTimeWarpScaleFactor(0.0);
 }
@@ -93,6 +114,9 @@ void MOOSAsyncCommClient::DoBanner() {
 bool MOOSAsyncCommClient::StartThreads() {
     m_bQuit = false;
 
+    m_PeerLinks.SetSharedMemory(m_bOfferSharedMemory);
+    m_PeerLinks.SetTCPNoDelay(m_bDisableNagle);
+
     if (!WritingThread_.Initialise(AsyncCommsWriterDispatch, this))
         return false;
 
@@ -122,6 +146,9 @@ bool MOOSAsyncCommClient::Close(bool) {
     if (!ReadingThread_.Stop())
         return false;
 
+    m_PeerLinks.Close();
+    m_PeerServer.Stop();
+
     OutGoingQueue_.Push(CMOOSMsg(MOOS_TERMINATE_CONNECTION,"-quit-", 0));
 
     if (!WritingThread_.Stop())
@@ -136,28 +163,148 @@ bool MOOSAsyncCommClient::Flush() {
 
 bool MOOSAsyncCommClient::Post(CMOOSMsg & Msg, bool bKeepMsgSourceName) {
 
-    if(!BASE::Post(Msg, bKeepMsgSourceName))
+    //big binary payloads can go straight to those who want them with
+    //only a stub going via the DB. The peer server keeps its own copy
+    if (IsPeerToPeer(Msg)) {
+        CMOOSMsg Stub;
+        if (m_PeerServer.Publish(Msg, Stub))
+            return Post(Stub, bKeepMsgSourceName);
+    }
+
+    if (!IsConnected())
+        return false;
+
+    //no out box and no lock - the writer's queue takes pushes from any thread
+    PrepareToPost(Msg, bKeepMsgSourceName);
+
+    LimitOutGoingQueue();
+
+    m_nOutGoingBytes += Msg.GetSizeInBytesWhenSerialised();
+    OutGoingQueue_.Push(Msg);
+
+    return true;
+}
+
+bool MOOSAsyncCommClient::Post(MOOSMSG_LIST & Msgs, bool bKeepMsgSourceName) {
+
+    if (!IsConnected())
+        return false;
+
+    //big binary payloads go their own way
+    if (m_nPeerToPeerThreshold > 0) {
+        MOOSMSG_LIST::iterator q = Msgs.begin();
+        while (q != Msgs.end()) {
+            if (IsPeerToPeer(*q)) {
+                Post(*q, bKeepMsgSourceName);
+                q = Msgs.erase(q);
+            } else {
+                ++q;
+            }
+        }
+    }
+
+    if (Msgs.empty())
+        return true;
+
+    unsigned int nBytes = 0;
+    MOOSMSG_LIST::iterator q;
+    for (q = Msgs.begin(); q != Msgs.end(); ++q) {
+        PrepareToPost(*q, bKeepMsgSourceName);
+        nBytes += q->GetSizeInBytesWhenSerialised();
+    }
+
+    LimitOutGoingQueue();
+
+    //straight into the writer's queue as one batch so it can't be split
+    //across packets
+    m_nOutGoingBytes += nBytes;
+    OutGoingQueue_.AppendToMeInConstantTime(Msgs);
+
+    return true;
+}
+
+void MOOSAsyncCommClient::LimitOutGoingQueue() {
+
+    if (OutGoingQueue_.Size() <= OUTBOX_PENDING_LIMIT)
+        return;
+
+    std::cerr << MOOS::ConsoleColours::red() << "WARNING "
+            << MOOS::ConsoleColours::reset()
+            << "MOOSAsyncCommClient::Outbox is very full "
+                "- ditching half of the unsent mail\n";
+
+    CMOOSMsg Discard;
+    while (OutGoingQueue_.Size() > OUTBOX_PENDING_LIMIT / 2
+            && OutGoingQueue_.Pull(Discard))
+        m_nOutGoingBytes -= Discard.GetSizeInBytesWhenSerialised();
+}
+
+bool MOOSAsyncCommClient::SetPeerToPeerThreshold(unsigned int nBytes) {
+    m_nPeerToPeerThreshold = nBytes;
+    return true;
+}
+
+bool MOOSAsyncCommClient::IsPeerToPeer(const CMOOSMsg & Msg) {
+
+    if (m_nPeerToPeerThreshold == 0 || !Msg.IsType(MOOS_NOTIFY)
+            || !Msg.IsBinary() || Msg.m_sVal.size() < m_nPeerToPeerThreshold)
         return false;
 
-    m_OutLock.Lock();
     {
-        if (OutGoingQueue_.Size() > OUTBOX_PENDING_LIMIT) {
-            std::cerr << MOOS::ConsoleColours::red() << "WARNING "
-                    << MOOS::ConsoleColours::reset()
-                    << "MOOSAsyncCommClient::Outbox is very full "
-                        "- ditching half of the unsent mail\n";
-
-            while (OutGoingQueue_.Size() > OUTBOX_PENDING_LIMIT / 2)
-                OutGoingQueue_.Pop();
+        MOOS::ScopedLock L(m_PeerToPeerLock);
+        std::map<std::string, double>::iterator q = m_PeerToPeerRefusals.find(
+                Msg.GetKey());
+        if (q != m_PeerToPeerRefusals.end()) {
+            if (MOOSLocalTime() - q->second < P2P_REFUSAL_PERIOD)
+                return false;
+            m_PeerToPeerRefusals.erase(q);
         }
-        OutGoingQueue_.AppendToMeInConstantTime(m_OutBox);
-        //std::cerr<<"OutGoingQueue_ : "<<OutGoingQueue_.Size()<<"\n";
     }
-    m_OutLock.UnLock();
 
+    return m_PeerServer.Run(m_bOfferSharedMemory, m_bDisableNagle);
+}
+
+bool MOOSAsyncCommClient::OnPeerToPeerRefused(const CMOOSMsg & Refusal) {
+
+    //someone who can't follow stubs wants this variable - for a while
+    //send it the long way...
+    m_PeerToPeerLock.Lock();
+    m_PeerToPeerRefusals[Refusal.GetKey()] = MOOSLocalTime();
+    m_PeerToPeerLock.UnLock();
+
+    //...starting with the sample the DB turned down
+    CMOOSMsg Msg;
+    if (!m_PeerServer.GetPublished(Refusal.GetKey(),
+            MOOS::P2P::GetSequence(Refusal), Msg))
+        return false;
+
+    return Post(Msg, true);
+}
+
+bool MOOSAsyncCommClient::SetWriteBatching(double dfMaxDelay, unsigned int nMaxBytes) {
+    if (dfMaxDelay < 0)
+        return false;
+    m_dfWriteBatchDelay = dfMaxDelay;
+    m_nWriteBatchBytes = nMaxBytes;
     return true;
 }
 
+uint64_t MOOSAsyncCommClient::GetNumPktsSent() {
+    return m_nPktsSent;
+}
+
+uint64_t MOOSAsyncCommClient::GetNumBatchWaits() {
+    return m_nBatchWaits;
+}
+
+uint64_t MOOSAsyncCommClient::GetNumFullBatches() {
+    return m_nFullBatches;
+}
+
+double MOOSAsyncCommClient::GetBatchWaitTime() {
+    return m_nBatchWaitMicroSeconds*1e-6;
+}
+
 bool MOOSAsyncCommClient::OnCloseConnection() {
     return BASE::OnCloseConnection();
 }
@@ -225,6 +372,8 @@ bool MOOSAsyncCommClient::WritingLoop() {
                     OutGoingQueue_.WaitForPush(nMSToWait);
                 }
 
+                WaitForBatch();
+
                 if (!DoWriting())
                 {
                     OnCloseConnection();
@@ -259,6 +408,43 @@ bool MOOSAsyncCommClient::WritingLoop() {
 
 
 
+void MOOSAsyncCommClient::WaitForBatch() {
+
+    if (m_dfWriteBatchDelay <= 0.0 || OutGoingQueue_.IsEmpty())
+        return;
+
+    //if things are quiet waiting would only add latency
+    double dfStart = MOOSLocalTime(false);
+    if (dfStart - m_dfLastWriteTime >= m_dfWriteBatchDelay)
+        return;
+
+    m_nBatchWaits++;
+
+    //sleep on the queue until either the deadline passes or enough has
+    //been pushed to fill a packet - posters wake us, we don't poll them
+    double dfDeadline = dfStart + m_dfWriteBatchDelay;
+    double dfNow = dfStart;
+    while (!WritingThread_.IsQuitRequested()) {
+
+        //read the count before the bytes so a push in between isn't missed
+        uint64_t nPushes = OutGoingQueue_.GetPushCount();
+
+        if (m_nWriteBatchBytes > 0 && m_nOutGoingBytes >= m_nWriteBatchBytes) {
+            m_nFullBatches++;
+            break;
+        }
+
+        long nMicroSeconds = (long) ((dfDeadline - dfNow) * 1e6);
+        if (nMicroSeconds <= 0)
+            break;
+
+        OutGoingQueue_.WaitForPushSince(nPushes, nMicroSeconds);
+        dfNow = MOOSLocalTime(false);
+    }
+
+    m_nBatchWaitMicroSeconds += (uint64_t) ((dfNow - dfStart) * 1e6);
+}
+
 bool MOOSAsyncCommClient::DoWriting() {
 
     //this is the IO Loop
@@ -269,17 +455,25 @@ bool MOOSAsyncCommClient::DoWriting() {
 
         MOOSMSG_LIST StuffToSend;
 
+        //the queue never hands over part of a batch
         OutGoingQueue_.AppendToOtherInConstantTime(StuffToSend);
 
+        unsigned int nBytes = 0;
+        bool bTerminate = false;
         for (MOOSMSG_LIST::iterator q = StuffToSend.begin(); q
                 != StuffToSend.end(); ++q)
         {
-            if (q->IsType(MOOS_TERMINATE_CONNECTION))
-            {
-                //std::cerr<<"writing thread receives terminate connection request from sibling reader thread\n";
-                return false;
-            }
-            m_nMsgsSent++;
+            nBytes += q->GetSizeInBytesWhenSerialised();
+            bTerminate |= q->IsType(MOOS_TERMINATE_CONNECTION);
+            if (!bTerminate)
+                m_nMsgsSent++;
+        }
+        m_nOutGoingBytes -= nBytes;
+
+        if (bTerminate)
+        {
+            //std::cerr<<"writing thread receives terminate connection request from sibling reader thread\n";
+            return false;
         }
 
         //and once in a while we shall send a timing
@@ -297,11 +491,14 @@ bool MOOSAsyncCommClient::DoWriting() {
         }
 
         //convert our out box to a single packet
-        CMOOSCommPkt PktTx;
+        CMOOSCommPkt PktTx(m_pPktPool);
 
         try
         {
-            PktTx.Serialize(StuffToSend, true);
+            //StuffToSend outlives the send so big payloads needn't be copied
+            PktTx.SetWireDictionary(GetTxDictionary());
+            PktTx.Serialize(StuffToSend, MOOSMSG_PTR_LIST(), true);
+            CompressIfAgreed(PktTx);
             m_nBytesSent += PktTx.GetStreamLength();
         }
         catch (const CMOOSException & e) {
@@ -314,6 +511,9 @@ bool MOOSAsyncCommClient::DoWriting() {
         //finally the send....
         SendPkt(m_pSocket, PktTx);
 
+        m_nPktsSent++;
+        m_dfLastWriteTime = MOOSLocalTime(false);
+
         MonitorAndLimitWriteSpeed();
 
     } catch (const CMOOSException & e) {
@@ -392,6 +592,33 @@ bool MOOSAsyncCommClient::ReadingLoop() {
 }
 
 
+bool MOOSAsyncCommClient::OnPeerMail(MOOSMSG_LIST & Mail)
+{
+	m_InLock.Lock();
+	{
+		m_nMsgsReceived+=Mail.size();
+
+		size_t nAlreadyInBox = m_InBox.size();
+		m_InBox.splice(m_InBox.end(),Mail);
+
+		AuditIncomingMail(nAlreadyInBox);
+
+		DispatchInBoxToActiveThreads();
+
+		m_bMailPresent = !m_InBox.empty();
+	}
+	m_InLock.UnLock();
+
+	if(m_pfnMailCallBack!=NULL && m_bMailPresent)
+	{
+		bool bUserResult = (*m_pfnMailCallBack)(m_pMailCallBackParam);
+		if(!bUserResult)
+			MOOSTrace("user mail callback returned false..is all ok?\n");
+	}
+
+	return true;
+}
+
 bool MOOSAsyncCommClient::IsRunning() {
     return WritingThread_.IsThreadRunning() || ReadingThread_.IsThreadRunning();
 }
@@ -401,7 +628,7 @@ bool MOOSAsyncCommClient::DoReading()
 
 	try
 	{
-		CMOOSCommPkt PktRx;
+		CMOOSCommPkt PktRx(m_pPktPool);
 
 		ReadPkt(m_pSocket,PktRx);
 
@@ -491,6 +718,37 @@ bool MOOSAsyncCommClient::DoReading()
                 }
             }
 
+            //stubs of payloads sent directly by their writers mean we
+            //should ask the writer for them. Refusals mean we should
+            //stop sending stubs
+            MOOSMSG_LIST::iterator s = m_InBox.begin();
+            std::advance(s,std::min<size_t>(nur,m_InBox.size()));
+            while(s!=m_InBox.end())
+            {
+                bool bTaken = false;
+                if(MOOS::P2P::IsStub(*s))
+                    bTaken = m_PeerLinks.OnStub(*s);
+                else if(MOOS::P2P::IsRefusal(*s))
+                {
+                    OnPeerToPeerRefused(*s);
+                    bTaken = true;
+                }
+
+                if(bTaken)
+                {
+                    m_InBox.erase(s++);
+                    m_nMsgsReceived--;
+                }
+                else
+                {
+                    ++s;
+                }
+            }
+
+			CollectServerReplies(nur);
+
+			AuditIncomingMail(nur);
+
 			DispatchInBoxToActiveThreads();
 
 			m_bMailPresent = !m_InBox.empty();
@@ -108,6 +108,7 @@ CMOOSCommClient::CMOOSCommClient()
         m_dfLastConnectionTime = -1;
 	m_nFundamentalFreq = CLIENT_DEFAULT_FUNDAMENTAL_FREQ;
 	m_nNextMsgID=0;
+	m_nNextServerRequestID = MOOS_SERVER_REQUEST_ID-1;
 	m_bFakeSource = false;
     m_bQuiet= false;
     m_bMonitorClientCommsStatus = false;
@@ -130,6 +131,11 @@ CMOOSCommClient::CMOOSCommClient()
 
 	//assume an old DB
 	m_bDBIsAsynchronous = false;
+	m_bDBAcceptsCompression = false;
+	m_nCompressionThreshold = 0;
+	m_bOfferSharedMemory = false;
+	m_bFollowsStubs = false;
+	m_bLatencyAudit = false;
 
 	SetCommsControlTimeWarpScaleFactor(TIME_WARP_AGGLOMERATION_CONSTANT);
 
@@ -138,8 +144,7 @@ CMOOSCommClient::CMOOSCommClient()
 	SocketsInit();
 
 #ifdef ENABLE_DETAILED_TIMING_AUDIT
-    std::cerr<<"starting detailed timing audit\n";
-    end_to_end_auditor_.Start();
+    EnableLatencyAudit(true);
 #endif
 
 
@@ -451,6 +456,8 @@ void CMOOSCommClient::PrintMessageToActiveQueueRouting()
 	std::cerr<<MOOS::ConsoleColours::reset();
 
 
+	MOOS::ScopedLock L(ActiveQueuesLock_);
+
 	for(q = Msg2ActiveQueueName_.begin();q!=Msg2ActiveQueueName_.end();++q)
 	{
 		//get a list of all queues which handle this message
@@ -459,16 +466,20 @@ void CMOOSCommClient::PrintMessageToActiveQueueRouting()
 		std::cerr<<std::setw(10)<< q->first<<" -> queues{ ";
 		for(p = rQL.begin();p!=rQL.end();++p)
 		{
-			if(WildcardQueuePatterns_.find(*p)!=WildcardQueuePatterns_.end())
-			{
-				std::cerr<<MOOS::ConsoleColours::Magenta()<<"*";
-			}
 			std::cerr<< "\""<<*p<<"\"";
-			std::cerr<<MOOS::ConsoleColours::reset()<<" ";
+			std::cerr<<" ";
 		}
 		std::cerr<<"}\n";
 	}
 
+	//and the wildcard queues which pick up anything matching their pattern
+	std::map<std::string, std::string >::iterator w;
+	for(w = WildcardQueuePatterns_.begin();w!=WildcardQueuePatterns_.end();++w)
+	{
+		std::cerr<<MOOS::ConsoleColours::Magenta()<<std::setw(10)<<w->second
+				<<" -> queues{ *\""<<w->first<<"\" }\n";
+	}
+
 	std::cerr<<MOOS::ConsoleColours::reset();
 
 
@@ -491,10 +502,12 @@ bool CMOOSCommClient::RemoveActiveQueue(const std::string & sQueueName)
 		}
 	}
 
-    std::map<std::string,MOOS::ActiveMailQueue*>::iterator w =  ActiveQueueMap_.find(sQueueName);
+    ACTIVE_QUEUE_MAP::iterator w =  ActiveQueueMap_.find(sQueueName);
     if(w!=ActiveQueueMap_.end())
     {
-    	delete w->second;
+    	//the dispatching thread may still have hold of it
+    	//so let the last one out delete it
+    	w->second->Stop();
     	ActiveQueueMap_.erase(w);
     }
     else
@@ -504,6 +517,8 @@ bool CMOOSCommClient::RemoveActiveQueue(const std::string & sQueueName)
     //and remove from wildcard queue (if it is there)
     WildcardQueuePatterns_.erase(sQueueName);
 
+    InvalidateActiveQueueRoutes();
+
 	return true;
 }
 
@@ -531,10 +546,13 @@ bool CMOOSCommClient::RemoveMessageRouteToActiveQueue(std::string const& sQueueN
 
     std::map<std::string,std::set<std::string>  >::iterator w = Msg2ActiveQueueName_.find(sMsgName);
 
-    if(w==Msg2ActiveQueueName_.end())
+    if(w==Msg2ActiveQueueName_.end() || w->second.erase(sQueueName)==0)
         return false;
 
-    Msg2ActiveQueueName_.erase(w);
+    if(w->second.empty())
+        Msg2ActiveQueueName_.erase(w);
+
+    InvalidateActiveQueueRoutes();
 
     return true;
 
@@ -558,7 +576,7 @@ bool CMOOSCommClient::AddActiveQueue(const std::string & sQueueName,
 {
 	MOOS::ScopedLock L(ActiveQueuesLock_);
 
-	std::map<std::string,MOOS::ActiveMailQueue*>::iterator w =  ActiveQueueMap_.find(sQueueName);
+	ACTIVE_QUEUE_MAP::iterator w =  ActiveQueueMap_.find(sQueueName);
 	if(w==ActiveQueueMap_.end())
 	{
 		//we need to create a new queue
@@ -590,18 +608,9 @@ bool CMOOSCommClient::AddWildcardActiveQueue(const std::string & sQueueName,
 
 	WildcardQueuePatterns_[sQueueName]=sPattern;
 
-	//now we had better see if this new wildcard queue is interested
-	//in any messages we have already seen
-	std::set< std::string>::iterator q;
-
-	for(q=WildcardCheckSet_.begin();q!=WildcardCheckSet_.end();++q)
-	{
-		if(MOOSWildCmp(sPattern,*q))
-		{
-			Msg2ActiveQueueName_[*q].insert(sQueueName);
-		}
-	}
-
+	//this new wildcard queue may be interested in
+	//messages we have already seen
+	InvalidateActiveQueueRoutes();
 
 	return true;
 
@@ -621,6 +630,8 @@ bool CMOOSCommClient::AddMessageRouteToActiveQueue(const std::string & sQueueNam
 		//to by this message name
 		Msg2ActiveQueueName_[sMsgName].insert(sQueueName);
 
+		InvalidateActiveQueueRoutes();
+
 		return true;
 	}
 	else
@@ -637,6 +648,44 @@ bool CMOOSCommClient::HasActiveQueue(const std::string & sQueueName)
 	return ActiveQueueMap_.find(sQueueName)!=ActiveQueueMap_.end();
 }
 
+void CMOOSCommClient::InvalidateActiveQueueRoutes()
+{
+	//don't clear the table - the dispatching thread may be reading it
+	ActiveQueueRoutes_ = NULL;
+}
+
+void CMOOSCommClient::FindActiveQueuesFor(const std::string & sMsgName,
+                                          std::vector<SharedActiveMailQueue> & Queues)
+{
+	std::set<std::string> Names;
+
+	//queues this message has been explicitly routed to...
+	std::map<std::string, std::set<std::string> >::iterator q = Msg2ActiveQueueName_.find(sMsgName);
+	if(q!=Msg2ActiveQueueName_.end())
+		Names = q->second;
+
+	//...and the wildcard queues which match it
+	std::map<std::string, std::string  >::iterator w;
+	for(w = WildcardQueuePatterns_.begin();w!=WildcardQueuePatterns_.end();++w)
+	{
+		if(MOOSWildCmp(w->second,sMsgName))
+			Names.insert(w->first);
+	}
+
+	std::set<std::string>::iterator r;
+	for(r = Names.begin();r!=Names.end();++r)
+	{
+		ACTIVE_QUEUE_MAP::iterator v = ActiveQueueMap_.find(*r);
+		if(v==ActiveQueueMap_.end())
+		{
+			//this is bad news - we have be told to use a queue
+			//which does not exist.
+			throw std::runtime_error("active queue "+*r+" not found");
+		}
+		Queues.push_back(v->second);
+	}
+}
+
 bool CMOOSCommClient::DoClientWork()
 {
 	//this existence of this object makes this scope
@@ -652,7 +701,7 @@ bool CMOOSCommClient::DoClientWork()
 			return false;
 
 		//note the symmetry here... a warm feeling
-		CMOOSCommPkt PktTx,PktRx;
+		CMOOSCommPkt PktTx(m_pPktPool),PktRx(m_pPktPool);
 
 		m_OutLock.Lock();
 		{
@@ -670,7 +719,9 @@ bool CMOOSCommClient::DoClientWork()
 			//convert our out box to a single packet
 			try
 			{
+				PktTx.SetWireDictionary(GetTxDictionary());
 				PktTx.Serialize(m_OutBox,true);
+				CompressIfAgreed(PktTx);
 				m_nMsgsSent+=PktTx.GetNumMessagesSerialised();
 				m_nBytesSent+=PktTx.GetStreamLength();
 			}
@@ -724,6 +775,7 @@ bool CMOOSCommClient::DoClientWork()
 				MOOSTrace("Too many unread incoming messages [%d] : purging\n",num_pending);
 				MOOSTrace("The user must read mail occasionally");
 				m_InBox.clear();
+				num_pending = 0;
 			}
 
 			//convert reply into a list of mesasges :-)
@@ -747,6 +799,10 @@ bool CMOOSCommClient::DoClientWork()
             }
 
 
+			CollectServerReplies(num_pending);
+
+			AuditIncomingMail(num_pending);
+
 			//here we dispatch to special call backs managed by threads
 			DispatchInBoxToActiveThreads();
 
@@ -775,133 +831,80 @@ bool CMOOSCommClient::DoClientWork()
 }
 
 
-bool CMOOSCommClient::DispatchInBoxToActiveThreads()
+void CMOOSCommClient::EnableLatencyAudit(bool bEnable)
 {
+	if(!bEnable || m_bLatencyAudit)
+		return;
 
+	if(!m_bQuiet)
+		std::cerr<<"starting end to end latency audit\n";
+	end_to_end_auditor_.Start();
+	m_bLatencyAudit = true;
+}
 
-	//here we dispatch to special callbacks managed by threads
 
-	MOOS::ScopedLock L(ActiveQueuesLock_);
+void CMOOSCommClient::AuditIncomingMail(size_t nAlreadyInBox)
+{
+	if(!m_bLatencyAudit || m_InBox.size()<=nAlreadyInBox)
+		return;
 
-#ifdef ENABLE_DETAILED_TIMING_AUDIT
-    double time_now = MOOSLocalTime();
-#endif
-	//before we start we can see if we have a default queue installed...
-	std::map<std::string, std::set<std::string> >::iterator q;
+	double dfTimeNow = MOOSLocalTime();
 
 	MOOSMSG_LIST::iterator t = m_InBox.begin();
+	std::advance(t,nAlreadyInBox);
+	for(;t!=m_InBox.end();++t)
+		end_to_end_auditor_.AddForAudit(*t,m_sMyName,dfTimeNow);
+}
 
-	//iterate over all pending messages.
-	while(t!=m_InBox.end())
-	{
 
-#ifdef ENABLE_DETAILED_TIMING_AUDIT
-    end_to_end_auditor_.AddForAudit(*t,m_sMyName,time_now);
-#endif
+bool CMOOSCommClient::DispatchInBoxToActiveThreads()
+{
+	//here we dispatch to special callbacks managed by threads. We hold on to
+	//the current routing table so the lock is only needed for messages
+	//we have never seen before
+	MOOS::Poco::SharedPtr<ACTIVE_QUEUE_ROUTES> pRoutes;
+	{
+		MOOS::ScopedLock L(ActiveQueuesLock_);
+		if(ActiveQueueMap_.empty())
+			return true;
 
-//	    std::cerr<<"Inbox size:"<<m_InBox.size()<<"\n";
-//	    t->Trace();
+		if(ActiveQueueRoutes_.isNull())
+			ActiveQueueRoutes_ = new ACTIVE_QUEUE_ROUTES;
+		pRoutes = ActiveQueueRoutes_;
+	}
 
-		//does this message have a active queue mapping?
-		q= Msg2ActiveQueueName_.find(t->GetKey());
+	MOOSMSG_LIST::iterator t = m_InBox.begin();
 
-		//have we ever checked this message against the wildcard queues?
-		std::set<std::string>::iterator u  =  WildcardCheckSet_.find(t->GetKey());
+	//iterate over all pending messages.
+	while(t!=m_InBox.end())
+	{
 
-		if(q==Msg2ActiveQueueName_.end() || u==WildcardCheckSet_.end() )
+		//which queues want this message?
+		ACTIVE_QUEUE_ROUTES::iterator q = pRoutes->find(t->GetKey());
+		if(q==pRoutes->end())
 		{
-			//maybe the wildcard queues are interested?
-			//or maybe this is a new message whihc has not been seen by wildcard queues
-
-			//each element is a <nickname,pattern> string pair;
-			std::map<std::string, std::string  >::iterator w;
-
-			bool bFoundWCMatch = false;
-			for(w = WildcardQueuePatterns_.begin();w!=WildcardQueuePatterns_.end();++w)
-			{
-				std::string sPattern = w->second;
-				//build a list of all wc queues that match this message
-				//add these queues to the list of queues pointed to by this message
-				if(MOOSWildCmp(sPattern,t->GetKey()))
-				{
-//				    std::cerr<<"found wildcard match adding queue  "<<w->first
-//				            <<" to routing for "<<t->GetKey()<<"\n";
-
-					Msg2ActiveQueueName_[t->GetKey()].insert(w->first);
-					bFoundWCMatch = true;
-				}
-			}
-
-			//remember all messages that have been received...
-			//we do it here because at this point wild card queue have been given
-			//the option to register their interest....
-			//but what to do if a wc queue in installed at run time...?
-			WildcardCheckSet_.insert(t->GetKey());
-
-			//std::cerr<<"added key"<<t->GetKey()<<" to wildcard chacek set\n";
-
-			//if we found a least one mapping simply go again without
-			//incrementing t...smart
-			if(bFoundWCMatch)
+			//first time we have seen it so work it out
+			std::vector<SharedActiveMailQueue> Queues;
 			{
-			    continue;
-			}
-			else
-			{
-			    if(q==Msg2ActiveQueueName_.end())
-			    {
-			        //wildcard queues are not interested
-			        //no standard queue is interested
-			        //nothing to do....
-			        return true;
-			    }
+				MOOS::ScopedLock L(ActiveQueuesLock_);
+				FindActiveQueuesFor(t->GetKey(),Queues);
 			}
+			q = pRoutes->insert(std::make_pair(t->GetKey(),Queues)).first;
 		}
 
-		//now we know which queue(s) are relevant for us.
-		//there namaes are in a string list.
-		std::set<std::string>::iterator r;
-
-		bool bPickedUpByActiveQueue = false;
-		for(r = q->second.begin();r!=q->second.end();++r)
+		if(q->second.empty())
 		{
-
-//		    std::cerr<<"found queue that is relevent "<<*r<<"\n";
-
-		    //for each named queue find a pointer to
-			//the actual active queue
-			std::map<std::string,MOOS::ActiveMailQueue*>::iterator v;
-			v = ActiveQueueMap_.find(*r);
-			if(v!=ActiveQueueMap_.end())
-			{
-				//and now we have checked it exists push this message to that
-				//queue
-                MOOS::ActiveMailQueue* pQ = v->second;
-//                std::cerr<<"pushing to queue: "<<(void*)pQ<<"\n";
-                bPickedUpByActiveQueue = true;
-				pQ->Push(*t);
-			}
-			else
-			{
-				//this is bad news - we have be told to use a queue
-				//which does not exist.
-			    //std::cerr<<"WTF\n";
-				throw std::runtime_error("active queue "+*r+" not found");
-			}
+			++t;
+			continue;
 		}
 
+		//push this message to every interested queue...
+		std::vector<SharedActiveMailQueue>::iterator r;
+		for(r = q->second.begin();r!=q->second.end();++r)
+			(*r)->Push(*t);
 
-		if(bPickedUpByActiveQueue)
-		{
-	        //we have now handled this message remove it from the Inbox.
-		    MOOSMSG_LIST::iterator to_erase = t;
-		    ++t;
-		    m_InBox.erase(to_erase);
-		}
-		else
-		{
-		    ++t;
-		}
+		//...and remove it from the Inbox.
+		t = m_InBox.erase(t);
 	}
 
 	return true;
@@ -928,6 +931,11 @@ bool CMOOSCommClient::ConnectToServer()
 		return true;
 	}
 
+	//nothing left over from a previous connection is any use
+	EnableReadAhead(true);
+	UseSharedMemory(NULL);
+	SetCompactWire(false);
+
 	int nAttempt=0;
 
 
@@ -1023,31 +1031,7 @@ bool CMOOSCommClient::Post(CMOOSMsg &Msg, bool bKeepMsgSourceName)
 
 	m_OutLock.Lock();
 
-	//stuff our name in here  - prevent client from having to worry about
-	//it...
-	if(!m_bFakeSource && !bKeepMsgSourceName )
-	{
-		Msg.m_sSrc = m_sMyName;
-	}
-	else
-	{
-		if(!Msg.IsType(MOOS_NOTIFY))
-		{
-			Msg.m_sSrc = m_sMyName;
-		}
-	}
-
-
-	if(Msg.IsType(MOOS_SERVER_REQUEST))
-	{
-		Msg.m_nID=MOOS_SERVER_REQUEST_ID;
-	}
-	else
-	{
-		//set up Message ID;
-		Msg.m_nID=m_nNextMsgID++;
-	}
-
+	PrepareToPost(Msg,bKeepMsgSourceName);
 
 	if(m_bPostNewestToFront)
 		m_OutBox.push_front(Msg);
@@ -1075,6 +1059,76 @@ bool CMOOSCommClient::Post(CMOOSMsg &Msg, bool bKeepMsgSourceName)
 
 }
 
+bool CMOOSCommClient::Post(MOOSMSG_LIST &Msgs, bool bKeepMsgSourceName)
+{
+	if(!IsConnected())
+		return false;
+
+	m_OutLock.Lock();
+
+	MOOSMSG_LIST::iterator q;
+	for(q = Msgs.begin();q!=Msgs.end();++q)
+		PrepareToPost(*q,bKeepMsgSourceName);
+
+	//the batch stays in order whichever end of the out box it goes
+	if(m_bPostNewestToFront)
+		m_OutBox.splice(m_OutBox.begin(),Msgs);
+	else
+		m_OutBox.splice(m_OutBox.end(),Msgs);
+
+	if(m_OutBox.size()>m_nOutPendingLimit)
+	{
+        if(!m_bExpectMailBoxOverFlow)
+        {
+            MOOSTrace("\nThe outbox is very full. This is suspicious and dangerous.\n");
+            MOOSTrace("\nRemoving old unsent messages as new ones are added\n");
+        }
+
+		//remove oldest messages...
+		while(m_OutBox.size()>m_nOutPendingLimit)
+		{
+			if(m_bPostNewestToFront)
+				m_OutBox.pop_back();
+			else
+				m_OutBox.pop_front();
+		}
+	}
+
+	m_OutLock.UnLock();
+
+	return true;
+}
+
+void CMOOSCommClient::PrepareToPost(CMOOSMsg &Msg, bool bKeepMsgSourceName)
+{
+	//stuff our name in here  - prevent client from having to worry about
+	//it...
+	if(!m_bFakeSource && !bKeepMsgSourceName )
+	{
+		Msg.m_sSrc = m_sMyName;
+	}
+	else
+	{
+		if(!Msg.IsType(MOOS_NOTIFY))
+		{
+			Msg.m_sSrc = m_sMyName;
+		}
+	}
+
+
+	if(Msg.IsType(MOOS_SERVER_REQUEST))
+	{
+		//ServerRequest() numbers its own requests below this
+		if(Msg.m_nID>=MOOS_SERVER_REQUEST_ID)
+			Msg.m_nID=MOOS_SERVER_REQUEST_ID;
+	}
+	else
+	{
+		//set up Message ID;
+		Msg.m_nID=m_nNextMsgID++;
+	}
+}
+
 bool IsNullMsg(const CMOOSMsg& msg)
 {
 	return msg.IsType(MOOS_NULL_MSG);
@@ -1108,6 +1162,12 @@ bool CMOOSCommClient::Fetch(MOOSMSG_LIST &MsgList)
 	return !MsgList.empty();
 }
 
+void CMOOSCommClient::CompressIfAgreed(CMOOSCommPkt & PktTx)
+{
+	if(m_bDBAcceptsCompression && m_nCompressionThreshold>0)
+		PktTx.Compress(m_nCompressionThreshold);
+}
+
 std::string CMOOSCommClient::HandShakeKey()
 {
 	//old MOOS Clients return empty string
@@ -1137,12 +1197,34 @@ bool CMOOSCommClient::HandShake()
 		//a little bit of handshaking..we need to say who we are
 		CMOOSMsg Msg(MOOS_DATA,HandShakeKey(),(char *)m_sMyName.c_str());
 
+		//and that we can read compressed and compact packets (old DBs
+		//ignore this)
+		MOOSAddValToString(Msg.m_sSrcAux,"compression",MOOS_PKT_COMPRESSION);
+		MOOSAddValToString(Msg.m_sSrcAux,"wire",MOOS_PKT_COMPACT);
+
+		//perhaps offer a shared memory channel (only a DB on this
+		//machine will be able to open it)
+		MOOS::Poco::SharedPtr<MOOS::SharedMemoryChannel> pSharedMemory;
+		if(m_bOfferSharedMemory)
+		{
+			pSharedMemory = MOOS::SharedMemoryChannel::Create();
+			if(!pSharedMemory.isNull())
+			{
+				MOOSAddValToString(Msg.m_sSrcAux,"shm_name",pSharedMemory->GetName());
+				MOOSAddValToString(Msg.m_sSrcAux,"shm_key",pSharedMemory->GetKey());
+			}
+		}
+
 		SendMsg(m_pSocket,Msg);
 
 		CMOOSMsg WelcomeMsg;
 
 		ReadMsg(m_pSocket,WelcomeMsg);
 
+		//either way nobody else need find the channel now
+		if(!pSharedMemory.isNull())
+			pSharedMemory->Unlink();
+
 		if(WelcomeMsg.IsType(MOOS_POISON))
 		{
             if(!m_bQuiet)
@@ -1163,6 +1245,23 @@ bool CMOOSCommClient::HandShake()
             m_bDBIsAsynchronous = MOOSStrCmp(WelcomeMsg.GetString(),"asynchronous");
             MOOSValFromString(m_sDBHostAsSeenByDB,WelcomeMsg.m_sSrcAux,"hostname",true);
 
+            std::string sCompression;
+            m_bDBAcceptsCompression = MOOSValFromString(sCompression,WelcomeMsg.m_sSrcAux,"compression",true) &&
+                    MOOSStrCmp(sCompression,MOOS_PKT_COMPRESSION);
+
+            std::string sSharedMemory;
+            if(!pSharedMemory.isNull() &&
+                    MOOSValFromString(sSharedMemory,WelcomeMsg.m_sSrcAux,"shm",true) &&
+                    MOOSStrCmp(sSharedMemory,"ok"))
+            {
+                UseSharedMemory(pSharedMemory);
+            }
+
+            //from here on we can send compact packets (and the DB will)
+            std::string sWire;
+            SetCompactWire(MOOSValFromString(sWire,WelcomeMsg.m_sSrcAux,"wire",true) &&
+                    MOOSStrCmp(sWire,MOOS_PKT_COMPACT));
+
 			if(!m_bQuiet)
 			{
 				std::cout<<MOOS::ConsoleColours::Green()<<"[ok]\n";
@@ -1185,6 +1284,36 @@ bool CMOOSCommClient::HandShake()
 
                 std::cout<<MOOS::ConsoleColours::reset();
 
+            	if(m_nCompressionThreshold>0)
+            	{
+                    std::cout<<std::left<<std::setw(40);
+                    std::cout<<"  Packet compression is ";
+                    if(m_bDBAcceptsCompression)
+                        std::cout<<MOOS::ConsoleColours::Green()<<"[on]\n";
+                    else
+                        std::cout<<MOOS::ConsoleColours::Red()<<"[off] (DB can't read it)\n";
+                    std::cout<<MOOS::ConsoleColours::reset();
+            	}
+
+            	if(m_bOfferSharedMemory)
+            	{
+                    std::cout<<std::left<<std::setw(40);
+                    std::cout<<"  Shared memory transport is ";
+                    if(IsUsingSharedMemory())
+                        std::cout<<MOOS::ConsoleColours::Green()<<"[on]\n";
+                    else
+                        std::cout<<MOOS::ConsoleColours::Red()<<"[off] (DB declined)\n";
+                    std::cout<<MOOS::ConsoleColours::reset();
+            	}
+
+                std::cout<<std::left<<std::setw(40);
+                std::cout<<"  Compact wire format is ";
+                if(IsCompactWire())
+                    std::cout<<MOOS::ConsoleColours::Green()<<"[on]\n";
+                else
+                    std::cout<<MOOS::ConsoleColours::yellow()<<"[off] (DB can't read it)\n";
+                std::cout<<MOOS::ConsoleColours::reset();
+
 
             	if(!WelcomeMsg.m_sSrcAux.empty())
             	{
@@ -1245,6 +1374,9 @@ std::string CMOOSCommClient::GetCommunityName()
 
 bool CMOOSCommClient::OnCloseConnection()
 {
+	//let the DB know if it is listening on shared memory
+	CloseSharedMemory();
+
 	m_pSocket->vCloseSocket();
 
 	if(m_pSocket)
@@ -1327,7 +1459,7 @@ bool CMOOSCommClient::UnRegister(const string &sVarPattern, const string & sAppP
 
 
 
-bool CMOOSCommClient::Register(const string &sVar, double dfInterval)
+bool CMOOSCommClient::Register(const string &sVar, double dfInterval, bool bLatestOnly)
 {
 	if(!IsConnected())
 		return false;
@@ -1339,6 +1471,13 @@ bool CMOOSCommClient::Register(const string &sVar, double dfInterval)
 	if(1)
 	{
 		CMOOSMsg MsgR(MOOS_REGISTER,sVar.c_str(),dfInterval);
+
+		//older DBs ignore this and send everything
+		if(bLatestOnly)
+			MOOSAddValToString(MsgR.m_sVal,"LatestOnly",std::string("true"));
+		if(m_bFollowsStubs)
+			MOOSAddValToString(MsgR.m_sVal,"FollowsStubs",std::string("true"));
+
 		bool bSuccess =  Post(MsgR);
 		if(bSuccess)
 		{
@@ -1366,6 +1505,8 @@ bool CMOOSCommClient::Register(const std::string & sVarPattern,const std::string
     MOOSAddValToString(sMsg,"AppPattern",sAppPattern);
     MOOSAddValToString(sMsg,"VarPattern",sVarPattern);
     MOOSAddValToString(sMsg,"Interval",dfInterval);
+    if(m_bFollowsStubs)
+        MOOSAddValToString(sMsg,"FollowsStubs",std::string("true"));
 
     CMOOSMsg MsgR(MOOS_WILDCARD_REGISTER,m_sMyName,sMsg);
 
@@ -1487,44 +1628,95 @@ bool CMOOSCommClient::Notify(const std::string & sVar,const std::vector<unsigned
 
 
 
+bool CMOOSCommClient::Notify(MOOSMSG_LIST & Msgs)
+{
+	MOOSMSG_LIST::iterator q;
+	for(q = Msgs.begin();q!=Msgs.end();++q)
+	{
+		if(q->IsType(MOOS_NOTIFY))
+			m_Published.insert(q->GetKey());
+	}
+
+	return Post(Msgs);
+}
+
+
 bool CMOOSCommClient::ServerRequest(const string &sWhat,MOOSMSG_LIST  & MsgList, double dfTimeOut, bool bClear)
 {
+    MsgList.clear();
+
     if(!IsConnected())
         return false;
 
     CMOOSMsg Msg(MOOS_SERVER_REQUEST,sWhat.c_str(),"");
 
-	if(!Post(Msg))
-		return false;
+    //the DB sends our ID back with the reply so we can tell it apart from
+    //replies to anyone else's requests
+    ServerReply Reply;
+    m_InLock.Lock();
+    {
+        Msg.m_nID = m_nNextServerRequestID--;
+        if(m_nNextServerRequestID<-1000000)
+            m_nNextServerRequestID = MOOS_SERVER_REQUEST_ID-1;
+        m_PendingServerRequests[Msg.m_nID] = &Reply;
+    }
+    m_InLock.UnLock();
 
-	if(!Flush())
-		return false;
+    bool bReplied = Post(Msg) && Flush() &&
+            Reply.Arrived.tryWait(dfTimeOut>0 ? long(dfTimeOut*1000) : 0);
 
-	if(Msg.m_nID != MOOS_SERVER_REQUEST_ID)
-	{
-		return MOOSFail("Logical Error in ::ServerRequest");
-	}
+    m_InLock.Lock();
+    {
+        m_PendingServerRequests.erase(Msg.m_nID);
+        MsgList.splice(MsgList.end(),Reply.Mail);
 
-	int nSleep = 100;
+        //conditionally (ex MIT suggestion 2006) remove all elements
+        if(bReplied && bClear)
+            m_InBox.clear();
+    }
+    m_InLock.UnLock();
 
-	double dfWaited = 0.0;
+    return bReplied && !MsgList.empty();
+}
 
-	while(dfWaited<dfTimeOut)
-	{
-		if (Peek(MsgList, MOOS_SERVER_REQUEST_ID, bClear))
-		{
-			//OK we have our reply...
-			return true;
-		}
-		else
-		{
-			MOOSPause(nSleep);
-			dfWaited+=((double)nSleep)/1000.0;
+void CMOOSCommClient::CollectServerReplies(size_t nAlreadyInBox)
+{
+    if(m_InBox.size()<=nAlreadyInBox)
+        return;
 
-		}
-	}
+    std::set<ServerReply*> Replied;
 
-	return false;
+    MOOSMSG_LIST::iterator p = m_InBox.begin();
+    std::advance(p,nAlreadyInBox);
+    while(p!=m_InBox.end())
+    {
+        //nothing but our own requests' replies carry these IDs
+        if(p->m_nID>=MOOS_SERVER_REQUEST_ID || p->IsType(MOOS_NULL_MSG))
+        {
+            ++p;
+            continue;
+        }
+
+        MOOSMSG_LIST::iterator q = p++;
+
+        //replies which come after their request gave up are dropped
+        std::map<int, ServerReply*>::iterator r;
+        r = m_PendingServerRequests.find(q->m_nID);
+        if(r==m_PendingServerRequests.end())
+        {
+            m_InBox.erase(q);
+            continue;
+        }
+
+        //in the order Peek() would have returned them
+        ServerReply * pReply = r->second;
+        pReply->Mail.splice(pReply->Mail.begin(),m_InBox,q);
+        Replied.insert(pReply);
+    }
+
+    std::set<ServerReply*>::iterator q;
+    for(q = Replied.begin();q!=Replied.end();++q)
+        (*q)->Arrived.set();
 }
 
 bool CMOOSCommClient::Peek(MOOSMSG_LIST & MsgList, int nIDRequired,bool bClear)
@@ -1637,18 +1829,16 @@ bool CMOOSCommClient::Close(bool  )
 
 	MOOS::ScopedLock L(ActiveQueuesLock_);
 
-	std::map<std::string,MOOS::ActiveMailQueue*  >::iterator q;
+	ACTIVE_QUEUE_MAP::iterator q;
 
 	for(q = ActiveQueueMap_.begin();q!=ActiveQueueMap_.end();++q)
 	{
-		MOOS::ActiveMailQueue* pQueue = q->second;
-		pQueue->Stop();
-		delete pQueue;
+		q->second->Stop();
 	}
 
 	ActiveQueueMap_.clear();
 	Msg2ActiveQueueName_.clear();
-	WildcardCheckSet_.clear();
+	InvalidateActiveQueueRoutes();
 
 
 	return true;
@@ -35,6 +35,16 @@
 #include "MOOS/libMOOS/Utils/MOOSException.h"
 #include "MOOS/libMOOS/Utils/ConsoleColours.h"
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+//most segments handed to the kernel in one go
+#define MAX_GATHER_SEGMENTS 64
 
 
 
@@ -48,7 +58,7 @@ const int kMaxBufferSizeKB = 2048;
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-CMOOSCommObject::CMOOSCommObject()
+CMOOSCommObject::CMOOSCommObject():m_pPktPool(new MOOS::PacketBufferPool)
 {
     m_bFakeDodgyComms = false;
     m_dfDodgeyCommsDelay = 1.0;
@@ -56,6 +66,9 @@ CMOOSCommObject::CMOOSCommObject()
     m_dfTerminateProbability = 0.0;
     m_bDisableNagle = false;
     m_bBoostIOThreads = false;
+    m_bReadAhead = false;
+    m_dfSharedMemoryWriteTimeout = -1;
+    m_bCompactWire = false;
 
 
     SetReceiveBufferSizeInKB(DEFAULT_SOCKET_RECEIVE_BUFFER_SIZE_KB);
@@ -157,41 +170,161 @@ void CMOOSCommObject::SimulateCommsError()
     }
 }
 
+void CMOOSCommObject::EnableReadAhead(bool bEnable)
+{
+    m_bReadAhead = bEnable;
+    m_RxBuffer.Clear();
+}
+
+void CMOOSCommObject::UseSharedMemory(const MOOS::Poco::SharedPtr<MOOS::SharedMemoryChannel> & pChannel,
+        double dfWriteTimeout)
+{
+    m_pSharedMemory = pChannel;
+    m_dfSharedMemoryWriteTimeout = dfWriteTimeout;
+}
+
+bool CMOOSCommObject::IsUsingSharedMemory()
+{
+    return !m_pSharedMemory.isNull();
+}
+
+bool CMOOSCommObject::HasSharedMemorySpaceFor(CMOOSCommPkt & PktTx)
+{
+    if(!IsUsingSharedMemory())
+        return false;
+
+    std::vector<CMOOSCommPkt::WireSegment> Segments;
+    PktTx.GetWireSegments(Segments);
+
+    int nLength = 0;
+    for(unsigned int i = 0;i<Segments.size();i++)
+        nLength+=Segments[i].nLength;
+
+    return nLength<=m_pSharedMemory->GetSpace();
+}
+
+void CMOOSCommObject::CloseSharedMemory()
+{
+    if(!m_pSharedMemory.isNull())
+        m_pSharedMemory->Close();
+}
+
+void CMOOSCommObject::SetCompactWire(bool bCompact)
+{
+    m_bCompactWire = bCompact;
+    m_TxDictionary.Clear();
+    m_RxDictionary.Clear();
+}
+
+MOOS::WireDictionary * CMOOSCommObject::GetTxDictionary()
+{
+    return m_bCompactWire ? &m_TxDictionary : NULL;
+}
+
+void CMOOSCommObject::OnPktRead(CMOOSCommPkt & PktRx)
+{
+    if(m_bCompactWire && !PktRx.ReadCompact(m_RxDictionary))
+        throw CMOOSException("CMOOSCommObject::ReadPkt() Failed Rx - bad compact packet");
+}
+
+bool CMOOSCommObject::ReadPktFromSharedMemory(CMOOSCommPkt &PktRx, int nSecondsTimeout)
+{
+    int nRqd=0;
+    while((nRqd=PktRx.GetBytesRequired())!=0)
+    {
+        int nRxd = m_pSharedMemory->Read(PktRx.NextWrite(),nRqd,(double)nSecondsTimeout);
+
+        switch(nRxd)
+        {
+        case -1:
+            throw CMOOSException("remote side closed....");
+            break;
+        case 0:
+            throw CMOOSException(MOOSFormat("remote side closed or lazy client ( waited more than %ds )",nSecondsTimeout));
+            break;
+        default:
+            if(!PktRx.OnBytesWritten(PktRx.NextWrite(),nRxd))
+                throw CMOOSException("CMOOSCommObject::ReadPkt() Failed Rx - Packet rejects filling");
+            break;
+        }
+    }
+
+    OnPktRead(PktRx);
+
+    return true;
+}
+
+bool CMOOSCommObject::SendPktToSharedMemory(CMOOSCommPkt &PktTx)
+{
+    std::vector<CMOOSCommPkt::WireSegment> Segments;
+    PktTx.GetWireSegments(Segments);
+
+    for(unsigned int i = 0;i<Segments.size();i++)
+    {
+        int nSent = 0;
+        while(nSent<Segments[i].nLength)
+        {
+            int n = m_pSharedMemory->Write(Segments[i].pData+nSent,
+                    Segments[i].nLength-nSent,
+                    m_dfSharedMemoryWriteTimeout);
+            if(n<=0)
+                throw CMOOSException("CMOOSCommObject::SendPkt() Failed Tx");
+            nSent+=n;
+        }
+    }
+
+    return true;
+}
+
 bool CMOOSCommObject::ReadPkt(XPCTcpSocket *pSocket, CMOOSCommPkt &PktRx, int nSecondsTimeout)
 {
     #define CHUNK_READ 8192
 
+    if(IsUsingSharedMemory())
+        return ReadPktFromSharedMemory(PktRx,nSecondsTimeout);
+
     //now receive a message back..
     int nRqd=0;
     while((nRqd=PktRx.GetBytesRequired())!=0)
     {
+        //anything left over from last time?
+        if(m_bReadAhead && !m_RxBuffer.IsEmpty())
+        {
+            if(!m_RxBuffer.Drain(PktRx))
+                throw CMOOSException("CMOOSCommObject::ReadPkt() Failed Rx - Packet rejects filling");
+            continue;
+        }
+
+        //small things (and the start of big ones) are read into our buffer
+        //along with whatever follows them, the bulk of big packets goes
+        //straight into the packet
+        bool bBuffered = m_bReadAhead && (unsigned int)nRqd<m_RxBuffer.Capacity();
+
+        unsigned char * pDest;
+        int nWanted;
+        if(bBuffered)
+        {
+            pDest = m_RxBuffer.WritePtr();
+            nWanted = m_RxBuffer.Space();
+        }
+        else
+        {
+            pDest = PktRx.NextWrite();
+            nWanted = m_bReadAhead ? nRqd : std::min(nRqd,CHUNK_READ);
+        }
+
         //std::cerr<<"I'm asking for "<<nRqd<<"\n";
         int nRxd = 0;
 
         try
         {
-            if(nRqd<CHUNK_READ)
+            if(nSecondsTimeout<0)
             {
-                //read in in chunks of 1k
-                if(nSecondsTimeout<0)
-                {
-                    nRxd  = pSocket->iRecieveMessage(PktRx.NextWrite(),nRqd);
-                }
-                else
-                {
-                    nRxd  = pSocket->iReadMessageWithTimeOut(PktRx.NextWrite(),nRqd,(double)nSecondsTimeout);
-                }
+                nRxd  = pSocket->iRecieveMessage(pDest,nWanted);
             }
             else
             {
-                if(nSecondsTimeout<0)
-                {
-                    nRxd  = pSocket->iRecieveMessage(PktRx.NextWrite(),CHUNK_READ);
-                }
-                else
-                {
-                    nRxd  = pSocket->iReadMessageWithTimeOut(PktRx.NextWrite(),CHUNK_READ,(double)nSecondsTimeout);
-                }
+                nRxd  = pSocket->iReadMessageWithTimeOut(pDest,nWanted,(double)nSecondsTimeout);
             }
         }
         catch( XPCException & e)
@@ -212,12 +345,16 @@ bool CMOOSCommObject::ReadPkt(XPCTcpSocket *pSocket, CMOOSCommPkt &PktRx, int nS
                 throw CMOOSException("remote side closed....");
             break;
         default:
-            if(!PktRx.OnBytesWritten(PktRx.NextWrite(),nRxd))
+            if(bBuffered)
+                m_RxBuffer.OnBytesRead(nRxd);
+            else if(!PktRx.OnBytesWritten(PktRx.NextWrite(),nRxd))
                 throw CMOOSException("CMOOSCommObject::ReadPkt() Failed Rx - Packet rejects filling");
             break;
         }
     }
 
+    OnPktRead(PktRx);
+
     return true;
 }
 
@@ -290,6 +427,16 @@ bool CMOOSCommObject::SendPkt(XPCTcpSocket *pSocket, CMOOSCommPkt &PktTx)
 {
     int nSent = 0;
 
+    if(IsUsingSharedMemory())
+        return SendPktToSharedMemory(PktTx);
+
+    //the testing cruft below wants it all in one place
+    if(m_bFakeDodgyComms)
+        PktTx.Flatten();
+
+    if(PktTx.IsGathered())
+        return SendGatheredPkt(pSocket,PktTx);
+
     try
     {
 
@@ -321,13 +468,61 @@ bool CMOOSCommObject::SendPkt(XPCTcpSocket *pSocket, CMOOSCommPkt &PktTx)
     return true;
 }
 
+bool CMOOSCommObject::SendGatheredPkt(XPCTcpSocket *pSocket, CMOOSCommPkt &PktTx)
+{
+    int nTotal = PktTx.GetStreamLength();
+    int nSent = 0;
+    std::vector<CMOOSCommPkt::WireSegment> Segments;
+
+    while(nSent<nTotal)
+    {
+        PktTx.GetWireSegments(Segments,nSent);
+
+        int nTx = 0;
+#ifdef _WIN32
+        try
+        {
+            nTx = pSocket->iSendMessage(Segments[0].pData,Segments[0].nLength);
+        }
+        catch(XPCException & e)
+        {
+            MOOSTrace("MOOSCommObject::SendPkt Exception caught %s\n",e.sGetException());
+            throw CMOOSException("CMOOSCommObject::SendPkt() Failed Tx");
+        }
+#else
+        struct iovec IOV[MAX_GATHER_SEGMENTS];
+        int nIOV = std::min((int)Segments.size(),MAX_GATHER_SEGMENTS);
+        for(int i = 0;i<nIOV;i++)
+        {
+            IOV[i].iov_base = (void*)Segments[i].pData;
+            IOV[i].iov_len = Segments[i].nLength;
+        }
+
+        nTx = (int)writev(pSocket->iGetSocketFd(),IOV,nIOV);
+        if(nTx<0)
+        {
+            if(errno==EINTR)
+                continue;
+            MOOSTrace("MOOSCommObject::SendPkt writev failed %s\n",strerror(errno));
+            throw CMOOSException("CMOOSCommObject::SendPkt() Failed Tx");
+        }
+#endif
+        if(nTx==0)
+            throw CMOOSException("CMOOSCommObject::SendPkt() Failed Tx");
+
+        nSent+=nTx;
+    }
+
+    return true;
+}
+
 bool CMOOSCommObject::SendMsg(XPCTcpSocket *pSocket,CMOOSMsg &Msg)
 {
     MOOSMSG_LIST MsgList;
     
     MsgList.push_front(Msg);
 
-    CMOOSCommPkt Pkt;
+    CMOOSCommPkt Pkt(m_pPktPool);
 
     Pkt.Serialize(MsgList,true);
 	
@@ -340,7 +535,7 @@ bool CMOOSCommObject::ReadMsg(XPCTcpSocket *pSocket,CMOOSMsg &Msg, int nSecondsT
 {
     MOOSMSG_LIST MsgList;
     
-    CMOOSCommPkt Pkt;
+    CMOOSCommPkt Pkt(m_pPktPool);
 
     if(ReadPkt(pSocket,Pkt,nSecondsTimeout))
     {
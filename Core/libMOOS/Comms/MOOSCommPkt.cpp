@@ -32,32 +32,127 @@
 #endif
 
 #include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "MOOS/libMOOS/Utils/LZCompression.h"
 #include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
 
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 
 using namespace std;
 
+//note +1 is for indicator regarding compressed or not compressed
+static const unsigned int kHeaderSize = 2 * sizeof(int) + 1;
+
+//bits of that indicator (a compact packet may be compressed too)
+static const unsigned char kUncompressed = 0;
+static const unsigned char kLZCompressed = 1;
+static const unsigned char kCompact = 2;
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
 CMOOSCommPkt::CMOOSCommPkt() {
 
-    m_nStreamSpace  = sizeof(int);
-    m_pStream = new unsigned char [m_nStreamSpace];
+    Initialise(MOOS::SharedPacketBufferPool());
+
+}
+
+CMOOSCommPkt::CMOOSCommPkt(const MOOS::SharedPacketBufferPool & pPool) {
+
+    Initialise(pPool);
+
+}
+
+void CMOOSCommPkt::Initialise(const MOOS::SharedPacketBufferPool & pPool) {
+
+    m_pPool = pPool.isNull() ? MOOS::PacketBufferPool::Shared() : pPool;
+    m_pStream = NULL;
+    m_nStreamSpace = 0;
+
+    Reset();
+
+}
+
+void CMOOSCommPkt::Reset() {
+
+    if (m_pStream == NULL) {
+        unsigned int nCapacity;
+        m_pStream = m_pPool->Get(sizeof(int), nCapacity);
+        m_nStreamSpace = nCapacity;
+    }
+
     m_pNextData = m_pStream;
     m_nByteCount = 0;
     m_nMsgLen = 0;
     m_nMsgsSerialised = 0;
+    m_nWireLength = 0;
+    m_nUncompressedLength = 0;
+    m_pDictionary = NULL;
+    m_CompactViews.clear();
+    m_bCompactRead = false;
+    m_Gathered.clear();
+    m_nGatheredBytes = 0;
+
+}
+
+void CMOOSCommPkt::Recycle() {
+
+    //a spare holds on to an everyday sized stream but not a huge one
+    if (m_nStreamSpace > MOOS_PKT_DEFAULT_SPACE) {
+        m_pPool->Return(m_pStream, m_nStreamSpace);
+        m_pStream = NULL;
+        m_nStreamSpace = 0;
+    }
+
+    m_Gathered.clear();
+    m_GatheredOwners.clear();
+    m_CompactViews.clear();
+    m_pDictionary = NULL;
+
+    //and not its pool either, which would then never go away
+    m_pPool = MOOS::SharedPacketBufferPool();
+
+}
+
+MOOS::SharedCommPkt CMOOSCommPkt::Make(const MOOS::SharedPacketBufferPool & pPool) {
+
+    MOOS::SharedPacketBufferPool pHome = pPool.isNull() ? MOOS::PacketBufferPool::Shared() : pPool;
+
+    CMOOSCommPkt * pPkt = pHome->TakePkt();
+    if (pPkt == NULL)
+        return MOOS::SharedCommPkt(new CMOOSCommPkt(pHome));
+
+    pPkt->m_pPool = pHome;
+    pPkt->Reset();
+    return MOOS::SharedCommPkt(pPkt);
+
+}
+
+void MOOS::CommPktReleasePolicy::release(CMOOSCommPkt * pPkt) {
+
+    if (pPkt == NULL)
+        return;
+
+    //the packet lets go of its pool so hold on to it here until it
+    //has been stashed
+    MOOS::SharedPacketBufferPool pHome = pPkt->m_pPool;
+    pPkt->Recycle();
+
+    if (!pHome->StashPkt(pPkt))
+        delete pPkt;
 
 }
 
 CMOOSCommPkt::~CMOOSCommPkt()
 {
-    delete [] m_pStream;
+    //spare packets no longer have a pool
+    if (m_pPool.isNull())
+        delete [] m_pStream;
+    else
+        m_pPool->Return(m_pStream, m_nStreamSpace);
 }
 
 
@@ -68,11 +163,12 @@ bool CMOOSCommPkt::InflateTo(int nNewStreamSize) {
         return true;
     }else{
 
-        unsigned char * t = new unsigned char [nNewStreamSize];
+        unsigned int nCapacity;
+        unsigned char * t = m_pPool->Get(nNewStreamSize, nCapacity);
         memcpy(t, m_pStream,m_nByteCount);
-        delete [] m_pStream;
+        m_pPool->Return(m_pStream, m_nStreamSpace);
         m_pStream=t;
-        m_nStreamSpace = nNewStreamSize;
+        m_nStreamSpace = nCapacity;
         m_pNextData = m_pStream + m_nByteCount;
 
     }
@@ -96,6 +192,14 @@ bool CMOOSCommPkt::OnBytesWritten(unsigned char * /*PositionWrittento*/,int nDat
                 m_nMsgLen = SwapByteOrder<int> (m_nMsgLen);
             }
 
+            //a packet can't be shorter than its header and we won't be
+            //told to allocate something huge
+            if (m_nMsgLen < (int) kHeaderSize || m_nMsgLen > MOOS_PKT_MAX_SIZE) {
+                std::cerr << "CMOOSCommPkt refusing a packet claiming to be "
+                        << m_nMsgLen << " bytes long\n";
+                return false;
+            }
+
             if(!InflateTo(m_nMsgLen))
                 return false;
         }
@@ -116,7 +220,7 @@ int CMOOSCommPkt::GetBytesRequired() {
 }
 
 int CMOOSCommPkt::GetStreamLength() {
-    return m_nByteCount;
+    return m_nByteCount+m_nGatheredBytes;
 }
 
 
@@ -128,6 +232,74 @@ unsigned char * CMOOSCommPkt::NextWrite(){
     return m_pNextData;
 }
 
+bool CMOOSCommPkt::IsGathered(){
+    return !m_Gathered.empty();
+}
+
+void CMOOSCommPkt::GetWireSegments(std::vector<WireSegment> & Segments, int nFrom) {
+
+    Segments.clear();
+
+    //interleave runs of the stream with the payloads which go between them
+    int nInline = 0;
+    int nWire = 0;
+    for (unsigned int i = 0; i <= m_Gathered.size(); i++) {
+
+        int nRunEnd = i < m_Gathered.size() ? m_Gathered[i].m_nInlineOffset : m_nByteCount;
+
+        WireSegment Run = {m_pStream + nInline, nRunEnd - nInline};
+        int nSkip = std::max(0, std::min(nFrom - nWire, Run.nLength));
+        nWire += Run.nLength;
+        if (Run.nLength > nSkip) {
+            WireSegment S = {Run.pData + nSkip, Run.nLength - nSkip};
+            Segments.push_back(S);
+        }
+        nInline = nRunEnd;
+
+        if (i == m_Gathered.size())
+            break;
+
+        const GatheredPayload & G = m_Gathered[i];
+        nSkip = std::max(0, std::min(nFrom - nWire, G.m_nLength));
+        nWire += G.m_nLength;
+        if (G.m_nLength > nSkip) {
+            WireSegment S = {G.m_pData + nSkip, G.m_nLength - nSkip};
+            Segments.push_back(S);
+        }
+    }
+}
+
+void CMOOSCommPkt::Flatten() {
+
+    if (m_Gathered.empty())
+        return;
+
+    int nTotal = GetStreamLength();
+
+    unsigned int nCapacity;
+    unsigned char * pFlat = m_pPool->Get(nTotal, nCapacity);
+
+    std::vector<WireSegment> Segments;
+    GetWireSegments(Segments);
+
+    unsigned char * p = pFlat;
+    for (unsigned int i = 0; i < Segments.size(); i++) {
+        memcpy(p, Segments[i].pData, Segments[i].nLength);
+        p += Segments[i].nLength;
+    }
+
+    m_pPool->Return(m_pStream, m_nStreamSpace);
+    m_pStream = pFlat;
+    m_nStreamSpace = nCapacity;
+
+    m_nByteCount = nTotal;
+    m_pNextData = m_pStream + nTotal;
+
+    m_Gathered.clear();
+    m_nGatheredBytes = 0;
+    m_GatheredOwners.clear();
+}
+
 
 int CMOOSCommPkt::GetNumMessagesSerialised()
 {
@@ -135,112 +307,451 @@ int CMOOSCommPkt::GetNumMessagesSerialised()
 }
 
 
-/** This function stuffs messages in/from a packet */
-bool CMOOSCommPkt::Serialize(MOOSMSG_LIST &List,
-                             bool bToStream,
-                             bool bNoNULL,
-                             double * pdfPktTime) {
-    //note +1 is for indicator regarding compressed or not compressed
-    unsigned int nHeaderSize = 2 * sizeof(int) + 1;
+static void WriteIntAsLittleEndian(unsigned char * pBuffer, int nVal)
+{
+    nVal = IsLittleEndian() ? nVal : SwapByteOrder<int> (nVal);
+    memcpy((void*) pBuffer, (void*) (&nVal), sizeof(nVal));
+}
 
-    if (bToStream) {
+static int ReadIntAsLittleEndian(const unsigned char * pBuffer)
+{
+    int nVal;
+    memcpy((void*) (&nVal), (const void*) pBuffer, sizeof(nVal));
+    return IsLittleEndian() ? nVal : SwapByteOrder<int> (nVal);
+}
 
-        m_nMsgLen = 0;
-        m_nByteCount = 0;
-        m_nMsgsSerialised = 0;
+//////////////////////////////////////////////////////////////////////
+// The compact format
+//
+// a compact packet has the usual header (flagged kCompact) followed by
+// messages laid out as
+//     type, data type, flags, key token, [id], [source token],
+//     [source aux], [community token], [time], [double], [double aux],
+//     [string]
+// where flags says which of the bracketed fields are present. Absent
+// fields have their default values. Lengths and ids are varints, doubles
+// are 8 bytes little endian. A token of 0 means a varint length and that
+// many bytes follow (and both ends learn the name), n>0 means the
+// dictionary's nth name
+//////////////////////////////////////////////////////////////////////
 
-        //lets figure out how much space we need?
-        unsigned int nBufferSize = nHeaderSize; //some head room
-        MOOSMSG_LIST::iterator p;
-        for (p = List.begin(); p != List.end(); ++p) {
-            nBufferSize += p->GetSizeInBytesWhenSerialised();
-        }
+static const unsigned char kHasID = 0x01;
+static const unsigned char kHasSrc = 0x02;
+static const unsigned char kHasSrcAux = 0x04;
+static const unsigned char kHasCommunity = 0x08;
+static const unsigned char kHasTime = 0x10;
+static const unsigned char kHasDouble = 0x20;
+static const unsigned char kHasDoubleAux = 0x40;
+static const unsigned char kHasString = 0x80;
+
+//the most a compact message can be bigger than the same message as written
+//by CMOOSMsg (five byte varints where it writes four byte ints, tokens and
+//the flags)
+static const int kCompactMsgOverhead = 18;
+
+static unsigned char * WriteVarint(unsigned char * p, unsigned int nVal)
+{
+    while (nVal >= 0x80) {
+        *p++ = (unsigned char) (nVal | 0x80);
+        nVal >>= 7;
+    }
+    *p++ = (unsigned char) nVal;
+    return p;
+}
 
-        InflateTo(nBufferSize);
+static const unsigned char * ReadVarint(const unsigned char * p,
+        const unsigned char * pEnd, unsigned int & nVal)
+{
+    nVal = 0;
+    for (int nShift = 0; nShift < 35 && p < pEnd; nShift += 7) {
+        unsigned char c = *p++;
+        nVal |= (unsigned int) (c & 0x7f) << nShift;
+        if (!(c & 0x80))
+            return p;
+    }
+    return NULL;
+}
 
-        m_pNextData = m_pStream + nHeaderSize;
-        m_nByteCount += nHeaderSize;
+static unsigned char * WriteDoubleAsLittleEndian(unsigned char * p, double dfVal)
+{
+    dfVal = IsLittleEndian() ? dfVal : SwapByteOrder<double> (dfVal);
+    memcpy((void*) p, (void*) (&dfVal), sizeof(dfVal));
+    return p + sizeof(dfVal);
+}
 
-        for (p = List.begin(); p != List.end(); ++p)
-        {
+static const unsigned char * ReadDoubleAsLittleEndian(const unsigned char * p,
+        const unsigned char * pEnd, double & dfVal)
+{
+    if (pEnd - p < (int) sizeof(dfVal))
+        return NULL;
+    memcpy((void*) (&dfVal), (const void*) p, sizeof(dfVal));
+    dfVal = IsLittleEndian() ? dfVal : SwapByteOrder<double> (dfVal);
+    return p + sizeof(dfVal);
+}
 
-            m_nMsgsSerialised++;
+static unsigned char * WriteBytes(unsigned char * p, const MOOS::StringView & s)
+{
+    p = WriteVarint(p, s.size());
+    memcpy((void*) p, (const void*) s.data(), s.size());
+    return p + s.size();
+}
 
-            int nCopied = p->Serialize(m_pNextData, nBufferSize - m_nByteCount);
+static const unsigned char * ReadBytes(const unsigned char * p,
+        const unsigned char * pEnd, MOOS::StringView & s)
+{
+    unsigned int nSize;
+    p = ReadVarint(p, pEnd, nSize);
+    if (p == NULL || nSize > (unsigned int) (pEnd - p))
+        return NULL;
+    s = MOOS::StringView((const char *) p, nSize);
+    return p + nSize;
+}
 
-            if (nCopied == -1) {
-                std::cerr << "big problem failed serialisation: "
-                        << "CMOOSCommPkt::Serialize()" << "\n";  // Was: __PRETTY_FUNCTION__ which only exists in GCC
+static unsigned char * WriteName(unsigned char * p, const MOOS::StringView & s,
+        MOOS::WireDictionary & Dictionary)
+{
+    unsigned int nToken = Dictionary.Encode(s.data(), s.size());
+    p = WriteVarint(p, nToken);
+    return nToken == 0 ? WriteBytes(p, s) : p;
+}
 
-                return false;
-            }
+static const unsigned char * ReadName(const unsigned char * p,
+        const unsigned char * pEnd, MOOS::StringView & s,
+        MOOS::WireDictionary & Dictionary)
+{
+    unsigned int nToken;
+    p = ReadVarint(p, pEnd, nToken);
+    if (p == NULL)
+        return NULL;
+
+    if (nToken == 0) {
+        p = ReadBytes(p, pEnd, s);
+        if (p != NULL)
+            Dictionary.Learn(s.data(), s.size());
+        return p;
+    }
 
-            m_pNextData += nCopied;
-            m_nByteCount += nCopied;
+    const std::string * pName = Dictionary.Lookup(nToken);
+    if (pName == NULL)
+        return NULL;
+    s = MOOS::StringView(pName->data(), pName->size());
+    return p;
+}
 
-        }
+//if bGatherString the string payload's length is written but not the payload
+static unsigned char * WriteCompactMsg(unsigned char * p,
+        const MOOS::MsgView & Msg, MOOS::WireDictionary & Dictionary,
+        bool bGatherString)
+{
+    unsigned char cFlags = 0;
+    if (Msg.m_nID != -1)            cFlags |= kHasID;
+    if (!Msg.m_Src.empty())         cFlags |= kHasSrc;
+    if (!Msg.m_SrcAux.empty())      cFlags |= kHasSrcAux;
+    if (!Msg.m_Community.empty())   cFlags |= kHasCommunity;
+    if (Msg.m_dfTime != -1)         cFlags |= kHasTime;
+    if (Msg.m_dfVal != -1)          cFlags |= kHasDouble;
+    if (Msg.m_dfVal2 != -1)         cFlags |= kHasDoubleAux;
+    if (!Msg.m_Val.empty())         cFlags |= kHasString;
+
+    *p++ = (unsigned char) Msg.m_cMsgType;
+    *p++ = (unsigned char) Msg.m_cDataType;
+    *p++ = cFlags;
+
+    p = WriteName(p, Msg.m_Key, Dictionary);
+
+    //zigzag so the default of -1 and small ids are one byte
+    if (cFlags & kHasID)
+        p = WriteVarint(p, ((unsigned int) Msg.m_nID << 1) ^ (unsigned int) (Msg.m_nID >> 31));
+    if (cFlags & kHasSrc)
+        p = WriteName(p, Msg.m_Src, Dictionary);
+    if (cFlags & kHasSrcAux)
+        p = WriteBytes(p, Msg.m_SrcAux);
+    if (cFlags & kHasCommunity)
+        p = WriteName(p, Msg.m_Community, Dictionary);
+    if (cFlags & kHasTime)
+        p = WriteDoubleAsLittleEndian(p, Msg.m_dfTime);
+    if (cFlags & kHasDouble)
+        p = WriteDoubleAsLittleEndian(p, Msg.m_dfVal);
+    if (cFlags & kHasDoubleAux)
+        p = WriteDoubleAsLittleEndian(p, Msg.m_dfVal2);
+    if ((cFlags & kHasString) && bGatherString)
+        p = WriteVarint(p, Msg.m_Val.size());
+    else if (cFlags & kHasString)
+        p = WriteBytes(p, Msg.m_Val);
+
+    return p;
+}
+
+static const unsigned char * ReadCompactMsg(const unsigned char * p,
+        const unsigned char * pEnd, MOOS::MsgView & Msg,
+        MOOS::WireDictionary & Dictionary)
+{
+    if (pEnd - p < 3)
+        return NULL;
+
+    Msg = MOOS::MsgView();
+    Msg.m_cMsgType = (char) *p++;
+    Msg.m_cDataType = (char) *p++;
+    unsigned char cFlags = *p++;
+
+    p = ReadName(p, pEnd, Msg.m_Key, Dictionary);
+
+    if (p != NULL && (cFlags & kHasID)) {
+        unsigned int nZigZag;
+        p = ReadVarint(p, pEnd, nZigZag);
+        Msg.m_nID = (int) (nZigZag >> 1) ^ -(int) (nZigZag & 1);
+    }
+    if (p != NULL && (cFlags & kHasSrc))
+        p = ReadName(p, pEnd, Msg.m_Src, Dictionary);
+    if (p != NULL && (cFlags & kHasSrcAux))
+        p = ReadBytes(p, pEnd, Msg.m_SrcAux);
+    if (p != NULL && (cFlags & kHasCommunity))
+        p = ReadName(p, pEnd, Msg.m_Community, Dictionary);
+    if (p != NULL && (cFlags & kHasTime))
+        p = ReadDoubleAsLittleEndian(p, pEnd, Msg.m_dfTime);
+    if (p != NULL && (cFlags & kHasDouble))
+        p = ReadDoubleAsLittleEndian(p, pEnd, Msg.m_dfVal);
+    if (p != NULL && (cFlags & kHasDoubleAux))
+        p = ReadDoubleAsLittleEndian(p, pEnd, Msg.m_dfVal2);
+    if (p != NULL && (cFlags & kHasString))
+        p = ReadBytes(p, pEnd, Msg.m_Val);
+
+    return p;
+}
+
+void CMOOSCommPkt::StartWriting(unsigned int nBufferSize) {
+
+    m_nMsgLen = 0;
+    m_nByteCount = 0;
+    m_nMsgsSerialised = 0;
+    m_CompactViews.clear();
+    m_bCompactRead = false;
+
+    m_Gathered.clear();
+    m_nGatheredBytes = 0;
+    m_GatheredOwners.clear();
 
-        unsigned char bCompressed = 0;
+    InflateTo(nBufferSize);
 
-        //finally write how many bytes we have written at the start
-        //look for need to swap byte order if required
-        m_pNextData = m_pStream;
-        int nBC = IsLittleEndian()
-                                   ? m_nByteCount
-                                   : SwapByteOrder<int> (m_nByteCount);
+    m_pNextData = m_pStream + kHeaderSize;
+    m_nByteCount += kHeaderSize;
+}
 
-        memcpy((void*) m_pNextData, (void*) (&nBC), sizeof(m_nByteCount));
-        m_pNextData += sizeof(m_nByteCount);
+bool CMOOSCommPkt::WriteMsg(const CMOOSMsg & Msg, bool bGather) {
 
-        //and then how many messages are included
-        //look for need to swap byte order if required
-        int nMessages = List.size();
-        nMessages = IsLittleEndian()
-                                     ? nMessages
-                                     : SwapByteOrder<int> (nMessages);
-        memcpy((void*) m_pNextData, (void*) (&nMessages), sizeof(nMessages));
-        m_pNextData += sizeof(nMessages);
+    m_nMsgsSerialised++;
 
-        //and is this a compressed message or not?
-        *m_pNextData = bCompressed;
-        m_pNextData += 1;
+    bGather = bGather && Msg.m_sVal.size() >= MOOS_PKT_GATHER_THRESHOLD;
 
+    int nCopied;
+    if (m_pDictionary != NULL) {
+        //Serialize() made room for the worst case
+        nCopied = (int) (WriteCompactMsg(m_pNextData, MOOS::MsgView(Msg),
+                *m_pDictionary, bGather) - m_pNextData);
     } else {
+        nCopied = bGather ?
+                Msg.SerializeHeaderTo(m_pNextData, m_nStreamSpace - m_nByteCount) :
+                Msg.SerializeTo(m_pNextData, m_nStreamSpace - m_nByteCount);
+    }
+
+    if (nCopied == -1) {
+        std::cerr << "big problem failed serialisation: "
+                << "CMOOSCommPkt::Serialize()" << "\n";  // Was: __PRETTY_FUNCTION__ which only exists in GCC
+
+        return false;
+    }
+
+    m_pNextData += nCopied;
+    m_nByteCount += nCopied;
 
-        m_pNextData = m_pStream;
-        m_nMsgLen = 0;
-        m_nByteCount = 0;
-
-        //first figure out the length of the message
-        //look to swap byte order as required
-        memcpy((void*) (&m_nMsgLen), (void*) m_pNextData, sizeof(m_nMsgLen));
-        m_nMsgLen = IsLittleEndian()
-                                     ? m_nMsgLen
-                                     : SwapByteOrder<int> (m_nMsgLen);
-        m_pNextData += sizeof(m_nMsgLen);
-        m_nByteCount += sizeof(m_nMsgLen);
-
-        int nSpaceFree = m_nMsgLen - sizeof(m_nMsgLen);
-
-        //now figure out how many messages are packed in this packet
-        //look to swap byte order as required
-        int nMessages = 0;
-        memcpy((void*) (&nMessages), (void*) m_pNextData, sizeof(nMessages));
-        nMessages = IsLittleEndian()
-                                     ? nMessages
-                                     : SwapByteOrder<int> (nMessages);
-        m_pNextData += sizeof(nMessages);
-        nSpaceFree -= sizeof(nMessages);
-        m_nByteCount += sizeof(nMessages);
-
-        //now account for one byet of compression indication
-        m_pNextData += sizeof(unsigned char);
-        nSpaceFree -= sizeof(unsigned char);
-        m_nByteCount += sizeof(unsigned char);
+    if (bGather) {
+        GatheredPayload G;
+        G.m_nInlineOffset = m_nByteCount;
+        G.m_pData = (const unsigned char *) Msg.m_sVal.data();
+        G.m_nLength = (int) Msg.m_sVal.size();
+        m_Gathered.push_back(G);
+        m_nGatheredBytes += G.m_nLength;
+    }
+
+    return true;
+}
+
+void CMOOSCommPkt::FinishWriting(int nMessages) {
+
+    unsigned char bCompressed = m_pDictionary != NULL ? kCompact : kUncompressed;
+
+    //finally write how many bytes we have written at the start
+    //look for need to swap byte order if required
+    m_pNextData = m_pStream;
+    int nTotal = GetStreamLength();
+    int nBC = IsLittleEndian()
+                               ? nTotal
+                               : SwapByteOrder<int> (nTotal);
+
+    memcpy((void*) m_pNextData, (void*) (&nBC), sizeof(m_nByteCount));
+    m_pNextData += sizeof(m_nByteCount);
+
+    //and then how many messages are included
+    //look for need to swap byte order if required
+    nMessages = IsLittleEndian()
+                                 ? nMessages
+                                 : SwapByteOrder<int> (nMessages);
+    memcpy((void*) m_pNextData, (void*) (&nMessages), sizeof(nMessages));
+    m_pNextData += sizeof(nMessages);
+
+    //and is this a compressed message or not?
+    *m_pNextData = bCompressed;
+    m_pNextData += 1;
+
+    m_nMsgLen = nTotal;
+    m_nWireLength = nTotal;
+    m_nUncompressedLength = nTotal;
+}
+
+bool CMOOSCommPkt::Compress(unsigned int nThreshold) {
+
+    if (GetStreamLength() < (int) nThreshold)
+        return false;
+
+    //the compressor needs it all in one place
+    Flatten();
+
+    int nBody = m_nByteCount - (int) kHeaderSize;
+
+    if (nBody <= 0 || m_nByteCount < (int) nThreshold
+            || (m_pStream[2 * sizeof(int)] & kLZCompressed)) {
+        return false;
+    }
+
+    //compress into a second buffer laid out as the packet will be:
+    //the header, [uncompressed body size][compressed body]
+    unsigned int nCapacity;
+    unsigned char * pCompressed = m_pPool->Get(
+            kHeaderSize + sizeof(int) + MOOS::LZ::CompressBound(nBody), nCapacity);
+
+    int nNewLength = kHeaderSize + sizeof(int)
+            + MOOS::LZ::Compress(m_pStream + kHeaderSize, nBody,
+                    pCompressed + kHeaderSize + sizeof(int));
+
+    //is it worth it?
+    if (nNewLength >= m_nByteCount) {
+        m_pPool->Return(pCompressed, nCapacity);
+        return false;
+    }
+
+    memcpy((void*) pCompressed, (void*) m_pStream, kHeaderSize);
+    WriteIntAsLittleEndian(pCompressed + kHeaderSize, nBody);
+
+    //and the header needs the new length and the compression indicator
+    WriteIntAsLittleEndian(pCompressed, nNewLength);
+    pCompressed[2 * sizeof(int)] |= kLZCompressed;
+
+    m_pPool->Return(m_pStream, m_nStreamSpace);
+    m_pStream = pCompressed;
+    m_nStreamSpace = nCapacity;
+
+    m_nByteCount = nNewLength;
+    m_nMsgLen = nNewLength;
+    m_nWireLength = nNewLength;
+    m_pNextData = m_pStream + nNewLength;
+
+    return true;
+}
+
+int CMOOSCommPkt::GetWireLength() {
+    return m_nWireLength;
+}
+
+int CMOOSCommPkt::GetUncompressedLength() {
+    return m_nUncompressedLength;
+}
+
+double CMOOSCommPkt::GetCompression() {
+    return m_nWireLength > 0 ? (double) m_nUncompressedLength / m_nWireLength : 1.0;
+}
+
+/** This function stuffs shared messages (which it does not alter) into a packet */
+bool CMOOSCommPkt::Serialize(const MOOSMSG_LIST & List,
+                             const MOOSMSG_PTR_LIST & SharedList,
+                             bool bGatherList) {
+
+    //lets figure out how much space we need? (payloads we won't copy
+    //need no room)
+    unsigned int nBufferSize = kHeaderSize;
+    if (m_pDictionary != NULL)
+        nBufferSize += kCompactMsgOverhead * (List.size() + SharedList.size());
+    MOOSMSG_LIST::const_iterator p;
+    MOOSMSG_PTR_LIST::const_iterator q;
+    for (p = List.begin(); p != List.end(); ++p) {
+        nBufferSize += p->GetSizeInBytesWhenSerialised();
+        if (bGatherList && p->m_sVal.size() >= MOOS_PKT_GATHER_THRESHOLD)
+            nBufferSize -= p->m_sVal.size();
+    }
+    for (q = SharedList.begin(); q != SharedList.end(); ++q) {
+        nBufferSize += (*q)->GetSizeInBytesWhenSerialised();
+        if ((*q)->m_sVal.size() >= MOOS_PKT_GATHER_THRESHOLD)
+            nBufferSize -= (*q)->m_sVal.size();
+    }
+
+    StartWriting(nBufferSize);
+
+    for (p = List.begin(); p != List.end(); ++p)
+        if (!WriteMsg(*p, bGatherList))
+            return false;
+
+    for (q = SharedList.begin(); q != SharedList.end(); ++q) {
+        if (!WriteMsg(**q, true))
+            return false;
+        if ((*q)->m_sVal.size() >= MOOS_PKT_GATHER_THRESHOLD)
+            m_GatheredOwners.push_back(*q);
+    }
+
+    FinishWriting(List.size() + SharedList.size());
+
+    return true;
+}
+
+/** This function stuffs messages in/from a packet */
+bool CMOOSCommPkt::Serialize(MOOSMSG_LIST &List,
+                             bool bToStream,
+                             bool bNoNULL,
+                             double * pdfPktTime) {
+
+    if (bToStream) {
+
+        return Serialize(List, MOOSMSG_PTR_LIST());
+
+    } else {
+
+        int nMessages = ReadHeader();
+
+        int nSpaceFree = m_nMsgLen - m_nByteCount;
+
+        if (m_bCompactRead) {
+            //ReadCompact() has decoded it already
+            for (unsigned int i = 0; i < m_CompactViews.size(); i++) {
+                const MOOS::MsgView & View = m_CompactViews[i];
+
+                if (View.IsType(MOOS_NULL_MSG) && pdfPktTime != NULL && i == 0) {
+                    *pdfPktTime = View.GetDouble();
+                }
+
+                if (!(bNoNULL && View.IsType(MOOS_NULL_MSG))) {
+                    List.push_back(CMOOSMsg());
+                    View.ToMsg(List.back());
+                }
+            }
+            nMessages = 0;
+            m_nByteCount = m_nMsgLen;
+            m_pNextData = m_pStream + m_nMsgLen;
+        }
 
         for (int i = 0; i < nMessages; i++) {
 
-            CMOOSMsg Msg;
+            //decode straight into the list so we don't copy each message twice
+            List.push_back(CMOOSMsg());
+            CMOOSMsg & Msg = List.back();
+
             int nUsed = Msg.Serialize(m_pNextData, nSpaceFree, false);
 
             if (nUsed != -1) {
@@ -252,8 +763,8 @@ bool CMOOSCommPkt::Serialize(MOOSMSG_LIST &List,
                     *pdfPktTime = Msg.GetDouble();
                 }
 
-                if (!bOmit) {
-                    List.push_back(Msg);
+                if (bOmit) {
+                    List.pop_back();
                 }
 
                 m_pNextData += nUsed;
@@ -262,6 +773,7 @@ bool CMOOSCommPkt::Serialize(MOOSMSG_LIST &List,
 
             } else {
                 //bad news...
+                List.pop_back();
                 break;
             }
         }
@@ -273,3 +785,212 @@ bool CMOOSCommPkt::Serialize(MOOSMSG_LIST &List,
     return true;
 }
 
+
+
+bool CMOOSCommPkt::Deserialize(MOOS::MsgViewVector & Views,
+                               bool bNoNULL,
+                               double * pdfPktTime) {
+
+    int nMessages = ReadHeader();
+
+    int nSpaceFree = m_nMsgLen - m_nByteCount;
+
+    if (m_bCompactRead) {
+        //ReadCompact() has decoded it already
+        Views.reserve(Views.size() + m_CompactViews.size());
+        for (unsigned int i = 0; i < m_CompactViews.size(); i++) {
+            const MOOS::MsgView & View = m_CompactViews[i];
+
+            if (View.IsType(MOOS_NULL_MSG) && pdfPktTime != NULL && i == 0) {
+                *pdfPktTime = View.GetDouble();
+            }
+
+            if (!(bNoNULL && View.IsType(MOOS_NULL_MSG))) {
+                Views.push_back(View);
+            }
+        }
+        nMessages = 0;
+        m_nByteCount = m_nMsgLen;
+        m_pNextData = m_pStream + m_nMsgLen;
+    }
+
+    //every message takes more than 50 bytes so the count can't make us
+    //reserve more than the stream could hold
+    Views.reserve(Views.size() + std::min(nMessages, std::max(nSpaceFree, 0) / 50));
+
+    for (int i = 0; i < nMessages; i++) {
+
+        MOOS::MsgView View;
+        int nUsed = View.Decode(m_pNextData, nSpaceFree);
+
+        if (nUsed == -1) {
+            //bad news...
+            break;
+        }
+
+        if (View.IsType(MOOS_NULL_MSG) && pdfPktTime != NULL && i == 0) {
+            *pdfPktTime = View.GetDouble();
+        }
+
+        if (!(bNoNULL && View.IsType(MOOS_NULL_MSG))) {
+            Views.push_back(View);
+        }
+
+        m_pNextData += nUsed;
+        m_nByteCount += nUsed;
+        nSpaceFree -= nUsed;
+    }
+
+    m_nMsgLen = m_nByteCount;
+
+    return true;
+}
+
+int CMOOSCommPkt::ReadHeader() {
+
+    m_pNextData = m_pStream;
+    m_nMsgLen = 0;
+    m_nByteCount = 0;
+
+    //first figure out the length of the message
+    //look to swap byte order as required
+    memcpy((void*) (&m_nMsgLen), (void*) m_pNextData, sizeof(m_nMsgLen));
+    m_nMsgLen = IsLittleEndian()
+                                 ? m_nMsgLen
+                                 : SwapByteOrder<int> (m_nMsgLen);
+    m_pNextData += sizeof(m_nMsgLen);
+    m_nByteCount += sizeof(m_nMsgLen);
+
+    //now figure out how many messages are packed in this packet
+    //look to swap byte order as required
+    int nMessages = 0;
+    memcpy((void*) (&nMessages), (void*) m_pNextData, sizeof(nMessages));
+    nMessages = IsLittleEndian()
+                                 ? nMessages
+                                 : SwapByteOrder<int> (nMessages);
+    m_pNextData += sizeof(nMessages);
+    m_nByteCount += sizeof(nMessages);
+
+    //now account for one byet of compression indication
+    unsigned char cCompression = *m_pNextData;
+    m_pNextData += sizeof(unsigned char);
+    m_nByteCount += sizeof(unsigned char);
+
+    if (!m_bCompactRead) {
+        m_nWireLength = m_nMsgLen;
+        m_nUncompressedLength = m_nMsgLen;
+    }
+
+    if (cCompression & ~(kLZCompressed | kCompact)) {
+        std::cerr << "CMOOSCommPkt received a packet with unknown compression "
+                << (int) cCompression << "\n";
+        return 0;
+    }
+
+    if ((cCompression & kLZCompressed) && !Inflate()) {
+        std::cerr << "CMOOSCommPkt failed to decompress a packet\n";
+        return 0;
+    }
+
+    if ((cCompression & kCompact) && !m_bCompactRead) {
+        std::cerr << "CMOOSCommPkt received a compact packet it has no dictionary for\n";
+        return 0;
+    }
+
+    return nMessages;
+}
+
+bool CMOOSCommPkt::Inflate() {
+
+    int nCompressed = m_nMsgLen - (int) (kHeaderSize + sizeof(int));
+    if (nCompressed < 0) {
+        return false;
+    }
+
+    int nBody = ReadIntAsLittleEndian(m_pNextData);
+
+    //nothing we write can expand by more than this so don't be
+    //tricked into allocating silly amounts of memory
+    if (nBody < 0 || nBody > MOOS_PKT_MAX_SIZE
+            || (nBody - 16) / 255 > nCompressed) {
+        return false;
+    }
+
+    int nNewLength = kHeaderSize + nBody;
+    unsigned int nCapacity;
+    unsigned char * pInflated = m_pPool->Get(nNewLength, nCapacity);
+
+    if (!MOOS::LZ::Decompress(m_pNextData + sizeof(int), nCompressed,
+            pInflated + kHeaderSize, nBody)) {
+        m_pPool->Return(pInflated, nCapacity);
+        return false;
+    }
+
+    //the inflated stream looks as if it had never been compressed
+    memcpy((void*) pInflated, (void*) m_pStream, kHeaderSize);
+    WriteIntAsLittleEndian(pInflated, nNewLength);
+    pInflated[2 * sizeof(int)] &= ~kLZCompressed;
+
+    m_pPool->Return(m_pStream, m_nStreamSpace);
+    m_pStream = pInflated;
+    m_nStreamSpace = nCapacity;
+    m_pNextData = m_pStream + kHeaderSize;
+
+    m_nMsgLen = nNewLength;
+    m_nUncompressedLength = nNewLength;
+
+    return true;
+}
+
+void CMOOSCommPkt::SetWireDictionary(MOOS::WireDictionary * pDictionary) {
+    m_pDictionary = pDictionary;
+}
+
+bool CMOOSCommPkt::ReadCompact(MOOS::WireDictionary & Dictionary) {
+
+    m_CompactViews.clear();
+    m_bCompactRead = false;
+
+    if (m_nByteCount < (int) kHeaderSize
+            || !(m_pStream[2 * sizeof(int)] & kCompact)) {
+        return true;
+    }
+
+    int nMessages = ReadIntAsLittleEndian(m_pStream + sizeof(int));
+    if (nMessages < 0)
+        return false;
+
+    m_nMsgLen = m_nByteCount;
+    m_nWireLength = m_nByteCount;
+    m_nUncompressedLength = m_nByteCount;
+    m_pNextData = m_pStream + kHeaderSize;
+
+    if ((m_pStream[2 * sizeof(int)] & kLZCompressed) && !Inflate())
+        return false;
+
+    const unsigned char * pNext = m_pStream + kHeaderSize;
+    const unsigned char * pEnd = m_pStream + m_nMsgLen;
+
+    //every compact message is at least 4 bytes so don't be tricked into
+    //reserving silly amounts of memory
+    m_CompactViews.reserve(std::min(nMessages, (int) (pEnd - pNext) / 4));
+
+    //the views point into this stream and the dictionary (whose names stay
+    //put until it is cleared)
+    for (int i = 0; i < nMessages; i++) {
+        MOOS::MsgView View;
+        pNext = ReadCompactMsg(pNext, pEnd, View, Dictionary);
+        if (pNext == NULL)
+            return false;
+        m_CompactViews.push_back(View);
+    }
+
+    if (pNext != pEnd)
+        return false;
+
+    m_nByteCount = m_nMsgLen;
+    m_pNextData = m_pStream + m_nMsgLen;
+    m_bCompactRead = true;
+
+    return true;
+}
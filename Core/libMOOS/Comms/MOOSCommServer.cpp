@@ -126,9 +126,12 @@ CMOOSCommServer::CMOOSCommServer()
 {
     m_nMaxSocketFD = 0;
     m_pfnRxCallBack = NULL;
+    m_pfnRxViewCallBack = NULL;
     m_pfnDisconnectCallBack = NULL;
     m_pfnConnectCallBack = NULL;
 	m_pfnFetchAllMailCallBack = NULL;
+	m_pfnFetchAllSharedMailCallBack = NULL;
+	m_pfnFetchClientsWithMailCallBack = NULL;
     m_sCommunityName = "#1";
     m_bQuiet  = false;
 	m_bDisableNameLookUp = true;
@@ -139,6 +142,8 @@ CMOOSCommServer::CMOOSCommServer()
 
 	m_dfClientTimeout = TOLERABLE_SILENCE;
 	m_dfCommsLatencyConcern = TOLERABLE_TRANSIT_TIME;
+	m_nCompressionThreshold = 0;
+	m_bSharedMemory = false;
 }
 
 CMOOSCommServer::~CMOOSCommServer()
@@ -178,6 +183,8 @@ bool CMOOSCommServer::Stop()
     m_ClientSocketList.clear();
     m_Socket2ClientMap.clear();
     m_AsynchronousClientSet.clear();
+    m_CompressionClientSet.clear();
+    m_CompactWireClientSet.clear();
     m_ClientTimingVector.clear();
 
     return true;
@@ -328,6 +335,16 @@ bool CMOOSCommServer::SetClientTimeout(double dfTimeoutPeriod)
 	return true;
 }
 
+void CMOOSCommServer::SetCompressionThreshold(unsigned int nBytes)
+{
+	m_nCompressionThreshold = nBytes;
+}
+
+void CMOOSCommServer::EnableSharedMemory(bool bEnable)
+{
+	m_bSharedMemory = bEnable;
+}
+
 
 bool  CMOOSCommServer::OnAbsentClient(XPCTcpSocket* pClient)
 {
@@ -655,7 +672,7 @@ bool CMOOSCommServer::ProcessClient()
         if(m_pfnRxCallBack!=NULL)
         {
 
-            CMOOSCommPkt PktRx,PktTx;
+            CMOOSCommPkt PktRx(m_pPktPool),PktTx(m_pPktPool);
             MOOSMSG_LIST MsgLstRx,MsgLstTx;
 
             //read input
@@ -696,6 +713,12 @@ bool CMOOSCommServer::ProcessClient()
             //stuff reply mesage into a packet
             PktTx.Serialize(MsgLstTx,true);
 
+            if(m_nCompressionThreshold>0 &&
+            		m_CompressionClientSet.find(sWho)!=m_CompressionClientSet.end())
+            {
+            	PktTx.Compress(m_nCompressionThreshold);
+            }
+
             //send packet
             SendPkt(m_pFocusSocket,PktTx);
 
@@ -822,6 +845,8 @@ bool CMOOSCommServer::OnClientDisconnect()
 
         m_Socket2ClientMap.erase(p);
         m_AsynchronousClientSet.erase(sWho);
+        m_CompressionClientSet.erase(sWho);
+        m_CompactWireClientSet.erase(sWho);
     }
 
 
@@ -862,6 +887,15 @@ void CMOOSCommServer::SetOnRxCallBack(bool ( *pfn)(const std::string & ,MOOSMSG_
     m_pRxCallBackParam = pParam;
 }
 
+void CMOOSCommServer::SetOnRxViewCallBack(bool ( *pfn)(const std::string & ,MOOS::MsgViewVector & RxViews,MOOSMSG_LIST & MsgListTx, void * pParam), void * pParam)
+{
+    //address of function to invoke (static)
+    m_pfnRxViewCallBack=pfn;
+
+    //store the parameter to pass with the invocation
+    m_pRxViewCallBackParam = pParam;
+}
+
 //void CMOOSCommServer::SetOnDisconnectCallBack(bool (__cdecl *pfn)(string & MsgListRx, void * pParam), void * pParam)
 void CMOOSCommServer::SetOnDisconnectCallBack(bool (*pfn)(string & , void * pParam), void * pParam)
 {
@@ -895,6 +929,26 @@ void CMOOSCommServer::SetOnFetchAllMailCallBack(bool (*pfn)(const std::string  &
 
 }
 
+void CMOOSCommServer::SetOnFetchAllSharedMailCallBack(bool (*pfn)(const std::string  & sClient,MOOSMSG_PTR_LIST & SharedListTx,void * pParam),void * pParam)
+{
+    //address of function to invoke (static)
+	m_pfnFetchAllSharedMailCallBack = pfn;
+
+	//store the parameter to pass with the invocation
+	m_pFetchAllSharedMailCallBackParam = pParam;
+
+}
+
+void CMOOSCommServer::SetOnFetchClientsWithMailCallBack(bool (*pfn)(STRING_LIST & Clients,void * pParam),void * pParam)
+{
+    //address of function to invoke (static)
+	m_pfnFetchClientsWithMailCallBack = pfn;
+
+	//store the parameter to pass with the invocation
+	m_pFetchClientsWithMailCallBackParam = pParam;
+
+}
+
 bool CMOOSCommServer::IsUniqueName(string &sClientName)
 {
     SOCKETFD_2_CLIENT_NAME_MAP::iterator p;
@@ -916,6 +970,7 @@ bool CMOOSCommServer::IsUniqueName(string &sClientName)
 //note we are only reading a few bytes so this lets us catch the case where
 //an old client that doesn't send a string simp;y sends a COmmPkt first
 //chances of a comm packet spelling out a protocol name are pretty damn slim.....
+//bCompact is set if the client can read compact packets
 bool CheckProtocol(XPCTcpSocket *pNewClient)
 {
     char sProtocol[MOOS_PROTOCOL_STRING_BUFFER_SIZE+1] = {};
@@ -927,6 +982,7 @@ bool CheckProtocol(XPCTcpSocket *pNewClient)
                         "MOOSLIB which uses the same protocol.\n");
 
     }
+
     if (!MOOSStrCmp(sProtocol, MOOS_PROTOCOL_STRING))
     {
         //this is bad - wrong flavour of comms - perhaps client needs to be recompiled...
@@ -970,6 +1026,44 @@ bool CMOOSCommServer::HandShake(XPCTcpSocket *pNewClient)
                 	m_AsynchronousClientSet.insert(Msg.m_sVal);
                 }
 
+                //newer clients tell us what they can decompress
+                std::string sCompression;
+                if(MOOSValFromString(sCompression,Msg.m_sSrcAux,"compression",true) &&
+                		MOOSStrCmp(sCompression,MOOS_PKT_COMPRESSION))
+                {
+                	m_CompressionClientSet.insert(Msg.m_sVal);
+                }
+                else
+                {
+                	m_CompressionClientSet.erase(Msg.m_sVal);
+                }
+
+                //and can it read compact packets?
+                std::string sWire;
+                if(SupportsCompactWire() &&
+                		MOOSValFromString(sWire,Msg.m_sSrcAux,"wire",true) &&
+                		MOOSStrCmp(sWire,MOOS_PKT_COMPACT))
+                {
+                	m_CompactWireClientSet.insert(Msg.m_sVal);
+                }
+                else
+                {
+                	m_CompactWireClientSet.erase(Msg.m_sVal);
+                }
+
+                //and would it like to talk through shared memory? (we'll only
+                //be able to open it if we are on the same machine)
+                m_SharedMemoryChannels.erase(Msg.m_sVal);
+                std::string sShmName,sShmKey;
+                if(m_bSharedMemory && SupportsSharedMemoryClients() &&
+                		MOOSValFromString(sShmName,Msg.m_sSrcAux,"shm_name",true) &&
+                		MOOSValFromString(sShmKey,Msg.m_sSrcAux,"shm_key",true))
+                {
+                	MOOS::SharedMemoryChannel * pChannel = MOOS::SharedMemoryChannel::Attach(sShmName,sShmKey);
+                	if(pChannel!=NULL)
+                		m_SharedMemoryChannels[Msg.m_sVal] = pChannel;
+                }
+
             }
             else
             {
@@ -995,6 +1089,17 @@ bool CMOOSCommServer::HandShake(XPCTcpSocket *pNewClient)
         std::string sAux;
         MOOSAddValToString(sAux,"hostname",GetLocalIPAddress());
 
+        //and we can read compressed packets
+        MOOSAddValToString(sAux,"compression",MOOS_PKT_COMPRESSION);
+
+        //and will send compact packets if the client can read them
+        if(m_CompactWireClientSet.find(Msg.m_sVal)!=m_CompactWireClientSet.end())
+            MOOSAddValToString(sAux,"wire",MOOS_PKT_COMPACT);
+
+        //and will use shared memory if it was offered and we could open it
+        if(m_SharedMemoryChannels.find(Msg.m_sVal)!=m_SharedMemoryChannels.end())
+            MOOSAddValToString(sAux,"shm","ok");
+
         MsgW.m_sSrcAux = sAux;
         MsgW.m_sOriginatingCommunity = m_sCommunityName;
         SendMsg(pNewClient,MsgW);
@@ -1039,6 +1144,16 @@ bool CMOOSCommServer::SupportsAsynchronousClients()
 	return false;
 }
 
+bool CMOOSCommServer::SupportsSharedMemoryClients()
+{
+	return false;
+}
+
+bool CMOOSCommServer::SupportsCompactWire()
+{
+	return false;
+}
+
 void CMOOSCommServer::DoBanner()
 {
     if(m_bQuiet)
@@ -1069,6 +1184,15 @@ void CMOOSCommServer::DoBanner()
     	std::cout<<MOOS::ConsoleColours::red()<<"off\n"<<MOOS::ConsoleColours::reset();
     }
 
+    if(m_bSharedMemory)
+    {
+        std::cout<<"  Shared memory transport is        ";
+        if(SupportsSharedMemoryClients())
+            std::cout<<MOOS::ConsoleColours::Green()<<"on\n"<<MOOS::ConsoleColours::reset();
+        else
+            std::cout<<MOOS::ConsoleColours::red()<<"off (not with this server)\n"<<MOOS::ConsoleColours::reset();
+    }
+
     std::cout<<"  Connect to this server on port    ";
     std::cout<<MOOS::ConsoleColours::green()<<m_lListenPort<<MOOS::ConsoleColours::reset()<<"\n";
 
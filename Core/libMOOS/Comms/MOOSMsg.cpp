@@ -150,21 +150,6 @@ template<class T> T CopyFromBufferAsLittleEndian(unsigned char* pBuffer)
 }
 
 
-void  CMOOSMsg::operator << (double & dfVal)
-{
-    int nSize = sizeof(dfVal);
-
-    if(CanSerialiseN(nSize))
-    {
-        CopyToBufferAsLittleEndian<double>(dfVal,m_pSerializeBuffer);
-        m_pSerializeBuffer+=nSize;
-    }
-    else
-    {
-        throw CMOOSException("CMOOSMsg::operator << Out Of Space");
-    }
-}
-
 void  CMOOSMsg::operator >> (double & dfVal)
 {
 	
@@ -184,36 +169,6 @@ void  CMOOSMsg::operator >> (double & dfVal)
 
 
 
-void  CMOOSMsg::operator << (string &   sVal)
-{
-/*
-    int nSize = sVal.size()+1;
-
-    if(CanSerialiseN(nSize))
-    {
-        strcpy((char *)m_pSerializeBuffer,sVal.c_str());
-        m_pSerializeBuffer+=nSize;
-    }
-    else
-    {
-        throw CMOOSException("CMOOSMsg::operator << Out Of Space");
-    }
- */
-	int nSize = sVal.size();
-	*this<<nSize;
-	
-	if(CanSerialiseN(nSize))
-    {
-        memcpy((char *)m_pSerializeBuffer,sVal.data(),nSize);
-        m_pSerializeBuffer+=nSize;
-    }
-    else
-    {
-        throw CMOOSException("CMOOSMsg::operator << Out Of Space");
-    }
-	
-}
-
 void  CMOOSMsg::operator >> (string & sVal)
 {
 	int nSize;
@@ -234,22 +189,6 @@ void  CMOOSMsg::operator >> (string & sVal)
 }
 
 
-void  CMOOSMsg::operator << (int & nVal)
-{
-    int nSize = sizeof(int);
-
-    if(CanSerialiseN(nSize))
-    {
-        CopyToBufferAsLittleEndian<int>(nVal,m_pSerializeBuffer);
-        //        memcpy((void*)(m_pSerializeBuffer),(void*)(&nVal),sizeof(nVal));
-        m_pSerializeBuffer+=nSize;
-    }
-    else
-    {
-        throw CMOOSException("CMOOSMsg::operator << Out Of Space");
-    }
-
-}
 void  CMOOSMsg::operator >> (int & nVal)
 {
     int nSize = sizeof(int);
@@ -268,22 +207,6 @@ void  CMOOSMsg::operator >> (int & nVal)
 
 }
 
-void  CMOOSMsg::operator << (char &  cVal)
-{
-    int nSize = sizeof(cVal);
-
-    if(CanSerialiseN(nSize))
-    {
-        memcpy((void*)(m_pSerializeBuffer),(void*)(&cVal),sizeof(cVal));
-        m_pSerializeBuffer+=sizeof(cVal);
-    }
-    else
-    {
-        throw CMOOSException("CMOOSMsg::operator << Out Of Space");
-    }
-
-}
-
 void  CMOOSMsg::operator >> (char & cVal)
 {
     int nSize = sizeof(cVal);
@@ -317,72 +240,75 @@ unsigned int CMOOSMsg::GetSizeInBytesWhenSerialised() const
 }
 
 
-int CMOOSMsg::Serialize(unsigned char *pBuffer, int nLen, bool bToStream)
+/** copies a length prefixed string to a buffer, returns the next free byte */
+static unsigned char * CopyStringToBuffer(const std::string & sVal,unsigned char* pBuffer)
 {
+    int nSize = (int)sVal.size();
+    CopyToBufferAsLittleEndian<int>(nSize,pBuffer);
+    pBuffer+=sizeof(int);
+    memcpy((void*)pBuffer,(const void*)sVal.data(),nSize);
+    return pBuffer+nSize;
+}
 
-    if(bToStream)
-    {
-        try
-        {
-
-            //MOOSTrace("Packing Msg with community %s\n",m_sOriginatingCommunity.c_str());
-
-            m_pSerializeBuffer = pBuffer;
-            m_pSerializeBufferStart = pBuffer;
-            m_nSerializeBufferLen = nLen;
-
-            //leave space for total byte count
-            m_pSerializeBuffer +=sizeof(int);
-
-            //what is message ID;
-            (*this)<<m_nID;
-
-            //what type of message is this?
-            (*this)<<m_cMsgType;
+int CMOOSMsg::SerializeTo(unsigned char *pBuffer, int nLen) const
+{
+    int nHeader = SerializeHeaderTo(pBuffer,nLen);
+    if(nHeader==-1)
+        return -1;
 
-            //what type of data is this?
-            (*this)<<m_cDataType;
+    memcpy((void*)(pBuffer+nHeader),(const void*)m_sVal.data(),m_sVal.size());
 
-            //from whence does it come
-            (*this)<<m_sSrc;
+    return nHeader+(int)m_sVal.size();
+}
 
-			//extra source info
-			(*this)<<m_sSrcAux;
+int CMOOSMsg::SerializeHeaderTo(unsigned char *pBuffer, int nLen) const
+{
+    int nLength = (int)GetSizeInBytesWhenSerialised();
+    if(nLength-(int)m_sVal.size()>nLen)
+    {
+        MOOSTrace("CMOOSMsg::SerializeTo failed: message needs %d bytes but only %d are available\n",nLength-(int)m_sVal.size(),nLen);
+        return -1;
+    }
 
-            //and from which community?
-            (*this)<<m_sOriginatingCommunity;
+    unsigned char * p = pBuffer;
 
-            //what
-            (*this)<<m_sKey;
+    //how many bytes in total (this includes this int at the start)
+    CopyToBufferAsLittleEndian<int>(nLength,p); p+=sizeof(int);
 
-            //what time was the notification?
-            (*this)<<m_dfTime;
+    //what is message ID;
+    CopyToBufferAsLittleEndian<int>(m_nID,p); p+=sizeof(int);
 
-            //double data
-            (*this)<<m_dfVal;
+    //what type of message is this and what type of data is it?
+    *p++ = (unsigned char)m_cMsgType;
+    *p++ = (unsigned char)m_cDataType;
 
-            //double data
-            (*this)<<m_dfVal2;
+    //from whence does it come, extra source info, from which community and what
+    p = CopyStringToBuffer(m_sSrc,p);
+    p = CopyStringToBuffer(m_sSrcAux,p);
+    p = CopyStringToBuffer(m_sOriginatingCommunity,p);
+    p = CopyStringToBuffer(m_sKey,p);
 
-            //string data
-            (*this)<<m_sVal;
+    //time of notification and double data
+    CopyToBufferAsLittleEndian<double>(m_dfTime,p); p+=sizeof(double);
+    CopyToBufferAsLittleEndian<double>(m_dfVal,p); p+=sizeof(double);
+    CopyToBufferAsLittleEndian<double>(m_dfVal2,p); p+=sizeof(double);
 
-            //how many bytes in total have we written (this includes an int at the start)?
-            m_nLength = m_pSerializeBuffer-m_pSerializeBufferStart;
+    //string data - just its length, the caller deals with the rest
+    CopyToBufferAsLittleEndian<int>((int)m_sVal.size(),p); p+=sizeof(int);
 
-            //reset destination
-            m_pSerializeBuffer = m_pSerializeBufferStart;
+    return (int)(p-pBuffer);
+}
 
-            //write the number of bytes
-            (*this)<<m_nLength;
+int CMOOSMsg::Serialize(unsigned char *pBuffer, int nLen, bool bToStream)
+{
 
-        }
-        catch(CMOOSException & e)
-        {
-            MOOSTrace("exception : CMOOSMsg::Serialize failed: %s\n ",e.m_sReason);
-			MOOSTrace("perhaps accummulated messages exceeded available buffer space of %d bytes\n", m_nSerializeBufferLen);
+    if(bToStream)
+    {
+        int nWritten = SerializeTo(pBuffer,nLen);
+        if(nWritten==-1)
             return -1;
-        }
+
+        m_nLength = nWritten;
     }
     else
     {
@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * MOOSMsgView.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "MOOS/libMOOS/Comms/MOOSMsgView.h"
+
+#include <cstring>
+
+namespace
+{
+const bool kLittleEndian = IsLittleEndian();
+
+//a tiny cursor over a serialised message. Mirrors the stream operators
+//in CMOOSMsg but never copies string data
+class Reader
+{
+public:
+    Reader(const unsigned char * pBuffer, int nSpace)
+        :m_pStart(pBuffer),m_pNext(pBuffer),m_nSpace(nSpace),m_bOK(true){}
+
+    template<class T> T Get()
+    {
+        T Val = T();
+        if(!CanRead(sizeof(T)))
+            return Val;
+        memcpy((void*)&Val,(const void*)m_pNext,sizeof(T));
+        m_pNext+=sizeof(T);
+        return kLittleEndian ? Val : SwapByteOrder<T>(Val);
+    }
+
+    MOOS::StringView GetString()
+    {
+        int nSize = Get<int>();
+        if(nSize<0 || !CanRead(nSize))
+        {
+            m_bOK = false;
+            return MOOS::StringView();
+        }
+        MOOS::StringView s((const char *)m_pNext,(unsigned int)nSize);
+        m_pNext+=nSize;
+        return s;
+    }
+
+    bool OK() const {return m_bOK;}
+    int Used() const {return (int)(m_pNext-m_pStart);}
+
+private:
+    bool CanRead(int N)
+    {
+        if(m_bOK && Used()+N<=m_nSpace)
+            return true;
+        m_bOK = false;
+        return false;
+    }
+
+    const unsigned char * m_pStart;
+    const unsigned char * m_pNext;
+    int m_nSpace;
+    bool m_bOK;
+};
+}
+
+namespace MOOS
+{
+
+MsgView::MsgView()
+    :m_nID(-1),
+     m_cMsgType(MOOS_NULL_MSG),
+     m_cDataType(MOOS_DOUBLE),
+     m_dfTime(-1),
+     m_dfVal(-1),
+     m_dfVal2(-1)
+{
+}
+
+MsgView::MsgView(const CMOOSMsg & Msg)
+    :m_nID(Msg.m_nID),
+     m_cMsgType(Msg.m_cMsgType),
+     m_cDataType(Msg.m_cDataType),
+     m_dfTime(Msg.m_dfTime),
+     m_dfVal(Msg.m_dfVal),
+     m_dfVal2(Msg.m_dfVal2),
+     m_Key(Msg.m_sKey.data(),Msg.m_sKey.size()),
+     m_Val(Msg.m_sVal.data(),Msg.m_sVal.size()),
+     m_Src(Msg.m_sSrc.data(),Msg.m_sSrc.size()),
+     m_SrcAux(Msg.m_sSrcAux.data(),Msg.m_sSrcAux.size()),
+     m_Community(Msg.m_sOriginatingCommunity.data(),Msg.m_sOriginatingCommunity.size())
+{
+}
+
+int MsgView::Decode(const unsigned char * pBuffer, int nSpace)
+{
+    Reader R(pBuffer,nSpace);
+
+    //the order here must match CMOOSMsg::Serialize
+    int nLength = R.Get<int>();
+    m_nID = R.Get<int>();
+    m_cMsgType = R.Get<char>();
+    m_cDataType = R.Get<char>();
+    m_Src = R.GetString();
+    m_SrcAux = R.GetString();
+    m_Community = R.GetString();
+    m_Key = R.GetString();
+    m_dfTime = R.Get<double>();
+    m_dfVal = R.Get<double>();
+    m_dfVal2 = R.Get<double>();
+    m_Val = R.GetString();
+
+    if(!R.OK() || nLength!=R.Used())
+        return -1;
+
+    return nLength;
+}
+
+void MsgView::ToMsg(CMOOSMsg & Msg) const
+{
+    Msg.m_nID = m_nID;
+    Msg.m_cMsgType = m_cMsgType;
+    Msg.m_cDataType = m_cDataType;
+    Msg.m_dfTime = m_dfTime;
+    Msg.m_dfVal = m_dfVal;
+    Msg.m_dfVal2 = m_dfVal2;
+    m_Src.AssignTo(Msg.m_sSrc);
+    m_SrcAux.AssignTo(Msg.m_sSrcAux);
+    m_Community.AssignTo(Msg.m_sOriginatingCommunity);
+    m_Key.AssignTo(Msg.m_sKey);
+    m_Val.AssignTo(Msg.m_sVal);
+}
+
+}
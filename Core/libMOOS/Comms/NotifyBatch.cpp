@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * NotifyBatch.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/NotifyBatch.h"
+
+namespace MOOS
+{
+
+NotifyBatch::NotifyBatch(CMOOSCommClient & Comms):m_Comms(Comms)
+{
+}
+
+void NotifyBatch::Notify(const std::string &sVar, const std::string & sVal, double dfTime)
+{
+    m_Msgs.push_back(CMOOSMsg(MOOS_NOTIFY,sVar,sVal,dfTime));
+}
+
+void NotifyBatch::Notify(const std::string &sVar, const std::string & sVal, const std::string & sSrcAux, double dfTime)
+{
+    Notify(sVar,sVal,dfTime);
+    m_Msgs.back().SetSourceAux(sSrcAux);
+}
+
+void NotifyBatch::Notify(const std::string &sVar, const char * sVal,double dfTime)
+{
+    Notify(sVar,std::string(sVal),dfTime);
+}
+
+void NotifyBatch::Notify(const std::string &sVar, const char * sVal,const std::string & sSrcAux, double dfTime)
+{
+    Notify(sVar,std::string(sVal),sSrcAux,dfTime);
+}
+
+void NotifyBatch::Notify(const std::string & sVar,double dfVal, double dfTime)
+{
+    m_Msgs.push_back(CMOOSMsg(MOOS_NOTIFY,sVar,dfVal,dfTime));
+}
+
+void NotifyBatch::Notify(const std::string & sVar,double dfVal, const std::string & sSrcAux,double dfTime)
+{
+    Notify(sVar,dfVal,dfTime);
+    m_Msgs.back().SetSourceAux(sSrcAux);
+}
+
+void NotifyBatch::Notify(const std::string & sVar,void *  pData, unsigned int nDataSize, double dfTime)
+{
+    m_Msgs.push_back(CMOOSMsg(MOOS_NOTIFY,sVar,nDataSize,pData,dfTime));
+    m_Msgs.back().MarkAsBinary();
+}
+
+void NotifyBatch::Notify(const std::string & sVar,const std::vector<unsigned char>& vData,double dfTime)
+{
+    if(!vData.empty())
+        Notify(sVar,(void*)(&vData[0]),vData.size(),dfTime);
+}
+
+bool NotifyBatch::Commit()
+{
+    if(m_Msgs.empty())
+        return true;
+
+    return m_Comms.Notify(m_Msgs);
+}
+
+void NotifyBatch::Clear()
+{
+    m_Msgs.clear();
+}
+
+unsigned int NotifyBatch::Size() const
+{
+    return m_Msgs.size();
+}
+
+}
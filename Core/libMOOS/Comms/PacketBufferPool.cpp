@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * PacketBufferPool.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/PacketBufferPool.h"
+#include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
+
+namespace
+{
+//small buffers are cheap to hoard, big ones aren't
+const unsigned int kMaxSpareBytesPerClass = 4*1024*1024;
+}
+
+namespace MOOS
+{
+
+PacketBufferPool::PacketBufferPool():
+        m_nReused(0),
+        m_nAllocated(0)
+{
+}
+
+PacketBufferPool::~PacketBufferPool()
+{
+    for(unsigned int i = 0;i<kNumClasses;i++)
+    {
+        unsigned char * pBuffer;
+        while((pBuffer = m_FreeLists[i].Take())!=NULL)
+            delete [] pBuffer;
+    }
+
+    CMOOSCommPkt * pPkt;
+    while((pPkt = m_SparePkts.Take())!=NULL)
+        delete pPkt;
+}
+
+unsigned int PacketBufferPool::ClassSize(int nClass)
+{
+    return 1U<<(nClass+kSmallestClassBits);
+}
+
+unsigned int PacketBufferPool::MaxSpare(int nClass)
+{
+    unsigned int n = kMaxSpareBytesPerClass/ClassSize(nClass);
+    if(n>kMaxSpare)
+        return kMaxSpare;
+    return n>0 ? n : 1;
+}
+
+int PacketBufferPool::SizeClass(unsigned int nSize)
+{
+    int nClass = 0;
+    while(ClassSize(nClass)<nSize)
+    {
+        if(++nClass==(int)kNumClasses)
+            return -1;
+    }
+    return nClass;
+}
+
+unsigned char * PacketBufferPool::Get(unsigned int nSize, unsigned int & nCapacity)
+{
+    int nClass = SizeClass(nSize);
+
+    if(nClass<0)
+    {
+        //too big to be worth keeping
+        nCapacity = nSize;
+        m_nAllocated++;
+        return new unsigned char[nSize];
+    }
+
+    nCapacity = ClassSize(nClass);
+
+    unsigned char * pBuffer = m_FreeLists[nClass].Take();
+    if(pBuffer!=NULL)
+    {
+        m_nReused++;
+        return pBuffer;
+    }
+
+    m_nAllocated++;
+    return new unsigned char[nCapacity];
+}
+
+void PacketBufferPool::Return(unsigned char * pBuffer, unsigned int nCapacity)
+{
+    if(pBuffer==NULL)
+        return;
+
+    int nClass = SizeClass(nCapacity);
+
+    if(nClass>=0 && ClassSize(nClass)==nCapacity &&
+            m_FreeLists[nClass].Put(pBuffer,MaxSpare(nClass)))
+        return;
+
+    delete [] pBuffer;
+}
+
+bool PacketBufferPool::StashPkt(CMOOSCommPkt * pPkt)
+{
+    return m_SparePkts.Put(pPkt);
+}
+
+CMOOSCommPkt * PacketBufferPool::TakePkt()
+{
+    return m_SparePkts.Take();
+}
+
+unsigned int PacketBufferPool::GetReuseCount()
+{
+    return m_nReused.value();
+}
+
+unsigned int PacketBufferPool::GetAllocationCount()
+{
+    return m_nAllocated.value();
+}
+
+SharedPacketBufferPool PacketBufferPool::Shared()
+{
+    static SharedPacketBufferPool pShared(new PacketBufferPool);
+    return pShared;
+}
+
+}
@@ -0,0 +1,989 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * PeerToPeer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/PeerToPeer.h"
+#include "MOOS/libMOOS/Comms/MOOSCommObject.h"
+#include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
+#include "MOOS/libMOOS/Comms/XPCTcpSocket.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "MOOS/libMOOS/Utils/MOOSException.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
+#include "MOOS/libMOOS/Utils/SafeList.h"
+
+
+#ifndef _WIN32
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <signal.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include <ctime>
+#include <cstdlib>
+
+//how many samples of each variable a writer keeps for readers to fetch
+#define PEER_HISTORY 8
+
+//how long a peer has to say hello
+#define PEER_HANDSHAKE_TIMEOUT 5
+
+//how long to wait before trying a writer we failed to reach again
+#define PEER_RETRY_PERIOD 2.0
+
+namespace MOOS
+{
+
+namespace P2P
+{
+
+bool IsStub(const CMOOSMsg & Msg)
+{
+    if(!Msg.IsType(MOOS_NOTIFY) || !Msg.IsBinary() || !Msg.m_sVal.empty())
+        return false;
+
+    std::string sHost;
+    int nPort;
+    return GetPublisher(Msg,sHost,nPort);
+}
+
+bool GetPublisher(const CMOOSMsg & Stub, std::string & sHost, int & nPort)
+{
+    return MOOSValFromString(sHost,Stub.m_sSrcAux,"p2p_host",true) &&
+            MOOSValFromString(nPort,Stub.m_sSrcAux,"p2p_port",true);
+}
+
+unsigned int GetPayloadSize(const CMOOSMsg & Stub)
+{
+    unsigned int nSize = 0;
+    if(IsStub(Stub))
+        MOOSValFromString(nSize,Stub.m_sSrcAux,"p2p_size",true);
+    return nSize;
+}
+
+unsigned int GetSequence(const CMOOSMsg & Msg)
+{
+    unsigned int nSeq = 0;
+    MOOSValFromString(nSeq,Msg.m_sSrcAux,"p2p_seq",true);
+    return nSeq;
+}
+
+CMOOSMsg MakeStub(const CMOOSMsg & Msg, const std::string & sHost, int nPort,
+        const std::string & sKey, unsigned int nSeq)
+{
+    CMOOSMsg Stub(MOOS_NOTIFY,Msg.GetKey(),std::string(),Msg.GetTime());
+    Stub.MarkAsBinary();
+    Stub.m_sSrc = Msg.m_sSrc;
+    Stub.m_sOriginatingCommunity = Msg.m_sOriginatingCommunity;
+    Stub.m_sSrcAux = Msg.m_sSrcAux;
+    MOOSAddValToString(Stub.m_sSrcAux,"p2p_host",sHost);
+    MOOSAddValToString(Stub.m_sSrcAux,"p2p_port",nPort);
+    MOOSAddValToString(Stub.m_sSrcAux,"p2p_size",(unsigned int)Msg.m_sVal.size());
+    MOOSAddValToString(Stub.m_sSrcAux,"p2p_seq",nSeq);
+    MOOSAddValToString(Stub.m_sSrcAux,"p2p_key",sKey);
+    return Stub;
+}
+
+bool IsRefusal(const CMOOSMsg & Msg)
+{
+    return Msg.IsType(MOOS_DATA) && Msg.IsString() && Msg.m_sVal=="p2p_refused";
+}
+
+CMOOSMsg MakeRefusal(const CMOOSMsg & Stub)
+{
+    CMOOSMsg Refusal(MOOS_DATA,Stub.GetKey(),std::string("p2p_refused"));
+    MOOSAddValToString(Refusal.m_sSrcAux,"p2p_seq",GetSequence(Stub));
+    return Refusal;
+}
+
+}
+
+/** a key for readers to show - they only get it in stubs from the DB
+ * so only clients who have shaken hands with the DB can know it */
+static std::string MakeKey()
+{
+    unsigned char Random[16];
+
+    bool bRandom = false;
+#ifndef _WIN32
+    int fd = open("/dev/urandom",O_RDONLY);
+    bRandom = fd>=0 && read(fd,Random,sizeof(Random))==(ssize_t)sizeof(Random);
+    if(fd>=0)
+        close(fd);
+#endif
+
+    if(!bRandom)
+    {
+        srand((unsigned int)time(NULL)^(unsigned int)(size_t)&Random);
+        for(unsigned int i = 0;i<sizeof(Random);i++)
+            Random[i] = (unsigned char)(rand()&0xFF);
+    }
+
+    std::string sKey;
+    for(unsigned int i = 0;i<sizeof(Random);i++)
+        sKey+=MOOSFormat("%02x",Random[i]);
+
+    return sKey;
+}
+
+
+/**
+ * what both ends of a link between peers have in common - a socket (and
+ * perhaps a shared memory channel) along which whole packets go
+ */
+class PeerConnection : public CMOOSCommObject
+{
+public:
+    PeerConnection(XPCTcpSocket * pSocket) : m_pSocket(pSocket)
+    {
+    }
+
+    virtual ~PeerConnection()
+    {
+        CloseSharedMemory();
+        delete m_pSocket;
+    }
+
+    /** wait up to dfTimeout seconds for something to read. Also says yes
+     * if the connection is broken so reading will find out */
+    bool WaitForPkt(double dfTimeout)
+    {
+        if(IsUsingSharedMemory())
+            return m_pSharedMemory->WaitForData(dfTimeout) || m_pSharedMemory->IsClosed();
+
+        struct timeval Timeout;
+        Timeout.tv_sec = (long)dfTimeout;
+        Timeout.tv_usec = (long)((dfTimeout-Timeout.tv_sec)*1e6);
+
+        fd_set fdset;
+        FD_ZERO(&fdset);
+        FD_SET(m_pSocket->iGetSocketFd(), &fdset);
+
+        return select(m_pSocket->iGetSocketFd()+1,&fdset,NULL,NULL,&Timeout)!=0;
+    }
+
+    /** read the next packet, adding what was in it to Mail */
+    bool ReadMail(MOOSMSG_LIST & Mail)
+    {
+        try
+        {
+            CMOOSCommPkt PktRx(m_pPktPool);
+            ReadPkt(m_pSocket,PktRx);
+            return PktRx.Serialize(Mail,false);
+        }
+        catch(const CMOOSException & e)
+        {
+            MOOS::DeliberatelyNotUsed(e);
+            return false;
+        }
+    }
+
+    /** kick anything blocked on this connection off it */
+    void Shutdown()
+    {
+#ifdef _WIN32
+        shutdown(m_pSocket->iGetSocketFd(),SD_BOTH);
+#else
+        shutdown(m_pSocket->iGetSocketFd(),SHUT_RDWR);
+#endif
+        CloseSharedMemory();
+    }
+
+protected:
+    XPCTcpSocket * m_pSocket;
+};
+
+
+/**
+ * one reader of variables we publish
+ */
+class PeerServer::Peer : public PeerConnection
+{
+public:
+    Peer(PeerServer * pServer, XPCTcpSocket * pSocket) :
+        PeerConnection(pSocket),
+        m_pServer(pServer),
+        m_bDead(false)
+    {
+    }
+
+    ~Peer()
+    {
+        Stop();
+    }
+
+    bool Start()
+    {
+        if(!m_ReadThread.Initialise(ReadDispatch,this) || !m_ReadThread.Start())
+        {
+            m_bDead = true;
+            return false;
+        }
+        return true;
+    }
+
+    void Stop()
+    {
+        m_ReadThread.RequestQuit();
+        m_WriteThread.RequestQuit();
+        Shutdown();
+        m_ReadThread.Stop();
+        m_WriteThread.Stop();
+    }
+
+    bool IsDead()
+    {
+        return m_bDead;
+    }
+
+    /** queue a message for sending - the peer asked for it so it is
+     * owed every one */
+    void Send(const MOOSMSG_PTR & pMsg)
+    {
+        m_OutBox.Push(pMsg);
+    }
+
+private:
+    static bool ReadDispatch(void * pParam)
+    {
+        return static_cast<Peer*>(pParam)->ReadLoop();
+    }
+
+    static bool WriteDispatch(void * pParam)
+    {
+        return static_cast<Peer*>(pParam)->WriteLoop();
+    }
+
+    bool HandShake()
+    {
+        try
+        {
+            CMOOSMsg Hello;
+            if(!ReadMsg(m_pSocket,Hello,PEER_HANDSHAKE_TIMEOUT))
+                return false;
+
+            //no key, no data
+            std::string sKey;
+            if(!MOOSValFromString(sKey,Hello.m_sSrcAux,"p2p_key",true) ||
+                    sKey!=m_pServer->m_sKey)
+            {
+                MOOSTrace("PeerServer refusing a peer which does not have our key\n");
+                return false;
+            }
+
+            CMOOSMsg Welcome(MOOS_WELCOME,"",0.0);
+
+            //a reader on this machine may have offered shared memory
+            MOOS::Poco::SharedPtr<SharedMemoryChannel> pSharedMemory;
+            std::string sShmName,sShmKey;
+            if(m_pServer->m_bSharedMemory &&
+                    MOOSValFromString(sShmName,Hello.m_sSrcAux,"shm_name",true) &&
+                    MOOSValFromString(sShmKey,Hello.m_sSrcAux,"shm_key",true))
+            {
+                pSharedMemory = SharedMemoryChannel::Attach(sShmName,sShmKey);
+                if(!pSharedMemory.isNull())
+                    MOOSAddValToString(Welcome.m_sSrcAux,"shm","ok");
+            }
+
+            SendMsg(m_pSocket,Welcome);
+
+            if(!pSharedMemory.isNull())
+                UseSharedMemory(pSharedMemory);
+
+            return true;
+        }
+        catch(const CMOOSException & e)
+        {
+            MOOS::DeliberatelyNotUsed(e);
+            return false;
+        }
+    }
+
+    bool ReadLoop()
+    {
+#ifndef _WIN32
+        signal(SIGPIPE,SIG_IGN);
+#endif
+        if(HandShake() &&
+                m_WriteThread.Initialise(WriteDispatch,this) &&
+                m_WriteThread.Start())
+        {
+            while(!m_ReadThread.IsQuitRequested() && !m_bDead)
+            {
+                if(!WaitForPkt(1.0))
+                    continue;
+
+                MOOSMSG_LIST Mail;
+                if(!ReadMail(Mail))
+                    break;
+
+                MOOSMSG_LIST::iterator q;
+                for(q = Mail.begin();q!=Mail.end();++q)
+                {
+                    if(q->IsType(MOOS_SERVER_REQUEST))
+                        m_pServer->OnPeerFetch(this,q->GetKey(),(unsigned int)q->GetDouble());
+                }
+            }
+        }
+
+        m_bDead = true;
+        return true;
+    }
+
+    bool WriteLoop()
+    {
+        while(!m_WriteThread.IsQuitRequested() && !m_bDead)
+        {
+            MOOSMSG_PTR_LIST ToSend;
+            m_OutBox.AppendToOtherInConstantTime(ToSend);
+            if(ToSend.empty())
+            {
+                m_OutBox.WaitForPush(100);
+                continue;
+            }
+
+            try
+            {
+                //payloads go from where they lie
+                CMOOSCommPkt PktTx(m_pPktPool);
+                PktTx.Serialize(MOOSMSG_LIST(),ToSend);
+                SendPkt(m_pSocket,PktTx);
+            }
+            catch(const CMOOSException & e)
+            {
+                MOOS::DeliberatelyNotUsed(e);
+                break;
+            }
+        }
+
+        m_bDead = true;
+        return true;
+    }
+
+    PeerServer * m_pServer;
+    CMOOSThread m_ReadThread;
+    CMOOSThread m_WriteThread;
+    MOOS::SafeList<MOOSMSG_PTR> m_OutBox;
+    volatile bool m_bDead;
+};
+
+
+bool PeerServerListenDispatch(void * pParam)
+{
+    return static_cast<PeerServer*>(pParam)->ListenLoop();
+}
+
+PeerServer::PeerServer()
+{
+    m_pListenSocket = NULL;
+    m_nPort = 0;
+    m_nLastSeq = 0;
+    m_bSharedMemory = false;
+    m_bDisableNagle = true;
+}
+
+PeerServer::~PeerServer()
+{
+    Stop();
+}
+
+bool PeerServer::Run(bool bSharedMemory, bool bDisableNagle)
+{
+    MOOS::ScopedLock Lock(m_Lock);
+
+    if(m_pListenSocket!=NULL)
+        return true;
+
+    m_bSharedMemory = bSharedMemory;
+    m_bDisableNagle = bDisableNagle;
+
+    //let the system choose a port
+    XPCTcpSocket * pSocket = NULL;
+    try
+    {
+        pSocket = new XPCTcpSocket((long int)0);
+        pSocket->vBindSocket();
+        pSocket->vListen(50);
+    }
+    catch(XPCException & e)
+    {
+        delete pSocket;
+        return MOOSFail("PeerServer::Run() cannot listen for peers: %s\n",e.sGetException());
+    }
+
+    struct sockaddr_in Address;
+#ifdef _WIN32
+    int nLength = sizeof(Address);
+#else
+    socklen_t nLength = sizeof(Address);
+#endif
+    if(getsockname(pSocket->iGetSocketFd(),(struct sockaddr*)&Address,&nLength)!=0)
+    {
+        delete pSocket;
+        return MOOSFail("PeerServer::Run() cannot tell which port it is listening on\n");
+    }
+
+    m_nPort = ntohs(Address.sin_port);
+    m_sHost = CMOOSCommObject::GetLocalIPAddress();
+    m_sKey = MakeKey();
+    m_pListenSocket = pSocket;
+
+    if(!m_ListenThread.Initialise(PeerServerListenDispatch,this) || !m_ListenThread.Start())
+    {
+        delete m_pListenSocket;
+        m_pListenSocket = NULL;
+        return MOOSFail("PeerServer::Run() failed to start listening thread\n");
+    }
+
+    return true;
+}
+
+void PeerServer::Stop()
+{
+    m_ListenThread.Stop();
+
+    ReapPeers(true);
+
+    MOOS::ScopedLock Lock(m_Lock);
+    delete m_pListenSocket;
+    m_pListenSocket = NULL;
+    m_Published.clear();
+}
+
+bool PeerServer::IsRunning()
+{
+    MOOS::ScopedLock Lock(m_Lock);
+    return m_pListenSocket!=NULL;
+}
+
+std::string PeerServer::GetHost()
+{
+    MOOS::ScopedLock Lock(m_Lock);
+    return m_sHost;
+}
+
+int PeerServer::GetPort()
+{
+    MOOS::ScopedLock Lock(m_Lock);
+    return m_nPort;
+}
+
+bool PeerServer::Publish(const CMOOSMsg & Msg, CMOOSMsg & Stub)
+{
+    MOOSMSG_PTR pMsg(new CMOOSMsg(Msg));
+
+    MOOS::ScopedLock Lock(m_Lock);
+
+    if(m_pListenSocket==NULL)
+        return false;
+
+    //readers fetch what the DB tells them about which may be a little
+    //behind what we have just written
+    SAMPLES & rSamples = m_Published[Msg.GetKey()];
+    rSamples.push_back(std::make_pair(++m_nLastSeq,pMsg));
+    if(rSamples.size()>PEER_HISTORY)
+        rSamples.pop_front();
+
+    Stub = P2P::MakeStub(Msg,m_sHost,m_nPort,m_sKey,m_nLastSeq);
+
+    return true;
+}
+
+bool PeerServer::GetPublished(const std::string & sVar, unsigned int nSeq, CMOOSMsg & Msg)
+{
+    MOOS::ScopedLock Lock(m_Lock);
+
+    std::map<std::string,SAMPLES>::iterator q = m_Published.find(sVar);
+    if(q==m_Published.end())
+        return false;
+
+    SAMPLES::iterator s;
+    for(s = q->second.begin();s!=q->second.end();++s)
+    {
+        if(s->first==nSeq)
+        {
+            Msg = *s->second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+unsigned int PeerServer::GetNumPeers()
+{
+    MOOS::ScopedLock Lock(m_Lock);
+
+    unsigned int nPeers = 0;
+    std::list<Peer*>::iterator q;
+    for(q = m_Peers.begin();q!=m_Peers.end();++q)
+        if(!(*q)->IsDead())
+            nPeers++;
+
+    return nPeers;
+}
+
+void PeerServer::OnPeerFetch(Peer * pPeer, const std::string & sVar, unsigned int nSeq)
+{
+    MOOS::ScopedLock Lock(m_Lock);
+
+    std::map<std::string,SAMPLES>::iterator q = m_Published.find(sVar);
+    if(q!=m_Published.end())
+    {
+        SAMPLES::iterator s;
+        for(s = q->second.begin();s!=q->second.end();++s)
+        {
+            if(s->first==nSeq)
+            {
+                pPeer->Send(s->second);
+                return;
+            }
+        }
+    }
+
+    //every request gets an answer - even if it is "too late"
+    pPeer->Send(MOOSMSG_PTR(new CMOOSMsg(MOOS_NULL_MSG,sVar,(double)nSeq)));
+}
+
+void PeerServer::ReapPeers(bool bAll)
+{
+    std::list<Peer*> Reaped;
+
+    m_Lock.Lock();
+    {
+        std::list<Peer*>::iterator q = m_Peers.begin();
+        while(q!=m_Peers.end())
+        {
+            if(bAll || (*q)->IsDead())
+            {
+                Reaped.push_back(*q);
+                q = m_Peers.erase(q);
+            }
+            else
+            {
+                ++q;
+            }
+        }
+    }
+    m_Lock.UnLock();
+
+    //stopping a peer waits for its threads so do it without the lock
+    std::list<Peer*>::iterator q;
+    for(q = Reaped.begin();q!=Reaped.end();++q)
+        delete *q;
+}
+
+bool PeerServer::ListenLoop()
+{
+    while(!m_ListenThread.IsQuitRequested())
+    {
+        ReapPeers(false);
+
+        struct timeval Timeout;
+        Timeout.tv_sec = 0;
+        Timeout.tv_usec = 500000;
+
+        fd_set fdset;
+        FD_ZERO(&fdset);
+        FD_SET(m_pListenSocket->iGetSocketFd(), &fdset);
+
+        if(select(m_pListenSocket->iGetSocketFd()+1,&fdset,NULL,NULL,&Timeout)<=0)
+            continue;
+
+        try
+        {
+            XPCTcpSocket * pNewSocket = m_pListenSocket->Accept();
+
+            if(m_bDisableNagle)
+                pNewSocket->vSetNoDelay(1);
+
+            Peer * pPeer = new Peer(this,pNewSocket);
+
+            MOOS::ScopedLock Lock(m_Lock);
+            m_Peers.push_back(pPeer);
+            pPeer->Start();
+        }
+        catch(XPCException & e)
+        {
+            MOOSTrace("PeerServer::ListenLoop() exception: %s\n",e.sGetException());
+        }
+    }
+
+    return true;
+}
+
+
+/**
+ * our connection to one writer of variables we want
+ */
+class PeerLinks::Link : public PeerConnection
+{
+public:
+    Link(PeerLinks * pOwner, const std::string & sHost, int nPort, const std::string & sKey) :
+        PeerConnection(new XPCTcpSocket((long int)nPort)),
+        m_pOwner(pOwner),
+        m_sHost(sHost),
+        m_sKey(sKey),
+        m_bUp(false),
+        m_bDead(false),
+        m_dfDiedAt(0.0)
+    {
+    }
+
+    ~Link()
+    {
+        Stop();
+    }
+
+    bool Start()
+    {
+        if(!m_Thread.Initialise(Dispatch,this) || !m_Thread.Start())
+        {
+            m_dfDiedAt = MOOSLocalTime();
+            m_bDead = true;
+            return false;
+        }
+        return true;
+    }
+
+    void RequestStop()
+    {
+        m_Thread.RequestQuit();
+        Shutdown();
+    }
+
+    void Stop()
+    {
+        RequestStop();
+        m_Thread.Stop();
+    }
+
+    bool IsDead()
+    {
+        return m_bDead;
+    }
+
+    double DiedAt()
+    {
+        return m_dfDiedAt;
+    }
+
+    /** ask the writer for the sample Stub stands in for. False if the
+     * link has already gone down */
+    bool Fetch(const CMOOSMsg & Stub)
+    {
+        MOOS::ScopedLock Lock(m_Lock);
+
+        if(m_bDead)
+            return false;
+
+        m_Pending.push_back(Stub);
+
+        //otherwise we'll ask once connected
+        if(m_bUp)
+            SendRequest(Stub);
+
+        return true;
+    }
+
+private:
+    static bool Dispatch(void * pParam)
+    {
+        return static_cast<Link*>(pParam)->Run();
+    }
+
+    /** call with m_Lock held. If this fails our thread will find out */
+    void SendRequest(const CMOOSMsg & Stub)
+    {
+        try
+        {
+            CMOOSMsg Msg(MOOS_SERVER_REQUEST,Stub.GetKey(),(double)P2P::GetSequence(Stub));
+            SendMsg(m_pSocket,Msg);
+        }
+        catch(const CMOOSException & e)
+        {
+            MOOS::DeliberatelyNotUsed(e);
+        }
+    }
+
+    bool Connect()
+    {
+        try
+        {
+            if(m_pOwner->m_bDisableNagle)
+                m_pSocket->vSetNoDelay(1);
+
+            m_pSocket->vConnect(m_sHost.c_str());
+
+            CMOOSMsg Hello(MOOS_DATA,"p2p",std::string());
+            MOOSAddValToString(Hello.m_sSrcAux,"p2p_key",m_sKey);
+
+            //a writer on this machine can use shared memory
+            MOOS::Poco::SharedPtr<SharedMemoryChannel> pSharedMemory;
+            if(m_pOwner->m_bSharedMemory && m_sHost==GetLocalIPAddress())
+            {
+                pSharedMemory = SharedMemoryChannel::Create();
+                if(!pSharedMemory.isNull())
+                {
+                    MOOSAddValToString(Hello.m_sSrcAux,"shm_name",pSharedMemory->GetName());
+                    MOOSAddValToString(Hello.m_sSrcAux,"shm_key",pSharedMemory->GetKey());
+                }
+            }
+
+            SendMsg(m_pSocket,Hello);
+
+            CMOOSMsg Welcome;
+            bool bWelcomed = ReadMsg(m_pSocket,Welcome,PEER_HANDSHAKE_TIMEOUT) &&
+                    Welcome.IsType(MOOS_WELCOME);
+
+            if(!pSharedMemory.isNull())
+                pSharedMemory->Unlink();
+
+            if(!bWelcomed)
+                return false;
+
+            std::string sSharedMemory;
+            if(!pSharedMemory.isNull() &&
+                    MOOSValFromString(sSharedMemory,Welcome.m_sSrcAux,"shm",true) &&
+                    MOOSStrCmp(sSharedMemory,"ok"))
+            {
+                UseSharedMemory(pSharedMemory);
+            }
+
+            //now ask for everything wanted so far
+            MOOS::ScopedLock Lock(m_Lock);
+            m_bUp = true;
+            std::list<CMOOSMsg>::iterator q;
+            for(q = m_Pending.begin();q!=m_Pending.end();++q)
+                SendRequest(*q);
+
+            return true;
+        }
+        catch(XPCException & e)
+        {
+            MOOS::DeliberatelyNotUsed(e);
+            return false;
+        }
+        catch(const CMOOSException & e)
+        {
+            MOOS::DeliberatelyNotUsed(e);
+            return false;
+        }
+    }
+
+    /** answers come back in the order asked for - put each payload in
+     * the stub it was asked for by */
+    void OnReplies(MOOSMSG_LIST & Replies, MOOSMSG_LIST & Mail)
+    {
+        MOOS::ScopedLock Lock(m_Lock);
+
+        MOOSMSG_LIST::iterator q;
+        for(q = Replies.begin();q!=Replies.end() && !m_Pending.empty();++q)
+        {
+            //the writer no longer has it - nothing to be done
+            if(q->IsType(MOOS_NULL_MSG))
+            {
+                m_Pending.pop_front();
+                continue;
+            }
+
+            //and what the writer put in the source aux rather than what
+            //we needed to find it
+            Mail.splice(Mail.end(),m_Pending,m_Pending.begin());
+            Mail.back().m_sVal.swap(q->m_sVal);
+            Mail.back().m_sSrcAux.swap(q->m_sSrcAux);
+        }
+    }
+
+    bool Run()
+    {
+#ifndef _WIN32
+        signal(SIGPIPE,SIG_IGN);
+#endif
+        if(Connect())
+        {
+            while(!m_Thread.IsQuitRequested())
+            {
+                if(!WaitForPkt(1.0))
+                    continue;
+
+                MOOSMSG_LIST Replies;
+                if(!ReadMail(Replies))
+                    break;
+
+                MOOSMSG_LIST Mail;
+                OnReplies(Replies,Mail);
+                if(!Mail.empty())
+                    m_pOwner->DeliverMail(Mail);
+            }
+        }
+
+        //whatever we didn't get the stub will have to do
+        MOOSMSG_LIST Mail;
+        m_Lock.Lock();
+        Mail.splice(Mail.end(),m_Pending);
+        m_bUp = false;
+        m_dfDiedAt = MOOSLocalTime();
+        m_bDead = true;
+        m_Lock.UnLock();
+
+        if(!Mail.empty())
+            m_pOwner->DeliverMail(Mail);
+
+        return true;
+    }
+
+    PeerLinks * m_pOwner;
+    std::string m_sHost;
+    std::string m_sKey;
+    CMOOSThread m_Thread;
+
+    CMOOSLock m_Lock;
+    std::list<CMOOSMsg> m_Pending; //stubs waiting for their payloads
+    bool m_bUp;
+
+    volatile bool m_bDead;
+    volatile double m_dfDiedAt;
+};
+
+
+PeerLinks::PeerLinks()
+{
+    m_pfnMailCallBack = NULL;
+    m_pMailCallBackParam = NULL;
+    m_bSharedMemory = false;
+    m_bDisableNagle = true;
+}
+
+PeerLinks::~PeerLinks()
+{
+    Close();
+}
+
+void PeerLinks::SetMailCallBack(bool (*pfn)(MOOSMSG_LIST & Mail,void * pParam),void * pParam)
+{
+    m_pfnMailCallBack = pfn;
+    m_pMailCallBackParam = pParam;
+}
+
+void PeerLinks::SetSharedMemory(bool bSharedMemory)
+{
+    m_bSharedMemory = bSharedMemory;
+}
+
+void PeerLinks::SetTCPNoDelay(bool bTCPNoDelay)
+{
+    m_bDisableNagle = bTCPNoDelay;
+}
+
+bool PeerLinks::OnStub(const CMOOSMsg & Stub)
+{
+    std::string sHost,sKey;
+    int nPort;
+    if(!P2P::GetPublisher(Stub,sHost,nPort) ||
+            !MOOSValFromString(sKey,Stub.m_sSrcAux,"p2p_key",true))
+        return false;
+
+    MOOS::ScopedLock Lock(m_Lock);
+
+    //forget about writers which went away a while ago
+    double dfNow = MOOSLocalTime();
+    std::map<std::string,Link*>::iterator q = m_Links.begin();
+    while(q!=m_Links.end())
+    {
+        if(q->second->IsDead() && dfNow-q->second->DiedAt()>=PEER_RETRY_PERIOD)
+        {
+            delete q->second;
+            m_Links.erase(q++);
+        }
+        else
+        {
+            ++q;
+        }
+    }
+
+    //a writer which restarts on the same port has a new key
+    std::string sAddress = MOOSFormat("%s:%d:%s",sHost.c_str(),nPort,sKey.c_str());
+
+    Link * pLink = NULL;
+    q = m_Links.find(sAddress);
+    if(q!=m_Links.end())
+    {
+        //we couldn't reach this writer very recently
+        if(q->second->IsDead())
+            return false;
+        pLink = q->second;
+    }
+    else
+    {
+        pLink = new Link(this,sHost,nPort,sKey);
+        m_Links[sAddress] = pLink;
+        pLink->Start();
+    }
+
+    return pLink->Fetch(Stub);
+}
+
+void PeerLinks::Close()
+{
+    MOOS::ScopedLock Lock(m_Lock);
+
+    //let them all wind down together
+    std::map<std::string,Link*>::iterator q;
+    for(q = m_Links.begin();q!=m_Links.end();++q)
+        q->second->RequestStop();
+
+    for(q = m_Links.begin();q!=m_Links.end();++q)
+        delete q->second;
+
+    m_Links.clear();
+}
+
+unsigned int PeerLinks::GetNumLinks()
+{
+    MOOS::ScopedLock Lock(m_Lock);
+
+    unsigned int nLinks = 0;
+    std::map<std::string,Link*>::iterator q;
+    for(q = m_Links.begin();q!=m_Links.end();++q)
+        if(!q->second->IsDead())
+            nLinks++;
+
+    return nLinks;
+}
+
+bool PeerLinks::DeliverMail(MOOSMSG_LIST & Mail)
+{
+    if(m_pfnMailCallBack==NULL)
+        return true;
+
+    return (*m_pfnMailCallBack)(Mail,m_pMailCallBackParam);
+}
+
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * ReceiveBuffer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/ReceiveBuffer.h"
+#include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
+#include <algorithm>
+#include <cstring>
+
+namespace MOOS
+{
+
+ReceiveBuffer::ReceiveBuffer(unsigned int nCapacity):
+        m_nCapacity(nCapacity),
+        m_nStart(0),
+        m_nEnd(0)
+{
+    //the memory is only found when first needed - plenty of
+    //comms objects never read ahead
+}
+
+bool ReceiveBuffer::Drain(CMOOSCommPkt & Pkt)
+{
+    int nRqd;
+    while(!IsEmpty() && (nRqd = Pkt.GetBytesRequired())>0)
+    {
+        unsigned int n = std::min((unsigned int)nRqd,m_nEnd-m_nStart);
+        memcpy(Pkt.NextWrite(),&m_Data[m_nStart],n);
+        m_nStart+=n;
+
+        if(!Pkt.OnBytesWritten(Pkt.NextWrite(),n))
+            return false;
+    }
+
+    if(IsEmpty())
+        Clear();
+
+    return true;
+}
+
+unsigned char * ReceiveBuffer::WritePtr()
+{
+    if(m_Data.empty())
+        m_Data.resize(m_nCapacity);
+
+    if(m_nStart>0)
+    {
+        //shuffle any partial packet down to make room
+        memmove(&m_Data[0],&m_Data[m_nStart],m_nEnd-m_nStart);
+        m_nEnd-=m_nStart;
+        m_nStart = 0;
+    }
+
+    return &m_Data[m_nEnd];
+}
+
+unsigned int ReceiveBuffer::Space() const
+{
+    return m_nCapacity-(m_nEnd-m_nStart);
+}
+
+}
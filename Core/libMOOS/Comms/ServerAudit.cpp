@@ -50,6 +50,8 @@ struct ClientAudit
     uint64_t total_sent_;
     uint64_t recently_received_;
     uint64_t recently_sent_;
+    uint64_t recently_received_uncompressed_;
+    uint64_t recently_sent_uncompressed_;
     uint64_t max_size_received_;
     uint64_t max_size_sent_;
     uint64_t min_size_received_;
@@ -77,6 +79,8 @@ struct ClientAudit
 		total_sent_ = 0;
 		recently_received_= 0;
 		recently_sent_ = 0;
+		recently_received_uncompressed_ = 0;
+		recently_sent_uncompressed_ = 0;
 		max_size_received_ = 0;
 		max_size_sent_ = 0;
 		min_size_received_ = 0;
@@ -99,12 +103,20 @@ struct ClientAudit
 	{
 		recently_received_= 0;
 		recently_sent_ = 0;
+		recently_received_uncompressed_ = 0;
+		recently_sent_uncompressed_ = 0;
 		recent_packets_received_ = 0;
 		recent_packets_sent_ = 0;
 		recent_messages_received_=0;
 		recent_messages_sent_=0;
 	}
 
+	//how much bigger would recent traffic have been without compression?
+	static double Ratio(uint64_t uncompressed, uint64_t wire)
+	{
+		return wire>0 ? (double)uncompressed/wire : 1.0;
+	}
+
 };
 
 bool AuditDispatch(void * pParam);
@@ -157,6 +169,8 @@ public:
 
 			uint64_t total_in = 0;
 			uint64_t total_out = 0;
+			uint64_t total_uncompressed_in = 0;
+			uint64_t total_uncompressed_out = 0;
 			uint64_t total_packets_in = 0;
 			uint64_t total_packets_out = 0;
 			uint64_t total_messages_in = 0;
@@ -171,7 +185,9 @@ public:
 					<<"msgs in"<<std::setw(10)
 					<<"msgs out"<<std::setw(10)
 					<<"B/s in"<<std::setw(10)
-					<<"B/s out\n";
+					<<"B/s out"<<std::setw(10)
+					<<"zip in"<<std::setw(10)
+					<<"zip out\n";
 
 				std::map<std::string,ClientAudit>::iterator q;
 				for(q=Audits_.begin(); q!=Audits_.end();++q)
@@ -183,10 +199,18 @@ public:
 					ss<<std::setw(10)<<q->second.recent_messages_sent_;
 					ss<<std::setw(10)<<q->second.recently_received_;
 					ss<<std::setw(10)<<q->second.recently_sent_;
+					ss<<std::fixed<<std::setprecision(2);
+					ss<<std::setw(10)<<ClientAudit::Ratio(q->second.recently_received_uncompressed_,
+							q->second.recently_received_);
+					ss<<std::setw(10)<<ClientAudit::Ratio(q->second.recently_sent_uncompressed_,
+							q->second.recently_sent_);
+					ss.unsetf(std::ios_base::floatfield);
 					ss<<std::endl;
 
 					total_in+=q->second.recently_received_;
 					total_out+=q->second.recently_sent_;
+					total_uncompressed_in+=q->second.recently_received_uncompressed_;
+					total_uncompressed_out+=q->second.recently_sent_uncompressed_;
 					total_packets_in+=q->second.recent_packets_received_;
 					total_packets_out+=q->second.recent_packets_sent_;
 					total_messages_in+=q->second.recent_messages_received_;
@@ -203,6 +227,9 @@ public:
 				ss<<std::setw(10)<<total_messages_out;
 				ss<<std::setw(10)<<total_in;
 				ss<<std::setw(10)<<total_out;
+				ss<<std::fixed<<std::setprecision(2);
+				ss<<std::setw(10)<<ClientAudit::Ratio(total_uncompressed_in,total_in);
+				ss<<std::setw(10)<<ClientAudit::Ratio(total_uncompressed_out,total_out);
 				ss<<std::endl;
 
 
@@ -324,15 +351,19 @@ public:
     }
 
 
-	bool AddStatistic(const std::string& sClient, unsigned int nBytes, unsigned int nMessages, double dfTime, bool bIncoming)
+	bool AddStatistic(const std::string& sClient, unsigned int nBytes, unsigned int nMessages, double dfTime, bool bIncoming, unsigned int nUncompressedBytes)
 	{
 		MOOS::DeliberatelyNotUsed(dfTime);
 
+		if(nUncompressedBytes==0)
+			nUncompressedBytes = nBytes;
+
 		lock_.Lock();
 		ClientAudit & rA = Audits_[sClient];
 		if(bIncoming)
 		{
 			rA.recently_received_+=nBytes;
+			rA.recently_received_uncompressed_+=nUncompressedBytes;
 			rA.total_received_+=nBytes;
 			rA.max_size_received_=std::max<uint64_t>(rA.max_size_received_,nBytes);
 			rA.min_size_received_=std::min<uint64_t>(rA.min_size_received_,nBytes);
@@ -344,6 +375,7 @@ public:
 		else
 		{
 			rA.recently_sent_+=nBytes;
+			rA.recently_sent_uncompressed_+=nUncompressedBytes;
 			rA.total_sent_+=nBytes;
 			rA.max_size_sent_=std::max<uint64_t>(rA.max_size_received_,nBytes);
 			rA.min_size_sent_=std::min<uint64_t>(rA.min_size_received_,nBytes);
@@ -407,10 +439,11 @@ bool ServerAudit::AddStatistic(const std::string & sClient,
                                unsigned int nBytes,
                                unsigned int nMessages,
                                double dfTime,
-                               bool bIncoming)
+                               bool bIncoming,
+                               unsigned int nUncompressedBytes)
 {
 
-	return Impl_->AddStatistic(sClient,nBytes,nMessages,dfTime,bIncoming);
+	return Impl_->AddStatistic(sClient,nBytes,nMessages,dfTime,bIncoming,nUncompressedBytes);
 }
 
 
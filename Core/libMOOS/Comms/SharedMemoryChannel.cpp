@@ -0,0 +1,516 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * SharedMemoryChannel.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/SharedMemoryChannel.h"
+
+#ifdef __linux__
+
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+
+namespace
+{
+const unsigned int kMagic = 0x4D4F4F53;
+const unsigned int kKeyLength = 32;
+
+//how long to sleep before checking our peer is still with us
+const double kLivenessCheckPeriod = 0.1;
+
+//how many times to look for data before sleeping on the doorbell. Being
+//woken costs tens of microseconds, which is most of what a round trip
+//through the DB costs, and a writer on another CPU is often only a moment
+//away. With one CPU the writer can't run while we spin so we never do
+const unsigned int kSpinsBeforeSleep = 4000;
+
+unsigned int SpinsBeforeSleep()
+{
+    static const unsigned int nSpins = sysconf(_SC_NPROCESSORS_ONLN)>1 ? kSpinsBeforeSleep : 0;
+    return nSpins;
+}
+
+//atomics which are lock free are also address free so are fine in memory
+//shared between processes
+template<class T> T Load(volatile T * p)
+{
+    return __atomic_load_n(p,__ATOMIC_SEQ_CST);
+}
+
+template<class T> void Store(volatile T * p, T v)
+{
+    __atomic_store_n(p,v,__ATOMIC_SEQ_CST);
+}
+
+unsigned int RoundUpToPowerOfTwo(unsigned int n)
+{
+    unsigned int p = 4096;
+    while(p<n)
+        p<<=1;
+    return p;
+}
+
+std::string MakeKey()
+{
+    std::string sKey;
+    unsigned char Random[kKeyLength/2];
+
+    int fd = open("/dev/urandom",O_RDONLY);
+    bool bRandom = fd>=0 && read(fd,Random,sizeof(Random))==(ssize_t)sizeof(Random);
+    if(fd>=0)
+        close(fd);
+
+    if(!bRandom)
+    {
+        srand((unsigned int)(time(NULL)^getpid()));
+        for(unsigned int i = 0;i<sizeof(Random);i++)
+            Random[i] = (unsigned char)(rand()&0xFF);
+    }
+
+    for(unsigned int i = 0;i<sizeof(Random);i++)
+        sKey+=MOOSFormat("%02x",Random[i]);
+
+    return sKey;
+}
+}
+
+namespace MOOS
+{
+
+//one direction of the channel. The counters only ever grow (and wrap) and
+//index the data modulo the (power of two) ring size
+struct SharedMemoryChannel::Ring
+{
+    volatile unsigned int m_nWritten;
+    char m_Pad0[60];
+    volatile unsigned int m_nRead;
+    char m_Pad1[60];
+
+    //bumped when data arrives / room is made and waited on with futexes
+    volatile int m_nDataBell;
+    volatile int m_nSpaceBell;
+
+    //is anyone asleep on the bells? (saves a system call if not)
+    volatile int m_bReaderWaiting;
+    volatile int m_bWriterWaiting;
+    char m_Pad2[48];
+};
+
+//what lives at the start of the shared memory, followed by the data of each
+//ring. Side 0 (the creator) writes to ring 0, side 1 to ring 1
+struct SharedMemoryChannel::Layout
+{
+    unsigned int m_nMagic;
+    unsigned int m_nRingSize;
+    char m_sKey[kKeyLength+1];
+    volatile int m_nPID[2];
+    volatile int m_bClosed[2];
+    char m_Pad[64];
+    Ring m_Rings[2];
+};
+
+SharedMemoryChannel::SharedMemoryChannel():
+        m_pLayout(NULL),
+        m_pTxData(NULL),
+        m_pRxData(NULL),
+        m_nMappedSize(0),
+        m_nSide(0),
+        m_bLinked(false)
+{
+}
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+    if(m_pLayout!=NULL)
+    {
+        Close();
+        munmap(m_pLayout,m_nMappedSize);
+    }
+
+    Unlink();
+}
+
+SharedMemoryChannel * SharedMemoryChannel::Create(unsigned int nRingSize)
+{
+    static volatile int nCreated = 0;
+
+    nRingSize = RoundUpToPowerOfTwo(nRingSize);
+
+    SharedMemoryChannel * pChannel = new SharedMemoryChannel;
+    pChannel->m_nSide = 0;
+    pChannel->m_sKey = MakeKey();
+    pChannel->m_sName = MOOSFormat("/moos-%d-%d-%s",
+            (int)getpid(),
+            __atomic_add_fetch(&nCreated,1,__ATOMIC_SEQ_CST),
+            pChannel->m_sKey.substr(0,8).c_str());
+
+    int fd = shm_open(pChannel->m_sName.c_str(),O_CREAT | O_EXCL | O_RDWR,0600);
+    if(fd<0)
+    {
+        delete pChannel;
+        return NULL;
+    }
+    pChannel->m_bLinked = true;
+
+    pChannel->m_nMappedSize = sizeof(Layout)+2*nRingSize;
+
+    void * pMapped = MAP_FAILED;
+    if(ftruncate(fd,pChannel->m_nMappedSize)==0)
+        pMapped = mmap(NULL,pChannel->m_nMappedSize,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+
+    if(pMapped==MAP_FAILED)
+    {
+        delete pChannel;
+        return NULL;
+    }
+
+    //fresh shared memory is zeroed so the rings start empty
+    pChannel->m_pLayout = (Layout*)pMapped;
+    pChannel->m_pLayout->m_nRingSize = nRingSize;
+    strncpy(pChannel->m_pLayout->m_sKey,pChannel->m_sKey.c_str(),kKeyLength);
+    pChannel->m_pLayout->m_nPID[0] = getpid();
+    Store(&pChannel->m_pLayout->m_nMagic,kMagic);
+
+    pChannel->m_pTxData = (unsigned char*)pMapped+sizeof(Layout);
+    pChannel->m_pRxData = pChannel->m_pTxData+nRingSize;
+
+    return pChannel;
+}
+
+SharedMemoryChannel * SharedMemoryChannel::Attach(const std::string & sName, const std::string & sKey)
+{
+    //names are only ever made by Create()
+    if(sName.find("/moos-")!=0 || sKey.size()!=kKeyLength)
+        return NULL;
+
+    int fd = shm_open(sName.c_str(),O_RDWR,0600);
+    if(fd<0)
+        return NULL;
+
+    struct stat Stat;
+    void * pMapped = MAP_FAILED;
+    if(fstat(fd,&Stat)==0 && Stat.st_size>(off_t)sizeof(Layout))
+        pMapped = mmap(NULL,Stat.st_size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    close(fd);
+
+    if(pMapped==MAP_FAILED)
+        return NULL;
+
+    SharedMemoryChannel * pChannel = new SharedMemoryChannel;
+    pChannel->m_nSide = 1;
+    pChannel->m_sName = sName;
+    pChannel->m_nMappedSize = Stat.st_size;
+    pChannel->m_pLayout = (Layout*)pMapped;
+
+    //is this really what we were offered? (and not something a
+    //namesake on a different machine made)
+    Layout * pLayout = pChannel->m_pLayout;
+    if(Load(&pLayout->m_nMagic)!=kMagic ||
+            (off_t)(sizeof(Layout)+2*(size_t)pLayout->m_nRingSize)!=Stat.st_size ||
+            strncmp(pLayout->m_sKey,sKey.c_str(),kKeyLength)!=0)
+    {
+        pChannel->m_pLayout = NULL;
+        munmap(pMapped,Stat.st_size);
+        delete pChannel;
+        return NULL;
+    }
+
+    pChannel->m_sKey = sKey;
+    Store(&pLayout->m_nPID[1],(int)getpid());
+
+    pChannel->m_pRxData = (unsigned char*)pMapped+sizeof(Layout);
+    pChannel->m_pTxData = pChannel->m_pRxData+pLayout->m_nRingSize;
+
+    return pChannel;
+}
+
+void SharedMemoryChannel::Unlink()
+{
+    if(m_bLinked)
+    {
+        shm_unlink(m_sName.c_str());
+        m_bLinked = false;
+    }
+}
+
+SharedMemoryChannel::Ring & SharedMemoryChannel::TxRing()
+{
+    return m_pLayout->m_Rings[m_nSide];
+}
+
+SharedMemoryChannel::Ring & SharedMemoryChannel::RxRing()
+{
+    return m_pLayout->m_Rings[1-m_nSide];
+}
+
+void SharedMemoryChannel::WaitOnDoorbell(volatile int * pDoorbell, int nSeen, double dfSeconds)
+{
+    struct timespec Timeout;
+    Timeout.tv_sec = (time_t)dfSeconds;
+    Timeout.tv_nsec = (long)((dfSeconds-Timeout.tv_sec)*1e9);
+
+    //not FUTEX_PRIVATE_FLAG - our peer is another process
+    if(syscall(SYS_futex,pDoorbell,FUTEX_WAIT,nSeen,&Timeout,NULL,0)==0 || errno!=ETIMEDOUT)
+        return;
+
+    //a peer which died can't have said goodbye
+    int nPeer = Load(&m_pLayout->m_nPID[1-m_nSide]);
+    if(nPeer>0 && kill(nPeer,0)!=0 && errno==ESRCH)
+        Store(&m_pLayout->m_bClosed[1-m_nSide],1);
+}
+
+void SharedMemoryChannel::RingDoorbell(volatile int * pDoorbell)
+{
+    __atomic_add_fetch(pDoorbell,1,__ATOMIC_SEQ_CST);
+    syscall(SYS_futex,pDoorbell,FUTEX_WAKE,1,NULL,NULL,0);
+}
+
+int SharedMemoryChannel::Write(const unsigned char * pData, int nLen, double dfTimeout)
+{
+    Ring & R = TxRing();
+    const unsigned int nSize = m_pLayout->m_nRingSize;
+    const double dfStart = MOOSLocalTime(false);
+
+    while(true)
+    {
+        if(IsClosed())
+            return -1;
+
+        int nSeen = Load(&R.m_nSpaceBell);
+        unsigned int nWritten = R.m_nWritten;
+        unsigned int nSpace = nSize-(nWritten-Load(&R.m_nRead));
+
+        if(nSpace>0)
+        {
+            unsigned int n = std::min((unsigned int)nLen,nSpace);
+            unsigned int nAt = nWritten&(nSize-1);
+            unsigned int nFirst = std::min(n,nSize-nAt);
+            memcpy(m_pTxData+nAt,pData,nFirst);
+            memcpy(m_pTxData,pData+nFirst,n-nFirst);
+
+            Store(&R.m_nWritten,nWritten+n);
+
+            if(Load(&R.m_bReaderWaiting))
+                RingDoorbell(&R.m_nDataBell);
+            else
+                __atomic_add_fetch(&R.m_nDataBell,1,__ATOMIC_SEQ_CST);
+
+            return (int)n;
+        }
+
+        double dfWait = kLivenessCheckPeriod;
+        if(dfTimeout>=0)
+        {
+            double dfLeft = dfTimeout-(MOOSLocalTime(false)-dfStart);
+            if(dfLeft<=0)
+                return 0;
+            dfWait = std::min(dfWait,dfLeft);
+        }
+
+        //the reader bumps the bell after making room so if it has done so
+        //since we looked we won't sleep at all
+        Store(&R.m_bWriterWaiting,1);
+        WaitOnDoorbell(&R.m_nSpaceBell,nSeen,dfWait);
+        Store(&R.m_bWriterWaiting,0);
+    }
+}
+
+int SharedMemoryChannel::GetSpace()
+{
+    Ring & R = TxRing();
+    if(IsClosed())
+        return 0;
+    return (int)(m_pLayout->m_nRingSize-(R.m_nWritten-Load(&R.m_nRead)));
+}
+
+bool SharedMemoryChannel::SpinForData()
+{
+    Ring & R = RxRing();
+    for(unsigned int i = SpinsBeforeSleep();i>0;i--)
+    {
+        if(Load(&R.m_nWritten)!=R.m_nRead)
+            return true;
+    }
+    return false;
+}
+
+int SharedMemoryChannel::Read(unsigned char * pData, int nLen, double dfTimeout)
+{
+    Ring & R = RxRing();
+    const unsigned int nSize = m_pLayout->m_nRingSize;
+    const double dfStart = MOOSLocalTime(false);
+
+    while(true)
+    {
+        int nSeen = Load(&R.m_nDataBell);
+        unsigned int nRead = R.m_nRead;
+        unsigned int nAvailable = Load(&R.m_nWritten)-nRead;
+
+        if(nAvailable>0)
+        {
+            unsigned int n = std::min((unsigned int)nLen,nAvailable);
+            unsigned int nAt = nRead&(nSize-1);
+            unsigned int nFirst = std::min(n,nSize-nAt);
+            memcpy(pData,m_pRxData+nAt,nFirst);
+            memcpy(pData+nFirst,m_pRxData,n-nFirst);
+
+            Store(&R.m_nRead,nRead+n);
+
+            if(Load(&R.m_bWriterWaiting))
+                RingDoorbell(&R.m_nSpaceBell);
+            else
+                __atomic_add_fetch(&R.m_nSpaceBell,1,__ATOMIC_SEQ_CST);
+
+            return (int)n;
+        }
+
+        //only give up once everything sent has been read
+        if(IsClosed())
+            return -1;
+
+        if(SpinForData())
+            continue;
+
+        double dfWait = kLivenessCheckPeriod;
+        if(dfTimeout>=0)
+        {
+            double dfLeft = dfTimeout-(MOOSLocalTime(false)-dfStart);
+            if(dfLeft<=0)
+                return 0;
+            dfWait = std::min(dfWait,dfLeft);
+        }
+
+        Store(&R.m_bReaderWaiting,1);
+        WaitOnDoorbell(&R.m_nDataBell,nSeen,dfWait);
+        Store(&R.m_bReaderWaiting,0);
+    }
+}
+
+bool SharedMemoryChannel::WaitForData(double dfTimeout)
+{
+    Ring & R = RxRing();
+    const double dfStart = MOOSLocalTime(false);
+
+    while(true)
+    {
+        int nSeen = Load(&R.m_nDataBell);
+        if(Load(&R.m_nWritten)!=R.m_nRead)
+            return true;
+
+        if(IsClosed())
+            return false;
+
+        if(SpinForData())
+            return true;
+
+        double dfLeft = dfTimeout-(MOOSLocalTime(false)-dfStart);
+        if(dfLeft<=0)
+            return false;
+
+        Store(&R.m_bReaderWaiting,1);
+        WaitOnDoorbell(&R.m_nDataBell,nSeen,std::min(dfLeft,kLivenessCheckPeriod));
+        Store(&R.m_bReaderWaiting,0);
+    }
+}
+
+void SharedMemoryChannel::Close()
+{
+    if(Load(&m_pLayout->m_bClosed[m_nSide]))
+        return;
+
+    Store(&m_pLayout->m_bClosed[m_nSide],1);
+
+    //wake anyone, on either side, waiting for anything
+    for(int i = 0;i<2;i++)
+    {
+        RingDoorbell(&m_pLayout->m_Rings[i].m_nDataBell);
+        RingDoorbell(&m_pLayout->m_Rings[i].m_nSpaceBell);
+    }
+}
+
+bool SharedMemoryChannel::IsClosed()
+{
+    return Load(&m_pLayout->m_bClosed[0]) || Load(&m_pLayout->m_bClosed[1]);
+}
+
+}
+
+#else
+
+//////////////////////////////////////////////////////////////////////
+// shared memory transport is Linux only - elsewhere there is only TCP
+
+namespace MOOS
+{
+
+struct SharedMemoryChannel::Layout {};
+
+SharedMemoryChannel::SharedMemoryChannel():
+        m_pLayout(NULL),
+        m_pTxData(NULL),
+        m_pRxData(NULL),
+        m_nMappedSize(0),
+        m_nSide(0),
+        m_bLinked(false)
+{
+}
+
+SharedMemoryChannel::~SharedMemoryChannel(){}
+
+SharedMemoryChannel * SharedMemoryChannel::Create(unsigned int){return NULL;}
+
+SharedMemoryChannel * SharedMemoryChannel::Attach(const std::string &, const std::string &){return NULL;}
+
+void SharedMemoryChannel::Unlink(){}
+
+int SharedMemoryChannel::Write(const unsigned char *, int, double){return -1;}
+
+int SharedMemoryChannel::GetSpace(){return 0;}
+
+int SharedMemoryChannel::Read(unsigned char *, int, double){return -1;}
+
+bool SharedMemoryChannel::WaitForData(double){return false;}
+
+void SharedMemoryChannel::Close(){}
+
+bool SharedMemoryChannel::IsClosed(){return true;}
+
+}
+
+#endif
@@ -36,6 +36,7 @@
 
 #include <csignal>
 #include <ctime>
+#include <cmath>
 
 
 #include "MOOS/libMOOS/Utils/MOOSException.h"
@@ -44,6 +45,7 @@
 #include "MOOS/libMOOS/Utils/ConsoleColours.h"
 #include "MOOS/libMOOS/Utils/ThreadPrint.h"
 #include "MOOS/libMOOS/Utils/ThreadPriority.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
 #include <iomanip>
 #include <iterator>
 #include <algorithm>
@@ -75,6 +77,10 @@ namespace MOOS
 
 ThreadedCommServer::ThreadedCommServer()
 {
+    m_bMailDeliveryPending = false;
+    m_dfMailBatchWindow = 0.0;
+    m_dfLastMailDelivery = 0.0;
+    m_bMailDeliveryDeferred = false;
     m_WasteDisposal.Initialise(WasteDisposalEntry,this);
     m_WasteDisposal.Start();
 }
@@ -167,13 +173,26 @@ bool ThreadedCommServer::AddAndStartClientThread(XPCTcpSocket & NewClientSocket,
     }
 
 
-    SharedClientThread pNewClientThread =  new  ClientThread(sName,
-    		NewClientSocket,
-    		m_SharedDataListFromClient,
-    		bAsync,
-    		dfConsolidationTime,
-    		m_dfClientTimeout,
-    		m_bBoostIOThreads);
+    SharedClientThread pNewClientThread = MakeClientThread(sName,
+            NewClientSocket,
+            bAsync,
+            dfConsolidationTime);
+
+    //will it read compressed packets?
+    if(m_CompressionClientSet.find(sName)!=m_CompressionClientSet.end())
+        pNewClientThread->SetCompressionThreshold(m_nCompressionThreshold);
+
+    //and compact ones?
+    if(m_CompactWireClientSet.find(sName)!=m_CompactWireClientSet.end())
+        pNewClientThread->SetCompactWire(true);
+
+    //did we agree to talk through shared memory?
+    SHARED_MEMORY_MAP::iterator s = m_SharedMemoryChannels.find(sName);
+    if(s!=m_SharedMemoryChannels.end())
+    {
+        pNewClientThread->UseSharedMemory(s->second,kSocketWriteTimeoutSeconds);
+        m_SharedMemoryChannels.erase(s);
+    }
 
     //add to map
     m_ClientThreads[sName] = pNewClientThread;
@@ -182,6 +201,20 @@ bool ThreadedCommServer::AddAndStartClientThread(XPCTcpSocket & NewClientSocket,
 
 }
 
+ThreadedCommServer::SharedClientThread ThreadedCommServer::MakeClientThread(const std::string & sName,
+        XPCTcpSocket & NewClientSocket,
+        bool bAsync,
+        double dfConsolidationTime)
+{
+    return new  ClientThread(sName,
+    		NewClientSocket,
+    		m_SharedDataListFromClient,
+    		bAsync,
+    		dfConsolidationTime,
+    		m_dfClientTimeout,
+    		m_bBoostIOThreads);
+}
+
 /**
  * This is the main loop - it looks for complete Pkt being placed in the incoming list
  * and invokes a handler
@@ -213,8 +246,24 @@ bool ThreadedCommServer::ServerLoop()
         }
 
 
+        //is it time to send mail we held back?
+        long nWaitMS = 1000;
+        if(m_bMailDeliveryDeferred)
+        {
+            double dfDue = m_dfLastMailDelivery+m_dfMailBatchWindow;
+            double dfNow = MOOS::Time();
+            if(dfNow>=dfDue)
+            {
+                DeliverPendingMail(m_sCommunityName,m_Auditor);
+            }
+            else
+            {
+                nWaitMS = static_cast<long>(std::ceil((dfDue-dfNow)*1000.0));
+            }
+        }
+
         if(m_SharedDataListFromClient.IsEmpty()){
-            if(!m_SharedDataListFromClient.WaitForPush(1000))
+            if(!m_SharedDataListFromClient.WaitForPush(nWaitMS))
                 continue;
         }
 
@@ -232,6 +281,15 @@ bool ThreadedCommServer::ServerLoop()
                 m_Auditor.Remove(SDFromClient._sClientName);
                 break;
 
+            case ClientThreadSharedData::DELIVER_MAIL:
+            {
+                m_MailDeliveryLock.Lock();
+                m_bMailDeliveryPending = false;
+                m_MailDeliveryLock.UnLock();
+                DeliverPendingMail(SDFromClient._sClientName,m_Auditor);
+                break;
+            }
+
             default:
                 break;
         }
@@ -259,7 +317,7 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
 
         //now we act on that packet
         //by way of the user supplied called back
-        if(m_pfnRxCallBack!=NULL)
+        if(m_pfnRxCallBack!=NULL || m_pfnRxViewCallBack!=NULL)
         {
 
             std::string sWho = SDFromClient._sClientName;
@@ -279,12 +337,19 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
 
             MOOSMSG_LIST MsgLstRx,MsgLstTx;
 
-            //convert to list of messages
-            SDFromClient._pPkt->Serialize(MsgLstRx,false);
+            //decode into views of the packet - nothing is copied until
+            //someone decides they need to keep a message
+            MOOS::MsgViewVector ViewsRx;
+            SDFromClient._pPkt->Deserialize(ViewsRx);
 
-            Auditor.AddStatistic(sWho,SDFromClient._pPkt->GetStreamLength(),MsgLstRx.size(),dfTNow,true);
+            Auditor.AddStatistic(sWho,
+                    SDFromClient._pPkt->GetWireLength(),
+                    ViewsRx.size(),
+                    dfTNow,
+                    true,
+                    SDFromClient._pPkt->GetUncompressedLength());
 
-			if(MsgLstRx.empty())
+			if(ViewsRx.empty())
 			{
 				std::cerr<<"very strange there is no content in the Pkt\n";
 				return false;
@@ -293,13 +358,13 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
             //is there any sort of notification going on here?
             bool bIsNotification = false;
             double dfLargeDelay = m_dfCommsLatencyConcern*GetMOOSTimeWarp();
-            for(MOOSMSG_LIST::iterator q = MsgLstRx.begin();q!=MsgLstRx.end();++q)
+            for(MOOS::MsgViewVector::iterator q = ViewsRx.begin();q!=ViewsRx.end();++q)
             {
             	if(q->IsType(MOOS_NOTIFY))
             	{
             		if(dfTNow-q->GetTime()>dfLargeDelay)
             		{
-            			std::cout<<"WARNING : Message "<<q->GetKey()<<" from "<<q->GetSource()<<" is "<<(dfTNow-q->GetTime())*1000<<" ms delayed\n";
+            			std::cout<<"WARNING : Message "<<q->GetKey().str()<<" from "<<q->GetSource().str()<<" is "<<(dfTNow-q->GetTime())*1000<<" ms delayed\n";
             		}
             		bIsNotification= true;
             		break;
@@ -310,12 +375,12 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
             //is this a timing message from V10 client?
             bool bTimingPresent = false;
             CMOOSMsg TimingMsg;
-            if(MsgLstRx.front().IsType(MOOS_TIMING))
+            if(ViewsRx.front().IsType(MOOS_TIMING))
             {
             	bTimingPresent = true;
-            	TimingMsg =MsgLstRx.front();
+            	ViewsRx.front().ToMsg(TimingMsg);
 
-            	MsgLstRx.pop_front();
+            	ViewsRx.erase(ViewsRx.begin());
 
 
             	TimingMsg.SetDouble( MOOSLocalTime());
@@ -330,7 +395,23 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
 
             //let owner figure out what to do !
 			//this is a user supplied call back
-			if(!(*m_pfnRxCallBack)(sWho,MsgLstRx,MsgLstTx,m_pRxCallBackParam))
+            bool bHandled = false;
+            if(m_pfnRxViewCallBack!=NULL)
+            {
+            	bHandled = (*m_pfnRxViewCallBack)(sWho,ViewsRx,MsgLstTx,m_pRxViewCallBackParam);
+            }
+            else
+            {
+            	//this owner wants owning copies
+            	for(MOOS::MsgViewVector::iterator q = ViewsRx.begin();q!=ViewsRx.end();++q)
+            	{
+            		MsgLstRx.push_back(CMOOSMsg());
+            		q->ToMsg(MsgLstRx.back());
+            	}
+            	bHandled = (*m_pfnRxCallBack)(sWho,MsgLstRx,MsgLstTx,m_pRxCallBackParam);
+            }
+
+			if(!bHandled)
 			{
 				//client call back failed!!
 				MOOSTrace(" CMOOSCommServer::ProcessClient()  pfnCallback failed\n");
@@ -340,6 +421,13 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
 				//std::cerr<<"picked up "<<MsgLstTx.size()<<" messages for "<<sWho<<"\n";
 			}
 
+            //mail held for this client which may well be shared with others
+            MOOSMSG_PTR_LIST SharedLstTx;
+            if(m_pfnFetchAllSharedMailCallBack!=NULL)
+            {
+            	(*m_pfnFetchAllSharedMailCallBack)(sWho,SharedLstTx,m_pFetchAllSharedMailCallBackParam);
+            }
+
 
             if(pClient->IsSynchronous())
             {
@@ -358,19 +446,19 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
             }
 
             //send packet back to client...
-            ClientThreadSharedData SDDownStream(sWho,ClientThreadSharedData::PKT_WRITE);
+            ClientThreadSharedData SDDownStream(sWho,
+                    ClientThreadSharedData::PKT_WRITE,
+                    pClient->GetPacketBufferPool());
 
-            if(!MsgLstTx.empty())
+            if(!MsgLstTx.empty() || !SharedLstTx.empty())
             {
-            	unsigned int nMessages = MsgLstTx.size();
-				//stuff reply message into a packet
-				SDDownStream._pPkt->Serialize(MsgLstTx,true);
+            	unsigned int nMessages = MsgLstTx.size()+SharedLstTx.size();
+				//stuff reply message into a packet (this thread writes
+				//every packet for a client, in the order they are sent)
+				SDDownStream._pPkt->SetWireDictionary(pClient->GetTxDictionary());
+				SDDownStream._pPkt->Serialize(MsgLstTx,SharedLstTx);
 
-				Auditor.AddStatistic(sWho,
-									SDDownStream._pPkt->GetStreamLength(),
-									nMessages,
-									MOOS::Time(),
-									false);
+				PrepareToSend(pClient,*SDDownStream._pPkt,nMessages,Auditor);
 
 				//add it to the work load
 				pClient->SendToClient(SDDownStream);
@@ -382,51 +470,135 @@ bool ThreadedCommServer::ProcessClient(ClientThreadSharedData &SDFromClient,MOOS
 
             //and here if we have any new fancy asynchronous clients
             //w can send them mail as well...
-            for(q=m_ClientThreads.begin();q!=m_ClientThreads.end();++q)
-            {
-            	ClientThread* pClient = q->second;
-            	if(m_pfnFetchAllMailCallBack!=NULL && pClient->IsAsynchronous())
-            	{
-            		//OK this client can handle unsolicited pushes of data
-            		MsgLstTx.clear();
-            		if((*m_pfnFetchAllMailCallBack)(q->first,MsgLstTx,m_pFetchAllMailCallBackParam))
-                    {
-                    	//any pending mail?
-                    	if(MsgLstTx.size()==0)
-                    		continue;
+            DeliverPendingMail(sWho,Auditor);
+        }
+    }
+    catch(CMOOSException & e)
+    {
+        MOOSTrace("ProcessClient() Exception: %s\n", e.m_sReason);
+        bResult = false;
+    }
 
-                    	ClientThreadSharedData SDAdditionalDownStream(sWho,
-                    			ClientThreadSharedData::PKT_WRITE);
+    return bResult;
 
-                    	//stuff all notifications into a packet
-                    	unsigned int nMessages = MsgLstTx.size();
-                    	SDAdditionalDownStream._pPkt->Serialize(MsgLstTx,true);
+}
 
+void ThreadedCommServer::RequestMailDelivery()
+{
+    //one outstanding request is plenty
+    MOOS::ScopedLock L(m_MailDeliveryLock);
+    if(m_bMailDeliveryPending)
+        return;
 
-                        Auditor.AddStatistic(q->first,
-                        		SDAdditionalDownStream._pPkt->GetStreamLength(),
-                        		nMessages,
-                        		MOOS::Time(),
-                        		false);
+    m_bMailDeliveryPending = true;
 
-                        //add it to the work load of this client
-                        pClient->SendToClient(SDAdditionalDownStream);
+    ClientThreadSharedData SD;
+    SD._Status = ClientThreadSharedData::DELIVER_MAIL;
+    m_SharedDataListFromClient.Push(SD);
+}
 
-                    }
-            	}
-            }
+/**
+ * look for pending mail for every asynchronous client and send it on its way
+ * @param sCause name of the client whose actions prompted this delivery
+ * @param Auditor
+ * @return true on success
+ */
+bool ThreadedCommServer::DeliverPendingMail(const std::string & sCause,MOOS::ServerAudit & Auditor)
+{
+    if(m_pfnFetchAllSharedMailCallBack==NULL && m_pfnFetchAllMailCallBack==NULL)
+        return true;
 
+    if(m_dfMailBatchWindow>0.0)
+    {
+        double dfNow = MOOS::Time();
+        if(dfNow-m_dfLastMailDelivery<m_dfMailBatchWindow)
+        {
+            //too soon - the server loop will come back for it
+            m_bMailDeliveryDeferred = true;
+            return true;
+        }
+        m_dfLastMailDelivery = dfNow;
+        m_bMailDeliveryDeferred = false;
+    }
+
+    ClientThreadsMap::iterator q;
 
+    if(m_pfnFetchClientsWithMailCallBack!=NULL)
+    {
+        //we can be told who has mail so only bother with them
+        STRING_LIST Clients;
+        (*m_pfnFetchClientsWithMailCallBack)(Clients,m_pFetchClientsWithMailCallBackParam);
+
+        STRING_LIST::iterator p;
+        for(p=Clients.begin();p!=Clients.end();++p)
+        {
+            q = m_ClientThreads.find(*p);
+            if(q!=m_ClientThreads.end())
+                DeliverMailTo(q->first,q->second,sCause,Auditor);
         }
     }
-    catch(CMOOSException & e)
+    else
     {
-        MOOSTrace("ProcessClient() Exception: %s\n", e.m_sReason);
-        bResult = false;
+        for(q=m_ClientThreads.begin();q!=m_ClientThreads.end();++q)
+            DeliverMailTo(q->first,q->second,sCause,Auditor);
     }
 
-    return bResult;
+    return true;
+}
+
+bool ThreadedCommServer::DeliverMailTo(const std::string & sClient,
+        ClientThread * pClient,
+        const std::string & sCause,
+        MOOS::ServerAudit & Auditor)
+{
+    //only some clients can handle unsolicited pushes of data
+    if(!pClient->IsAsynchronous())
+        return true;
+
+    MOOSMSG_LIST MsgLstTx;
+    MOOSMSG_PTR_LIST SharedLstTx;
+    bool bFetched = m_pfnFetchAllSharedMailCallBack!=NULL ?
+            (*m_pfnFetchAllSharedMailCallBack)(sClient,SharedLstTx,m_pFetchAllSharedMailCallBackParam) :
+            (*m_pfnFetchAllMailCallBack)(sClient,MsgLstTx,m_pFetchAllMailCallBackParam);
 
+    //any pending mail?
+    unsigned int nMessages = MsgLstTx.size()+SharedLstTx.size();
+    if(!bFetched || nMessages==0)
+        return true;
+
+    ClientThreadSharedData SDAdditionalDownStream(sCause,
+            ClientThreadSharedData::PKT_WRITE,
+            pClient->GetPacketBufferPool());
+
+    //stuff all notifications into a packet
+    SDAdditionalDownStream._pPkt->SetWireDictionary(pClient->GetTxDictionary());
+    SDAdditionalDownStream._pPkt->Serialize(MsgLstTx,SharedLstTx);
+
+    PrepareToSend(pClient,*SDAdditionalDownStream._pPkt,nMessages,Auditor);
+
+    //add it to the work load of this client
+    return pClient->SendToClient(SDAdditionalDownStream);
+}
+
+void ThreadedCommServer::PrepareToSend(ClientThread * pClient,
+        CMOOSCommPkt & Pkt,
+        unsigned int nMessages,
+        MOOS::ServerAudit & Auditor)
+{
+    if(pClient->GetCompressionThreshold()>0)
+        Pkt.Compress(pClient->GetCompressionThreshold());
+
+    Auditor.AddStatistic(pClient->GetClientName(),
+            Pkt.GetWireLength(),
+            nMessages,
+            MOOS::Time(),
+            false,
+            Pkt.GetUncompressedLength());
+}
+
+void ThreadedCommServer::SetMailBatchWindowMS(double dfWindowMS)
+{
+    m_dfMailBatchWindow = dfWindowMS>0.0 ? dfWindowMS/1000.0 : 0.0;
 }
 
 bool ThreadedCommServer::ProcessClient()
@@ -537,6 +709,16 @@ bool ThreadedCommServer::SupportsAsynchronousClients()
 	return true;
 }
 
+bool ThreadedCommServer::SupportsSharedMemoryClients()
+{
+	return true;
+}
+
+bool ThreadedCommServer::SupportsCompactWire()
+{
+	return true;
+}
+
 bool ThreadedCommServer::TimerLoop()
 {
     //we don't run absent client checks in the threaded version
@@ -557,12 +739,16 @@ ThreadedCommServer::ClientThread::ClientThread(const std::string & sName, XPCTcp
             m_sClientName(sName),
             m_ClientSocket(ClientSocket),
             m_SharedDataIncoming(SharedDataIncoming),
+            m_nWriterBacklog(0),
+            m_bWriterFailed(false),
             m_bAsynchronous(bAsync),
             m_dfConsolidationPeriod(dfConsolidationPeriodMS/1000.0),
             m_dfClientTimeout(dfClientTimeout),
-            m_bBoostThread(bBoost)
+            m_bBoostThread(bBoost),
+            m_nCompressionThreshold(0)
 {
-
+    //this thread is the only reader of its socket
+    EnableReadAhead(true);
 
     struct timeval timeout;
     timeout.tv_sec = kSocketWriteTimeoutSeconds;
@@ -610,6 +796,29 @@ bool ThreadedCommServer::ClientThread::AsynchronousReadLoop()
 
     while(!m_Reader.IsQuitRequested())
     {
+        //packets from clients using shared memory don't come by the socket
+        if(IsUsingSharedMemory())
+        {
+            //if the channel has closed reading will notice and say so
+            if(m_pSharedMemory->WaitForData(1.0) || m_pSharedMemory->IsClosed())
+            {
+                if(!HandleClientWrite())
+                {
+                    OnClientDisconnect();
+                    return true;
+                }
+                dfLastGoodComms = MOOSLocalTime(false);
+            }
+            else if(MOOSLocalTime(false)-dfLastGoodComms>m_dfClientTimeout)
+            {
+                std::cout<<MOOS::ConsoleColours::Red();
+                std::cout<<"Disconnecting \""<<m_sClientName<<"\" after "<<m_dfClientTimeout<<" seconds of silence\n";
+                std::cout<<MOOS::ConsoleColours::reset();
+                OnClientDisconnect();
+                return true;
+            }
+            continue;
+        }
 
         // The socket file descriptor set is cleared and the socket file
         // descriptor contained within tcpSocket is added to the file
@@ -694,9 +903,10 @@ bool ThreadedCommServer::ClientThread::AsynchronousReadLoop()
 
 bool ThreadedCommServer::ClientThread::OnClientDisconnect()
 {
+    //let a client using shared memory know we have gone
+    CloseSharedMemory();
 
     //prepare to send it up the chain
-    CMOOSCommPkt PktRx,PktTx;
     ClientThreadSharedData SD(m_sClientName,ClientThreadSharedData::CONNECTION_CLOSED);
 
     //push this data back to the central thread
@@ -750,6 +960,35 @@ double ThreadedCommServer::ClientThread::GetConsolidationTime()
 
 bool ThreadedCommServer::ClientThread::SendToClient(ClientThreadSharedData & OutGoing)
 {
+    MOOS::ScopedLock L(m_WriterBacklogLock);
+
+    //nobody is left to send anything queued
+    if(m_bWriterFailed)
+        return false;
+
+    //packets to a client on shared memory are written here and now if the
+    //writer thread is idle and they fit - waking the writer to do it
+    //would cost more than the copy (TCP sends can block so always go via it)
+    if(IsAsynchronous() && m_nWriterBacklog==0 &&
+            OutGoing._Status==ClientThreadSharedData::PKT_WRITE &&
+            HasSharedMemorySpaceFor(*OutGoing._pPkt))
+    {
+        try
+        {
+            SendPkt(&m_ClientSocket,*OutGoing._pPkt);
+            return true;
+        }
+        catch (const CMOOSException & e)
+        {
+            //the channel closed under us - the threads will find out
+            MOOS::DeliberatelyNotUsed(e);
+            return false;
+        }
+    }
+
+    if(IsAsynchronous() && OutGoing._Status==ClientThreadSharedData::PKT_WRITE)
+        m_nWriterBacklog++;
+
     m_SharedDataOutgoing.Push(OutGoing);
     return true;
 }
@@ -791,6 +1030,10 @@ bool ThreadedCommServer::ClientThread::AsynchronousWriteLoop()
 				{
 					//send packet to client
                     SendPkt(&m_ClientSocket,*SDDownChain._pPkt);
+
+                    m_WriterBacklogLock.Lock();
+                    m_nWriterBacklog--;
+                    m_WriterBacklogLock.UnLock();
 					break;
 				}
             default:
@@ -801,6 +1044,11 @@ bool ThreadedCommServer::ClientThread::AsynchronousWriteLoop()
     catch (const CMOOSException & e)
 	{
        gPrinter.SimplyPrintTimeAndMessage("AsynchronousWriteLoop() catches exception and exits");
+
+       //what is still queued will never go so stop anyone adding to it
+       MOOS::ScopedLock L(m_WriterBacklogLock);
+       m_bWriterFailed = true;
+       m_nWriterBacklog = 0;
        return false;
 	}
     return bResult;
@@ -817,8 +1065,9 @@ bool ThreadedCommServer::ClientThread::HandleClientWrite()
     {
 
         //prepare to send it up the chain
-        ClientThreadSharedData SDUpChain(m_sClientName);
-        SDUpChain._Status = ClientThreadSharedData::PKT_READ;
+        ClientThreadSharedData SDUpChain(m_sClientName,
+                ClientThreadSharedData::PKT_READ,
+                m_pPktPool);
 
         //read input
 
@@ -835,7 +1084,7 @@ bool ThreadedCommServer::ClientThread::HandleClientWrite()
         if(IsSynchronous())
         {
 			//wait for data to be returned...
-            ClientThreadSharedData SDDownChain(m_sClientName);
+            ClientThreadSharedData SDDownChain;
 
             if(m_SharedDataOutgoing.Size()==0)
                 m_SharedDataOutgoing.WaitForPush();
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * WireDictionary.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Comms/WireDictionary.h"
+
+namespace MOOS
+{
+
+WireDictionary::WireDictionary(unsigned int nCapacity)
+{
+    m_nCapacity = nCapacity;
+}
+
+bool WireDictionary::HasRoomFor(unsigned int nLength) const
+{
+    return Size()<m_nCapacity && nLength<=MOOS_WIRE_DICTIONARY_MAX_LENGTH;
+}
+
+unsigned int WireDictionary::Encode(const char * pData, unsigned int nLength)
+{
+    std::string sName(pData,nLength);
+
+    std::map<std::string,unsigned int>::iterator q = m_Tokens.find(sName);
+    if(q!=m_Tokens.end())
+        return q->second;
+
+    //the receiver will do the same when it reads it
+    if(HasRoomFor(nLength))
+    {
+        unsigned int nToken = m_Tokens.size()+1;
+        m_Tokens[sName] = nToken;
+    }
+
+    return 0;
+}
+
+void WireDictionary::Learn(const char * pData, unsigned int nLength)
+{
+    if(HasRoomFor(nLength))
+        m_Names.push_back(std::string(pData,nLength));
+}
+
+const std::string * WireDictionary::Lookup(unsigned int nToken) const
+{
+    if(nToken==0 || nToken>m_Names.size())
+        return NULL;
+    return &m_Names[nToken-1];
+}
+
+void WireDictionary::Clear()
+{
+    m_Tokens.clear();
+    m_Names.clear();
+}
+
+unsigned int WireDictionary::Size() const
+{
+    return m_Tokens.size()+m_Names.size();
+}
+
+}
@@ -31,8 +31,9 @@
 #ifndef ACTIVEMAILQUEUE_H_
 #define ACTIVEMAILQUEUE_H_
 #include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include "MOOS/libMOOS/Comms/CompactMsg.h"
 #include "MOOS/libMOOS/Utils/MOOSThread.h"
-#include "MOOS/libMOOS/Utils/SafeList.h"
+#include "MOOS/libMOOS/Utils/LockFreeQueue.h"
 #include "MOOS/libMOOS/Comms/MessageFunction.h"
 
 
@@ -85,7 +86,7 @@ public:
     bool DoWork();
 
 protected:
-	MOOS::SafeList<CMOOSMsg> queue_;
+	MOOS::LockFreeQueue<MOOS::CompactMsg> queue_;
 
     /** the user supplied Callback*/
     bool (*pfn_)(CMOOSMsg &M, void* pParam);
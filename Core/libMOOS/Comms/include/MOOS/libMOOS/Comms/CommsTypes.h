@@ -10,6 +10,13 @@
 
 #include <list>
 #include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include "MOOS/libMOOS/Thirdparty/PocoBits/SharedPtr.h"
 typedef std::list<CMOOSMsg> MOOSMSG_LIST;
 
+//a reference counted message - one of these can sit in the outgoing
+//mail of many clients without being copied. Treat the message as read only
+//once it has been shared
+typedef MOOS::Poco::SharedPtr<CMOOSMsg> MOOSMSG_PTR;
+typedef std::list<MOOSMSG_PTR> MOOSMSG_PTR_LIST;
+
 #endif /* COMMSTYPES_H_ */
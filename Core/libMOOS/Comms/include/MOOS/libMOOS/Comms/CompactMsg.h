@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * CompactMsg.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef COMPACTMSG_H_
+#define COMPACTMSG_H_
+
+#include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include "MOOS/libMOOS/Comms/MOOSMsgView.h"
+#include "MOOS/libMOOS/Thirdparty/PocoBits/AtomicCounter.h"
+#include <string>
+#include <list>
+
+//at most this many names are ever interned - after that they are
+//simply shared like any other string
+#define MOOS_SHARED_STRING_POOL_SIZE 8192
+
+//longer names than this are never interned
+#define MOOS_SHARED_STRING_MAX_INTERN_LENGTH 256
+
+namespace MOOS
+{
+
+/**
+ * An immutable string which is cheap to copy. Strings of up to
+ * kInlineSize characters are kept inside the object itself. Longer ones live
+ * in a single reference counted block which all copies share, so copying
+ * never allocates. Strings made by Intern() share one block with every other
+ * interned string holding the same characters; those blocks live for the rest
+ * of the process and copying them doesn't even touch the reference count.
+ */
+class SharedString
+{
+public:
+    enum {kInlineSize = 15};
+
+    SharedString();
+    SharedString(const char * pData, unsigned int nSize);
+    explicit SharedString(const std::string & s);
+    SharedString(const SharedString & Other);
+    SharedString & operator=(const SharedString & Other);
+    ~SharedString();
+
+#if __cplusplus >= 201103L
+    SharedString(SharedString && Other);
+    SharedString & operator=(SharedString && Other);
+#endif
+
+    void swap(SharedString & Other);
+
+    /** the one pooled copy of these characters (made the first time they are
+     * asked for). Repeated calls from the same thread usually neither
+     * lock nor allocate */
+    static SharedString Intern(const char * pData, unsigned int nSize);
+    static SharedString Intern(const std::string & s);
+
+    /** how many strings have been interned so far */
+    static unsigned int GetNumInterned();
+
+    const char * data() const {return IsInline() ? m_Store.Inline : m_Store.pBlock->Data;}
+    unsigned int size() const {return m_nSize;}
+    bool empty() const {return m_nSize==0;}
+
+    /** make an owning copy */
+    std::string str() const {return std::string(data(),m_nSize);}
+
+    /** copy into an existing string (which can reuse its storage)*/
+    void AssignTo(std::string & sDest) const {sDest.assign(data(),m_nSize);}
+
+    bool operator==(const SharedString & Other) const;
+    bool operator!=(const SharedString & Other) const {return !(*this==Other);}
+
+    /** is this one of the pooled strings made by Intern()? */
+    bool IsInterned() const {return !IsInline() && m_Store.pBlock->bInterned;}
+
+private:
+    struct Block
+    {
+        Poco::AtomicCounter Refs;
+        bool bInterned;
+        char Data[1];
+    };
+
+    bool IsInline() const {return m_nSize<=kInlineSize;}
+    void Init(const char * pData, unsigned int nSize);
+    void Acquire();
+    void Release();
+
+    static Block * MakeBlock(const char * pData, unsigned int nSize, bool bInterned);
+
+    unsigned int m_nSize;
+    union
+    {
+        Block * pBlock;
+        char Inline[kInlineSize+1];
+    } m_Store;
+};
+
+/**
+ * A CMOOSMsg for passing about inside a process. It has no virtual functions
+ * or serialisation state, the key, source and community are interned (there
+ * are only ever a handful of those) and the value and source aux are
+ * SharedStrings. So copying one - into a queue, a list node or another
+ * thread's mailbox - costs no allocation beyond that of a long value, once,
+ * when the CompactMsg is first made. Convert to and from CMOOSMsg at the edges.
+ */
+class CompactMsg
+{
+public:
+    CompactMsg();
+    explicit CompactMsg(const CMOOSMsg & Msg);
+    explicit CompactMsg(const MsgView & View);
+
+    /** fill in a CMOOSMsg. Every field is overwritten, so passing the same
+     * message each time lets its strings reuse their storage */
+    void ToMsg(CMOOSMsg & Msg) const;
+
+    bool IsType(char cType) const {return m_cMsgType==cType;}
+    char GetType() const {return m_cMsgType;}
+    bool IsDataType(char cDataType) const {return m_cDataType==cDataType;}
+    bool IsDouble() const {return IsDataType(MOOS_DOUBLE);}
+    bool IsString() const {return IsDataType(MOOS_STRING) || IsDataType(MOOS_BINARY_STRING);}
+
+    double GetTime() const {return m_dfTime;}
+    double GetDouble() const {return m_dfVal;}
+    double GetDoubleAux() const {return m_dfVal2;}
+    const SharedString & GetKey() const {return m_Key;}
+    const SharedString & GetString() const {return m_Val;}
+    const SharedString & GetSource() const {return m_Src;}
+    const SharedString & GetSourceAux() const {return m_SrcAux;}
+    const SharedString & GetCommunity() const {return m_Community;}
+
+    char m_cMsgType;
+    char m_cDataType;
+    int m_nID;
+    double m_dfTime;
+    double m_dfVal;
+    double m_dfVal2;
+    SharedString m_Key;
+    SharedString m_Val;
+    SharedString m_Src;
+    SharedString m_SrcAux;
+    SharedString m_Community;
+};
+
+typedef std::list<CompactMsg> COMPACT_MSG_LIST;
+
+}
+
+#endif /* COMPACTMSG_H_ */
@@ -14,10 +14,16 @@
 #include "MOOS/libMOOS/Utils/MOOSThread.h"
 #include "MOOS/libMOOS/Comms/MulticastNode.h"
 #include "MOOS/libMOOS/Utils/ProcInfo.h"
+#include "MOOS/libMOOS/Comms/LatencyHistogram.h"
 
 namespace MOOS{
 /**
- * @brief The EndToEndAudit class
+ * @brief The EndToEndAudit class keeps, for every source and variable a
+ * client hears about, a histogram of how long messages took to arrive.
+ * Recording a message costs a couple of increments in counters belonging to
+ * the recording thread (no locks, no copies). Once a second the counters are
+ * gathered up and what changed is multicast as a compact LatencySummary
+ * for atm to listen to, so this can be left on.
  */
 class EndToEndAudit{
 
@@ -27,9 +33,10 @@ public:
      * @brief EndToEndAudit
      */
     EndToEndAudit();
+    ~EndToEndAudit();
 
     /**
-     * @brief Start
+     * @brief Start publishing summaries (only the first call does anything)
      */
     void Start();
 
@@ -51,6 +58,36 @@ public:
     };
     typedef std::vector<MessageStatistic> MessageStatistics;
 
+    /**
+     * @brief what one client heard in one interval
+     */
+    struct LatencySummary{
+        struct Channel{
+            std::string source_client;
+            std::string message_name;
+            uint64_t bytes;
+            LatencyHistogram latency;
+        };
+
+        std::string destination_client;
+        int64_t time;
+        double cpu_load;
+        std::vector<Channel> channels;
+
+        /**
+         * @brief Encode as as many datagrams (none bigger than
+         * max_datagram bytes unless one channel is) as it takes
+         */
+        void Encode(std::vector<std::string> & datagrams,
+                    unsigned int max_datagram = 8192) const;
+
+        /**
+         * @brief Decode one datagram made by Encode
+         * @return false if it isn't one
+         */
+        bool Decode(const std::string & datagram);
+    };
+
     /**
      * @brief AddForAudit
      * @param msg
@@ -61,6 +98,13 @@ public:
                      const std::string  & client_name,
                      double time_now);
 
+    /**
+     * @brief gather up what has been recorded since last time
+     * (one summary per destination client, one channel per source and
+     * variable whichever threads recorded it)
+     */
+    void Collect(std::vector<LatencySummary> & summaries);
+
 
     static bool ThreadDispatch(void *p){
         EndToEndAudit* pMe = (EndToEndAudit*)p;
@@ -70,9 +114,25 @@ public:
     bool TransmitWorker();
 
 private:
+    //the counts for one variable from one source kept by one thread
+    struct Cell;
+    //the cells of one thread
+    struct Recorder;
+    //the recorders of one thread, one per audit, let go when it exits
+    struct ThreadRecorders;
+
+    Recorder & RecorderForThisThread();
+    static ThreadRecorders & ThisThreadsRecorders();
+
+    /** the thread which recorded into recorder has gone, so once what it
+     * counted has been published the recorder can go too */
+    void Retire(Recorder * recorder);
+
+    uint64_t id_;
+    bool started_;
     CMOOSThread transmit_thread_;
     CMOOSLock audit_lock_;
-    MessageStatistics message_statistics_;
+    std::vector<Recorder*> recorders_;
     MOOS::MulticastNode multicaster_;
     MOOS::ProcInfo proc_info_;
 
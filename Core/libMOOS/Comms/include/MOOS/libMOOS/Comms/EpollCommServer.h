@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * EpollCommServer.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef EPOLLCOMMSERVER_H_
+#define EPOLLCOMMSERVER_H_
+
+//epoll is a linux thing
+#ifdef __linux__
+
+#include "MOOS/libMOOS/Comms/ThreadedCommServer.h"
+#include <list>
+#include <set>
+#include <vector>
+
+namespace MOOS
+{
+
+/**
+ * A comms server which, rather than giving every client a reader and a writer
+ * thread, services all clients from a small number of epoll event loops. Each
+ * client is handled by a Connection which reads packets with a simple state
+ * machine on top of CMOOSCommPkt::GetBytesRequired()/OnBytesWritten() and
+ * queues outgoing packets until its socket can take them. Everything above
+ * the socket (the server loop, callbacks, mail delivery) is inherited from
+ * ThreadedCommServer.
+ */
+class EpollCommServer : public ThreadedCommServer
+{
+public:
+    /**
+     * @param nLoops how many event loops (threads) to share clients between
+     */
+    EpollCommServer(unsigned int nLoops = 1);
+    virtual ~EpollCommServer();
+
+    virtual bool Stop();
+
+protected:
+    class EventLoop;
+    typedef Poco::SharedPtr<EventLoop> SharedEventLoop;
+
+    /**
+     * a client serviced by an EventLoop. Reading is done only by the loop thread,
+     * writing by whichever thread gets there first (the caller of SendToClient
+     * or the loop once the socket becomes writable again)
+     */
+    class Connection : public ClientThread
+    {
+    public:
+        Connection(const std::string & sName,
+                XPCTcpSocket & ClientSocket,
+                SHARED_PKT_LIST & SharedDataIncoming,
+                bool bAsync,
+                double dfConsolidationPeriodMS,
+                double dfClientTimeout,
+                SharedEventLoop pLoop);
+
+        virtual ~Connection();
+
+        /** join our event loop */
+        virtual bool Start();
+
+        /** queue a packet for the client and send as much as the socket will take */
+        virtual bool SendToClient(ClientThreadSharedData & OutGoing);
+
+        /** read whatever is waiting, handing complete packets to the server.
+         * returns false if the connection has gone */
+        bool OnReadable();
+
+        /** send as much queued data as the socket will take. returns false
+         * if the connection has gone */
+        bool OnWritable();
+
+        /** has the client been quiet for too long? */
+        bool IsSilent(double dfTimeNow);
+
+        /** mark the connection as dead and tell the server (the loop will
+         * already have forgotten about us) */
+        void OnClosed();
+
+        int GetFD();
+
+    protected:
+        virtual bool Kill();
+
+        /** write queued packets until done or the socket is full
+         * (m_WriteLock must be held) */
+        bool FlushWrites();
+
+        SharedEventLoop m_pLoop;
+
+        //the packet currently being read
+        MOOS::SharedCommPkt m_pPktRx;
+
+        //packets waiting to go and how much of the first has gone
+        std::list< MOOS::SharedCommPkt > m_WriteQueue;
+        int m_nWriteOffset;
+        CMOOSLock m_WriteLock;
+
+        double m_dfLastGoodComms;
+        bool m_bClosed;
+    };
+
+    /** one epoll set and the thread that waits on it */
+    class EventLoop
+    {
+    public:
+        EventLoop();
+        ~EventLoop();
+
+        bool Start(bool bBoost);
+        bool Stop();
+
+        /** start watching a connection for input */
+        bool Add(Connection * pConnection);
+
+        /** stop watching a connection - safe to call more than once */
+        void Remove(Connection * pConnection);
+
+        /** also wake up when the socket of pConnection can be written to */
+        bool WatchWritable(Connection * pConnection, bool bWatch);
+
+        unsigned int Size();
+
+    private:
+        static bool LoopEntry(void * pParam) {return static_cast<EventLoop*>(pParam)->Loop();}
+        bool Loop();
+
+        /** forget a connection and tell the server it has gone (m_Lock held)*/
+        void Close(Connection * pConnection);
+
+        int m_nEpollFD;
+        bool m_bBoost;
+        CMOOSThread m_Thread;
+
+        //held while events are being handled so connections cannot
+        //disappear from under us
+        CMOOSLock m_Lock;
+        std::set<Connection*> m_Connections;
+    };
+
+    virtual SharedClientThread MakeClientThread(const std::string & sName,
+            XPCTcpSocket & NewClientSocket,
+            bool bAsync,
+            double dfConsolidationTime);
+
+    /** connections are driven by socket readiness so can't use shared memory*/
+    virtual bool SupportsSharedMemoryClients();
+
+    std::vector<SharedEventLoop> m_Loops;
+};
+
+}
+
+#endif // __linux__
+
+#endif /* EPOLLCOMMSERVER_H_ */
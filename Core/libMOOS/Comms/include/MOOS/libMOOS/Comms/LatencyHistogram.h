@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * LatencyHistogram.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LATENCYHISTOGRAM_H_
+#define LATENCYHISTOGRAM_H_
+
+#include <map>
+#include <string>
+
+#include <stdint.h>
+
+namespace MOOS
+{
+
+/**
+ * A histogram of latencies (in microseconds) in the style of HdrHistogram:
+ * values below 16 get a bucket each and every doubling above that is split
+ * into 16 buckets, so whatever the size of a value it is counted to within
+ * about 6%. Latencies up to 2^40us (12 days) are counted, anything longer
+ * (or negative) is clamped. Only buckets which have counted something take
+ * any room. A histogram can be summed with others and written very
+ * compactly.
+ */
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        kSubBucketBits = 4,
+        kSubBuckets = 1<<kSubBucketBits,
+        kMaxValueBits = 40,
+        kNumBuckets = (kMaxValueBits-kSubBucketBits+1)*kSubBuckets
+    };
+
+    LatencyHistogram();
+
+    /** count one (or nCount) latencies of nMicroSeconds */
+    void Record(int64_t nMicroSeconds, uint64_t nCount = 1);
+
+    /** the bucket nMicroSeconds is counted in */
+    static unsigned int BucketFor(int64_t nMicroSeconds);
+
+    /** the smallest and largest values counted in bucket nBucket */
+    static uint64_t BucketLowest(unsigned int nBucket);
+    static uint64_t BucketHighest(unsigned int nBucket);
+
+    uint64_t GetCount() const {return m_nCount;}
+    uint64_t GetBucketCount(unsigned int nBucket) const;
+
+    /** the latency below which dfPercent of those counted lie (as the
+     * highest value in the bucket it falls in) */
+    uint64_t GetPercentile(double dfPercent) const;
+    uint64_t GetMax() const;
+    double GetMean() const;
+
+    /** for building a histogram from counts kept elsewhere: add nCount to
+     * a bucket and nSum to the total of all values counted */
+    void AddToBucket(unsigned int nBucket, uint64_t nCount);
+    void AddToSum(uint64_t nSum){m_nSum+=nSum;}
+
+    /** add in everything counted by Other */
+    void Merge(const LatencyHistogram & Other);
+
+    /** forget everything */
+    void Clear();
+
+    /** append a compact description (varints, empty buckets skipped) */
+    void Encode(std::string & sOut) const;
+
+    /** read what Encode wrote starting at nPos which is moved past it.
+     * Returns false if it doesn't make sense */
+    bool Decode(const std::string & sIn, size_t & nPos);
+
+    /** helpers for compact formats */
+    static void WriteVarint(std::string & sOut, uint64_t nValue);
+    static bool ReadVarint(const std::string & sIn, size_t & nPos, uint64_t & nValue);
+
+private:
+    //counts of the buckets which aren't empty
+    typedef std::map<unsigned int, uint64_t> COUNTS;
+    COUNTS m_Counts;
+    uint64_t m_nCount;
+    uint64_t m_nSum;
+};
+
+}
+
+#endif /* LATENCYHISTOGRAM_H_ */
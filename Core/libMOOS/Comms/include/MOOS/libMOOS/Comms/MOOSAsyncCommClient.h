@@ -27,7 +27,8 @@
 #include <map>
 #include "MOOS/libMOOS/Comms/MOOSCommClient.h"
 #include "MOOS/libMOOS/Utils/MOOSThread.h"
-#include "MOOS/libMOOS/Utils/SafeList.h"
+#include "MOOS/libMOOS/Utils/LockFreeQueue.h"
+#include "MOOS/libMOOS/Comms/PeerToPeer.h"
 
 namespace MOOS
 {
@@ -66,6 +67,58 @@ namespace MOOS
 		 */
 	    virtual bool Post(CMOOSMsg & Msg,bool bKeepMsgSourceName=false);
 
+	    /**
+	     * Send a list of MOOSMsgs in one packet, waking the writing
+	     * thread once. Big binary notifications which go straight to their
+	     * subscribers (see SetPeerToPeerThreshold()) are taken out and
+	     * sent on their own
+	     * @param Msgs (left empty)
+	     * @param bKeepMsgSourceName
+	     * @return
+	     */
+	    virtual bool Post(MOOSMSG_LIST & Msgs,bool bKeepMsgSourceName=false);
+
+	    /**
+	     * Send binary notifications of at least nBytes straight to the
+	     * clients which subscribe to them (over TCP, or shared memory if
+	     * enabled and they are on this machine) rather than through the
+	     * DB, which just gets a stub saying who wrote what, when, how big
+	     * it was and where subscribers can get it. Subscribers fetch the
+	     * samples the DB sends them stubs for, so intervals and
+	     * latest-only registrations work as usual. While anyone who can't
+	     * follow stubs (a synchronous or older client) subscribes, the DB
+	     * refuses them and the data goes the long way. 0 (the default)
+	     * turns this off.
+	     * @param nBytes
+	     * @return true on success
+	     */
+	    bool SetPeerToPeerThreshold(unsigned int nBytes);
+
+	    /**
+	     * Let the writing thread wait up to dfMaxDelay seconds for more
+	     * mail to share a packet with, or until nMaxBytes of it are
+	     * waiting. It only waits when busy (the last packet went less
+	     * than dfMaxDelay ago) so occasional mail is still sent at once.
+	     * Bursts of small notifications then go as a few big packets not
+	     * many tiny ones. 0 (the default) turns this off.
+	     * @param dfMaxDelay longest wait in seconds (something like 200e-6)
+	     * @param nMaxBytes stop waiting once this much is queued
+	     * @return true on success
+	     */
+	    bool SetWriteBatching(double dfMaxDelay, unsigned int nMaxBytes = 16384);
+
+	    /** how many packets have been sent */
+	    uint64_t GetNumPktsSent();
+
+	    /** how many of those waited for company (see SetWriteBatching())*/
+	    uint64_t GetNumBatchWaits();
+
+	    /** how many waits were cut short by the batch being full */
+	    uint64_t GetNumFullBatches();
+
+	    /** total time (seconds) spent waiting for batches to fill*/
+	    double GetBatchWaitTime();
+
 
 	    /**
 	     * Is client running
@@ -91,6 +144,15 @@ namespace MOOS
 	    bool ReadingLoop();
 	    bool WritingLoop();
 
+	    /** take delivery of mail which came straight from its writer */
+	    bool OnPeerMail(MOOSMSG_LIST & Mail);
+
+	    /** should Msg go peer to peer? */
+	    bool IsPeerToPeer(const CMOOSMsg & Msg);
+
+	    /** the DB won't take our stubs for a variable */
+	    bool OnPeerToPeerRefused(const CMOOSMsg & Refusal);
+
 
 	protected:
 
@@ -130,6 +192,16 @@ namespace MOOS
 	     */
 	    bool DoWriting();
 
+	    /**
+	     * if we are busy wait a little while for more mail so it can
+	     * share a packet (see SetWriteBatching())
+	     */
+	    void WaitForBatch();
+
+	    /** if the writer has fallen a long way behind throw away the older
+	     * half of what it has still to send */
+	    void LimitOutGoingQueue();
+
 
 	    //data members below here
 	    CMOOSThread WritingThread_; //handles writing
@@ -140,7 +212,34 @@ namespace MOOS
 
 
 
-	    MOOS::SafeList<CMOOSMsg> OutGoingQueue_; //queue of outgoing mail
+	    MOOS::LockFreeQueue<CMOOSMsg> OutGoingQueue_; //queue of outgoing mail
+
+	    unsigned int m_nPeerToPeerThreshold; //binary payloads this big go direct
+	    MOOS::PeerServer m_PeerServer; //to subscribers of what we write
+	    MOOS::PeerLinks m_PeerLinks; //from writers of what we subscribe to
+	    CMOOSLock m_PeerToPeerLock;
+	    std::map<std::string,double> m_PeerToPeerRefusals; //variable -> when
+
+	    double m_dfWriteBatchDelay; //longest wait for a batch to fill
+	    unsigned int m_nWriteBatchBytes; //stop waiting when this much is queued
+#if __cplusplus >= 201103L
+	    std::atomic<unsigned int> m_nOutGoingBytes; //roughly how much is queued
+#else
+	    unsigned int m_nOutGoingBytes;
+#endif
+	    double m_dfLastWriteTime; //when the last packet went
+	    //written by the writing thread, read by anyone
+#if __cplusplus >= 201103L
+	    std::atomic<uint64_t> m_nPktsSent;
+	    std::atomic<uint64_t> m_nBatchWaits;
+	    std::atomic<uint64_t> m_nFullBatches;
+	    std::atomic<uint64_t> m_nBatchWaitMicroSeconds;
+#else
+	    uint64_t m_nPktsSent;
+	    uint64_t m_nBatchWaits;
+	    uint64_t m_nFullBatches;
+	    uint64_t m_nBatchWaitMicroSeconds;
+#endif
 
 
 
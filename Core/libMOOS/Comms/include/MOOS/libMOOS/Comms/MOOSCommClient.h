@@ -35,12 +35,19 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
+#if __cplusplus >= 201103L
+#include <unordered_map>
+#include <atomic>
+#endif
 
 
 #include "MOOS/libMOOS/Utils/MOOSLock.h"
 #include "MOOS/libMOOS/Utils/MOOSThread.h"
 #include "MOOS/libMOOS/Utils/MOOSScopedPtr.h"
 #include "MOOS/libMOOS/Utils/Macros.h"
+#include "MOOS/libMOOS/Thirdparty/PocoBits/SharedPtr.h"
+#include "MOOS/libMOOS/Thirdparty/PocoBits/Event.h"
 #include "MOOS/libMOOS/Comms/MOOSCommObject.h"
 #include "MOOS/libMOOS/Comms/ActiveMailQueue.h"
 #include "MOOS/libMOOS/Comms/ClientCommsStatus.h"
@@ -103,11 +110,19 @@ public:
     bool Notify(const std::string & sVar,const std::vector<unsigned char>& vData,double dfTime=-1);
     bool Notify(const std::string & sVar,const std::vector<unsigned char>& vData, const std::string & sSrcAux,double dfTime=-1);
 
+    /** notify a whole batch of messages in one go - they take one trip
+     * through the outbox and go to the DB in the same packet. Msgs is left
+     * empty. See also MOOS::NotifyBatch */
+    bool Notify(MOOSMSG_LIST & Msgs);
+
 	
     /** Register for notification in changes of named variable
     @param sVar name of variable of interest
-    @param dfInterval minimum time between notifications*/
-    bool Register(const std::string & sVar,double dfInterval=0);
+    @param dfInterval minimum time between notifications
+    @param bLatestOnly if true the DB holds at most one notification of sVar
+    for us between calls, replacing it with each new one (handy for slow
+    clients of fast variables)*/
+    bool Register(const std::string & sVar,double dfInterval=0,bool bLatestOnly=false);
 
     /**
      * Wild card registration
@@ -152,6 +167,11 @@ public:
     @param Msg reference to CMOOSMsg which user wishes to send*/
     virtual bool Post(CMOOSMsg  & Msg,bool bKeepMsgSourceName = false);
 
+    /** place a list of messages in the out box, in order, taking the out box
+    lock once. They will all be sent in the same packet. Msgs is left empty
+    @param Msgs messages the user wishes to send*/
+    virtual bool Post(MOOSMSG_LIST & Msgs,bool bKeepMsgSourceName = false);
+
     /** internal method which runs in a seperate thread and manages the input and output
     of messages from the server. DO NOT CALL THIS METHOD.*/
     virtual bool ClientLoop();
@@ -190,7 +210,8 @@ public:
     bool HasMailCallBack();
     
     /** Directly and asynchronously make a request to the server (use this very rarely if ever. It's not
-    meant for public consumption)
+    meant for public consumption). Returns as soon as the reply arrives and several threads may have
+    requests in flight at once (but don't call it from a mail callback which the reading thread runs)
     @param sWhat string specifying what request to make - ALL, DB_CLEAR, PROCESS_SUMMARY or VAR_SUMMARY
     @param MsgList List of messages returned by server
     @param dfTimeOut TimeOut
@@ -289,6 +310,20 @@ public:
     /** Set the number of ms between loops of the Comms thread (not relevent if teh cleint is Asynchoronous)*/
     bool SetCommsTick(int nCommsTick);
 
+    /** compress outgoing packets bigger than nBytes, provided the DB says it can
+     * read them when we connect. 0 (the default) turns compression off */
+    void SetCompressionThreshold(unsigned int nBytes){m_nCompressionThreshold = nBytes;};
+
+    /** offer, when connecting, to exchange packets with the DB through shared
+     * memory. A DB on another machine (or one which doesn't support it)
+     * declines and TCP is used as usual */
+    void SetSharedMemory(bool bEnable){m_bOfferSharedMemory = bEnable;};
+
+    /** keep histograms of how long mail took to reach us (by variable and
+     * sender) and multicast them once a second for atm to show. Once
+     * started the audit keeps running until the client is destroyed */
+    void EnableLatencyAudit(bool bEnable);
+
     bool ExpectOutboxOverflow(unsigned int outbox_pending_size);
 
     /**
@@ -449,7 +484,12 @@ public:
 protected:
     bool ClearResources();
     
+    /** the asynchronous client numbers messages without holding m_OutLock*/
+#if __cplusplus >= 201103L
+    std::atomic<int> m_nNextMsgID;
+#else
     int m_nNextMsgID;
+#endif
     
     /** send library info to stdout */
     virtual void DoBanner();
@@ -603,32 +643,66 @@ protected:
     std::map<std::string,std::set<std::string>  > Msg2ActiveQueueName_;
 
     /**
-     * mapping a queue name to a pointer to a queue
+     * mapping a queue name to a (shared) pointer to a queue
      */
-    std::map<std::string,MOOS::ActiveMailQueue*> ActiveQueueMap_;
+    typedef MOOS::Poco::SharedPtr<MOOS::ActiveMailQueue> SharedActiveMailQueue;
+    typedef std::map<std::string,SharedActiveMailQueue> ACTIVE_QUEUE_MAP;
+    ACTIVE_QUEUE_MAP ActiveQueueMap_;
 
     /**
      * a list of <queuename,pattern> pairs
      */
     std::map< std::string, std::string > WildcardQueuePatterns_;
 
-    /** the set of messages names/keys that have been received and
-     * because of that need not be shown again to the wildcard queues. Note
-     * that this may be a larger set than m_Registered because of wildcard
-     * subscriptions  */
-    std::set<std::string> WildcardCheckSet_;
+    /**
+     * for every message name received so far the queues it should be
+     * pushed to (empty if none are interested). Entries are worked out
+     * from the routes and patterns above the first time a name is seen and
+     * the whole table is thrown away whenever they change. Only the thread
+     * dispatching mail adds to a table, everyone else just replaces it
+     */
+#if __cplusplus >= 201103L
+    typedef std::unordered_map<std::string,std::vector<SharedActiveMailQueue> > ACTIVE_QUEUE_ROUTES;
+#else
+    typedef std::map<std::string,std::vector<SharedActiveMailQueue> > ACTIVE_QUEUE_ROUTES;
+#endif
+    MOOS::Poco::SharedPtr<ACTIVE_QUEUE_ROUTES> ActiveQueueRoutes_;
 
     /*
      * a mutex protecting  ActiveQueues_
      */
     CMOOSLock ActiveQueuesLock_;
 
+    /*
+     * forget all routing decisions (ActiveQueuesLock_ must be held)
+     */
+    void InvalidateActiveQueueRoutes();
+
+    /*
+     * work out which queues want sMsgName (ActiveQueuesLock_ must be held)
+     */
+    void FindActiveQueuesFor(const std::string & sMsgName,
+                             std::vector<SharedActiveMailQueue> & Queues);
+
     /*
      * an inernal helper function which sorts some mail into
      * active queues (if any have been installed)
      */
     bool DispatchInBoxToActiveThreads();
 
+    /*
+     * record the latency of mail which has just arrived (everything in
+     * the inbox after the first nAlreadyInBox messages)
+     */
+    void AuditIncomingMail(size_t nAlreadyInBox);
+
+    /*
+     * hand replies to server requests which have just arrived (after the
+     * first nAlreadyInBox messages in the inbox) to whoever is waiting
+     * for them. Call with m_InLock held
+     */
+    void CollectServerReplies(size_t nAlreadyInBox);
+
     /*
      * a counter for total bytes received
      */
@@ -666,6 +740,29 @@ protected:
     /** true if after handshaking DB announces its ability to support aysnc comms*/
     bool m_bDBIsAsynchronous;
 
+    /** true if after handshaking DB announces it can read compressed packets*/
+    bool m_bDBAcceptsCompression;
+
+    /** outgoing packets bigger than this are compressed (0 means never)*/
+    unsigned int m_nCompressionThreshold;
+
+    /** should we offer the DB a shared memory channel when connecting?*/
+    bool m_bOfferSharedMemory;
+
+    /** can we fetch the payloads of peer to peer stubs (so should tell the
+     * DB it may send us them when we register)?*/
+    bool m_bFollowsStubs;
+
+    /** are we auditing the latency of incoming mail?*/
+    bool m_bLatencyAudit;
+
+    /** compress an outgoing packet if we and the DB have agreed to do so*/
+    void CompressIfAgreed(CMOOSCommPkt & PktTx);
+
+    /** fill in the source and ID of a message about to be posted. Call
+     * with m_OutLock held*/
+    void PrepareToPost(CMOOSMsg & Msg, bool bKeepMsgSourceName);
+
 
     /** true if we expect Comms to overflow and want older (unsent) messages to be replaced by new ones */
     bool m_bExpectMailBoxOverFlow;
@@ -694,6 +791,18 @@ protected:
 private:
     std::map< std::string, double > m_RecurrentSubscriptions;
 
+    /** where the reading thread puts the reply to one server request */
+    struct ServerReply
+    {
+        MOOS::Poco::Event Arrived;
+        MOOSMSG_LIST Mail;
+    };
+
+    /** server requests in flight by the ID the DB will echo back
+     * (protected by m_InLock) */
+    std::map<int, ServerReply*> m_PendingServerRequests;
+    int m_nNextServerRequestID;
+
     MOOS::EndToEndAudit end_to_end_auditor_;
 
 
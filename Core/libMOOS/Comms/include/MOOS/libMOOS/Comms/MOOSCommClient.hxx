@@ -28,7 +28,7 @@ bool CMOOSCommClient::AddActiveQueue(const std::string & sQueueName,
 {
 	MOOS::ScopedLock L(ActiveQueuesLock_);
 
-	std::map<std::string,MOOS::ActiveMailQueue*>::iterator w =  ActiveQueueMap_.find(sQueueName);
+	ACTIVE_QUEUE_MAP::iterator w =  ActiveQueueMap_.find(sQueueName);
 	if(w==ActiveQueueMap_.end())
 	{
 		//we need to create a new queue
@@ -61,17 +61,9 @@ bool CMOOSCommClient::AddWildcardActiveQueue(const std::string & sQueueName,
 
 	WildcardQueuePatterns_[sQueueName]=sPattern;
 
-	//now we had better see if the wildcard queue is interested
-	//in any messages we have already seen
-	std::set< std::string>::iterator q;
-
-	for(q=WildcardCheckSet_.begin();q!=WildcardCheckSet_.end();++q)
-	{
-		if(MOOSWildCmp(sPattern,*q))
-		{
-			Msg2ActiveQueueName_[*q].insert(sQueueName);
-		}
-	}
+	//this new wildcard queue may be interested in
+	//messages we have already seen
+	InvalidateActiveQueueRoutes();
 
 
 	return true;
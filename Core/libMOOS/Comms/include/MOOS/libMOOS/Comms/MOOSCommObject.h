@@ -32,6 +32,8 @@
 #pragma once
 #endif // _MSC_VER > 1000
 #include "MOOSCommPkt.h"
+#include "ReceiveBuffer.h"
+#include "SharedMemoryChannel.h"
 
 class XPCTcpSocket;
 
@@ -47,6 +49,10 @@ public:
 
 protected:
     bool SendPkt(XPCTcpSocket* pSocket,CMOOSCommPkt & PktTx);
+
+    /** send a packet which refers to payloads it has not copied with as
+     * few (gathering) system calls as possible */
+    bool SendGatheredPkt(XPCTcpSocket* pSocket,CMOOSCommPkt & PktTx);
     bool ReadPkt(XPCTcpSocket* pSocket,CMOOSCommPkt & PktRx,int nSecondsTimeOut = -1);
     bool SendMsg(XPCTcpSocket* pSocket,CMOOSMsg & Msg);
     bool ReadMsg(XPCTcpSocket* pSocket,CMOOSMsg & Msg, int nSecondsTimeOut = -1);
@@ -80,6 +86,38 @@ public:
     /** return a string of the host machines's IP adress*/
     static std::string GetLocalIPAddress();
 
+    /** the pool this object's packets keep their data in */
+    const MOOS::SharedPacketBufferPool & GetPacketBufferPool(){return m_pPktPool;};
+
+    /** from now on send and read packets through pChannel rather than
+     * the socket passed to SendPkt() and ReadPkt(). NULL reverts to TCP.
+     * Sends give up after dfWriteTimeout seconds (never if negative) */
+    void UseSharedMemory(const MOOS::Poco::SharedPtr<MOOS::SharedMemoryChannel> & pChannel,
+            double dfWriteTimeout = -1);
+
+    /** are packets going through shared memory? */
+    bool IsUsingSharedMemory();
+
+    /** is there room in shared memory to send all of PktTx without waiting?
+     * (always false over TCP) */
+    bool HasSharedMemorySpaceFor(CMOOSCommPkt & PktTx);
+
+    /** tell the other end we are done with any shared memory channel */
+    void CloseSharedMemory();
+
+    /** send packets in the compact format (see
+     * CMOOSCommPkt::SetWireDictionary) from now on, or stop doing so. Either way both ends' dictionaries start
+     * afresh, so only call this before the first packet on a connection */
+    void SetCompactWire(bool bCompact);
+
+    /** are packets being sent compacted? */
+    bool IsCompactWire(){return m_bCompactWire;};
+
+    /** the dictionary packets for this connection must be written with
+     * (NULL unless the wire is compact). Packets must be sent in the order
+     * they were written with it */
+    MOOS::WireDictionary * GetTxDictionary();
+
 
 protected:
 
@@ -106,6 +144,31 @@ protected:
 
 	bool m_bDisableNagle;
 
+    //packets made for this connection reuse buffers from here
+    MOOS::SharedPacketBufferPool m_pPktPool;
+
+    /** read as much as the socket has in ReadPkt() and keep what the packet
+     * doesn't need for the next one. Only for objects reading one socket
+     * from one thread. Clears anything already buffered */
+    void EnableReadAhead(bool bEnable);
+
+    bool m_bReadAhead;
+    MOOS::ReceiveBuffer m_RxBuffer;
+
+    bool ReadPktFromSharedMemory(CMOOSCommPkt & PktRx,int nSecondsTimeOut);
+    bool SendPktToSharedMemory(CMOOSCommPkt & PktTx);
+
+    MOOS::Poco::SharedPtr<MOOS::SharedMemoryChannel> m_pSharedMemory;
+    double m_dfSharedMemoryWriteTimeout;
+
+    /** decode a compact packet which has just been read, throws if it
+     * can't be done */
+    void OnPktRead(CMOOSCommPkt & PktRx);
+
+    bool m_bCompactWire;
+    MOOS::WireDictionary m_TxDictionary;
+    MOOS::WireDictionary m_RxDictionary;
+
 
 private:
     //these are just here to help us test aspects of the communications
@@ -31,6 +31,10 @@
 
 
 #include "MOOS/libMOOS/Comms/CommsTypes.h"
+#include "MOOS/libMOOS/Comms/MOOSMsgView.h"
+#include "MOOS/libMOOS/Comms/PacketBufferPool.h"
+#include "MOOS/libMOOS/Comms/WireDictionary.h"
+#include <vector>
 
 ///////////////////////////////////////////////////////////////////////////////////
 //Here we define the current protocol string for this version of the library
@@ -41,21 +45,93 @@
 #define MOOS_PROTOCOL_STRING "ELKS CAN'T DANCE 2/8/10"
 #define MOOS_PKT_DEFAULT_SPACE 32768
 
+//the biggest packet we will agree to read - the length comes off the wire
+//so don't let it make us allocate anything we please
+#ifndef MOOS_PKT_MAX_SIZE
+#define MOOS_PKT_MAX_SIZE (512*1024*1024)
+#endif
+
+//the name by which peers announce, during handshaking, that they can read
+//packets compressed with MOOS::LZ
+#define MOOS_PKT_COMPRESSION "lz"
+
+//and the name by which they announce that they can read packets in the
+//compact format (see CMOOSCommPkt::SetWireDictionary)
+#define MOOS_PKT_COMPACT "compact"
+
+//string payloads at least this big are not copied into outgoing packets but
+//sent from where they lie (see CMOOSCommPkt::GetWireSegments)
+#define MOOS_PKT_GATHER_THRESHOLD 16384
+
+
+class CMOOSCommPkt;
+
+namespace MOOS
+{
+/** hands a packet made by CMOOSCommPkt::Make() back to the pool it came
+ * from, rather than deleting it, when the last reference goes */
+class CommPktReleasePolicy
+{
+public:
+    void release(CMOOSCommPkt * pPkt);
+};
+
+typedef Poco::SharedPtr<CMOOSCommPkt,Poco::ReferenceCounter,CommPktReleasePolicy> SharedCommPkt;
+}
 
 /** This class is part of MOOS's internal transport mechanism. It any number of CMOOSMsg's
 can be packed into a CMOOSCommPkt and sent in one lump between a CMOOSCommServer and CMOOSCommClient
 object. It is never used by a user of MOOSLib */
 class CMOOSCommPkt  
 {
+private:
+    //packets own their stream and are not copyable
+    CMOOSCommPkt(const CMOOSCommPkt &);
+    CMOOSCommPkt & operator=(const CMOOSCommPkt &);
+
 public:
+    /** a run of bytes to be sent, see GetWireSegments() */
+    struct WireSegment
+    {
+        const unsigned char * pData;
+        int nLength;
+    };
+
     CMOOSCommPkt();
+
+    /** a packet whose storage is drawn from (and returned to) pPool.
+     * A NULL pool means use PacketBufferPool::Shared() */
+    explicit CMOOSCommPkt(const MOOS::SharedPacketBufferPool & pPool);
+
     virtual ~CMOOSCommPkt();
 
+    /** a packet drawn from pPool's spare packets (a new one if it has none)
+     * which goes back there, stream and all, once finished with. Servers
+     * use these so reading and writing a packet needn't touch the heap.
+     * A NULL pool means use PacketBufferPool::Shared() */
+    static MOOS::SharedCommPkt Make(const MOOS::SharedPacketBufferPool & pPool);
+
     /**
      * serialise to or from a list of CMOOSMsgs
      */
     bool    Serialize(MOOSMSG_LIST & List, bool bToStream = true, bool bNoNULL =false,double * pdfPktTime=NULL);
 
+    /**
+     * serialise a list of messages followed by a list of shared messages
+     * to a stream. Neither list is altered. Big string payloads of shared
+     * messages are not copied, the packet keeps the messages alive and
+     * sends them from where they lie. If bGatherList is true the same goes
+     * for messages in List which then must outlive the sending of this packet
+     */
+    bool    Serialize(const MOOSMSG_LIST & List, const MOOSMSG_PTR_LIST & SharedList, bool bGatherList = false);
+
+    /**
+     * decode the packet into read only views of its messages. No string data
+     * is copied - the views point into this packet's stream and so are only valid
+     * while the packet is alive and unaltered
+     */
+    bool    Deserialize(MOOS::MsgViewVector & Views, bool bNoNULL =false,double * pdfPktTime=NULL);
+
     /**
      * return length of serialised stream
      */
@@ -67,12 +143,94 @@ public:
 
     int    GetNumMessagesSerialised();
 
+    /** the serialised stream. For gathered packets (see IsGathered()) this
+     * is not the whole story - use GetWireSegments() or Flatten() */
     unsigned char * Stream();
 
+    /** does this packet refer to string payloads it has not copied? */
+    bool    IsGathered();
+
+    /** fill in Segments with what, in order, goes on the wire skipping the
+     * first nFrom bytes. One segment unless the packet is gathered */
+    void    GetWireSegments(std::vector<WireSegment> & Segments, int nFrom = 0);
+
+    /** copy any referenced payloads into the stream so Stream() holds it all*/
+    void    Flatten();
+
     unsigned char * NextWrite();
 
+    /**
+     * compress a packet which has just been serialised to a stream. Packets
+     * smaller than nThreshold bytes, or which would not get any smaller, are
+     * left alone. Only send compressed packets to peers who said they could
+     * read them during handshaking. Decompression happens automatically
+     * when the packet is deserialised.
+     * @return true if the packet was compressed
+     */
+    bool    Compress(unsigned int nThreshold);
+
+    /**
+     * serialise messages in the compact format from now on: keys, sources
+     * and communities are replaced by tokens from Dictionary once they have
+     * been sent in full, lengths are varints and fields still holding their
+     * default values are left out. NULL goes back to the usual format. Only
+     * write compact packets for peers who said they could read them during
+     * handshaking, with the same dictionary, in the order they will be sent.
+     */
+    void    SetWireDictionary(MOOS::WireDictionary * pDictionary);
+
+    /**
+     * decode a compact packet which has just been read, Dictionary being
+     * the receiving end's twin of the one it was written with. This must be
+     * done as packets arrive, in order. Deserialize() then hands out the
+     * messages decoded here. Packets which are not compact are left alone.
+     * @return false if the packet could not be decoded
+     */
+    bool    ReadCompact(MOOS::WireDictionary & Dictionary);
+
+    /** how many bytes this packet occupies (or occupied) on the wire*/
+    int     GetWireLength();
+
+    /** how many bytes this packet would occupy uncompressed */
+    int     GetUncompressedLength();
+
+    /** ratio of uncompressed to wire size (1.0 for uncompressed packets)*/
+    double  GetCompression();
+
 protected:
     bool InflateTo(int nNewStreamSize);
+
+    /** set up an empty stream drawn from pPool */
+    void Initialise(const MOOS::SharedPacketBufferPool & pPool);
+
+    /** empty the packet, keeping whatever stream it has */
+    void Reset();
+
+    /** let go of everything a spare packet shouldn't hang on to */
+    void Recycle();
+
+    friend class MOOS::CommPktReleasePolicy;
+
+    /** make room for nBufferSize bytes and leave m_pNextData just past
+     * the header */
+    void StartWriting(unsigned int nBufferSize);
+
+    /** append one message to the stream (in the compact format if there
+     * is a dictionary), if bGather and its payload is big enough only
+     * remember where the payload is*/
+    bool WriteMsg(const CMOOSMsg & Msg, bool bGather = false);
+
+    /** fill in the header once nMessages messages have been written*/
+    void FinishWriting(int nMessages);
+
+    /** read the packet header and leave m_pNextData at the first message,
+     * returns the number of messages in the packet (0 if it can't be read)*/
+    int ReadHeader();
+
+    /** replace a compressed stream (header already read) with its
+     * uncompressed equivalent */
+    bool Inflate();
+
     int m_nByteCount;
     int m_nMsgLen;
 
@@ -80,12 +238,41 @@ protected:
     unsigned char * m_pNextData;
     int             m_nStreamSpace;
 
+    //where m_pStream came from and will go back to
+    MOOS::SharedPacketBufferPool m_pPool;
+
 	//how many messages are contained in this  packet when serialsised to a stream?
     int m_nToStreamCount;
 
 	//how many messages are serialsied
     int m_nMsgsSerialised;
 
+    //sizes of the packet as sent and once uncompressed
+    int m_nWireLength;
+    int m_nUncompressedLength;
+
+    //if not NULL messages are written in the compact format with this
+    MOOS::WireDictionary * m_pDictionary;
+
+    //the messages of a compact packet, decoded by ReadCompact() (so
+    //m_nWireLength stands)
+    MOOS::MsgViewVector m_CompactViews;
+    bool m_bCompactRead;
+
+    //payloads which belong on the wire at m_nInlineOffset bytes into the
+    //stream but have not been copied there
+    struct GatheredPayload
+    {
+        int m_nInlineOffset;
+        const unsigned char * m_pData;
+        int m_nLength;
+    };
+    std::vector<GatheredPayload> m_Gathered;
+    int m_nGatheredBytes;
+
+    //keeps the messages m_Gathered points into alive
+    MOOSMSG_PTR_LIST m_GatheredOwners;
+
 };
 
 #endif
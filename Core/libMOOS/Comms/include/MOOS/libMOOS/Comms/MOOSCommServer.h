@@ -80,6 +80,17 @@ public:
     */
     void SetOnRxCallBack(bool (*pfn)(const std::string  & sClient,MOOSMSG_LIST & MsgListRx,MOOSMSG_LIST & MsgListTx,void * pParam),void * pParam);
 
+    /** Set an optional receive call back which is handed read only views of the incoming
+    messages rather than a list of CMOOSMsg copies. The views point into the received packet
+    and are only valid for the duration of the call. Servers which support it
+    (ThreadedCommServer) prefer this call back over the one set by SetOnRxCallBack.
+    @param sClient    Name of client at the end of the socket sending this Pkt
+    @param RxViews    views of the incoming messages.
+    @param TxLst    recepticle for all the message that should be sent back to the client
+    @param pParam      user suplied parameter to be passed to callback function
+    */
+    void SetOnRxViewCallBack(bool (*pfn)(const std::string  & sClient,MOOS::MsgViewVector & RxViews,MOOSMSG_LIST & MsgListTx,void * pParam),void * pParam);
+
     /** Set the disconnect message call back handler.  The supplied call back must be of the form
     static bool MyCallBack(std::string  & sClient,, void * pParam).
     @param sClient   Name of client at the end of the socket sending this Pkt
@@ -105,6 +116,40 @@ public:
 	*/
     void SetOnFetchAllMailCallBack(bool (*pfn)(const std::string  & sClient,MOOSMSG_LIST & MsgListTx,void * pParam),void * pParam);
 
+    /**
+    * as above but the pending mail is handed over as shared (reference
+    * counted) messages so one notification sent to many clients is never
+    * copied. Servers that support it (ThreadedCommServer) prefer this call back
+    * over the one set by SetOnFetchAllMailCallBack and use it to collect the
+    * mail returned after every packet.
+    * @param pfn
+    * @param pParam
+    */
+    void SetOnFetchAllSharedMailCallBack(bool (*pfn)(const std::string  & sClient,MOOSMSG_PTR_LIST & SharedListTx,void * pParam),void * pParam);
+
+    /**
+    * Set up a callback which names the clients whose held mail has changed
+    * since it was last called. When set, servers which push mail to clients
+    * (ThreadedCommServer) only visit these clients rather than every client
+    * @param pfn
+    * @param pParam
+    */
+    void SetOnFetchClientsWithMailCallBack(bool (*pfn)(STRING_LIST & Clients,void * pParam),void * pParam);
+
+    /**
+    * Servers which push mail to clients will do so at most once every
+    * dfWindowMS milliseconds, so notifications arriving in a burst are sent
+    * to each client in one packet. 0 (the default) means send immediately.
+    */
+    virtual void SetMailBatchWindowMS(double /*dfWindowMS*/){};
+
+    /**
+    * Tell the server (from any thread) that mail has been left for clients
+    * outside of a call to the Rx callback. Servers which can push data to
+    * clients will arrange for the FetchAllMail callback to be invoked soon after.
+    */
+    virtual void RequestMailDelivery(){};
+
     /** This function is the listen loop called from one of the two server threads. It is responsible
     for accepting a coonection and creating a new client socket.    */
     virtual bool ListenLoop();
@@ -124,6 +169,20 @@ public:
      */
     bool  SetClientTimeout(double dfTimeoutPeriod);
 
+    /**
+     * compress packets bigger than nBytes on their way to clients which
+     * said during handshaking that they can read compressed packets.
+     * 0 (the default) turns compression off
+     */
+    void SetCompressionThreshold(unsigned int nBytes);
+
+    /**
+     * let clients on this machine which ask to, exchange packets with us
+     * through shared memory rather than loopback TCP (if the server
+     * supports it - see SupportsSharedMemoryClients())
+     */
+    void EnableSharedMemory(bool bEnable);
+
 
     /** specify a threshold above which the DB will print a warning if the time between
      * the time stamp in a message and it being printed is exceeded
@@ -179,6 +238,13 @@ protected:
     /** return true if Aynschronous Clients are supported */
     virtual bool SupportsAsynchronousClients();
 
+    /** return true if clients can talk to us through shared memory */
+    virtual bool SupportsSharedMemoryClients();
+
+    /** return true if we can send and read compact packets
+     * (see CMOOSCommPkt::SetWireDictionary) */
+    virtual bool SupportsCompactWire();
+
     /** Get the name of the client on the remote end of pSocket*/
     std::string  GetClientName(XPCTcpSocket* pSocket);
 
@@ -220,6 +286,14 @@ protected:
     @see SetOnRxCallBack */
     void * m_pRxCallBackParam;
 
+    /** user supplied OnRx callback taking message views
+    @see SetOnRxViewCallBack */
+    bool (*m_pfnRxViewCallBack)(const std::string  & sClient,MOOS::MsgViewVector & RxViews,MOOSMSG_LIST & MsgListTx,void * pCaller);
+
+    /** place holder for the address of the object passed back to the user during an Rx view callback
+    @see SetOnRxViewCallBack */
+    void * m_pRxViewCallBackParam;
+
 
     /** user supplied OnDisconnect callback
     @see SetOnDisconnectCallBack */
@@ -248,6 +322,22 @@ protected:
 	@see SetOnFetchAllMailCallBack */
     void * m_pFetchAllMailCallBackParam;
 
+    /** user supplied FetchAllSharedMail callback
+	@see SetOnFetchAllSharedMailCallBack */
+	bool (*m_pfnFetchAllSharedMailCallBack)(const std::string  & sClient,MOOSMSG_PTR_LIST & SharedListTx,void * pCaller);
+
+	/** place holder for the address of the object passed back to the user during an FetchAllSharedMail callback
+	@see SetOnFetchAllSharedMailCallBack */
+    void * m_pFetchAllSharedMailCallBackParam;
+
+    /** user supplied FetchClientsWithMail callback
+	@see SetOnFetchClientsWithMailCallBack */
+	bool (*m_pfnFetchClientsWithMailCallBack)(STRING_LIST & Clients,void * pCaller);
+
+	/** place holder for the address of the object passed back to the user during an FetchClientsWithMail callback
+	@see SetOnFetchClientsWithMailCallBack */
+    void * m_pFetchClientsWithMailCallBackParam;
+
 
 
     /** Listen socket (bound to port address supplied in constructor) */
@@ -267,6 +357,17 @@ protected:
      * asynchronous reception of data*/
     std::set<std::string> m_AsynchronousClientSet;
 
+    /** names of clients which can read compressed packets */
+    std::set<std::string> m_CompressionClientSet;
+
+    /** names of clients which can read compact packets */
+    std::set<std::string> m_CompactWireClientSet;
+
+    /** shared memory channels agreed during handshaking, waiting to be
+     * picked up by whatever serves the client */
+    typedef std::map<std::string, MOOS::Poco::SharedPtr<MOOS::SharedMemoryChannel> > SHARED_MEMORY_MAP;
+    SHARED_MEMORY_MAP m_SharedMemoryChannels;
+
     /** Called when a new client connects. Performs handshaking and adds new socket to m_ClientSocketList
     @param pNewClient pointer to the new socket created in ListenLoop;
     @see ListenLoop*/
@@ -314,6 +415,12 @@ protected:
     //how long will we tolerate a cleint not talking to us?
     double m_dfClientTimeout;
 
+    //packets to capable clients bigger than this are compressed (0 means never)
+    unsigned int m_nCompressionThreshold;
+
+    //will we talk to clients through shared memory?
+    bool m_bSharedMemory;
+
     //what threshold in transit time from client to DB worries us
     //and will cause us to issue a warning
     double m_dfCommsLatencyConcern;
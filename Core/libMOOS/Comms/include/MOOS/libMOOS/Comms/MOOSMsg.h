@@ -206,6 +206,15 @@ public:
     //serialise this message into/outof a character buffer
     int Serialize(unsigned char *  pBuffer,int  nLen,bool bToStream=true);
 
+    //serialise this message into a buffer without altering it (so it is safe
+    //to use on a message shared between threads). Returns bytes written or -1
+    int SerializeTo(unsigned char *  pBuffer,int  nLen) const;
+
+    //as SerializeTo but stops short of the bytes of the string payload (which
+    //always come last) so they can be sent from where they lie. Returns bytes
+    //written or -1
+    int SerializeHeaderTo(unsigned char *  pBuffer,int  nLen) const;
+
     //comparsion operator for sorting and storing
     bool operator <(const CMOOSMsg & Msg) const{ return m_dfTime<Msg.m_dfTime;};
 
@@ -221,10 +230,6 @@ private:
     int  m_nSerializeBufferLen;
     int  m_nLength;
     int GetLength();
-    void  operator << (char & cVal);
-    void  operator << (double & dfVal);
-    void  operator << (std::string & sVal);
-    void  operator << (int & nVal);
     void  operator >> (char & cVal);
     void  operator >> (double & dfVal);
     void  operator >> (std::string & sVal);
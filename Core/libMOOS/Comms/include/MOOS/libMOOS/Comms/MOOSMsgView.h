@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * MOOSMsgView.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef MOOSMSGVIEW_H_
+#define MOOSMSGVIEW_H_
+
+#include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include <string>
+#include <vector>
+
+namespace MOOS
+{
+
+/** a non owning reference to a run of characters sitting in
+ * someone else's buffer (typically a CMOOSCommPkt). It is only valid for
+ * as long as that buffer is alive and unaltered */
+class StringView
+{
+public:
+    StringView():m_pData(NULL),m_nSize(0){}
+    StringView(const char * pData, unsigned int nSize):m_pData(pData),m_nSize(nSize){}
+
+    const char * data() const {return m_pData;}
+    unsigned int size() const {return m_nSize;}
+    bool empty() const {return m_nSize==0;}
+
+    /** make an owning copy */
+    std::string str() const {return std::string(m_pData,m_nSize);}
+
+    /** copy into an existing string (which can reuse its storage)*/
+    void AssignTo(std::string & sDest) const {sDest.assign(m_pData,m_nSize);}
+
+    bool operator==(const std::string & s) const
+    {
+        return s.size()==m_nSize && s.compare(0,m_nSize,m_pData,m_nSize)==0;
+    }
+    bool operator!=(const std::string & s) const {return !(*this==s);}
+
+private:
+    const char * m_pData;
+    unsigned int m_nSize;
+};
+
+/** A read only view of a serialised CMOOSMsg. Decoding a message into a
+ * MsgView copies no string data - all the string fields refer directly to the
+ * bytes of the packet the message was read from. Use ToMsg() to make an
+ * owning CMOOSMsg once (and only if) the message has to be kept.*/
+class MsgView
+{
+public:
+    MsgView();
+
+    /** a view of Msg itself, valid while Msg is alive and unaltered */
+    explicit MsgView(const CMOOSMsg & Msg);
+
+    /** decode a single message which has been serialised at pBuffer (as
+     * written by CMOOSMsg::Serialize). Returns the number of bytes consumed or
+     * -1 if the buffer does not hold a complete message */
+    int Decode(const unsigned char * pBuffer, int nSpace);
+
+    /** fill in an owning copy of this message */
+    void ToMsg(CMOOSMsg & Msg) const;
+
+    bool IsType(char cType) const {return m_cMsgType==cType;}
+    char GetType() const {return m_cMsgType;}
+    bool IsDataType(char cDataType) const {return m_cDataType==cDataType;}
+    bool IsDouble() const {return IsDataType(MOOS_DOUBLE);}
+    bool IsString() const {return IsDataType(MOOS_STRING) || IsDataType(MOOS_BINARY_STRING);}
+
+    double GetTime() const {return m_dfTime;}
+    double GetDouble() const {return m_dfVal;}
+    double GetDoubleAux() const {return m_dfVal2;}
+    const StringView & GetKey() const {return m_Key;}
+    const StringView & GetString() const {return m_Val;}
+    const StringView & GetSource() const {return m_Src;}
+    const StringView & GetSourceAux() const {return m_SrcAux;}
+    const StringView & GetCommunity() const {return m_Community;}
+
+    int m_nID;
+    char m_cMsgType;
+    char m_cDataType;
+    double m_dfTime;
+    double m_dfVal;
+    double m_dfVal2;
+    StringView m_Key;
+    StringView m_Val;
+    StringView m_Src;
+    StringView m_SrcAux;
+    StringView m_Community;
+};
+
+typedef std::vector<MsgView> MsgViewVector;
+
+}
+
+#endif /* MOOSMSGVIEW_H_ */
@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * NotifyBatch.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef NOTIFYBATCH_H_
+#define NOTIFYBATCH_H_
+
+#include "MOOS/libMOOS/Comms/MOOSCommClient.h"
+
+namespace MOOS
+{
+
+/**
+ * Collects notifications and publishes them all at once. Handy for
+ * applications which publish lots of variables each iteration (a sensor
+ * driver say) as the whole batch costs one trip through the client's out
+ * box, one wake up of its writing thread and goes to the DB in one packet.
+ * @code
+ * MOOS::NotifyBatch Batch(m_Comms);
+ * Batch.Notify("NAV_X",dfX);
+ * Batch.Notify("NAV_Y",dfY);
+ * Batch.Notify("NAV_STATUS","ok");
+ * Batch.Commit();
+ * @endcode
+ * Nothing is sent until Commit() is called (uncommitted notifications are
+ * simply dropped when the batch goes out of scope). A batch can be reused
+ * once committed.
+ */
+class NotifyBatch
+{
+public:
+    NotifyBatch(CMOOSCommClient & Comms);
+
+    /** add a notification to the batch (string)*/
+    void Notify(const std::string &sVar, const std::string & sVal, double dfTime=-1);
+    void Notify(const std::string &sVar, const std::string & sVal, const std::string & sSrcAux, double dfTime=-1);
+    void Notify(const std::string &sVar, const char * sVal,double dfTime=-1);
+    void Notify(const std::string &sVar, const char * sVal,const std::string & sSrcAux, double dfTime=-1);
+
+    /** add a notification to the batch (double)*/
+    void Notify(const std::string & sVar,double dfVal, double dfTime=-1);
+    void Notify(const std::string & sVar,double dfVal, const std::string & sSrcAux,double dfTime=-1);
+
+    /** add a notification to the batch (binary data)*/
+    void Notify(const std::string & sVar,void *  pData, unsigned int nDataSize, double dfTime=-1);
+    void Notify(const std::string & sVar,const std::vector<unsigned char>& vData,double dfTime=-1);
+
+    /** publish everything in the batch and empty it
+     * @return false if the client is not connected (in which case the
+     * batch is kept)*/
+    bool Commit();
+
+    /** forget everything in the batch */
+    void Clear();
+
+    /** how many notifications are waiting to be committed */
+    unsigned int Size() const;
+
+private:
+    CMOOSCommClient & m_Comms;
+    MOOSMSG_LIST m_Msgs;
+};
+
+}
+
+#endif /* NOTIFYBATCH_H_ */
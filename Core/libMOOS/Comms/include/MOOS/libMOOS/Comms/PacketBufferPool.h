@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * PacketBufferPool.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef PACKETBUFFERPOOL_H_
+#define PACKETBUFFERPOOL_H_
+
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
+#include "MOOS/libMOOS/Thirdparty/PocoBits/SharedPtr.h"
+#include "MOOS/libMOOS/Thirdparty/PocoBits/AtomicCounter.h"
+#include <cstddef>
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#endif
+
+class CMOOSCommPkt;
+
+namespace MOOS
+{
+
+/**
+ * Room for up to N spare objects which any thread may Put() and Take()
+ * without locking. Each slot is swapped whole so a pointer is never half
+ * taken and there is no ABA to worry about.
+ */
+template<class T, unsigned int N>
+class SpareSlots
+{
+public:
+    SpareSlots()
+    {
+        for(unsigned int i = 0;i<N;i++)
+            m_Slots[i] = NULL;
+    }
+
+    /** stash p in one of the first nLimit slots, false if they are all full*/
+    bool Put(T * p, unsigned int nLimit = N)
+    {
+#if __cplusplus >= 201103L
+        for(unsigned int i = 0;i<nLimit && i<N;i++)
+        {
+            T * pEmpty = NULL;
+            if(m_Slots[i].load(std::memory_order_relaxed)==NULL &&
+                    m_Slots[i].compare_exchange_strong(pEmpty,p,std::memory_order_release))
+                return true;
+        }
+#else
+        MOOS::ScopedLock L(m_Lock);
+        for(unsigned int i = 0;i<nLimit && i<N;i++)
+        {
+            if(m_Slots[i]==NULL)
+            {
+                m_Slots[i] = p;
+                return true;
+            }
+        }
+#endif
+        return false;
+    }
+
+    /** take any spare, NULL if there are none */
+    T * Take()
+    {
+#if __cplusplus >= 201103L
+        for(unsigned int i = 0;i<N;i++)
+        {
+            if(m_Slots[i].load(std::memory_order_relaxed)==NULL)
+                continue;
+            T * p = m_Slots[i].exchange(NULL,std::memory_order_acquire);
+            if(p!=NULL)
+                return p;
+        }
+#else
+        MOOS::ScopedLock L(m_Lock);
+        for(unsigned int i = 0;i<N;i++)
+        {
+            if(m_Slots[i]!=NULL)
+            {
+                T * p = m_Slots[i];
+                m_Slots[i] = NULL;
+                return p;
+            }
+        }
+#endif
+        return NULL;
+    }
+
+private:
+#if __cplusplus >= 201103L
+    std::atomic<T*> m_Slots[N];
+#else
+    T * m_Slots[N];
+    CMOOSLock m_Lock;
+#endif
+};
+
+/**
+ * A thread safe cache of the byte buffers CMOOSCommPkts keep their streams
+ * in, and of the packets themselves. Buffers come in power of two size
+ * classes and are kept in a few lock free slots per class when returned, so
+ * once a connection has seen its usual range of packet sizes it stops
+ * touching the heap altogether. Every comms object owns one of these (so
+ * connections don't contend with each other) and packets keep a reference to
+ * the pool they came from so buffers can be returned from any thread, even
+ * after the connection has gone.
+ */
+class PacketBufferPool
+{
+public:
+    PacketBufferPool();
+    ~PacketBufferPool();
+
+    /** fetch a buffer of at least nSize bytes. nCapacity is filled in with
+     * its actual size which must be passed back to Return() */
+    unsigned char * Get(unsigned int nSize, unsigned int & nCapacity);
+
+    /** hand back a buffer previously returned by Get() */
+    void Return(unsigned char * pBuffer, unsigned int nCapacity);
+
+    /** park a packet nobody wants any more for TakePkt() to hand out again,
+     * false (and the caller must delete it) if there are spares enough */
+    bool StashPkt(CMOOSCommPkt * pPkt);
+
+    /** a previously stashed packet or NULL (see CMOOSCommPkt::Make()) */
+    CMOOSCommPkt * TakePkt();
+
+    /** how many calls to Get() were satisfied without allocating */
+    unsigned int GetReuseCount();
+
+    /** how many calls to Get() had to allocate */
+    unsigned int GetAllocationCount();
+
+    /** a pool for packets which have no particular home */
+    static Poco::SharedPtr<PacketBufferPool> Shared();
+
+private:
+    //not copyable
+    PacketBufferPool(const PacketBufferPool &);
+    PacketBufferPool & operator=(const PacketBufferPool &);
+
+    /** which class buffers of nSize bytes belong to (or -1 if too big to pool)*/
+    static int SizeClass(unsigned int nSize);
+
+    /** how big buffers of class nClass are */
+    static unsigned int ClassSize(int nClass);
+
+    /** how many spare buffers of class nClass we keep */
+    static unsigned int MaxSpare(int nClass);
+
+    //buffers are sized 2^kSmallestClassBits ... 2^kLargestClassBits bytes
+    //and we keep at most kMaxSpare of each size (or packet)
+    enum
+    {
+        kSmallestClassBits = 6,
+        kLargestClassBits = 24,
+        kNumClasses = kLargestClassBits-kSmallestClassBits+1,
+        kMaxSpare = 16
+    };
+
+    SpareSlots<unsigned char,kMaxSpare> m_FreeLists[kNumClasses];
+    SpareSlots<CMOOSCommPkt,kMaxSpare> m_SparePkts;
+
+    Poco::AtomicCounter m_nReused;
+    Poco::AtomicCounter m_nAllocated;
+};
+
+typedef Poco::SharedPtr<PacketBufferPool> SharedPacketBufferPool;
+
+}
+
+#endif /* PACKETBUFFERPOOL_H_ */
@@ -0,0 +1,202 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * PeerToPeer.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef PEERTOPEER_H_
+#define PEERTOPEER_H_
+
+#include <string>
+#include <list>
+#include <map>
+
+#include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include "MOOS/libMOOS/Comms/CommsTypes.h"
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+
+class XPCTcpSocket;
+
+namespace MOOS
+{
+
+/**
+ * Large binary variables can travel straight from the client which writes
+ * them to the clients which read them. The writer keeps the payload in a
+ * PeerServer and posts only a "stub" to the DB - a binary notification with
+ * no payload whose source aux says where the real thing can be had, which
+ * sample it stands in for, how big it is and the key a reader must show to
+ * get it. The DB stores and forwards the stub as it would any other
+ * notification, so intervals and latest-only registrations apply to stubs
+ * just as they would to the data and DB_VARSUMMARY still shows who wrote
+ * what and when. A reader receiving a stub fetches that sample from the
+ * writer (via its PeerLinks) and is handed the stub with the payload put
+ * back in. Peers talk ordinary MOOS packets over TCP, or over a
+ * SharedMemoryChannel when they share a machine.
+ *
+ * Subscribers which say they can follow stubs when they register are the
+ * only ones who can be sent them. If anyone else subscribes the DB refuses
+ * the stub and tells the writer, which posts the sample in full instead.
+ */
+namespace P2P
+{
+    /** is this a stub standing in for a payload sent directly? */
+    bool IsStub(const CMOOSMsg & Msg);
+
+    /** where can the payload a stub stands in for be had? */
+    bool GetPublisher(const CMOOSMsg & Stub, std::string & sHost, int & nPort);
+
+    /** how big is the payload a stub stands in for? (0 if not a stub) */
+    unsigned int GetPayloadSize(const CMOOSMsg & Stub);
+
+    /** which sample does a stub (or a refusal of one) stand in for? */
+    unsigned int GetSequence(const CMOOSMsg & Msg);
+
+    /** make the stub to send to the DB in place of Msg, the nSeq'th sample
+     * published by the PeerServer at sHost:nPort which wants sKey from
+     * its readers */
+    CMOOSMsg MakeStub(const CMOOSMsg & Msg, const std::string & sHost, int nPort,
+            const std::string & sKey, unsigned int nSeq);
+
+    /** is this the DB refusing a stub? */
+    bool IsRefusal(const CMOOSMsg & Msg);
+
+    /** make the message the DB sends a writer whose stub it won't take */
+    CMOOSMsg MakeRefusal(const CMOOSMsg & Stub);
+}
+
+/**
+ * The writing end. Holds the last few samples of every variable published
+ * through it and sends any of them to peers which ask - and can show the
+ * key given out in our stubs. Each peer has a reading and a writing thread.
+ */
+class PeerServer
+{
+public:
+    PeerServer();
+    ~PeerServer();
+
+    /** start listening on a port of the system's choosing. Does nothing if
+     * already running. Peers offering shared memory get it if
+     * bSharedMemory is true */
+    bool Run(bool bSharedMemory = false, bool bDisableNagle = true);
+
+    /** drop all peers and stop listening */
+    void Stop();
+
+    bool IsRunning();
+
+    /** where peers can find us */
+    std::string GetHost();
+    int GetPort();
+
+    /** keep a copy of Msg for peers to fetch and fill in Stub, which is
+     * what should go to the DB instead */
+    bool Publish(const CMOOSMsg & Msg, CMOOSMsg & Stub);
+
+    /** get back the nSeq'th sample if we still have it */
+    bool GetPublished(const std::string & sVar, unsigned int nSeq, CMOOSMsg & Msg);
+
+    /** how many peers are connected */
+    unsigned int GetNumPeers();
+
+    /** thread worker - you won't be calling this yourself */
+    bool ListenLoop();
+
+private:
+    class Peer;
+    friend class Peer;
+
+    typedef std::list<std::pair<unsigned int,MOOSMSG_PTR> > SAMPLES;
+
+    /** a peer wants a sample (called by its thread) */
+    void OnPeerFetch(Peer * pPeer, const std::string & sVar, unsigned int nSeq);
+
+    /** get rid of peers which have gone away */
+    void ReapPeers(bool bAll);
+
+    CMOOSLock m_Lock;
+    std::list<Peer*> m_Peers;
+    std::map<std::string,SAMPLES> m_Published;
+    unsigned int m_nLastSeq;
+    std::string m_sKey;
+
+    XPCTcpSocket * m_pListenSocket;
+    CMOOSThread m_ListenThread;
+    std::string m_sHost;
+    int m_nPort;
+    bool m_bSharedMemory;
+    bool m_bDisableNagle;
+};
+
+/**
+ * The reading end. Follows stubs to their writers, keeping one link to each
+ * writer, and hands each stub, filled in, to a mail callback.
+ */
+class PeerLinks
+{
+public:
+    PeerLinks();
+    ~PeerLinks();
+
+    /** pfn is called (from a link's thread) with each batch of mail */
+    void SetMailCallBack(bool (*pfn)(MOOSMSG_LIST & Mail,void * pParam),void * pParam);
+
+    /** offer shared memory to writers on this machine? */
+    void SetSharedMemory(bool bSharedMemory);
+
+    void SetTCPNoDelay(bool bTCPNoDelay);
+
+    /** a stub has arrived - fetch the sample it stands in for. Returns
+     * false if we can't reach the writer, in which case the stub is all
+     * the caller is going to get */
+    bool OnStub(const CMOOSMsg & Stub);
+
+    /** drop all links */
+    void Close();
+
+    /** how many writers are we linked to */
+    unsigned int GetNumLinks();
+
+private:
+    class Link;
+    friend class Link;
+
+    bool DeliverMail(MOOSMSG_LIST & Mail);
+
+    CMOOSLock m_Lock;
+    std::map<std::string,Link*> m_Links;
+
+    bool (*m_pfnMailCallBack)(MOOSMSG_LIST & Mail,void * pParam);
+    void * m_pMailCallBackParam;
+    bool m_bSharedMemory;
+    bool m_bDisableNagle;
+};
+
+}
+
+#endif /* PEERTOPEER_H_ */
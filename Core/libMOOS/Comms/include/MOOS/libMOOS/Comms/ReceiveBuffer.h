@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * ReceiveBuffer.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef RECEIVEBUFFER_H_
+#define RECEIVEBUFFER_H_
+
+#include <vector>
+
+class CMOOSCommPkt;
+
+namespace MOOS
+{
+
+/**
+ * Bytes read from a socket ahead of the packet currently being assembled.
+ * Rather than asking the socket for exactly what the packet needs next (four
+ * bytes of length and then the rest) a connection reads as much as the socket
+ * has into one of these and slices packets out of it, carrying anything left
+ * over on to the next packet. Under load that means several packets per
+ * read rather than two or more reads per packet.
+ */
+class ReceiveBuffer
+{
+public:
+    explicit ReceiveBuffer(unsigned int nCapacity = 65536);
+
+    /** move as many buffered bytes into Pkt as it wants (or we have).
+     * Returns false if the packet rejects them */
+    bool Drain(CMOOSCommPkt & Pkt);
+
+    /** is there nothing waiting to be drained? */
+    bool IsEmpty() const {return m_nStart==m_nEnd;}
+
+    /** where to read more bytes to (the buffer is compacted first)*/
+    unsigned char * WritePtr();
+
+    /** how many bytes can be read to WritePtr()*/
+    unsigned int Space() const;
+
+    /** n bytes have just been read to WritePtr() */
+    void OnBytesRead(unsigned int n) {m_nEnd+=n;}
+
+    unsigned int Capacity() const {return m_nCapacity;}
+
+    /** forget anything buffered (eg the connection has changed) */
+    void Clear() {m_nStart = m_nEnd = 0;}
+
+private:
+    std::vector<unsigned char> m_Data;
+    unsigned int m_nCapacity;
+    unsigned int m_nStart;
+    unsigned int m_nEnd;
+};
+
+}
+
+#endif /* RECEIVEBUFFER_H_ */
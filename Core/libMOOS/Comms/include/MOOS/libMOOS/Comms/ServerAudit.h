@@ -41,7 +41,11 @@ class ServerAudit {
 public:
 	ServerAudit();
 	virtual ~ServerAudit();
-  bool AddStatistic(const std::string & sClient, unsigned int nBytes, unsigned int nMessages, double dfTime, bool bIncoming);
+  /** record a packet to or from a client.
+   * @param nBytes bytes on the wire
+   * @param nUncompressedBytes size of the packet once uncompressed (0 if it wasn't compressed)
+   */
+  bool AddStatistic(const std::string & sClient, unsigned int nBytes, unsigned int nMessages, double dfTime, bool bIncoming, unsigned int nUncompressedBytes = 0);
 	bool Run(const std::string & destination_host = "localhost", unsigned int port = DEFAULT_AUDIT_PORT);
 	bool Remove(const std::string & sClient);
 	bool SetQuiet(bool bQuiet);
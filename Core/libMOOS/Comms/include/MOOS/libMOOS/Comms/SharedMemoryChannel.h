@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * SharedMemoryChannel.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef SHAREDMEMORYCHANNEL_H_
+#define SHAREDMEMORYCHANNEL_H_
+
+#include <string>
+
+//how many bytes each direction of a shared memory channel can hold
+#define MOOS_SHM_DEFAULT_RING_SIZE (1024*1024)
+
+namespace MOOS
+{
+
+/**
+ * A pair of byte rings in POSIX shared memory through which a client and a
+ * MOOSDB on the same machine exchange the very same packets they would
+ * otherwise send over loopback TCP. Each ring has exactly one writer and one
+ * reader, and a side which has nothing to do sleeps on a futex "doorbell"
+ * rung by its peer. The client makes the channel and offers its name (and a
+ * secret key) during handshaking; a DB which can open it and agrees says so
+ * in its welcome and from then on both ends read and write packets here.
+ * The TCP connection stays open and is still how the connection as a whole
+ * lives and dies. Only available on Linux - elsewhere Create() and Attach()
+ * always fail and TCP is used.
+ */
+class SharedMemoryChannel
+{
+public:
+    ~SharedMemoryChannel();
+
+    /** make a new channel with nRingSize bytes each way (client side)
+     * returns NULL on failure */
+    static SharedMemoryChannel * Create(unsigned int nRingSize = MOOS_SHM_DEFAULT_RING_SIZE);
+
+    /** open a channel made by a peer, checking sKey is the one it was made
+     * with (DB side). Returns NULL on failure */
+    static SharedMemoryChannel * Attach(const std::string & sName, const std::string & sKey);
+
+    /** the name by which a peer can attach */
+    std::string GetName() const {return m_sName;}
+
+    /** the secret a peer must know to attach */
+    std::string GetKey() const {return m_sKey;}
+
+    /** remove the name from the system (mappings live on). Called once
+     * the peer has attached or declined */
+    void Unlink();
+
+    /** copy up to nLen bytes in, waiting up to dfTimeout seconds (forever if
+     * negative) for room. Returns bytes written, 0 on timeout or -1 if the
+     * channel is closed */
+    int Write(const unsigned char * pData, int nLen, double dfTimeout = -1);
+
+    /** how many bytes could be written right now without waiting */
+    int GetSpace();
+
+    /** copy up to nLen available bytes out, waiting up to dfTimeout seconds
+     * (forever if negative) for some to arrive. Returns bytes read, 0 on
+     * timeout or -1 if the channel is closed */
+    int Read(unsigned char * pData, int nLen, double dfTimeout = -1);
+
+    /** wait up to dfTimeout seconds for something to read. Returns false
+     * on timeout or if the channel has closed */
+    bool WaitForData(double dfTimeout);
+
+    /** tell our peer (and our own threads) that we are done with this */
+    void Close();
+
+    /** has either side closed the channel (or died)? */
+    bool IsClosed();
+
+private:
+    SharedMemoryChannel();
+
+    //not copyable
+    SharedMemoryChannel(const SharedMemoryChannel &);
+    SharedMemoryChannel & operator=(const SharedMemoryChannel &);
+
+    struct Ring;
+    struct Layout;
+
+    Ring & TxRing();
+    Ring & RxRing();
+
+    /** sleep until *pDoorbell is no longer nSeen or dfSeconds pass. If
+     * we slept the whole time check our peer is still alive */
+    void WaitOnDoorbell(volatile int * pDoorbell, int nSeen, double dfSeconds);
+
+    /** poll briefly for data before going to sleep waiting for it */
+    bool SpinForData();
+    void RingDoorbell(volatile int * pDoorbell);
+
+    Layout * m_pLayout;
+    unsigned char * m_pTxData;
+    unsigned char * m_pRxData;
+    unsigned int m_nMappedSize;
+    int m_nSide;
+    bool m_bLinked;
+    std::string m_sName;
+    std::string m_sKey;
+};
+
+}
+
+#endif /* SHAREDMEMORYCHANNEL_H_ */
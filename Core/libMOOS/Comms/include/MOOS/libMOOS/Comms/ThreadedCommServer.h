@@ -34,6 +34,7 @@
 
 #include "MOOS/libMOOS/Comms/MOOSCommServer.h"
 #include "MOOS/libMOOS/Utils/SafeList.h"
+#include "MOOS/libMOOS/Utils/LockFreeQueue.h"
 #include "MOOS/libMOOS/Thirdparty/PocoBits/SharedPtr.h"
 
 namespace MOOS
@@ -47,7 +48,7 @@ struct ClientThreadSharedData
 	std::string _sClientName;
 
 	//payload
-	Poco::SharedPtr<CMOOSCommPkt> _pPkt;
+	MOOS::SharedCommPkt _pPkt;
 
 	//little bit of status
 	enum Status
@@ -57,13 +58,21 @@ struct ClientThreadSharedData
 	  CONNECTION_CLOSED,
 	  PKT_WRITE,
 	  STOP_THREAD,
+	  DELIVER_MAIL,
 	} _Status;
 
 
 	ClientThreadSharedData(const std::string & sN,Status eStatus =NOT_INITIALISED):
 	_sClientName(sN),_Status(eStatus)
 	{
-		_pPkt = new CMOOSCommPkt;
+		_pPkt = CMOOSCommPkt::Make(MOOS::SharedPacketBufferPool());
+	};
+
+	//as above but with a packet (and storage) recycled through pPool
+	ClientThreadSharedData(const std::string & sN,Status eStatus,const MOOS::SharedPacketBufferPool & pPool):
+	_sClientName(sN),_Status(eStatus)
+	{
+		_pPkt = CMOOSCommPkt::Make(pPool);
 	};
 
 	ClientThreadSharedData(){_Status =NOT_INITIALISED; };
@@ -84,7 +93,7 @@ private:
 
 
 protected:
-    typedef SafeList<ClientThreadSharedData> SHARED_PKT_LIST;
+    typedef LockFreeQueue<ClientThreadSharedData> SHARED_PKT_LIST;
 
 
     /**
@@ -138,7 +147,7 @@ protected:
          * @param OutGoing an object which was orginally collected from _SharedDataIncoming
          * @return tru on success
          */
-        bool SendToClient(ClientThreadSharedData & OutGoing);
+        virtual bool SendToClient(ClientThreadSharedData & OutGoing);
 
         bool SelectWrite(ClientThreadSharedData & SDOutGoing);
 
@@ -154,9 +163,13 @@ protected:
 
         double GetConsolidationTime();
 
+        /** packets to this client bigger than nBytes will be compressed (0 means never)*/
+        void SetCompressionThreshold(unsigned int nBytes){m_nCompressionThreshold = nBytes;};
+        unsigned int GetCompressionThreshold(){return m_nCompressionThreshold;};
+
         const std::string & GetClientName(){ return m_sClientName;};
 
-        bool Start();
+        virtual bool Start();
 
     protected:
 
@@ -166,7 +179,7 @@ protected:
         CMOOSThread m_Writer;
 
         //terminates this client and constituent threads
-        bool Kill();
+        virtual bool Kill();
 
         //what is the name of the client we are representing?
         std::string m_sClientName;
@@ -180,6 +193,13 @@ protected:
         //note that this one we own - its private to us
         ThreadedCommServer::SHARED_PKT_LIST m_SharedDataOutgoing;
 
+        //how many packets handed to the writer thread it has yet to finish
+        //sending (while there are any nobody else may write) and has it
+        //given up after failing to send one?
+        CMOOSLock m_WriterBacklogLock;
+        unsigned int m_nWriterBacklog;
+        bool m_bWriterFailed;
+
         //is the client asynchronous?
         bool m_bAsynchronous;
 
@@ -192,6 +212,9 @@ protected:
         //are we asked to boost prioirty
         bool m_bBoostThread;
 
+        //compress packets to the client bigger than this
+        unsigned int m_nCompressionThreshold;
+
         std::vector<unsigned char  > m_IncomingStorage;
         std::vector<unsigned char  > m_OutgoingStorage;
     };
@@ -211,12 +234,24 @@ protected:
     /** return true if Aynschronous Clients are supported */
     virtual bool SupportsAsynchronousClients();
 
+    virtual bool SupportsSharedMemoryClients();
+
+    virtual bool SupportsCompactWire();
+
     virtual bool ServerLoop();
 
     virtual bool TimerLoop();
 
     virtual bool AddAndStartClientThread(XPCTcpSocket & NewClientSocket,const std::string & sName);
 
+    /** make (but don't start) the object which will look after all
+     * communications with a newly connected client. Derived servers can
+     * override this to handle clients some other way */
+    virtual SharedClientThread MakeClientThread(const std::string & sName,
+            XPCTcpSocket & NewClientSocket,
+            bool bAsync,
+            double dfConsolidationTime);
+
     virtual bool ProcessClient(ClientThreadSharedData &SD, MOOS::ServerAudit & Auditor);
 
     virtual bool ProcessClient();
@@ -225,13 +260,40 @@ protected:
 
     virtual bool Stop();
 
+    /** can be called from any thread to have the server loop collect
+     * and send any pending mail to asynchronous clients*/
+    virtual void RequestMailDelivery();
+
+    /** send any pending mail to asynchronous clients */
+    bool DeliverPendingMail(const std::string & sCause, MOOS::ServerAudit & Auditor);
+
+    /** collect and send pending mail for a single client */
+    bool DeliverMailTo(const std::string & sClient, ClientThread * pClient, const std::string & sCause, MOOS::ServerAudit & Auditor);
+
+    /** compress (where allowed) and account for a packet about to be sent to a client */
+    void PrepareToSend(ClientThread * pClient, CMOOSCommPkt & Pkt, unsigned int nMessages, MOOS::ServerAudit & Auditor);
+
+    /** coalesce pushed mail so each client gets at most one packet every dfWindowMS*/
+    virtual void SetMailBatchWindowMS(double dfWindowMS);
+
     protected:
 
 		//all connected clients will push the received Pkts into this list....
-		SafeList<ClientThreadSharedData> m_SharedDataListFromClient;
+		SHARED_PKT_LIST m_SharedDataListFromClient;
         typedef std::map<std::string,SharedClientThread> ClientThreadsMap;
         ClientThreadsMap m_ClientThreads;
 
+        //is there a request to deliver mail sitting in m_SharedDataListFromClient?
+        bool m_bMailDeliveryPending;
+        CMOOSLock m_MailDeliveryLock;
+
+        //mail is pushed at most once per m_dfMailBatchWindow seconds. When
+        //a delivery is asked for too soon it is deferred and m_bMailDeliveryDeferred
+        //is set (only touched by the server loop thread)
+        double m_dfMailBatchWindow;
+        double m_dfLastMailDelivery;
+        bool m_bMailDeliveryDeferred;
+
         typedef SafeList<SharedClientThread> SafeClientThreadsList;
         SafeClientThreadsList m_OldClientThreadsToDestroy;
 
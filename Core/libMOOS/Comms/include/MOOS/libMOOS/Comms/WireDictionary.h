@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * WireDictionary.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef WIREDICTIONARY_H_
+#define WIREDICTIONARY_H_
+
+#include <string>
+#include <map>
+#include <deque>
+
+//how many names one direction of a connection remembers
+#define MOOS_WIRE_DICTIONARY_SIZE 4096
+
+//names longer than this are always sent in full
+#define MOOS_WIRE_DICTIONARY_MAX_LENGTH 256
+
+namespace MOOS
+{
+
+/**
+ * The names (keys, sources and communities) which have gone one way along a
+ * connection speaking the compact wire format, and the small numbers which
+ * now stand for them. The first time a name is sent it goes in full and both
+ * ends add it to their dictionary, after that its token is sent instead.
+ * The sender's and receiver's dictionaries stay the same only if both see
+ * every compact packet in the order it was sent, so each connection has one
+ * per direction and they are cleared when it (re)connects.
+ */
+class WireDictionary
+{
+public:
+    WireDictionary(unsigned int nCapacity = MOOS_WIRE_DICTIONARY_SIZE);
+
+    /** sending: the token standing for the nLength bytes at pData or 0 if
+     * they must be sent in full (in which case they will have the next
+     * token from now on, if there is room) */
+    unsigned int Encode(const char * pData, unsigned int nLength);
+
+    /** receiving: a name was sent in full, so give it the next token
+     * if there is room */
+    void Learn(const char * pData, unsigned int nLength);
+
+    /** receiving: the name nToken stands for (NULL if unknown). The string
+     * stays put until the dictionary is cleared */
+    const std::string * Lookup(unsigned int nToken) const;
+
+    /** forget everything */
+    void Clear();
+
+    /** how many names are remembered */
+    unsigned int Size() const;
+
+private:
+    bool HasRoomFor(unsigned int nLength) const;
+
+    unsigned int m_nCapacity;
+
+    //used when sending
+    std::map<std::string,unsigned int> m_Tokens;
+
+    //used when receiving (a deque so strings don't move as it grows)
+    std::deque<std::string> m_Names;
+};
+
+}
+
+#endif /* WIREDICTIONARY_H_ */
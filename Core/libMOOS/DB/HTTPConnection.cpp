@@ -38,8 +38,20 @@
 #endif
 
 #include "MOOS/libMOOS/DB/HTTPConnection.h"
+#include "MOOS/libMOOS/DB/MOOSDB.h"
 #include <sstream>
 
+#ifdef _WIN32
+    #define HTTP_SEND_FLAGS 0
+    #define HTTP_SHUTDOWN_SEND SD_SEND
+#else
+    #define HTTP_SEND_FLAGS (MSG_DONTWAIT | MSG_NOSIGNAL)
+    #define HTTP_SHUTDOWN_SEND SHUT_WR
+#endif
+
+//how much of a request header we will hold on to
+#define HTTP_MAX_HEADER_SIZE (64*1024)
+
 class CHTMLTag
 {
 private:
@@ -95,89 +107,169 @@ public:
 
 CHTTPConnection::CHTTPConnection(XPCTcpSocket * pSocket,
                                  CMOOSCommClient* pMOOSComms,
-                                 CMOOSLock* pMOOSCommsLock):m_pSocket(pSocket),m_pMOOSComms(pMOOSComms),m_pMOOSCommsLock(pMOOSCommsLock)
+                                 CMOOSLock* pMOOSCommsLock,
+                                 CMOOSDB* pDB):m_pSocket(pSocket),m_pMOOSComms(pMOOSComms),m_pMOOSCommsLock(pMOOSCommsLock),m_pDB(pDB)
 {
+    m_nSent = 0;
+    m_nToDiscard = 0;
+    m_bCloseWhenSent = false;
+    m_bClosed = false;
+    m_dfLastActivity = MOOSLocalTime();
+}
 
+CHTTPConnection::~CHTTPConnection()
+{
+    m_pSocket->vCloseSocket();
+    delete m_pSocket;
 }
 
+int CHTTPConnection::GetSocketFD()
+{
+    return m_pSocket->iGetSocketFd();
+}
 
-bool CHTTPConnection::Run()
+static bool WouldBlock()
 {
-    m_ServeThread.Initialise(_CB,this);
+#ifdef _WIN32
+    int nError = WSAGetLastError();
+    return nError==WSAEWOULDBLOCK || nError==WSAEINTR;
+#else
+    return errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR;
+#endif
+}
 
-    m_ServeThread.Start();
+bool CHTTPConnection::OnReadable()
+{
+    char Buffer[4096];
+    int nRead = m_pSocket->iRecieveMessage(Buffer,sizeof(Buffer),0);
+    if(nRead<=0)
+    {
+        //graceful closure (or reset)
+        m_bClosed = true;
+        return false;
+    }
 
-    return true;
-}
+    m_dfLastActivity = MOOSLocalTime();
 
+    //once we have decided to close we only wait for the client to do so
+    if(m_bCloseWhenSent)
+        return true;
 
-bool CHTTPConnection::Serve()
-{
- 
-    //ignore broken pipes as is standard for network apps
-#ifndef _WIN32
-    signal(SIGPIPE,SIG_IGN);
-#endif
-    
-    try
+    m_sInput.append(Buffer,nRead);
+
+    //answer every whole request we have, in order
+    while(!m_bCloseWhenSent)
     {
-        if(ReadRequest())
+        if(m_nToDiscard>0)
         {
-            if(!MakeWebPage())
-            {
-                SendFailureHeader();
-            }
-            else
+            size_t nDiscard = std::min(m_nToDiscard,m_sInput.size());
+            m_sInput.erase(0,nDiscard);
+            m_nToDiscard-=nDiscard;
+            if(m_nToDiscard>0)
+                break;
+        }
+
+        size_t nEnd = m_sInput.find("\r\n\r\n");
+        if(nEnd==std::string::npos)
+        {
+            if(m_sInput.size()>HTTP_MAX_HEADER_SIZE)
             {
-                SendHeader();
+                m_bClosed = true;
+                return false;
             }
-            
-            SendWebPage();
-            
-        }    
+            break;
+        }
+
+        std::string sHeader = m_sInput.substr(0,nEnd);
+        m_sInput.erase(0,nEnd+4);
+
+        Serve(sHeader);
     }
-    catch(XPCException & e)
+
+    return OnWritable();
+}
+
+bool CHTTPConnection::OnWritable()
+{
+    while(m_nSent<m_sOutput.size())
     {
-        MOOSTrace("Exception caught in HTTP Connection server :\n%s\n",e.sGetException());
-        UNUSED_PARAMETER(e);
+        int nSent = send(GetSocketFD(),
+                         m_sOutput.data()+m_nSent,
+                         int(m_sOutput.size()-m_nSent),
+                         HTTP_SEND_FLAGS);
+        if(nSent<0)
+        {
+            if(WouldBlock())
+                return true;
+            m_bClosed = true;
+            return false;
+        }
+        m_nSent+=nSent;
+        m_dfLastActivity = MOOSLocalTime();
     }
-    
-    //all done - clean up
-    //strange behaviour on some combinations of clients and hosts
-    //closing socket too quickly (and I mean with a few uS) prevents final read of page even though
-    //XPCSocket reports all data is sent
-    MOOSPause(100);
 
-    m_pSocket->vCloseSocket();
-    
-    delete m_pSocket;
-    
+    m_sOutput.clear();
+    m_nSent = 0;
+
+    //closing straight away can lose the end of the reply on some clients
+    //so say we are done and let them close
+    if(m_bCloseWhenSent)
+        shutdown(GetSocketFD(),HTTP_SHUTDOWN_SEND);
+
     return true;
 }
 
+bool CHTTPConnection::Serve(const std::string & sHeader)
+{
+    std::string sQuery;
+    if(!ReadRequest(sHeader,sQuery))
+    {
+        m_bCloseWhenSent = true;
+        return false;
+    }
 
+    if(!MakeJSON(sQuery))
+    {
+        if(!sQuery.empty())
+        {
+            HandlePoke(sQuery);
+        }
+
+        if(!MakeWebPage())
+        {
+            SendFailureHeader();
+        }
+        else
+        {
+            SendHeader();
+        }
+
+        SendWebPage();
+    }
 
-bool CHTTPConnection::ReadRequest()
+    return true;
+}
+
+
+bool CHTTPConnection::ReadRequest(const std::string & sHeader, std::string & sQuery)
 {    
 
     m_Request.Clean();
 
+    std::string sLines = sHeader;
+
     //first line should always be obvious
-    std::string sLine;
-    if(!ReadLine(sLine))
+    std::string sLine = MOOSChomp(sLines,"\r\n");
+    if(sLine.empty())
         return false;
 
     std::string sWhat = MOOSChomp(sLine," ");
     std::string sPath = MOOSChomp(sLine," ");
     std::string sProtocol = MOOSChomp(sLine," ");
 
-    //switch
-    //get the file name
-    //std::string sFile = sPath.substr(0,sPath.find_last_of("/"));
-
     //this is a Poke form
     std::string sFocus = MOOSChomp(sPath,"?");
-    std::string sFormContents = sPath;
+    sQuery = sPath;
 
     //are we looking for a single variable?
     MOOSRemoveChars(sFocus,"/");
@@ -189,26 +281,31 @@ bool CHTTPConnection::ReadRequest()
     {
         m_sFocusVariable.clear();
     }
-    
-
-    if(!sFormContents.empty())
-    {        
-        HandlePoke(sFormContents);
-    }
 
-    //now read in rest of header lines
-    do{
-        //fetch a line but with speed as we know a request is being formed
-        if(ReadLine(sLine))
+    //now the rest of header lines
+    while(!sLines.empty())
+    {
+        sLine = MOOSChomp(sLines,"\r\n");
+        if(!sLine.empty())
         {
-            //MOOSTrace("Rx: %s\n", sLine.c_str());
-            if(!sLine.empty())
-            {
-                //we are in a header so parse a line
-                m_Request.AddHeader(sLine);
-            }
+            //we are in a header so parse a line
+            m_Request.AddHeader(sLine);
         }
-    }while(sLine.size());
+    }
+
+    //anything sent with the request is of no interest
+    std::list<std::string> Values;
+    if(m_Request.GetHeader("Content-Length",Values) && !Values.empty())
+    {
+        m_nToDiscard = atoi(Values.front().c_str());
+    }
+
+    //HTTP/1.0 clients have to ask to keep the connection
+    if(!m_Request.IsKeepAlive() ||
+            (MOOSStrCmp(sProtocol,"HTTP/1.0") && !m_Request.HasProperty("CONNECTION","keep-alive")))
+    {
+        m_bCloseWhenSent = true;
+    }
 
     return true;
 }
@@ -216,62 +313,17 @@ bool CHTTPConnection::ReadRequest()
 void CHTTPConnection::SendLine(std::string sLine)
 {
     sLine+="\r\n";
-    int nSent = m_pSocket->iSendMessage((void*)(sLine.c_str()),sLine.size());
-    if(nSent!=(int)sLine.size())
-	MOOSTrace("Failed tcp/ip send\n");
+    SendString(sLine);
 }
 
-void CHTTPConnection::SendString(std::string sLine)
+void CHTTPConnection::SendString(const std::string & sLine)
 {
-    m_pSocket->iSendMessage((void*)(sLine.c_str()),sLine.size());
-}
-
-
-
-bool CHTTPConnection::ReadLine(std::string & sLine)
-{    
-    sLine.clear();
-
-    try
-    {
-        char t = '\0';
-        while(1)
-        {
-            int nRead = m_pSocket->iRecieveMessage(&t,sizeof(t),0);
-            if(nRead==1)
-            {
-                if(t!='\r')
-                {
-                    sLine+=t;
-                }
-                else
-                {
-                    break;
-                }
-            }
-            if(nRead==0)
-            {
-                //time out or graceful closure
-                return false;
-            }
-        }
-
-    }
-    catch(XPCException & e)
-    {
-        UNUSED_PARAMETER(e);
-        MOOSAssert(0);
-    }
-    
-    MOOSRemoveChars(sLine,"\r\n");
-
-    //MOOSTrace(sLine+"\n");
-    return true;
+    m_sOutput+=sLine;
 }
 
 bool CHTTPConnection::SendWebPage()
 {   
-   SendLine(m_sWebPage);
+   SendString(m_sWebPage);
 
    return true;
 }
@@ -367,12 +419,20 @@ bool CHTTPConnection::MakeWebPage()
 
     try
     {
-        if(!m_pMOOSComms->IsConnected())
-            throw CMOOSException("No DB Connection");
-
         MOOSMSG_LIST MsgList;
-        if(!m_pMOOSComms->ServerRequest("ALL",MsgList))
-            throw CMOOSException("Failed ServerRequest");
+        if(m_pDB!=NULL)
+        {
+            //straight from the horse's mouth
+            m_pDB->GetVariables(MsgList);
+        }
+        else
+        {
+            if(!m_pMOOSComms->IsConnected())
+                throw CMOOSException("No DB Connection");
+
+            if(!m_pMOOSComms->ServerRequest("ALL",MsgList))
+                throw CMOOSException("Failed ServerRequest");
+        }
 
         
         std::ostringstream wp;
@@ -582,25 +642,93 @@ bool CHTTPConnection::BuildFullDBWebPageContents( std::ostringstream & wp,MOOSMS
 }
 
 
+bool CHTTPConnection::MakeJSON(const std::string & sQuery)
+{
+    if(!MOOSStrCmp(m_sFocusVariable,"json"))
+        return false;
+
+    if(m_pDB==NULL)
+    {
+        //only the DB itself keeps track of what has changed
+        SendFailureHeader();
+        SendWebPage();
+        return true;
+    }
+
+    //which changes does the client already know about?
+    uint64_t nSince = 0;
+    std::string sFields = sQuery;
+    while(!sFields.empty())
+    {
+        std::string sValue = MOOSChomp(sFields,"&");
+        std::string sToken = MOOSChomp(sValue,"=");
+        if(MOOSStrCmp(sToken,"since"))
+        {
+            std::istringstream ss(sValue);
+            ss>>nSince;
+        }
+    }
+
+    //nothing has changed since they last asked
+    std::string sETag = MOOSFormat("\"%llu\"",(unsigned long long)m_pDB->GetLastChange());
+    if(m_Request.HasProperty("If-None-Match",sETag))
+    {
+        SendLine("HTTP/1.1 304 Not Modified");
+        SendLine("ETag: "+sETag);
+        SendLine("");
+        return true;
+    }
+
+    uint64_t nChange = 0;
+    m_pDB->GetVariablesAsJSON(nSince,m_sWebPage,nChange);
+
+    SendHeader("application/json",
+               MOOSFormat("ETag: \"%llu\"\r\nCache-Control: no-cache\r\n",
+                          (unsigned long long)nChange));
+    SendWebPage();
+
+    return true;
+}
+
+
 bool CHTTPConnection::SendFailureHeader()
 {
+    m_sWebPage = "Not Found";
+
     SendLine("HTTP/1.1 404 Not Found");
-    SendLine("NONE");
+    SendLine("Content-Type: text/plain");
+    SendLine(MOOSFormat("Content-Length: %lu",(unsigned long)m_sWebPage.size()));
+    if(m_bCloseWhenSent)
+        SendLine("Connection: close");
     SendLine("");
     
     return true;
 }
 
-bool CHTTPConnection::SendHeader()
+bool CHTTPConnection::SendHeader(const std::string & sContentType,
+                                 const std::string & sExtraHeaders)
 {
       SendLine("HTTP/1.1 200 OK");
-      SendLine("Content-Type: text/html; charset=ISO-8859-1");
-      SendLine(MOOSFormat("Content-Length: %lu",m_sWebPage.size()));
+      SendLine("Content-Type: "+sContentType);
+      SendLine(MOOSFormat("Content-Length: %lu",(unsigned long)m_sWebPage.size()));
+      SendString(sExtraHeaders);
+      if(m_bCloseWhenSent)
+          SendLine("Connection: close");
       SendLine("");
 
       return true;
 }
-bool CHTTPConnection::HasCompleted()
+
+bool CHTTPConnection::HasCompleted(double dfIdleTimeOut)
 {
-    return !m_ServeThread.IsThreadRunning();
+    if(m_bClosed)
+        return true;
+
+    double dfIdle = MOOSLocalTime()-m_dfLastActivity;
+
+    //having said our piece we don't wait long for them to hang up
+    if(m_bCloseWhenSent && !HasPendingReply())
+        return dfIdle>1.0;
+
+    return dfIdle>dfIdleTimeOut;
 }
@@ -40,7 +40,9 @@
 #include "MOOS/libMOOS/Utils/ConsoleColours.h"
 #include "MOOS/libMOOS/DB/MOOSDBLogger.h"
 #include "MOOS/libMOOS/Utils/MOOSScopedPtr.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
 #include "MOOS/libMOOS/DB/MOOSDB.h"
+#include "MOOS/libMOOS/Comms/PeerToPeer.h"
 
 #include "assert.h"
 #include <iostream>
@@ -48,6 +50,7 @@
 #include <sstream>
 #include <vector>
 #include <iterator>
+#include <algorithm>
 using namespace std;
 
 //////////////////////////////////////////////////////////////////////
@@ -63,6 +66,13 @@ bool CMOOSDB::OnRxPktCallBack(const std::string & sWho,MOOSMSG_LIST & MsgListRx,
     return pMe->OnRxPkt(sWho,MsgListRx,MsgListTx);
 }
 
+bool CMOOSDB::OnRxPktViewCallBack(const std::string & sWho,MOOS::MsgViewVector & RxViews,MOOSMSG_LIST & MsgListTx, void * pParam)
+{
+    CMOOSDB* pMe = (CMOOSDB*)(pParam);
+
+    return pMe->OnRxPkt(sWho,RxViews,MsgListTx);
+}
+
 bool CMOOSDB::OnFetchAllMailCallBack(const std::string & sWho,MOOSMSG_LIST & MsgListTx, void * pParam)
 {
     CMOOSDB* pMe = (CMOOSDB*)(pParam);
@@ -70,6 +80,20 @@ bool CMOOSDB::OnFetchAllMailCallBack(const std::string & sWho,MOOSMSG_LIST & Msg
     return pMe->OnFetchAllMail(sWho,MsgListTx);
 }
 
+bool CMOOSDB::OnFetchAllSharedMailCallBack(const std::string & sWho,MOOSMSG_PTR_LIST & SharedListTx, void * pParam)
+{
+    CMOOSDB* pMe = (CMOOSDB*)(pParam);
+
+    return pMe->OnFetchAllSharedMail(sWho,SharedListTx);
+}
+
+bool CMOOSDB::OnFetchClientsWithMailCallBack(STRING_LIST & Clients, void * pParam)
+{
+    CMOOSDB* pMe = (CMOOSDB*)(pParam);
+
+    return pMe->OnFetchClientsWithMail(Clients);
+}
+
 bool CMOOSDB::OnDisconnectCallBack(string & sClient, void * pParam)
 {
     CMOOSDB* pMe = (CMOOSDB*)(pParam);
@@ -91,12 +115,19 @@ CMOOSDB::CMOOSDB()
     m_sDBName = "MOOSDB#1";
     m_sCommunityName = "#1";
     m_dfSummaryTime = MOOS::Time();
+    m_bVarSummaryDeltas = false;
+    m_nRWSummaryChanges = -1;
+    m_nLastChange = 0;
+    m_nJSONSnapshotChange = 0;
     
     //her is the default port to listen on
     m_nPort = DEFAULT_MOOS_SERVER_PORT;
     
     m_bQuiet = false;
 
+    //to start with all variables live in one place
+    SetDispatchThreads(1);
+
     //make our own variable called DB_TIME
     {
         CMOOSDBVar NewVar("DB_TIME");
@@ -105,7 +136,7 @@ CMOOSDB::CMOOSDB()
         NewVar.m_sWhoChangedMe = m_sDBName;
         NewVar.m_sOriginatingCommunity = m_sCommunityName;
         NewVar.m_dfWrittenTime = HPMOOSTime();
-        m_VarMap["DB_TIME"] = NewVar;
+        ShardFor("DB_TIME").Vars["DB_TIME"] = NewVar;
     }
     
     //make our own variable called DB_TIME
@@ -116,7 +147,7 @@ CMOOSDB::CMOOSDB()
         NewVar.m_sWhoChangedMe = m_sDBName;
         NewVar.m_sOriginatingCommunity = m_sCommunityName;
         NewVar.m_dfWrittenTime = HPMOOSTime();
-        m_VarMap["DB_UPTIME"] = NewVar;
+        ShardFor("DB_UPTIME").Vars["DB_UPTIME"] = NewVar;
     }
 
     //make our own variable called DB_CLIENTS
@@ -127,7 +158,7 @@ CMOOSDB::CMOOSDB()
         NewVar.m_sWhoChangedMe = m_sDBName;
         NewVar.m_sOriginatingCommunity = m_sCommunityName;
         NewVar.m_dfWrittenTime = HPMOOSTime();
-        m_VarMap["DB_CLIENTS"] = NewVar;
+        ShardFor("DB_CLIENTS").Vars["DB_CLIENTS"] = NewVar;
     }
     
     //make our own variable called DB_EVENT
@@ -138,7 +169,7 @@ CMOOSDB::CMOOSDB()
         NewVar.m_sWhoChangedMe = m_sDBName;
         NewVar.m_sOriginatingCommunity = m_sCommunityName;
         NewVar.m_dfWrittenTime = MOOSTime();
-        m_VarMap["DB_EVENT"] = NewVar;
+        ShardFor("DB_EVENT").Vars["DB_EVENT"] = NewVar;
     }
 
     //make our own variable called DB_VARSUMMARY
@@ -149,7 +180,7 @@ CMOOSDB::CMOOSDB()
         NewVar.m_sWhoChangedMe = m_sDBName;
         NewVar.m_sOriginatingCommunity = m_sCommunityName;
         NewVar.m_dfWrittenTime = MOOSTime();
-        m_VarMap["DB_VARSUMMARY"] = NewVar;
+        ShardFor("DB_VARSUMMARY").Vars["DB_VARSUMMARY"] = NewVar;
     }
 
 
@@ -161,7 +192,7 @@ CMOOSDB::CMOOSDB()
         NewVar.m_sWhoChangedMe = m_sDBName;
         NewVar.m_sOriginatingCommunity = m_sCommunityName;
         NewVar.m_dfWrittenTime = MOOSTime();
-        m_VarMap["DB_QOS"] = NewVar;
+        ShardFor("DB_QOS").Vars["DB_QOS"] = NewVar;
     }
 
     //make our own variable called DB_RWSUMMARY
@@ -172,7 +203,15 @@ CMOOSDB::CMOOSDB()
         NewVar.m_sWhoChangedMe = m_sDBName;
         NewVar.m_sOriginatingCommunity = m_sCommunityName;
         NewVar.m_dfWrittenTime = MOOSTime();
-        m_VarMap["DB_RWSUMMARY"] = NewVar;
+        ShardFor("DB_RWSUMMARY").Vars["DB_RWSUMMARY"] = NewVar;
+    }
+
+    //all of which start off with stale summary rows
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        DBVAR_MAP::iterator p;
+        for(p = m_Shards[i]->Vars.begin();p!=m_Shards[i]->Vars.end();++p)
+            m_Shards[i]->SummaryDirty.push_back(p->first);
     }
 
 
@@ -191,8 +230,255 @@ CMOOSDB::CMOOSDB()
 
 CMOOSDB::~CMOOSDB()
 {
+    //the web server looks at our variables so goes first
+    m_pWebServer.reset();
+
     if(m_pCommServer.get()!=NULL)
         m_pCommServer->Stop();
+
+    StopShards();
+
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+        delete m_Shards[i];
+}
+
+bool CMOOSDB::SetDispatchThreads(unsigned int nThreads)
+{
+    if(nThreads==0)
+        nThreads = 1;
+
+    StopShards();
+
+    //collect up everything we already know about...
+    DBVAR_MAP AllVars;
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        AllVars.insert(m_Shards[i]->Vars.begin(),m_Shards[i]->Vars.end());
+        delete m_Shards[i];
+    }
+    m_Shards.clear();
+
+    for(unsigned int i = 0;i<nThreads;i++)
+    {
+        Shard * pShard = new Shard;
+        pShard->pDB = this;
+        m_Shards.push_back(pShard);
+    }
+
+    //...and redistribute it (along with which summary rows are stale)
+    DBVAR_MAP::iterator p;
+    for(p = AllVars.begin();p!=AllVars.end();++p)
+    {
+        CMOOSDBVar & rVar = ShardFor(p->first).Vars.insert(*p).first->second;
+        if(rVar.m_nSummaryWrites!=rVar.m_nWrittenTo)
+            ShardFor(p->first).SummaryDirty.push_back(p->first);
+    }
+
+    if(IsShardedDispatch())
+    {
+        for(unsigned int i = 0;i<m_Shards.size();i++)
+        {
+            m_Shards[i]->Worker.Initialise(ShardWorkerEntry,m_Shards[i]);
+            m_Shards[i]->Worker.Name(MOOSFormat("DBShard%d",i));
+            if(!m_Shards[i]->Worker.Start())
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void CMOOSDB::StopShards()
+{
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+        m_Shards[i]->Worker.Stop();
+}
+
+unsigned int CMOOSDB::ShardIndex(const std::string & sKey) const
+{
+    if(m_Shards.size()==1)
+        return 0;
+
+    //FNV-1a
+    unsigned int nHash = 2166136261u;
+    for(std::string::const_iterator q = sKey.begin();q!=sKey.end();++q)
+    {
+        nHash ^= (unsigned char)(*q);
+        nHash *= 16777619u;
+    }
+    return nHash%m_Shards.size();
+}
+
+CMOOSDB::Shard & CMOOSDB::ShardFor(const std::string & sKey)
+{
+    return *m_Shards[ShardIndex(sKey)];
+}
+
+void CMOOSDB::FindVarsMatching(Shard & rShard,
+        const MOOS::CompiledGlob & Var,
+        const MOOS::CompiledGlob & App,
+        std::vector<std::string> & Names)
+{
+    //the variables are kept in name order so only those starting
+    //with the literal part of the pattern need looking at
+    const std::string & sPrefix = Var.Prefix();
+    DBVAR_MAP::iterator q;
+    for(q = rShard.Vars.lower_bound(sPrefix);q!=rShard.Vars.end();++q)
+    {
+        if(q->first.compare(0,sPrefix.size(),sPrefix)!=0)
+            break;
+
+        if(Var.Matches(q->first) && App.Matches(q->second.m_sWhoChangedMe))
+            Names.push_back(q->first);
+
+        if(Var.IsLiteral())
+            break;
+    }
+}
+
+bool CMOOSDB::IsKeyedMsg(char cMsgType) const
+{
+    return cMsgType==MOOS_NOTIFY ||
+            cMsgType==MOOS_REGISTER ||
+            cMsgType==MOOS_UNREGISTER;
+}
+
+bool CMOOSDB::ShardWorkerEntry(void * pParam)
+{
+    Shard * pShard = static_cast<Shard*>(pParam);
+    return pShard->pDB->ShardWorkerLoop(pShard);
+}
+
+/** each shard worker sits here taking keyed messages out of its mailbox*/
+bool CMOOSDB::ShardWorkerLoop(Shard * pShard)
+{
+    MOOS::COMPACT_MSG_LIST Work;
+
+    //one message is reused for everything so its strings keep their storage
+    CMOOSMsg Msg;
+    while(!pShard->Worker.IsQuitRequested())
+    {
+        if(pShard->MailBox.IsEmpty() && !pShard->MailBox.WaitForPush(100))
+            continue;
+
+        Work.clear();
+        pShard->MailBox.AppendToOtherInConstantTime(Work);
+        if(Work.empty())
+            continue;
+
+        {
+            MOOS::ScopedLock L(pShard->Lock);
+            MOOS::COMPACT_MSG_LIST::iterator p;
+            for(p = Work.begin();p!=Work.end();++p)
+            {
+                if(p->IsType(MOOS_NULL_MSG))
+                {
+                    OnShardBarrier(*pShard,p->m_nID);
+                    continue;
+                }
+                p->ToMsg(Msg);
+                ProcessShardMsg(*pShard,Msg);
+            }
+        }
+
+        //we have been working away from the comms thread so
+        //it needs telling there may be mail to send
+        if(m_pCommServer.get()!=NULL)
+            m_pCommServer->RequestMailDelivery();
+    }
+    return true;
+}
+
+/** hand batches of keyed messages (one per shard) to their shards*/
+void CMOOSDB::DispatchToShards(std::vector<MOOS::COMPACT_MSG_LIST> & Batches)
+{
+    for(unsigned int i = 0;i<Batches.size();i++)
+    {
+        if(!Batches[i].empty())
+            m_Shards[i]->MailBox.AppendToMeInConstantTime(Batches[i]);
+    }
+}
+
+void CMOOSDB::WaitForShards()
+{
+    //a numbered barrier goes to the back of every shard's mail box...
+    std::vector<int> Barriers(m_Shards.size());
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        Shard & rShard = *m_Shards[i];
+        MOOS::CompactMsg Barrier;
+        Barrier.m_cMsgType = MOOS_NULL_MSG;
+
+        //numbering and pushing together keeps the numbers in queue order
+        MOOS::ScopedLock L(rShard.BarrierLock);
+        Barrier.m_nID = Barriers[i] = ++rShard.nBarriersSent;
+        rShard.MailBox.Push(Barrier);
+    }
+
+    //...and once each has got that far everything before it is done
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        Shard & rShard = *m_Shards[i];
+        while(rShard.nBarrierPassed.value()<Barriers[i] && rShard.Worker.IsThreadRunning())
+        {
+#if __cplusplus >= 201103L
+            std::unique_lock<std::mutex> L(m_BarrierMutex);
+            if(rShard.nBarrierPassed.value()<Barriers[i])
+                m_BarrierPassed.wait_for(L,std::chrono::milliseconds(100));
+#else
+            MOOSPause(1);
+#endif
+        }
+    }
+}
+
+void CMOOSDB::OnShardBarrier(Shard & rShard, int nBarrier)
+{
+#if __cplusplus >= 201103L
+    std::lock_guard<std::mutex> L(m_BarrierMutex);
+    rShard.nBarrierPassed = nBarrier;
+    m_BarrierPassed.notify_all();
+#else
+    rShard.nBarrierPassed = nBarrier;
+#endif
+}
+
+bool CMOOSDB::ProcessShardMsg(Shard & rShard, CMOOSMsg & Msg)
+{
+    switch(Msg.m_cMsgType)
+    {
+    case MOOS_NOTIFY:
+        return DoNotify(Msg);
+    case MOOS_REGISTER:
+        return DoRegister(Msg);
+    case MOOS_UNREGISTER:
+        return DoUnRegister(Msg);
+    case MOOS_TERMINATE_CONNECTION:
+        RemoveClientFromShard(rShard,Msg.m_sSrc);
+        return true;
+    }
+    return true;
+}
+
+/** forget all subscriptions of a departing client to variables in the
+given shard (whose lock must be held) and any mail waiting for it*/
+void CMOOSDB::RemoveClientFromShard(Shard & rShard, std::string & sClient)
+{
+    DBVAR_MAP::iterator p;
+    for(p=rShard.Vars.begin();p!=rShard.Vars.end();++p)
+    {
+        CMOOSDBVar  & rVar = p->second;
+
+        rVar.RemoveSubscriber(sClient);
+    }
+    ++m_RWSummaryChanges;
+
+    unsigned int nClientID = ClientID(sClient);
+    if(nClientID<rShard.ClientMail.size())
+    {
+        rShard.ClientMail[nClientID].clear();
+        rShard.LatestOnlySlots[nClientID].clear();
+    }
 }
 
 
@@ -224,7 +510,15 @@ void PrintHelpAndExit()
 
 	std::cout<<"-d    (--dns)                      run with dns lookup\n";
 	std::cout<<"-s    (--single_threaded)          run as a single thread (legacy mode)\n";
+	std::cout<<"--epoll_loops=<unsigned int>       serve clients from this many epoll loops not a thread each (linux)\n";
 	std::cout<<"-b    (--moos_boost)               boost priority of communications\n";
+	std::cout<<"--dispatch_threads=<unsigned int>  shard variables across this many threads\n";
+	std::cout<<"                                   (changes keep their order per variable and\n";
+	std::cout<<"                                   are done before a client's next request)\n";
+	std::cout<<"--mail_batch_window=<positive_float>  push mail to clients at most this often in ms\n";
+	std::cout<<"--compression_threshold=<unsigned int>  compress packets to clients bigger than this (bytes)\n";
+	std::cout<<"--var_summary_deltas               also publish changed DB_VARSUMMARY rows as DB_VARSUMMARY_DELTA\n";
+	std::cout<<"--shared_memory                    let local clients which ask talk through shared memory\n";
 	std::cout<<"--moos_timeout=<positive_float>    specify client timeout\n";
 	std::cout<<"--response=<string-list>           specify tolerable client latencies in ms\n";
 	std::cout<<"--warning_latency=<positive_float>    specify latency above which warning is issued in ms\n";
@@ -237,6 +531,7 @@ void PrintHelpAndExit()
 
 //#ifdef MOOSDB_HAS_WEBSERVER
 	std::cout<<"--webserver_port=<positive_integer> run webserver on given port\n";
+	std::cout<<"                                   (variables as JSON at /json, changes only at /json?since=N)\n";
 //#endif
 	std::cout<<"--help                             print help and exit\n";
 	std::cout<<"\nexample:\n";
@@ -323,7 +618,7 @@ bool CMOOSDB::Run(int argc,  char * argv[] )
 
 	//if either the mission file or command line have set a webserver port then launch one
 	if(nWebServerPort>0)
-		m_pWebServer.reset(new CMOOSDBHTTPServer(GetDBPort(), nWebServerPort));
+		m_pWebServer.reset(new CMOOSDBHTTPServer(GetDBPort(), nWebServerPort, this));
 
 	double dfClientTimeout = 5.0;
 	m_MissionReader.GetValue("ClientTimeout",dfClientTimeout);
@@ -371,6 +666,44 @@ bool CMOOSDB::Run(int argc,  char * argv[] )
     //are we being asked to be old skool and use a single thread?
     bool bSingleThreaded = P.GetFlag("-s","--single_threaded");
 
+    ///////////////////////////////////////////////////////////
+    //or should clients share a few epoll loops rather than
+    //having two threads each?
+    unsigned int nEpollLoops = 0;
+    m_MissionReader.GetValue("EpollLoops",nEpollLoops);
+    P.GetVariable("--epoll_loops",nEpollLoops);
+
+    ///////////////////////////////////////////////////////////
+    //how many threads should work on the variable store?
+    unsigned int nDispatchThreads = 1;
+    m_MissionReader.GetValue("DispatchThreads",nDispatchThreads);
+    P.GetVariable("--dispatch_threads",nDispatchThreads);
+
+    ///////////////////////////////////////////////////////////
+    //should mail pushed to clients be gathered up for a while?
+    double dfMailBatchWindowMS = 0.0;
+    m_MissionReader.GetValue("MailBatchWindow",dfMailBatchWindowMS);
+    P.GetVariable("--mail_batch_window",dfMailBatchWindowMS);
+
+    ///////////////////////////////////////////////////////////
+    //should big packets to clients be compressed?
+    unsigned int nCompressionThreshold = 0;
+    m_MissionReader.GetValue("CompressionThreshold",nCompressionThreshold);
+    P.GetVariable("--compression_threshold",nCompressionThreshold);
+
+    ///////////////////////////////////////////////////////////
+    //can clients on this machine talk to us through shared memory?
+    bool bSharedMemory = false;
+    m_MissionReader.GetValue("SharedMemory",bSharedMemory);
+    if(P.GetFlag("--shared_memory"))
+        bSharedMemory = true;
+
+    ///////////////////////////////////////////////////////////
+    //should the changes to DB_VARSUMMARY be published by themselves?
+    m_MissionReader.GetValue("VarSummaryDeltas",m_bVarSummaryDeltas);
+    if(P.GetFlag("--var_summary_deltas"))
+        m_bVarSummaryDeltas = true;
+
 
     //is the community name being specified on the cli?
 	unsigned int nAuditPort=9020;
@@ -425,21 +758,48 @@ bool CMOOSDB::Run(int argc,  char * argv[] )
         std::cout<<MOOS::ConsoleColours::yellow()<<"warning : running in single threaded mode performance will be affected by poor networks\n"<<MOOS::ConsoleColours::reset();
         m_pCommServer.reset(new CMOOSCommServer);
     }
+    else if(nEpollLoops>0)
+    {
+#ifdef __linux__
+        std::cout<<"clients served by "<<nEpollLoops<<" epoll event loop(s)\n";
+        m_pCommServer.reset(new MOOS::EpollCommServer(nEpollLoops));
+#else
+        std::cout<<MOOS::ConsoleColours::yellow()<<"warning : epoll is not available on this platform - using a thread per client\n"<<MOOS::ConsoleColours::reset();
+        m_pCommServer.reset(new MOOS::ThreadedCommServer);
+#endif
+    }
     else
     {
         //std::cerr<<MOOS::ConsoleColours::green()<<"running in multi-threaded mode\n"<<MOOS::ConsoleColours::reset();
         m_pCommServer.reset(new MOOS::ThreadedCommServer);
     }
 
+    if(nDispatchThreads>1)
+    {
+        std::cout<<"variable store split across "<<nDispatchThreads<<" dispatch threads\n";
+        SetDispatchThreads(nDispatchThreads);
+    }
+
     m_pCommServer->SetQuiet(m_bQuiet);
 
     m_pCommServer->SetOnRxCallBack(OnRxPktCallBack,this);
 
+    m_pCommServer->SetOnRxViewCallBack(OnRxPktViewCallBack,this);
+
     m_pCommServer->SetOnDisconnectCallBack(OnDisconnectCallBack,this);
 
     m_pCommServer->SetOnConnectCallBack(OnConnectCallBack,this);
 
     m_pCommServer->SetOnFetchAllMailCallBack(OnFetchAllMailCallBack,this);
+    m_pCommServer->SetOnFetchAllSharedMailCallBack(OnFetchAllSharedMailCallBack,this);
+
+    m_pCommServer->SetOnFetchClientsWithMailCallBack(OnFetchClientsWithMailCallBack,this);
+
+    m_pCommServer->SetMailBatchWindowMS(dfMailBatchWindowMS);
+
+    m_pCommServer->SetCompressionThreshold(nCompressionThreshold);
+
+    m_pCommServer->EnableSharedMemory(bSharedMemory);
 
     m_pCommServer->SetClientTimeout(dfClientTimeout);
 
@@ -518,6 +878,28 @@ void PrintCollection( const T & collection, ostream & out, const std::string & d
 }
 
 void CMOOSDB::UpdateReadWriteSummaryVar()
+{
+    STRING_LIST Clients;
+    m_pCommServer->GetClientNames(Clients);
+
+    //if nobody has (un)subscribed or started writing something new
+    //the last summary still holds
+    int nChanges = m_RWSummaryChanges.value();
+    if(nChanges!=m_nRWSummaryChanges || Clients!=m_RWSummaryClients)
+    {
+        m_nRWSummaryChanges = nChanges;
+        m_RWSummaryClients = Clients;
+        m_sRWSummary = MakeReadWriteSummary(Clients);
+    }
+
+    CMOOSMsg DBS(MOOS_NOTIFY,"DB_RWSUMMARY",m_sRWSummary);
+    DBS.m_sSrc = m_sDBName;
+    DBS.m_sOriginatingCommunity = m_sCommunityName;
+    OnNotify(DBS);
+
+}
+
+std::string CMOOSDB::MakeReadWriteSummary(STRING_LIST & Clients)
 {
 
     std::map<std::string,std::list<std::string> > Pub;
@@ -525,23 +907,26 @@ void CMOOSDB::UpdateReadWriteSummaryVar()
 
     DBVAR_MAP::iterator p;
 
-    for(p=m_VarMap.begin();p!=m_VarMap.end();++p)
+    for(unsigned int i = 0;i<m_Shards.size();i++)
     {
-        CMOOSDBVar  & rVar = p->second;
-        STRING_SET::iterator w;
-        REGISTER_INFO_MAP::iterator v;
+        MOOS::ScopedLock L(m_Shards[i]->Lock);
+        DBVAR_MAP & rVars = m_Shards[i]->Vars;
+        for(p=rVars.begin();p!=rVars.end();++p)
+        {
+            CMOOSDBVar  & rVar = p->second;
+            STRING_SET::iterator w;
+            REGISTER_INFO_VECTOR::iterator v;
 
-        std::stringstream ss;
-        for(v = rVar.m_Subscribers.begin();v!=rVar.m_Subscribers.end();++v)
-            Sub[v->second.m_sClientName].push_back(rVar.m_sName);
+            std::stringstream ss;
+            for(v = rVar.m_Subscribers.begin();v!=rVar.m_Subscribers.end();++v)
+                Sub[v->m_sClientName].push_back(rVar.m_sName);
 
-        for(w = rVar.m_Writers.begin();w!=rVar.m_Writers.end();++w)
-            Pub[*w].push_back(rVar.m_sName);
+            for(w = rVar.m_Writers.begin();w!=rVar.m_Writers.end();++w)
+                Pub[*w].push_back(rVar.m_sName);
+        }
     }
 
 
-    STRING_LIST Clients;
-    m_pCommServer->GetClientNames(Clients);
     STRING_LIST::iterator q;
 
     std::ostringstream ss;
@@ -557,11 +942,7 @@ void CMOOSDB::UpdateReadWriteSummaryVar()
 
     }
 
-    CMOOSMsg DBS(MOOS_NOTIFY,"DB_RWSUMMARY",ss.str());
-    DBS.m_sSrc = m_sDBName;
-    DBS.m_sOriginatingCommunity = m_sCommunityName;
-    OnNotify(DBS);
-
+    return ss.str();
 }
 
 void CMOOSDB::UpdateDBTimeVars()
@@ -586,10 +967,78 @@ bool CMOOSDB::OnRxPkt(const std::string & sClient,MOOSMSG_LIST & MsgListRx,MOOSM
     
     for(p = MsgListRx.begin();p!=MsgListRx.end();++p)
     {
+        //anything not handed to a shard must wait for what the
+        //shards have already been given by this client
+        if(IsShardedDispatch() && !IsKeyedMsg(p->GetType()) &&
+                !p->IsType(MOOS_TIMING) && !p->IsType(MOOS_NULL_MSG))
+            WaitForShards();
+
         ProcessMsg(*p,MsgListTx);
     }
     
+    return OnRxPktComplete(sClient,!MsgListRx.empty(),MsgListTx);
+}
+
+/**this will be called each time a new packet is recieved by a server
+which can hand us views of its contents*/
+bool CMOOSDB::OnRxPkt(const std::string & sClient,MOOS::MsgViewVector & RxViews,MOOSMSG_LIST & MsgListTx)
+{
+    MOOS::MsgViewVector::const_iterator p;
+
+    if(IsShardedDispatch())
+    {
+        //sort keyed messages into batches for the shard workers
+        //and do everything else here and now - but only once the
+        //shards have dealt with what came before it
+        std::vector<MOOS::COMPACT_MSG_LIST> Batches(m_Shards.size());
+        std::string sKey;
+        for(p = RxViews.begin();p!=RxViews.end();++p)
+        {
+            if(IsKeyedMsg(p->GetType()))
+            {
+                p->GetKey().AssignTo(sKey);
+                Batches[ShardIndex(sKey)].push_back(MOOS::CompactMsg(*p));
+            }
+            else
+            {
+                if(!p->IsType(MOOS_TIMING) && !p->IsType(MOOS_NULL_MSG))
+                {
+                    DispatchToShards(Batches);
+                    WaitForShards();
+                }
+                CMOOSMsg MsgRx;
+                p->ToMsg(MsgRx);
+                ProcessMsg(MsgRx,MsgListTx);
+            }
+        }
+        DispatchToShards(Batches);
+    }
+    else
+    {
+        for(p = RxViews.begin();p!=RxViews.end();++p)
+        {
+            if(p->IsType(MOOS_NOTIFY))
+            {
+                //the common case - try not to copy anything
+                OnNotify(*p);
+            }
+            else
+            {
+                CMOOSMsg MsgRx;
+                p->ToMsg(MsgRx);
+                ProcessMsg(MsgRx,MsgListTx);
+            }
+        }
+    }
+
+    //the server collects our mail for this client via OnFetchAllSharedMail
+    return OnRxPktComplete(sClient,false,MsgListTx);
+}
 
+/** housekeeping to be done at the end of every packet and collection
+of mail to be returned to the calling client*/
+bool CMOOSDB::OnRxPktComplete(const std::string & sClient, bool bCollectMail, MOOSMSG_LIST & MsgListTx)
+{
     double dfNow = MOOS::Time();
     if(dfNow-m_dfSummaryTime>2.0)
     {
@@ -611,61 +1060,96 @@ bool CMOOSDB::OnRxPkt(const std::string & sClient,MOOSMSG_LIST & MsgListRx,MOOSM
         UpdateReadWriteSummaryVar();
     }
 
-    if(!MsgListRx.empty())
+    if(bCollectMail)
     {
-        
         //now we fill in the packet with our replies to THIS CLIENT
-        MOOSMSG_LIST_STRING_MAP::iterator q = m_HeldMailMap.find(sClient);
-        
-        if(q==m_HeldMailMap.end())
-        {
-            
-            //CMOOSMsg & rMsg = MsgListRx.front();
-            //there is no mail waiting to be sent to this client
-            //should only happen at start up...
-            //string sClient = MsgListRx.front().m_sSrc;
-            
-            MOOSMSG_LIST NewList;
-            
-            m_HeldMailMap[sClient] = NewList;
-            
-            q = m_HeldMailMap.find(sClient);
-            
-            assert(q!=m_HeldMailMap.end());
-        }
-                
-        if(q!=m_HeldMailMap.end())
-        {
-            //MOOSTrace("%f OnRxPkt %d messages held for client %s\n",MOOSTime(),q->second.size(),sClient.c_str());
-
-            if(!q->second.empty())
-            {
-                //copy all the held mail to MsgListTx
-                MsgListTx.splice(MsgListTx.begin(),
-                		q->second,
-                		q->second.begin(),
-                		q->second.end());
-            }
-        }
+        return OnFetchAllMail(sClient,MsgListTx);
     }
     
     return true;
 }
 
+/** hand over (copies of) all the mail held for a client*/
 bool CMOOSDB::OnFetchAllMail(const std::string & sWho,MOOSMSG_LIST & MsgListTx)
 {
-	MOOSMSG_LIST_STRING_MAP::iterator q = m_HeldMailMap.find(sWho);
-	if(q!=m_HeldMailMap.end())
-	{
-		if(!q->second.empty())
-		{
-            MsgListTx.splice(MsgListTx.begin(),
-            		q->second,
-            		q->second.begin(),
-            		q->second.end());
-		}
-	}
-	return true;
+    MOOSMSG_PTR_LIST SharedListTx;
+    OnFetchAllSharedMail(sWho,SharedListTx);
+
+    MOOSMSG_LIST Held;
+    MOOSMSG_PTR_LIST::iterator q;
+    for(q = SharedListTx.begin();q!=SharedListTx.end();++q)
+        Held.push_back(**q);
+
+    MsgListTx.splice(MsgListTx.begin(),Held);
+    return true;
+}
+
+/** hand over all the mail held for a client - the messages themselves
+may also be in the mail boxes of other clients and must not be altered*/
+static bool StampedEarlier(const std::pair<uint64_t,MOOSMSG_PTR> & A,
+        const std::pair<uint64_t,MOOSMSG_PTR> & B)
+{
+    return A.first<B.first;
+}
+
+bool CMOOSDB::OnFetchAllSharedMail(const std::string & sWho,MOOSMSG_PTR_LIST & SharedListTx)
+{
+    unsigned int nClientID = ClientID(sWho);
+
+    //each shard's mail is in the order it was posted so merging by
+    //stamp gives the order across the lot
+    STAMPED_MAIL Mail;
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        Shard & rShard = *m_Shards[i];
+        MOOS::ScopedLock L(rShard.Lock);
+        if(nClientID>=rShard.ClientMail.size() || rShard.ClientMail[nClientID].empty())
+            continue;
+
+        STAMPED_MAIL & rBox = rShard.ClientMail[nClientID];
+        if(Mail.empty())
+            Mail.splice(Mail.end(),rBox);
+        else
+            Mail.merge(rBox,StampedEarlier);
+        rShard.LatestOnlySlots[nClientID].clear();
+    }
+
+    STAMPED_MAIL::iterator q;
+    for(q = Mail.begin();q!=Mail.end();++q)
+        SharedListTx.push_back(q->second);
+
+    return true;
+}
+
+/** name the clients whose mail boxes have been added to since we were last
+asked (and which have not since been emptied)*/
+bool CMOOSDB::OnFetchClientsWithMail(STRING_LIST & Clients)
+{
+    std::vector<unsigned int> IDs;
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        Shard & rShard = *m_Shards[i];
+        MOOS::ScopedLock L(rShard.Lock);
+        std::vector<unsigned int>::iterator q;
+        for(q = rShard.ClientsWithMail.begin();q!=rShard.ClientsWithMail.end();++q)
+        {
+            rShard.HasNewMail[*q] = false;
+            if(!rShard.ClientMail[*q].empty())
+                IDs.push_back(*q);
+        }
+        rShard.ClientsWithMail.clear();
+    }
+
+    //a client may have mail from more than one shard
+    std::sort(IDs.begin(),IDs.end());
+    IDs.erase(std::unique(IDs.begin(),IDs.end()),IDs.end());
+
+    MOOS::ScopedLock L(m_ClientIDLock);
+    std::vector<unsigned int>::iterator q;
+    for(q = IDs.begin();q!=IDs.end();++q)
+        Clients.push_back(m_ClientNames[*q]);
+
+    return true;
 }
 
 /** This functions decides what needs to be done on a message by message basis */
@@ -702,6 +1186,19 @@ bool CMOOSDB::ProcessMsg(CMOOSMsg &MsgRx,MOOSMSG_LIST & MsgListTx)
 /** called when the in focus client is telling us something
 has changed. Ie this is a notify packet */
 bool CMOOSDB::OnNotify(CMOOSMsg &Msg)
+{
+    Shard & rShard = ShardFor(Msg.m_sKey);
+
+    if(IsShardedDispatch())
+        return rShard.MailBox.Push(MOOS::CompactMsg(Msg));
+
+    MOOS::ScopedLock L(rShard.Lock);
+    return DoNotify(Msg);
+}
+
+/** update a variable and post notifications to its subscribers - the
+lock of the shard holding the variable must be held */
+bool CMOOSDB::DoNotify(CMOOSMsg &Msg)
 {
     double dfTimeNow = HPMOOSTime();
     
@@ -714,29 +1211,31 @@ bool CMOOSDB::OnNotify(CMOOSMsg &Msg)
 
         //look to see if any existing wildcards make us want to subscribe
 		//to this new message
-		HASH_MAP_TYPE<std::string, std::set<MOOS::MsgFilter> >::const_iterator g;
-		for (g = m_ClientFilters.begin(); g != m_ClientFilters.end(); ++g)
+		std::vector<MOOS::WildcardIndex::Match> Matches;
+		m_FiltersLock.Lock();
+		m_Wildcards.Find(Msg.GetKey(),Msg.GetSource(),Matches);
+		m_FiltersLock.UnLock();
+
+		std::vector<MOOS::WildcardIndex::Match>::const_iterator h;
+		for (h = Matches.begin(); h != Matches.end(); ++h)
 		{
-			//for every client
-			std::set<MOOS::MsgFilter>::const_iterator h;
-			for (h = g->second.begin(); h != g->second.end(); ++h)
+			//add the filter owner as a subscriber
+			rVar.AddSubscriber(h->sClient, ClientID(h->sClient), h->Filter.period());
+			++m_RWSummaryChanges;
+			if(!m_bQuiet)
 			{
-				//for every filter
-				if (h->Matches(Msg))
-				{
-					//add the filter owner (client *g) as a subscriber
-					rVar.AddSubscriber(g->first, h->period());
-					if(!m_bQuiet)
-					{
-                        std::cout<<"+ subs of \""<<g->first<<"\" to \""
-                                <<Msg.GetKey()<<"\" via wildcard \""<<h->as_string()
-                                <<"\""<<std::endl;
-					}
-				}
+				std::cout<<"+ subs of \""<<h->sClient<<"\" to \""
+						<<Msg.GetKey()<<"\" via wildcard \""<<h->Filter.as_string()
+						<<"\""<<std::endl;
 			}
 		}
 
     }
+
+    //a stub is no use to a subscriber who can't fetch what it stands
+    //in for - tell the writer to send the real thing instead
+    if(MOOS::P2P::IsStub(Msg) && !AllFollowStubs(rVar))
+        return RefuseStub(Msg);
     
     if(rVar.m_cDataType==Msg.m_cDataType)
     {
@@ -773,57 +1272,43 @@ bool CMOOSDB::OnNotify(CMOOSMsg &Msg)
         }
         
         //record sSrc as a writer of this data
-        rVar.m_Writers.insert(Msg.m_sSrc);
+        if(rVar.m_Writers.insert(Msg.m_sSrc).second)
+            ++m_RWSummaryChanges;
         
         //increment the number of times we have written to this variable
+        MarkSummaryDirty(rVar);
         rVar.m_nWrittenTo++;
+        StampChange(rVar);
         
         //how often is it being written?
-        double dfDT = (dfTimeNow-rVar.m_Stats.m_dfLastStatsTime);
-        int nWrites  = rVar.m_nWrittenTo-rVar.m_Stats.m_nLastStatsWrites;
-        if(dfDT>0.5)
-        {
-            //this looks a little hookey - the numbers are arbitrary to give sensible
-            //looking frequencies when timing is coarse
-            if(dfDT>10.0)
-            {
-                //MIN
-                rVar.m_dfWriteFreq = 0.0;
-            }
-            else
-            {
-                //IIR FILTER COOEFFICENT
-                double dfAlpha = 0.5;
-                double df = dfDT/nWrites;
-
-                rVar.m_dfWriteFreq = dfAlpha*rVar.m_dfWriteFreq + (1.0-dfAlpha)/(df);
-            }
-            rVar.m_Stats.m_nLastStatsWrites = rVar.m_nWrittenTo;
-            rVar.m_Stats.m_dfLastStatsTime = dfTimeNow;
-        }
+        UpdateWriteStatistics(rVar,dfTimeNow);
         
         //now comes the intersting part...
         //which clients have asked to be informed
         //of changes in this variable?
-        REGISTER_INFO_MAP::iterator p;
+        REGISTER_INFO_VECTOR::iterator p;
         
+        //every client that wants to hear about this gets a reference
+        //to the one copy we make of the Msg
+        MOOSMSG_PTR pShared;
         
         for(p = rVar.m_Subscribers.begin();p!=rVar.m_Subscribers.end();++p)
         {
             
-            CMOOSRegisterInfo & rInfo = p->second;
+            CMOOSRegisterInfo & rInfo = *p;
             //has enough time expired since the last time we
             //sent notification for the variable?
             if(rInfo.Expired(dfTimeNow))
             {
+                if(pShared.isNull())
+                {
+                    //the Msg we were passed has all the information we require already
+                    Msg.m_cMsgType = MOOS_NOTIFY;
+                    pShared = new CMOOSMsg(Msg);
+                }
                 
-                string  & sClient = p->second.m_sClientName;
-                
-                //the Msg we were passed has all the information we require already
-                Msg.m_cMsgType = MOOS_NOTIFY;
-                
-                
-                AddMessageToClientBox(sClient,Msg);
+                AddMessageToClientBox(ShardFor(rVar.m_sName),rInfo.m_nClientID,
+                        rVar.m_nChange,pShared,rInfo.m_bLatestOnly);
                 
 
                 //finally we remember when we sent this to the client in question
@@ -848,31 +1333,213 @@ bool CMOOSDB::OnNotify(CMOOSMsg &Msg)
 }
 
 
+/** a notification arriving as a view. If the variable already exists, is
+of the right type and nobody is waiting to be told about the change we can
+update it straight from the packet. Otherwise we make a proper message
+and do things the long way*/
+bool CMOOSDB::OnNotify(const MOOS::MsgView & View)
+{
+    std::string sKey;
+    View.GetKey().AssignTo(sKey);
+
+    Shard & rShard = ShardFor(sKey);
+
+    //we are going to have to hand this to another thread
+    if(IsShardedDispatch())
+        return rShard.MailBox.Push(MOOS::CompactMsg(View));
+
+    MOOS::ScopedLock L(rShard.Lock);
+
+    DBVAR_MAP::iterator q = rShard.Vars.find(sKey);
+
+    //(stubs go the long way in case they have to be refused)
+    bool bFastPath = q!=rShard.Vars.end() &&
+            q->second.m_nWrittenTo!=0 &&
+            q->second.m_cDataType==View.m_cDataType &&
+            !(View.m_cDataType==MOOS_BINARY_STRING && View.GetString().empty());
+
+    double dfTimeNow = HPMOOSTime();
+
+    if(bFastPath)
+    {
+        REGISTER_INFO_VECTOR::iterator p;
+        for(p = q->second.m_Subscribers.begin();p!=q->second.m_Subscribers.end();++p)
+        {
+            if(p->Expired(dfTimeNow))
+            {
+                //someone needs a copy
+                bFastPath = false;
+                break;
+            }
+        }
+    }
+
+    if(!bFastPath)
+    {
+        CMOOSMsg Msg;
+        View.ToMsg(Msg);
+        return DoNotify(Msg);
+    }
+
+    CMOOSDBVar & rVar = q->second;
+
+    rVar.m_dfWrittenTime = dfTimeNow;
+    rVar.m_dfTime = View.GetTime();
+    View.GetSource().AssignTo(rVar.m_sWhoChangedMe);
+    View.GetSourceAux().AssignTo(rVar.m_sSrcAux);
+
+    if(View.GetCommunity().empty())
+        rVar.m_sOriginatingCommunity = m_sCommunityName;
+    else
+        View.GetCommunity().AssignTo(rVar.m_sOriginatingCommunity);
+
+    switch(rVar.m_cDataType)
+    {
+    case MOOS_DOUBLE:
+        rVar.m_dfVal = View.GetDouble();
+        break;
+    case MOOS_STRING:
+    case MOOS_BINARY_STRING:
+        View.GetString().AssignTo(rVar.m_sVal);
+        break;
+    }
+
+    if(rVar.m_Writers.insert(rVar.m_sWhoChangedMe).second)
+        ++m_RWSummaryChanges;
+
+    MarkSummaryDirty(rVar);
+    rVar.m_nWrittenTo++;
+    StampChange(rVar);
+
+    UpdateWriteStatistics(rVar,dfTimeNow);
+
+    return true;
+}
+
+/** maintain our estimate of how often a variable is being written */
+void CMOOSDB::UpdateWriteStatistics(CMOOSDBVar & rVar, double dfTimeNow)
+{
+    double dfDT = (dfTimeNow-rVar.m_Stats.m_dfLastStatsTime);
+    int nWrites  = rVar.m_nWrittenTo-rVar.m_Stats.m_nLastStatsWrites;
+    if(dfDT>0.5)
+    {
+        //this looks a little hookey - the numbers are arbitrary to give sensible
+        //looking frequencies when timing is coarse
+        if(dfDT>10.0)
+        {
+            //MIN
+            rVar.m_dfWriteFreq = 0.0;
+        }
+        else
+        {
+            //IIR FILTER COOEFFICENT
+            double dfAlpha = 0.5;
+            double df = dfDT/nWrites;
+
+            rVar.m_dfWriteFreq = dfAlpha*rVar.m_dfWriteFreq + (1.0-dfAlpha)/(df);
+        }
+        rVar.m_Stats.m_nLastStatsWrites = rVar.m_nWrittenTo;
+        rVar.m_Stats.m_dfLastStatsTime = dfTimeNow;
+    }
+}
+
+
 /** we now want to store some message in anoth cleints message box, when they next call
 in they shall be informed of the change by stuffing this msg into a return packet */
-bool    CMOOSDB::AddMessageToClientBox(const string &sClient,CMOOSMsg & Msg)
+bool    CMOOSDB::AddMessageToClientBox(Shard & rShard, unsigned int nClientID, uint64_t nStamp,
+        const MOOSMSG_PTR & pMsg,bool bLatestOnly)
 {
-    MOOSMSG_LIST_STRING_MAP::iterator q = m_HeldMailMap.find(sClient);
-    
-    if(q==m_HeldMailMap.end())
+    if(nClientID>=rShard.ClientMail.size())
     {
-        //there is no mail waiting to be sent to this client
-        //should only happen at start up...
-        MOOSMSG_LIST NewList;
-        m_HeldMailMap[sClient] = NewList;
-        
-        q = m_HeldMailMap.find(sClient);
-        
-        assert(q!=m_HeldMailMap.end());
+        rShard.ClientMail.resize(nClientID+1);
+        rShard.LatestOnlySlots.resize(nClientID+1);
+        rShard.HasNewMail.resize(nClientID+1,false);
+    }
+
+    STAMPED_MAIL & rBox = rShard.ClientMail[nClientID];
+
+    if(bLatestOnly)
+    {
+        //if there is already a notification for this variable waiting
+        //just swap in the new one - the box can't grow
+        LATEST_ONLY_SLOTS & rSlots = rShard.LatestOnlySlots[nClientID];
+        LATEST_ONLY_SLOTS::iterator q = rSlots.find(pMsg->GetKey());
+        if(q!=rSlots.end())
+        {
+            q->second->second = pMsg;
+            return true;
+        }
+        rSlots[pMsg->GetKey()] = rBox.insert(rBox.end(),std::make_pair(nStamp,pMsg));
+    }
+    else
+    {
+        //this list of messages will be sent to the client the next
+        //time it calls into the database...
+        rBox.push_back(std::make_pair(nStamp,pMsg));
+    }
+
+    if(!rShard.HasNewMail[nClientID])
+    {
+        rShard.HasNewMail[nClientID] = true;
+        rShard.ClientsWithMail.push_back(nClientID);
     }
     
-    //q->second is now a reference to a list of messages that will be
-    //sent to sClient the next time it calls into the database...   
-    q->second.push_back(Msg);
-    
     return true;
 }
 
+unsigned int CMOOSDB::ClientID(const std::string & sClient)
+{
+    MOOS::ScopedLock L(m_ClientIDLock);
+
+    std::map<std::string,unsigned int>::iterator q = m_ClientIDs.find(sClient);
+    if(q!=m_ClientIDs.end())
+        return q->second;
+
+    //a new face - give them the next number (their mail boxes are
+    //made by the shards as they need them)
+    unsigned int nClientID = m_ClientNames.size();
+    m_ClientIDs[sClient] = nClientID;
+    m_ClientNames.push_back(sClient);
+
+    return nClientID;
+}
+
+void CMOOSDB::SetFollowsStubs(const std::string & sClient, bool bFollowsStubs)
+{
+    unsigned int nClientID = ClientID(sClient);
+
+    MOOS::ScopedLock L(m_ClientIDLock);
+    if(nClientID>=m_FollowsStubs.size())
+        m_FollowsStubs.resize(nClientID+1,false);
+    m_FollowsStubs[nClientID] = bFollowsStubs;
+}
+
+bool CMOOSDB::FollowsStubs(unsigned int nClientID)
+{
+    MOOS::ScopedLock L(m_ClientIDLock);
+    return nClientID<m_FollowsStubs.size() && m_FollowsStubs[nClientID];
+}
+
+bool CMOOSDB::AllFollowStubs(CMOOSDBVar & rVar)
+{
+    REGISTER_INFO_VECTOR::iterator p;
+    for(p = rVar.m_Subscribers.begin();p!=rVar.m_Subscribers.end();++p)
+    {
+        if(!FollowsStubs(p->m_nClientID))
+            return false;
+    }
+    return true;
+}
+
+/** tell whoever wrote Stub we won't pass it on - the lock of the shard
+holding the variable must be held */
+bool CMOOSDB::RefuseStub(const CMOOSMsg & Stub)
+{
+    MOOSMSG_PTR pRefusal(new CMOOSMsg(MOOS::P2P::MakeRefusal(Stub)));
+    return AddMessageToClientBox(ShardFor(Stub.GetKey()),ClientID(Stub.GetSource()),
+            NextChange(),pRefusal);
+}
+
 
 /** Called when a msg containing a unregistration (desubscribe) 
 request is received */
@@ -880,13 +1547,13 @@ bool CMOOSDB::OnUnRegister(CMOOSMsg &Msg)
 {
 	if(Msg.IsType(MOOS_UNREGISTER))
 	{
-		//what are we looking to un register for?
-		bool bAlreadyThere = VariableExists(Msg.m_sKey);
-		if(bAlreadyThere)
-		{
-			CMOOSDBVar & rVar  = GetOrMakeVar(Msg);
-			rVar.RemoveSubscriber(Msg.m_sSrc);
-		}
+		Shard & rShard = ShardFor(Msg.m_sKey);
+
+		if(IsShardedDispatch())
+			return rShard.MailBox.Push(MOOS::CompactMsg(Msg));
+
+		MOOS::ScopedLock L(rShard.Lock);
+		return DoUnRegister(Msg);
 	}
 	else if (Msg.IsType(MOOS_WILDCARD_UNREGISTER))
 	{
@@ -900,18 +1567,27 @@ bool CMOOSDB::OnUnRegister(CMOOSMsg &Msg)
 		MOOSValFromString(var_pattern,Msg.GetString(),"VarPattern");
 		MOOS::MsgFilter F(app_pattern,var_pattern,period);
 
-		DBVAR_MAP::iterator q;
-		for(q = m_VarMap.begin();q!=m_VarMap.end();++q)
+		//variables written from now on shouldn't pick this filter up
+		m_FiltersLock.Lock();
+		m_Wildcards.Remove(Msg.GetSource(),F);
+		m_FiltersLock.UnLock();
+
+		MOOS::CompiledGlob VarGlob(var_pattern);
+		MOOS::CompiledGlob AppGlob(app_pattern);
+
+		for(unsigned int i = 0;i<m_Shards.size();i++)
 		{
-			CMOOSMsg M;
-			Var2Msg(q->second,M);
-			if(F.Matches(M))
+			MOOS::ScopedLock L(m_Shards[i]->Lock);
+
+			std::vector<std::string> Names;
+			FindVarsMatching(*m_Shards[i],VarGlob,AppGlob,Names);
+
+			std::vector<std::string>::iterator q;
+			for(q = Names.begin();q!=Names.end();++q)
 			{
-				M.m_cMsgType = MOOS_UNREGISTER;
-				M.m_cDataType = MOOS_STRING;
+				CMOOSMsg M(MOOS_UNREGISTER,*q,"");
 				M.m_sSrc = Msg.GetSource();
-				M.m_sKey = q->first;
-				OnUnRegister(M);//smart...
+				DoUnRegister(M);//smart...
 			}
 		}
 	}
@@ -919,56 +1595,45 @@ bool CMOOSDB::OnUnRegister(CMOOSMsg &Msg)
     return true;
 }
 
+/** remove a subscription to a single variable - the lock of the
+shard holding the variable must be held */
+bool CMOOSDB::DoUnRegister(CMOOSMsg &Msg)
+{
+	//what are we looking to un register for?
+	bool bAlreadyThere = VariableExists(Msg.m_sKey);
+	if(bAlreadyThere)
+	{
+		CMOOSDBVar & rVar  = GetOrMakeVar(Msg);
+		rVar.RemoveSubscriber(Msg.m_sSrc);
+		++m_RWSummaryChanges;
+	}
+
+	return true;
+}
+
 
 /** Called when a msg containing a registration (subscription) 
 request is received */
 bool CMOOSDB::OnRegister(CMOOSMsg &Msg)
 {
-    
     //what are we looking to register for?
 	if(Msg.IsType(MOOS_REGISTER))
 	{
+		Shard & rShard = ShardFor(Msg.m_sKey);
 
-		//if the variable already exists then post a notification message
-		//to the client
-		bool bAlreadyThere = VariableExists(Msg.m_sKey);
-
-		CMOOSDBVar & rVar  = GetOrMakeVar(Msg);
-
-        //PMN drops this check to allow notification
-        //periods to be changed dynamically 21/12/17
-//		if(rVar.HasSubscriber(Msg.m_sSrc))
-//			return true;
-
-		if(!rVar.AddSubscriber(Msg.m_sSrc,Msg.m_dfVal))
-			return false;
-
-        double dfActualPeriod;
-        if(!rVar.GetUpdatePeriod(Msg.m_sSrc,dfActualPeriod)){
-            return false;
-        }
-        std::string detail =MOOSFormat("%s@%.1f",rVar.m_sName.c_str(),dfActualPeriod);
-        m_EventLogger.AddEvent("register",
-                               Msg.m_sSrc,
-                               detail);
-
-		if(bAlreadyThere && rVar.m_nWrittenTo!=0)
-		{
-			//when the client registered the variable already existed...
-			//better tell them
-			CMOOSMsg ReplyMsg;
-			Var2Msg(rVar,ReplyMsg);
-
-			ReplyMsg.m_cMsgType = MOOS_NOTIFY;
-
-			AddMessageToClientBox(Msg.m_sSrc,ReplyMsg);
-
-        	rVar.m_Subscribers[Msg.m_sSrc].SetLastTimeSent(MOOS::Time());
+		if(IsShardedDispatch())
+			return rShard.MailBox.Push(MOOS::CompactMsg(Msg));
 
-		}
+		MOOS::ScopedLock L(rShard.Lock);
+		return DoRegister(Msg);
 	}
 	else if(Msg.IsType(MOOS_WILDCARD_REGISTER))
 	{
+		//can this client fetch what peer to peer stubs stand in for?
+		bool bFollowsStubs = false;
+		MOOSValFromString(bFollowsStubs,Msg.m_sVal,"FollowsStubs");
+		SetFollowsStubs(Msg.m_sSrc,bFollowsStubs);
+
 		//here we parse out the filter
 		std::string app_pattern = "";
 		std::string var_pattern = "";
@@ -982,36 +1647,42 @@ bool CMOOSDB::OnRegister(CMOOSMsg &Msg)
 
 		//store this filter we will need it later when new
 		//as yet undiscovered variables are written
-		m_ClientFilters[Msg.GetSource()].insert(F);
+		m_FiltersLock.Lock();
+		m_Wildcards.Add(Msg.GetSource(),F);
+		m_FiltersLock.UnLock();
 
 
         m_EventLogger.AddEvent("wildcard",Msg.m_sSrc,Msg.GetString());
 
 
-		//now iterate over all existing variables and see if they match
-		//if the do simply register for them...
-		DBVAR_MAP::iterator q;
-		for(q = m_VarMap.begin();q!=m_VarMap.end();++q)
+		//now look for existing variables which match and
+		//simply register for them...
+		MOOS::CompiledGlob VarGlob(var_pattern);
+		MOOS::CompiledGlob AppGlob(app_pattern);
+
+		for(unsigned int i = 0;i<m_Shards.size();i++)
 		{
-			CMOOSMsg M;
-			Var2Msg(q->second,M);
-			if(F.Matches(M))
+			MOOS::ScopedLock L(m_Shards[i]->Lock);
+
+			std::vector<std::string> Names;
+			FindVarsMatching(*m_Shards[i],VarGlob,AppGlob,Names);
+
+			std::vector<std::string>::iterator q;
+			for(q = Names.begin();q!=Names.end();++q)
 			{
-				M.m_cMsgType = MOOS_REGISTER;
-				M.m_cDataType = MOOS_DOUBLE;
-				M.m_dfVal = period;
+				CMOOSMsg M(MOOS_REGISTER,*q,period);
 				M.m_sSrc = Msg.GetSource();
 
 				if(!m_bQuiet)
 				{
-                    std::cout<<MOOS::ConsoleColours::yellow()
-                            <<"+ subs of \""
-                            <<Msg.GetSource()<<"\" to variables matching \""
-                            <<var_pattern<<":"<<app_pattern<<"\""
-                            <<MOOS::ConsoleColours::reset()<<std::endl;
+					std::cout<<MOOS::ConsoleColours::yellow()
+                        <<"+ subs of \""
+                        <<Msg.GetSource()<<"\" to variables matching \""
+                        <<var_pattern<<":"<<app_pattern<<"\""
+                        <<MOOS::ConsoleColours::reset()<<std::endl;
 				}
 
-				OnRegister(M);//smart...
+				DoRegister(M);//smart...
 			}
 		}
 
@@ -1022,6 +1693,69 @@ bool CMOOSDB::OnRegister(CMOOSMsg &Msg)
     return true;
 }
 
+/** add a subscription to a single variable - the lock of the
+shard holding the variable must be held */
+bool CMOOSDB::DoRegister(CMOOSMsg &Msg)
+{
+	//if the variable already exists then post a notification message
+	//to the client
+	bool bAlreadyThere = VariableExists(Msg.m_sKey);
+
+	CMOOSDBVar & rVar  = GetOrMakeVar(Msg);
+
+    //PMN drops this check to allow notification
+    //periods to be changed dynamically 21/12/17
+//	if(rVar.HasSubscriber(Msg.m_sSrc))
+//		return true;
+
+	//does the client want every change or just the latest
+	//one waiting for it when it next calls in?
+	bool bLatestOnly = false;
+	MOOSValFromString(bLatestOnly,Msg.m_sVal,"LatestOnly");
+
+	//and can it fetch what peer to peer stubs stand in for? (this runs on
+	//shard workers too, SetFollowsStubs() takes its own lock)
+	bool bFollowsStubs = false;
+	MOOSValFromString(bFollowsStubs,Msg.m_sVal,"FollowsStubs");
+	SetFollowsStubs(Msg.m_sSrc,bFollowsStubs);
+
+	unsigned int nClientID = ClientID(Msg.m_sSrc);
+	++m_RWSummaryChanges;
+	if(!rVar.AddSubscriber(Msg.m_sSrc,nClientID,Msg.m_dfVal,bLatestOnly))
+		return false;
+
+    double dfActualPeriod;
+    if(!rVar.GetUpdatePeriod(Msg.m_sSrc,dfActualPeriod)){
+        return false;
+    }
+    std::string detail =MOOSFormat("%s@%.1f",rVar.m_sName.c_str(),dfActualPeriod);
+    m_EventLogger.AddEvent("register",
+                           Msg.m_sSrc,
+                           detail);
+
+	if(bAlreadyThere && rVar.m_nWrittenTo!=0)
+	{
+		//when the client registered the variable already existed...
+		//better tell them
+		MOOSMSG_PTR pReplyMsg(new CMOOSMsg);
+		Var2Msg(rVar,*pReplyMsg);
+
+		pReplyMsg->m_cMsgType = MOOS_NOTIFY;
+
+		//if all we have is a stub they can't follow the writer
+		//had better send the real thing (to everyone)
+		if(MOOS::P2P::IsStub(*pReplyMsg) && !FollowsStubs(nClientID))
+			return RefuseStub(*pReplyMsg);
+
+		AddMessageToClientBox(ShardFor(rVar.m_sName),nClientID,NextChange(),pReplyMsg,bLatestOnly);
+
+    	rVar.FindSubscriber(Msg.m_sSrc)->SetLastTimeSent(MOOS::Time());
+
+	}
+
+	return true;
+}
+
 
 /** return a reference to a DB variable is it already exists
 and if not make one and then return a reference to it.
@@ -1031,10 +1765,11 @@ CMOOSDBVar & CMOOSDB::GetOrMakeVar(CMOOSMsg &Msg)
 {    
     
     //look up this variable name
-    DBVAR_MAP::iterator p = m_VarMap.find(Msg.m_sKey);
+    DBVAR_MAP & rVars = ShardFor(Msg.m_sKey).Vars;
+    DBVAR_MAP::iterator p = rVars.find(Msg.m_sKey);
     
 
-    if(p==m_VarMap.end())
+    if(p==rVars.end())
     {
         //we need to make a new variable here for this key
         //as we don't know about it!
@@ -1062,12 +1797,12 @@ CMOOSDBVar & CMOOSDB::GetOrMakeVar(CMOOSMsg &Msg)
 
 
         //index our new creation
-        m_VarMap[Msg.m_sKey] = NewVar;
+        rVars[Msg.m_sKey] = NewVar;
         
         //check we can get it back ok!!
-        p = m_VarMap.find(Msg.m_sKey);
+        p = rVars.find(Msg.m_sKey);
         
-        assert(p!=m_VarMap.end());
+        assert(p!=rVars.end());
         
 #ifdef DB_VERBOSE
         
@@ -1079,6 +1814,10 @@ CMOOSDBVar & CMOOSDB::GetOrMakeVar(CMOOSMsg &Msg)
 
         m_EventLogger.AddEvent("create",Msg.GetSource(),Msg.GetName());
 
+        //a new (if perhaps pending) variable is a change too
+        StampChange(p->second);
+        ShardFor(Msg.m_sKey).SummaryDirty.push_back(Msg.m_sKey);
+
     }
     
 
@@ -1094,6 +1833,9 @@ bool CMOOSDB::OnConnect(string &sClient)
 {
     m_EventLogger.AddEvent("connect",sClient,"client connects");
 
+    //from now on we know this client by number
+    ClientID(sClient);
+
     //notify ourselves....
     CMOOSMsg DBC(MOOS_NOTIFY,"DB_EVENT",MOOSFormat("connected=%s",sClient.c_str()));
     DBC.m_sOriginatingCommunity = m_sCommunityName;
@@ -1112,21 +1854,29 @@ bool CMOOSDB::OnDisconnect(string &sClient)
         std::cout<<MOOS::ConsoleColours::yellow()<<sClient<<" is leaving...           ";
     }
     
-    DBVAR_MAP::iterator p;
-    
-    for(p=m_VarMap.begin();p!=m_VarMap.end();++p)
-    {
-        CMOOSDBVar  & rVar = p->second;
-        
-        rVar.RemoveSubscriber(sClient);
-    }
-    if(m_ClientFilters.find(sClient)!=m_ClientFilters.end())
+    m_FiltersLock.Lock();
+    m_Wildcards.RemoveClient(sClient);
+    m_FiltersLock.UnLock();
+
+    SetFollowsStubs(sClient,false);
+
+    for(unsigned int i = 0;i<m_Shards.size();i++)
     {
-    	m_ClientFilters[sClient].clear();
+        if(IsShardedDispatch())
+        {
+            //the shard may still have work from this client queued so
+            //the clean up must happen after it
+            CMOOSMsg Bye(MOOS_TERMINATE_CONNECTION,"",0.0);
+            Bye.m_sSrc = sClient;
+            m_Shards[i]->MailBox.Push(MOOS::CompactMsg(Bye));
+        }
+        else
+        {
+            MOOS::ScopedLock L(m_Shards[i]->Lock);
+            RemoveClientFromShard(*m_Shards[i],sClient);
+        }
     }
     
-    m_HeldMailMap.erase(sClient);
-    
     if(!m_bQuiet)
         std::cout<<MOOS::ConsoleColours::Green()<<"[OK]\n"<<MOOS::ConsoleColours::reset();
 
@@ -1168,77 +1918,190 @@ bool CMOOSDB::DoServerRequest(CMOOSMsg &Msg, MOOSMSG_LIST &MsgTxList)
     return false;
 }
 
-void CMOOSDB::UpdateSummaryVar()
+/** the line describing rVar in DB_VARSUMMARY */
+static void MakeSummaryRow(const CMOOSDBVar & rVar, std::string & sRow)
 {
-
     std::stringstream ss;
-    DBVAR_MAP::iterator p;
 
-    for(p=m_VarMap.begin();p!=m_VarMap.end();++p)
+    ss<<std::left<<std::setw(20);
+    ss<<rVar.m_sName<<" ";
+
+    ss<<std::left<<std::setw(20);
+    ss<<MOOS::TimeToDate(rVar.m_dfWrittenTime,false,true)<<" ";
+
+    ss<<std::left<<std::setw(20);
+    if(rVar.m_sWhoChangedMe.empty())
     {
-        ss<<std::left<<std::setw(20);
-        ss<<p->first<<" ";
+        ss<<"(write pending)"<<" ";
+    }
+    else
+    {
+        ss<<rVar.m_sWhoChangedMe<<" ";
+    }
 
-        ss<<std::left<<std::setw(20);
-        ss<<MOOS::TimeToDate(p->second.m_dfWrittenTime,false,true)<<" ";
+    //write frequency
+    ss << std::fixed << std::setw( 4 ) << std::setprecision( 1 ) << rVar.m_dfWriteFreq<< "Hz ";
 
-        ss<<std::left<<std::setw(20);
-        if(p->second.m_sWhoChangedMe.empty())
+    ss<<std::left<<std::setw(2);
+    ss<<rVar.m_cDataType<<" ";
+
+    switch(rVar.m_cDataType)
+    {
+        case MOOS_DOUBLE:
+            ss<<rVar.m_dfVal;
+            break;
+        case MOOS_STRING:
         {
-            ss<<"(write pending)"<<" ";
+            unsigned int s = rVar.m_sVal.size();
+            if(s>25)
+                ss<<(rVar.m_sVal.substr(0,22)+"...");
+            else
+                ss<<rVar.m_sVal;
+
+            break;
         }
-        else
+        case MOOS_BINARY_STRING:
         {
-            ss<<p->second.m_sWhoChangedMe<<" ";
-        }
+            unsigned int s = rVar.m_sVal.size();
 
-        //write frequency
-        ss << std::fixed << std::setw( 4 ) << std::setprecision( 1 ) << p->second.m_dfWriteFreq<< "Hz ";
+            //payloads sent straight from writer to readers leave us a
+            //stub which says how big they are
+            bool bDirect = s==0 && MOOSValFromString(s,rVar.m_sSrcAux,"p2p_size",true);
 
-        ss<<std::left<<std::setw(2);
-        ss<<p->second.m_cDataType<<" ";
-
-        switch(p->second.m_cDataType)
-        {
-            case MOOS_DOUBLE:
-                ss<<p->second.m_dfVal;
-                break;
-            case MOOS_STRING:
-            {
-                unsigned int s = p->second.m_sVal.size();
-                if(s>25)
-                    ss<<(p->second.m_sVal.substr(0,22)+"...");
-                else
-                    ss<<p->second.m_sVal;
+            std::string bss;
+            if(s<1024)
+                bss = MOOSFormat("*binary* %-4d B",s);
+            else if(s<1024*1024)
+                bss = MOOSFormat("*binary* %.3f KB",s/(1024.0));
+            else
+                bss = MOOSFormat("*binary* %.3f MB",s/(1024.0*1024.0));
 
-                break;
-            }
-            case MOOS_BINARY_STRING:
-            {
-                unsigned int s = p->second.m_sVal.size();
-                std::string bss;
-                if(s<1024)
-                    bss = MOOSFormat("*binary* %-4d B",s);
-                else if(s<1024*1024)
-                    bss = MOOSFormat("*binary* %.3f KB",s/(1024.0));
-                else
-                    bss = MOOSFormat("*binary* %.3f MB",s/(1024.0*1024.0));
-
-                ss<<bss;
-                break;
-            }
+            if(bDirect)
+                bss+=" (direct)";
+            ss<<bss;
+            break;
         }
+    }
+
+    ss<<"\n";
+
+    sRow = ss.str();
+}
 
+void CMOOSDB::MarkSummaryDirty(CMOOSDBVar & rVar)
+{
+    //only list a variable the first time it goes stale
+    if(rVar.m_nSummaryWrites==rVar.m_nWrittenTo)
+        ShardFor(rVar.m_sName).SummaryDirty.push_back(rVar.m_sName);
+}
+
+void CMOOSDB::UpdateSummaryVar()
+{
+    MOOS::ScopedLock SL(m_SummaryLock);
 
-        ss<<"\n";
+    //only variables written since last time (which their shards have
+    //listed) have their rows made again, the rest stay as they are in
+    //m_sVarSummary
+    std::vector<std::pair<int,std::string> > Rows;
+    std::string sDelta;
 
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        MOOS::ScopedLock L(m_Shards[i]->Lock);
+        DBVAR_MAP & rVars = m_Shards[i]->Vars;
+        std::vector<std::string> & rDirty = m_Shards[i]->SummaryDirty;
+        for(unsigned int j = 0;j<rDirty.size();j++)
+        {
+            DBVAR_MAP::iterator p = rVars.find(rDirty[j]);
+            if(p==rVars.end())
+                continue;
+
+            CMOOSDBVar & rVar = p->second;
+            if(rVar.m_nSummaryRow<0)
+                rVar.m_nSummaryRow = m_SummaryRowStart.size()+Rows.size();
+
+            Rows.push_back(std::make_pair(rVar.m_nSummaryRow,std::string()));
+            MakeSummaryRow(rVar,Rows.back().second);
+            rVar.m_nSummaryWrites = rVar.m_nWrittenTo;
+            if(m_bVarSummaryDeltas)
+                sDelta+=Rows.back().second;
+        }
+        rDirty.clear();
     }
 
-    CMOOSMsg DBC(MOOS_NOTIFY,"DB_VARSUMMARY",ss.str());
+    SpliceSummaryRows(Rows);
+
+    CMOOSMsg DBC(MOOS_NOTIFY,"DB_VARSUMMARY",m_sVarSummary);
     DBC.m_sOriginatingCommunity = m_sCommunityName;
     DBC.m_sSrc = m_sDBName;
     OnNotify(DBC);
 
+    if(m_bVarSummaryDeltas)
+    {
+        CMOOSMsg DBD(MOOS_NOTIFY,"DB_VARSUMMARY_DELTA",sDelta);
+        DBD.m_sOriginatingCommunity = m_sCommunityName;
+        DBD.m_sSrc = m_sDBName;
+        OnNotify(DBD);
+    }
+}
+
+void CMOOSDB::SpliceSummaryRows(std::vector<std::pair<int,std::string> > & Rows)
+{
+    std::sort(Rows.begin(),Rows.end());
+
+    //rows we have never had before go on the end in order
+    size_t nOldRows = m_SummaryRowStart.size();
+    std::vector<std::pair<int,std::string> >::iterator q = Rows.begin();
+    while(q!=Rows.end() && q->first<(int)nOldRows)
+        ++q;
+    std::vector<std::pair<int,std::string> >::iterator qNew = q;
+
+    //existing rows which are the same length as before are written over...
+    bool bSameLengths = true;
+    for(q = Rows.begin();q!=qNew && bSameLengths;++q)
+    {
+        size_t nEnd = q->first+1<(int)nOldRows ? m_SummaryRowStart[q->first+1] : m_sVarSummary.size();
+        bSameLengths = nEnd-m_SummaryRowStart[q->first]==q->second.size();
+    }
+
+    if(bSameLengths)
+    {
+        for(q = Rows.begin();q!=qNew;++q)
+            m_sVarSummary.replace(m_SummaryRowStart[q->first],q->second.size(),q->second);
+    }
+    else
+    {
+        //...otherwise the summary is spliced together in one pass
+        std::string sSummary;
+        sSummary.reserve(m_sVarSummary.size());
+        size_t nCopied = 0;
+        long nShift = 0;
+        size_t nRow = 0;
+        for(q = Rows.begin();q!=qNew;++q)
+        {
+            size_t nStart = m_SummaryRowStart[q->first];
+            size_t nEnd = q->first+1<(int)nOldRows ? m_SummaryRowStart[q->first+1] : m_sVarSummary.size();
+
+            sSummary.append(m_sVarSummary,nCopied,nStart-nCopied);
+            sSummary+=q->second;
+            nCopied = nEnd;
+
+            for(;nRow<=(size_t)q->first;nRow++)
+                m_SummaryRowStart[nRow]+=nShift;
+            nShift+=(long)q->second.size()-(long)(nEnd-nStart);
+        }
+        sSummary.append(m_sVarSummary,nCopied,std::string::npos);
+        for(;nRow<nOldRows;nRow++)
+            m_SummaryRowStart[nRow]+=nShift;
+
+        m_sVarSummary.swap(sSummary);
+    }
+
+    for(q = qNew;q!=Rows.end();++q)
+    {
+        m_SummaryRowStart.push_back(m_sVarSummary.size());
+        m_sVarSummary+=q->second;
+    }
 }
 
 bool CMOOSDB::OnProcessSummaryRequested(CMOOSMsg &Msg, MOOSMSG_LIST &MsgTxList)
@@ -1256,27 +2119,32 @@ bool CMOOSDB::OnProcessSummaryRequested(CMOOSMsg &Msg, MOOSMSG_LIST &MsgTxList)
         string sPublished= "PUBLISHED=";
         string sSubscribed = "SUBSCRIBED=";
         
-        for(p=m_VarMap.begin();p!=m_VarMap.end();++p)
+        for(unsigned int i = 0;i<m_Shards.size();i++)
         {
-            CMOOSDBVar  & rVar = p->second;
-            
-            if(rVar.m_Writers.find(sWho)!=rVar.m_Writers.end())
+            MOOS::ScopedLock L(m_Shards[i]->Lock);
+            DBVAR_MAP & rVars = m_Shards[i]->Vars;
+            for(p=rVars.begin();p!=rVars.end();++p)
             {
-                if(!sPublished.empty())
+                CMOOSDBVar  & rVar = p->second;
+            
+                if(rVar.m_Writers.find(sWho)!=rVar.m_Writers.end())
                 {
-                    sPublished+=",";
-                }
-                sPublished+=rVar.m_sName;
+                    if(!sPublished.empty())
+                    {
+                        sPublished+=",";
+                    }
+                    sPublished+=rVar.m_sName;
                 
-            }
+                }
             
-            if(rVar.m_Subscribers.find(sWho)!=rVar.m_Subscribers.end())
-            {
-                if(!sSubscribed.empty())
+                if(rVar.HasSubscriber(sWho))
                 {
-                    sSubscribed+=",";
+                    if(!sSubscribed.empty())
+                    {
+                        sSubscribed+=",";
+                    }
+                    sSubscribed+=rVar.m_sName;
                 }
-                sSubscribed+=rVar.m_sName;
             }
         }
         
@@ -1306,51 +2174,230 @@ bool CMOOSDB::OnServerAllRequested(CMOOSMsg &Msg, MOOSMSG_LIST &MsgTxList)
     
     DBVAR_MAP::iterator p;
     
-    for(p=m_VarMap.begin();p!=m_VarMap.end();++p)
+    for(unsigned int i = 0;i<m_Shards.size();i++)
     {
-        CMOOSDBVar  & rVar = p->second;
+        MOOS::ScopedLock L(m_Shards[i]->Lock);
+        DBVAR_MAP & rVars = m_Shards[i]->Vars;
+        for(p=rVars.begin();p!=rVars.end();++p)
+        {
+            CMOOSDBVar  & rVar = p->second;
         
-        CMOOSMsg MsgVar;
+            CMOOSMsg MsgVar;
         
-        MsgVar.m_nID        = Msg.m_nID;
+            MsgVar.m_nID        = Msg.m_nID;
         
-        MsgVar.m_cMsgType   = MOOS_NOTIFY;
-        MsgVar.m_cDataType  = rVar.m_cDataType;
-        MsgVar.m_dfTime     = rVar.m_dfWrittenTime-m_dfStartTime; //for display
-        MsgVar.m_sSrc       = rVar.m_sWhoChangedMe;
-        MsgVar.m_sKey       = rVar.m_sName;
-        MsgVar.m_sVal       = rVar.m_sVal;
-		MsgVar.m_sSrcAux    = rVar.m_sSrcAux;
-        MsgVar.m_dfVal      = rVar.m_dfVal;
-        MsgVar.m_dfVal2     = rVar.m_dfWriteFreq;
-        MsgVar.m_sOriginatingCommunity = rVar.m_sOriginatingCommunity;
+            MsgVar.m_cMsgType   = MOOS_NOTIFY;
+            MsgVar.m_cDataType  = rVar.m_cDataType;
+            MsgVar.m_dfTime     = rVar.m_dfWrittenTime-m_dfStartTime; //for display
+            MsgVar.m_sSrc       = rVar.m_sWhoChangedMe;
+            MsgVar.m_sKey       = rVar.m_sName;
+            MsgVar.m_sVal       = rVar.m_sVal;
+    		MsgVar.m_sSrcAux    = rVar.m_sSrcAux;
+            MsgVar.m_dfVal      = rVar.m_dfVal;
+            MsgVar.m_dfVal2     = rVar.m_dfWriteFreq;
+            MsgVar.m_sOriginatingCommunity = rVar.m_sOriginatingCommunity;
         
-        if(MsgVar.m_dfTime<0) 
-        {
-            MsgVar.m_dfTime =-1;
-        }
+            if(MsgVar.m_dfTime<0) 
+            {
+                MsgVar.m_dfTime =-1;
+            }
         
-        MsgTxList.push_front(MsgVar);
+            MsgTxList.push_front(MsgVar);
         
         
+        }
     }
     
     
     return true;
 }
 
+void CMOOSDB::GetVariables(MOOSMSG_LIST & Vars)
+{
+    CMOOSMsg Request(MOOS_SERVER_REQUEST,"ALL","");
+    OnServerAllRequested(Request,Vars);
+}
+
+uint64_t CMOOSDB::GetLastChange()
+{
+#if __cplusplus >= 201103L
+    return m_nLastChange;
+#else
+    MOOS::ScopedLock L(m_ChangeLock);
+    return m_nLastChange;
+#endif
+}
+
+void CMOOSDB::StampChange(CMOOSDBVar & rVar)
+{
+    rVar.m_nChange = NextChange();
+}
+
+uint64_t CMOOSDB::NextChange()
+{
+#if __cplusplus >= 201103L
+    return ++m_nLastChange;
+#else
+    MOOS::ScopedLock L(m_ChangeLock);
+    return ++m_nLastChange;
+#endif
+}
+
+/** s as a quoted JSON string */
+static void AppendJSONString(std::string & sOut, const std::string & s)
+{
+    sOut+='"';
+    for(std::string::const_iterator q = s.begin();q!=s.end();++q)
+    {
+        unsigned char c = *q;
+        switch(c)
+        {
+        case '"': sOut+="\\\""; break;
+        case '\\': sOut+="\\\\"; break;
+        case '\n': sOut+="\\n"; break;
+        case '\r': sOut+="\\r"; break;
+        case '\t': sOut+="\\t"; break;
+        default:
+            if(c<0x20)
+                sOut+=MOOSFormat("\\u%04x",c);
+            else
+                sOut+=c;
+        }
+    }
+    sOut+='"';
+}
+
+/** a JSON number (JSON has no infinities or NaNs) */
+static void AppendJSONNumber(std::string & sOut, double dfVal, const char * sFormat = "%.15g")
+{
+    //only NaN and infinity aren't zero when taken from themselves
+    if(dfVal-dfVal==0.0)
+        sOut+=MOOSFormat(sFormat,dfVal);
+    else
+        sOut+="null";
+}
+
+const std::string & CMOOSDB::VarAsJSON(CMOOSDBVar & rVar)
+{
+    if(!rVar.m_sJSON.empty() && rVar.m_nJSONChange==rVar.m_nChange)
+        return rVar.m_sJSON;
+
+    std::string & s = rVar.m_sJSON;
+    s = "{\"name\":";
+    AppendJSONString(s,rVar.m_sName);
+
+    switch(rVar.m_cDataType)
+    {
+    case MOOS_DOUBLE:
+        s+=",\"type\":\"double\",\"value\":";
+        AppendJSONNumber(s,rVar.m_dfVal);
+        break;
+    case MOOS_STRING:
+        s+=",\"type\":\"string\",\"value\":";
+        AppendJSONString(s,rVar.m_sVal);
+        break;
+    case MOOS_BINARY_STRING:
+    {
+        //payloads sent straight from writer to readers leave us a
+        //stub which says how big they are
+        unsigned int nSize = rVar.m_sVal.size();
+        if(nSize==0)
+            MOOSValFromString(nSize,rVar.m_sSrcAux,"p2p_size",true);
+        s+=MOOSFormat(",\"type\":\"binary\",\"size\":%u",nSize);
+        break;
+    }
+    default:
+        s+=",\"type\":\"pending\",\"value\":null";
+        break;
+    }
+
+    s+=",\"time\":";
+    AppendJSONNumber(s,rVar.m_dfTime,"%.6f");
+    s+=",\"written\":";
+    AppendJSONNumber(s,rVar.m_dfWrittenTime,"%.6f");
+    s+=",\"freq\":";
+    AppendJSONNumber(s,rVar.m_dfWriteFreq,"%.3f");
+    s+=",\"source\":";
+    AppendJSONString(s,rVar.m_sWhoChangedMe);
+    s+=",\"aux\":";
+    AppendJSONString(s,rVar.m_sSrcAux);
+    s+=",\"community\":";
+    AppendJSONString(s,rVar.m_sOriginatingCommunity);
+    s+=MOOSFormat(",\"change\":%llu}",(unsigned long long)rVar.m_nChange);
+
+    rVar.m_nJSONChange = rVar.m_nChange;
+    return s;
+}
+
+void CMOOSDB::MakeJSON(uint64_t nSince, uint64_t nChange, std::string & sJSON)
+{
+    sJSON = "{\"community\":";
+    AppendJSONString(sJSON,m_sCommunityName);
+    sJSON+=MOOSFormat(",\"change\":%llu,\"since\":%llu,\"variables\":[",
+            (unsigned long long)nChange,
+            (unsigned long long)nSince);
+
+    bool bFirst = true;
+    DBVAR_MAP::iterator p;
+    for(unsigned int i = 0;i<m_Shards.size();i++)
+    {
+        MOOS::ScopedLock L(m_Shards[i]->Lock);
+        DBVAR_MAP & rVars = m_Shards[i]->Vars;
+        for(p=rVars.begin();p!=rVars.end();++p)
+        {
+            CMOOSDBVar & rVar = p->second;
+            if(nSince!=0 && rVar.m_nChange<=nSince)
+                continue;
+
+            if(!bFirst)
+                sJSON+=",";
+            sJSON+="\n";
+            sJSON+=VarAsJSON(rVar);
+            bFirst = false;
+        }
+    }
+
+    sJSON+="]}\n";
+}
+
+void CMOOSDB::GetVariablesAsJSON(uint64_t nSince, std::string & sJSON, uint64_t & nChange)
+{
+    //every change numbered up to here has been made by the time we look
+    //in its shard as changes are numbered with the shard lock held
+    nChange = GetLastChange();
+
+    if(nSince!=0)
+    {
+        MakeJSON(nSince,nChange,sJSON);
+        return;
+    }
+
+    MOOS::ScopedLock L(m_JSONSnapshotLock);
+    if(m_sJSONSnapshot.empty() || m_nJSONSnapshotChange!=nChange)
+    {
+        MakeJSON(0,nChange,m_sJSONSnapshot);
+        m_nJSONSnapshotChange = nChange;
+    }
+    sJSON = m_sJSONSnapshot;
+}
+
 //Suggested addition by MIT users 2006 - shorter version of OnProcessSummary
 bool CMOOSDB::OnVarSummaryRequested(CMOOSMsg &Msg, MOOSMSG_LIST &MsgTxList)
 {
     std::string TheVars;
     DBVAR_MAP::iterator p;
-    for(p = m_VarMap.begin(); p != m_VarMap.end(); ++p) 
+    for(unsigned int i = 0;i<m_Shards.size();i++)
     {
-        //look to a comma
-        if(p!=m_VarMap.begin())
-            TheVars += ",";
+        MOOS::ScopedLock L(m_Shards[i]->Lock);
+        DBVAR_MAP & rVars = m_Shards[i]->Vars;
+        for(p=rVars.begin();p!=rVars.end();++p)
+        {
+            //look to a comma
+            if(!TheVars.empty())
+                TheVars += ",";
 
-        TheVars += p->first;
+            TheVars += p->first;
+        }
     }
     
     CMOOSMsg Reply;
@@ -1381,25 +2428,37 @@ bool CMOOSDB::OnClearRequested(CMOOSMsg &Msg, MOOSMSG_LIST &MsgTxList)
 
     MOOSTrace("Clear Down Requested:\n");
     
-    MOOSTrace("    Resetting %lu variables...",m_VarMap.size());
+    MOOSTrace("    Resetting variables...");
     
     DBVAR_MAP::iterator p;
     
-    for(p = m_VarMap.begin();p!=m_VarMap.end();++p)
+    for(unsigned int i = 0;i<m_Shards.size();i++)
     {
-        CMOOSDBVar & rVar = p->second;
-        rVar.Reset();
+        MOOS::ScopedLock L(m_Shards[i]->Lock);
+        DBVAR_MAP & rVars = m_Shards[i]->Vars;
+        for(p=rVars.begin();p!=rVars.end();++p)
+        {
+            CMOOSDBVar & rVar = p->second;
+            MarkSummaryDirty(rVar);
+            rVar.Reset();
+            StampChange(rVar);
+            ++m_RWSummaryChanges;
+        }
     }
     MOOSTrace("done\n");
     
     
-    MOOSTrace("    Removing %lu existing notification queues...",m_HeldMailMap.size());
-    MOOSMSG_LIST_STRING_MAP::iterator q;
-    
-    for(q = m_HeldMailMap.begin();q!=m_HeldMailMap.end();++q)
+    MOOSTrace("    Removing existing notification queues...");
+    for(unsigned int i = 0;i<m_Shards.size();i++)
     {
-        MOOSMSG_LIST & rList = q->second;
-        rList.clear();
+        MOOS::ScopedLock L(m_Shards[i]->Lock);
+        std::vector<STAMPED_MAIL>::iterator q;
+        for(q = m_Shards[i]->ClientMail.begin();q!=m_Shards[i]->ClientMail.end();++q)
+            q->clear();
+
+        std::vector<LATEST_ONLY_SLOTS>::iterator s;
+        for(s = m_Shards[i]->LatestOnlySlots.begin();s!=m_Shards[i]->LatestOnlySlots.end();++s)
+            s->clear();
     }
     MOOSTrace("done\n");
     
@@ -1425,9 +2484,10 @@ void CMOOSDB::LogStartTime()
 
 bool CMOOSDB::VariableExists(const string &sVar)
 {
-    DBVAR_MAP::iterator p=m_VarMap.find(sVar);
+    DBVAR_MAP & rVars = ShardFor(sVar).Vars;
+    DBVAR_MAP::iterator p=rVars.find(sVar);
     
-    return (!m_VarMap.empty()) && (p!=m_VarMap.end());
+    return (!rVars.empty()) && (p!=rVars.end());
 }
 
 void CMOOSDB::Var2Msg(CMOOSDBVar &Var, CMOOSMsg &Msg)
@@ -36,30 +36,49 @@
 #define DEFAULT_WEBSERVER_PORT 9080L
 #define WEBSERVER_COMMCLIENT_TICK 5
 
+//connections idle for longer than this (seconds) are closed
+#define WEBSERVER_IDLE_TIMEOUT 30.0
+
+//more connections than this at once are turned away
+#define WEBSERVER_MAX_CONNECTIONS 256
+
 bool _DUMMYMOOSCB(void *){return true;}
 
 CMOOSDBHTTPServer::CMOOSDBHTTPServer(long lDBPort)
 {
-    Initialise(lDBPort, DEFAULT_WEBSERVER_PORT);
+    Initialise(lDBPort, DEFAULT_WEBSERVER_PORT, NULL);
 }
 
 CMOOSDBHTTPServer::CMOOSDBHTTPServer(long lDBPort, long lWebServerPort)
 {
-    Initialise(lDBPort, lWebServerPort);
+    Initialise(lDBPort, lWebServerPort, NULL);
+}
+
+CMOOSDBHTTPServer::CMOOSDBHTTPServer(long lDBPort, long lWebServerPort, CMOOSDB * pDB)
+{
+    Initialise(lDBPort, lWebServerPort, pDB);
 }
 
 CMOOSDBHTTPServer::~CMOOSDBHTTPServer(void)
 {
     //clean up
+    m_ListenThread.Stop();
+
+    std::list<CHTTPConnection*>::iterator q;
+    for(q = m_Connections.begin();q!=m_Connections.end();++q)
+        delete *q;
+
     m_pMOOSComms->Close();
     delete m_pMOOSComms;
     delete m_pMOOSCommsLock;
 }
 
 
-void CMOOSDBHTTPServer::Initialise(long lDBPort, long lWebServerPort)
+void CMOOSDBHTTPServer::Initialise(long lDBPort, long lWebServerPort, CMOOSDB * pDB)
 {
     m_lWebServerPort = lWebServerPort;
+    m_pDB = pDB;
+    m_pListenSocket = NULL;
 
     //make a new comms client to reach the DB   
     m_pMOOSComms = new CMOOSCommClient;
@@ -99,7 +118,11 @@ bool CMOOSDBHTTPServer::Listen()
     
     
     while(!m_pMOOSComms->IsConnected())
+    {
+        if(m_ListenThread.IsQuitRequested())
+            return true;
         MOOSPause(100);
+    }
     
     DoBanner();
     
@@ -109,6 +132,7 @@ bool CMOOSDBHTTPServer::Listen()
     {
         m_pListenSocket->vSetReuseAddr(1);
         m_pListenSocket->vBindSocket();
+        m_pListenSocket->vListen();
     }
     catch(XPCException & e)
     {        
@@ -121,56 +145,103 @@ bool CMOOSDBHTTPServer::Listen()
     }
     
     //OK looks good...
-    while(1)
+    while(!m_ListenThread.IsQuitRequested())
     {
-        
-        try
+        //wait here for folk demanding attention
+        fd_set Readable;
+        fd_set Writable;
+        FD_ZERO(&Readable);
+        FD_ZERO(&Writable);
+
+        int nMaxFD = m_pListenSocket->iGetSocketFd();
+        FD_SET(nMaxFD,&Readable);
+
+        std::list<CHTTPConnection*>::iterator q;
+        for(q = m_Connections.begin();q!=m_Connections.end();++q)
+        {
+            int nFD = (*q)->GetSocketFD();
+            FD_SET(nFD,&Readable);
+            if((*q)->HasPendingReply())
+                FD_SET(nFD,&Writable);
+            nMaxFD = std::max(nMaxFD,nFD);
+        }
+
+        //so we notice being asked to quit
+        struct timeval Timeout;
+        Timeout.tv_sec = 0;
+        Timeout.tv_usec = 100000;
+
+        if(select(nMaxFD+1,&Readable,&Writable,NULL,&Timeout)<0)
+        {
+            MOOSPause(10);
+            continue;
+        }
+
+        //service those who are ready and carefully remove expired handler objects
+        q = m_Connections.begin();
+        while(q!=m_Connections.end())
+        {
+            CHTTPConnection * pConnection = *q;
+            int nFD = pConnection->GetSocketFD();
+            try
+            {
+                if(FD_ISSET(nFD,&Readable))
+                    pConnection->OnReadable();
+                if(FD_ISSET(nFD,&Writable))
+                    pConnection->OnWritable();
+            }
+            catch(XPCException & e)
+            {
+                UNUSED_PARAMETER(e);
+                delete pConnection;
+                q = m_Connections.erase(q);
+                continue;
+            }
+
+            if(pConnection->HasCompleted(WEBSERVER_IDLE_TIMEOUT))
+            {
+                delete pConnection;
+                q = m_Connections.erase(q);
+            }
+            else
+            {
+                ++q;
+            }
+        }
+
+        if(FD_ISSET(m_pListenSocket->iGetSocketFd(),&Readable))
         {
-            char sClientName[200];
-            
-            //wait here for folk demanding attention
-            m_pListenSocket->vListen();
-            
-            //let them in the door
-            XPCTcpSocket * pNewSocket = m_pListenSocket->Accept(sClientName);
-
-            //make a new handler object
-            CHTTPConnection * pNewConnection = new CHTTPConnection(pNewSocket,m_pMOOSComms,m_pMOOSCommsLock);
-
-            //let it run and service the client as it sees fit
-            //this is a non blocking call allowing the server to 
-            //dal with other requests
-            pNewConnection->Run();
-            
-            //store this connection
-            m_Connections.push_back(pNewConnection);  
-
-            //look to clean up here..
-            std::list<CHTTPConnection*>::iterator q = m_Connections.begin();
-            while( q!=m_Connections.end())
+            try
             {
-                //carefully remove expired handler objects
-                if((*q)->HasCompleted())
+                char sClientName[200];
+
+                //let them in the door
+                XPCTcpSocket * pNewSocket = m_pListenSocket->Accept(sClientName);
+
+                if(m_Connections.size()>=WEBSERVER_MAX_CONNECTIONS ||
+                        pNewSocket->iGetSocketFd()>=FD_SETSIZE)
                 {
-                    CHTTPConnection* t = *q;
-                    q = m_Connections.erase(q);
-                    delete t;
+                    pNewSocket->vCloseSocket();
+                    delete pNewSocket;
                 }
                 else
                 {
-                    ++q;
+                    //make a new handler object which will service the
+                    //client as and when its socket is ready
+                    m_Connections.push_back(new CHTTPConnection(pNewSocket,
+                                                                m_pMOOSComms,
+                                                                m_pMOOSCommsLock,
+                                                                m_pDB));
                 }
             }
-
-
-        }
-        catch(XPCException & e)
-        {
-            MOOSTrace("Exception Thrown in listen loop: %s\n",e.sGetException());
+            catch(XPCException & e)
+            {
+                MOOSTrace("Exception Thrown in listen loop: %s\n",e.sGetException());
+            }
         }
-        
     }
     
     delete m_pListenSocket;
+    m_pListenSocket = NULL;
     return true;
 }
@@ -50,6 +50,11 @@ CMOOSDBVar::CMOOSDBVar() :
     m_sOriginatingCommunity(),
     m_Stats(),
     m_nWrittenTo(0),
+    m_nSummaryRow(-1),
+    m_nSummaryWrites(-1),
+    m_nChange(0),
+    m_sJSON(),
+    m_nJSONChange(0),
     m_Subscribers(),
     m_Writers()
 {}
@@ -68,6 +73,11 @@ CMOOSDBVar::CMOOSDBVar(const string & sName) :
     m_sOriginatingCommunity(),
     m_Stats(),
     m_nWrittenTo(0),
+    m_nSummaryRow(-1),
+    m_nSummaryWrites(-1),
+    m_nChange(0),
+    m_sJSON(),
+    m_nJSONChange(0),
     m_Subscribers(),
     m_Writers()
 {}
@@ -78,13 +88,14 @@ CMOOSDBVar::~CMOOSDBVar()
 }
 
 bool CMOOSDBVar::GetUpdatePeriod(const string & sClient, double & dfPeriod){
-    if(!HasSubscriber(sClient))
+    REGISTER_INFO_VECTOR::iterator p = FindSubscriber(sClient);
+    if(p==m_Subscribers.end())
         return false;
-    dfPeriod = m_Subscribers[sClient].m_dfPeriod;
+    dfPeriod = p->m_dfPeriod;
     return true;
 }
 
-bool CMOOSDBVar::AddSubscriber(const string &sClient, double dfPeriod)
+bool CMOOSDBVar::AddSubscriber(const string &sClient, unsigned int nClientID, double dfPeriod, bool bLatestOnly)
 {
 
     if(sClient.empty())
@@ -95,26 +106,40 @@ bool CMOOSDBVar::AddSubscriber(const string &sClient, double dfPeriod)
 
     CMOOSRegisterInfo Info;
     Info.m_sClientName = sClient;
+    Info.m_nClientID = nClientID;
     Info.m_dfPeriod = dfPeriod;
-    m_Subscribers[sClient] = Info;
+    Info.m_bLatestOnly = bLatestOnly;
+
+    REGISTER_INFO_VECTOR::iterator p = FindSubscriber(sClient);
+    if(p!=m_Subscribers.end())
+        *p = Info;
+    else
+        m_Subscribers.push_back(Info);
 
     return true;
 }
 
-bool CMOOSDBVar::HasSubscriber(const string & sClient)
+REGISTER_INFO_VECTOR::iterator CMOOSDBVar::FindSubscriber(const string & sClient)
 {
-	if(m_Subscribers.empty())
-		return false;
-	else
-		return m_Subscribers.find(sClient)!=m_Subscribers.end();
+    REGISTER_INFO_VECTOR::iterator p;
+    for(p = m_Subscribers.begin();p!=m_Subscribers.end();++p)
+    {
+        if(p->m_sClientName==sClient)
+            break;
+    }
+    return p;
+}
 
+bool CMOOSDBVar::HasSubscriber(const string & sClient)
+{
+    return FindSubscriber(sClient)!=m_Subscribers.end();
 }
 
 
 void CMOOSDBVar::RemoveSubscriber(string &sWho)
 {
 
-    REGISTER_INFO_MAP::iterator p = m_Subscribers.find(sWho);
+    REGISTER_INFO_VECTOR::iterator p = FindSubscriber(sWho);
     if(p!=m_Subscribers.end())
     {
     //MOOSTrace("MOOSDB: Removing \"%s\"'s subscription to \"%s\"\n",sWho.c_str(),m_sName.c_str());
@@ -134,6 +159,9 @@ bool CMOOSDBVar::Reset()
     m_dfWrittenTime = -1;
     m_nWrittenTo = 0;
     m_dfWriteFreq = 0;
+    m_nSummaryWrites = -1;
+    m_sJSON.clear();
+    m_nJSONChange = 0;
 
     return true;
 }
@@ -34,6 +34,8 @@ CMOOSRegisterInfo::CMOOSRegisterInfo()
 {
     m_dfLastTimeSent = 0;
     m_dfPeriod = 0.5;
+    m_nClientID = 0;
+    m_bLatestOnly = false;
 }
 
 CMOOSRegisterInfo::~CMOOSRegisterInfo()
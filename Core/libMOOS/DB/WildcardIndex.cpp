@@ -0,0 +1,267 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * WildcardIndex.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/DB/WildcardIndex.h"
+
+namespace MOOS
+{
+
+CompiledGlob::CompiledGlob()
+{
+    m_Segments.push_back("");
+    m_bLiteral = true;
+}
+
+CompiledGlob::CompiledGlob(const std::string & sPattern)
+{
+    m_sPattern = sPattern;
+
+    size_t nWild = sPattern.find_first_of("*?");
+    m_bLiteral = nWild==std::string::npos;
+    m_sPrefix = sPattern.substr(0,nWild);
+
+    //split on '*' - an empty first (last) segment means the pattern
+    //starts (ends) with a '*'
+    size_t nStart = 0;
+    for(;;)
+    {
+        size_t nStar = sPattern.find('*',nStart);
+        if(nStar==std::string::npos)
+        {
+            m_Segments.push_back(sPattern.substr(nStart));
+            break;
+        }
+        m_Segments.push_back(sPattern.substr(nStart,nStar-nStart));
+        nStart = nStar+1;
+    }
+}
+
+bool CompiledGlob::SegmentAt(const std::string & sSegment,const std::string & sString,size_t nPos)
+{
+    if(nPos+sSegment.size()>sString.size())
+        return false;
+
+    for(size_t i = 0;i<sSegment.size();i++)
+    {
+        if(sSegment[i]!='?' && sSegment[i]!=sString[nPos+i])
+            return false;
+    }
+    return true;
+}
+
+size_t CompiledGlob::FindSegment(const std::string & sSegment,const std::string & sString,size_t nFrom,size_t nTo)
+{
+    for(size_t nPos = nFrom;nPos+sSegment.size()<=nTo;nPos++)
+    {
+        if(SegmentAt(sSegment,sString,nPos))
+            return nPos;
+    }
+    return std::string::npos;
+}
+
+bool CompiledGlob::Matches(const std::string & sString) const
+{
+    if(m_Segments.size()==1)
+        return sString.size()==m_Segments[0].size() && SegmentAt(m_Segments[0],sString,0);
+
+    //the first and last segments are pinned to the ends of the string...
+    const std::string & sFirst = m_Segments.front();
+    const std::string & sLast = m_Segments.back();
+    if(sString.size()<sFirst.size()+sLast.size())
+        return false;
+
+    size_t nEnd = sString.size()-sLast.size();
+    if(!SegmentAt(sFirst,sString,0) || !SegmentAt(sLast,sString,nEnd))
+        return false;
+
+    //...and those in between just have to be found in order
+    size_t nPos = sFirst.size();
+    for(size_t i = 1;i+1<m_Segments.size();i++)
+    {
+        nPos = FindSegment(m_Segments[i],sString,nPos,nEnd);
+        if(nPos==std::string::npos)
+            return false;
+        nPos+=m_Segments[i].size();
+    }
+
+    return true;
+}
+
+
+WildcardIndex::WildcardIndex()
+{
+    m_pRoot = new Node;
+    m_nSize = 0;
+}
+
+WildcardIndex::~WildcardIndex()
+{
+    Delete(m_pRoot);
+}
+
+void WildcardIndex::Delete(Node * pNode)
+{
+    std::map<char,Node*>::iterator q;
+    for(q = pNode->Children.begin();q!=pNode->Children.end();++q)
+        Delete(q->second);
+    delete pNode;
+}
+
+WildcardIndex::Node * WildcardIndex::NodeFor(const std::string & sPrefix,bool bMake)
+{
+    Node * pNode = m_pRoot;
+    for(size_t i = 0;i<sPrefix.size();i++)
+    {
+        std::map<char,Node*>::iterator q = pNode->Children.find(sPrefix[i]);
+        if(q==pNode->Children.end())
+        {
+            if(!bMake)
+                return NULL;
+            q = pNode->Children.insert(std::make_pair(sPrefix[i],new Node)).first;
+        }
+        pNode = q->second;
+    }
+    return pNode;
+}
+
+void WildcardIndex::Prune(const std::string & sPrefix)
+{
+    std::vector<Node*> Path(1,m_pRoot);
+    for(size_t i = 0;i<sPrefix.size();i++)
+    {
+        std::map<char,Node*>::iterator q = Path.back()->Children.find(sPrefix[i]);
+        if(q==Path.back()->Children.end())
+            return;
+        Path.push_back(q->second);
+    }
+
+    for(size_t i = Path.size()-1;i>0;i--)
+    {
+        Node * pNode = Path[i];
+        if(!pNode->Entries.empty() || !pNode->Children.empty())
+            break;
+        Path[i-1]->Children.erase(sPrefix[i-1]);
+        delete pNode;
+    }
+}
+
+bool WildcardIndex::Add(const std::string & sClient,const MsgFilter & Filter)
+{
+    if(!m_ClientFilters[sClient].insert(Filter).second)
+        return false;
+
+    Entry E;
+    E.sClient = sClient;
+    E.Filter = Filter;
+    E.Var = CompiledGlob(Filter.var_filter());
+    E.App = CompiledGlob(Filter.app_filter());
+
+    NodeFor(E.Var.Prefix(),true)->Entries.push_back(E);
+    m_nSize++;
+
+    return true;
+}
+
+bool WildcardIndex::Remove(const std::string & sClient,const MsgFilter & Filter)
+{
+    std::map<std::string,std::set<MsgFilter> >::iterator p = m_ClientFilters.find(sClient);
+    if(p==m_ClientFilters.end() || p->second.erase(Filter)==0)
+        return false;
+
+    if(p->second.empty())
+        m_ClientFilters.erase(p);
+
+    std::string sPrefix = CompiledGlob(Filter.var_filter()).Prefix();
+    Node * pNode = NodeFor(sPrefix,false);
+    if(pNode==NULL)
+        return false;
+
+    //filters compare equal on their patterns alone
+    std::vector<Entry>::iterator q;
+    for(q = pNode->Entries.begin();q!=pNode->Entries.end();++q)
+    {
+        if(q->sClient==sClient && !(q->Filter<Filter) && !(Filter<q->Filter))
+        {
+            pNode->Entries.erase(q);
+            m_nSize--;
+            break;
+        }
+    }
+
+    Prune(sPrefix);
+
+    return true;
+}
+
+void WildcardIndex::RemoveClient(const std::string & sClient)
+{
+    std::map<std::string,std::set<MsgFilter> >::iterator p = m_ClientFilters.find(sClient);
+    if(p==m_ClientFilters.end())
+        return;
+
+    //take a copy as Remove() edits the original
+    std::set<MsgFilter> Filters = p->second;
+    std::set<MsgFilter>::iterator q;
+    for(q = Filters.begin();q!=Filters.end();++q)
+        Remove(sClient,*q);
+}
+
+void WildcardIndex::Find(const std::string & sVar,const std::string & sSrc,std::vector<Match> & Matches) const
+{
+    //every node on the way down holds filters whose prefix sVar starts with
+    const Node * pNode = m_pRoot;
+    for(size_t i = 0;;i++)
+    {
+        std::vector<Entry>::const_iterator q;
+        for(q = pNode->Entries.begin();q!=pNode->Entries.end();++q)
+        {
+            if(q->Var.Matches(sVar) && q->App.Matches(sSrc))
+            {
+                Matches.push_back(Match());
+                Matches.back().sClient = q->sClient;
+                Matches.back().Filter = q->Filter;
+            }
+        }
+
+        if(i==sVar.size())
+            break;
+
+        std::map<char,Node*>::const_iterator c = pNode->Children.find(sVar[i]);
+        if(c==pNode->Children.end())
+            break;
+        pNode = c->second;
+    }
+}
+
+unsigned int WildcardIndex::Size() const
+{
+    return m_nSize;
+}
+
+}
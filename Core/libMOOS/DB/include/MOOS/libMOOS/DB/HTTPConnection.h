@@ -35,6 +35,7 @@
 class XPCTcpSocket;
 class CMOOSCommClient;
 class CMOOSLock;
+class CMOOSDB;
 
 
 
@@ -146,33 +147,46 @@ public:
 
 
 
-    /** simple constructor*/
-    CHTTPConnection(XPCTcpSocket* pNewSocket,CMOOSCommClient* pMOOSComms,CMOOSLock* pMOOSCommsLock);
+    /** simple constructor. If pDB is not NULL variables are read straight
+    from it rather than requested through the comms client*/
+    CHTTPConnection(XPCTcpSocket* pNewSocket,CMOOSCommClient* pMOOSComms,CMOOSLock* pMOOSCommsLock,CMOOSDB* pDB = NULL);
 
-    /** start the connection processing...*/
-    bool Run();
+    ~CHTTPConnection();
 
-    /** has the connection terminated?*/
-    bool HasCompleted();
+    /** the socket to watch */
+    int GetSocketFD();
 
-    /** call back to allow Serve to run in MOOSThread*/
-    static bool _CB(void* pParam)
-    {
-        CHTTPConnection* pMe = (CHTTPConnection*) pParam;
-        return pMe->Serve();
-    }
+    /** read whatever the client has sent and answer any whole requests.
+    Call when the socket is readable. Returns false when the client has
+    gone */
+    bool OnReadable();
+
+    /** send as much of the pending reply as the socket will take. Call
+    when the socket is writable */
+    bool OnWritable();
+
+    /** is there a reply waiting to be sent?*/
+    bool HasPendingReply(){return m_nSent<m_sOutput.size();}
+
+    /** has the connection terminated? (either end closed it or it has
+    been idle longer than dfIdleTimeOut seconds)*/
+    bool HasCompleted(double dfIdleTimeOut);
 
 
 protected:
-    /** main sequence of response actions */
-    bool Serve();
+    /** answer one request whose header is sHeader */
+    bool Serve(const std::string & sHeader);
     /** Makes a webpage */
     bool MakeWebPage();
-    /** Sends an all OK header detailing length of page to follow */
-    bool SendHeader();
-    /** Sends a 404 error header */
+    /** answers requests for /json, returning false if the request is for
+    something else */
+    bool MakeJSON(const std::string & sQuery);
+    /** queue an all OK header detailing length of page to follow */
+    bool SendHeader(const std::string & sContentType = "text/html; charset=ISO-8859-1",
+                    const std::string & sExtraHeaders = "");
+    /** queue a 404 error header */
     bool SendFailureHeader();
-	/** Send the webpage itself*/
+	/** queue the webpage itself*/
     bool SendWebPage();
     /** respond to someone putting data */
     bool HandlePoke(std::string sPokeURL);
@@ -180,21 +194,17 @@ protected:
     bool BuildSingleVariableWebPageContents( std::ostringstream & wp,MOOSMSG_LIST & MsgList);
     /** build we page of whole DB*/
     bool BuildFullDBWebPageContents( std::ostringstream & wp,MOOSMSG_LIST & MsgList);
-	/** read a request header*/
-    bool ReadRequest();
+	/** parse a request header*/
+    bool ReadRequest(const std::string & sHeader, std::string & sQuery);
 
-    /** read a single line from client */
-    bool ReadLine(std::string &);
-	/** lower level send string with appended \r\n */
+	/** lower level queue string with appended \r\n */
     void SendLine(std::string sLine);
-    /** lower level send string (no line feed cr appended) */
-    void SendString(std::string sLine);
+    /** lower level queue string (no line feed cr appended) */
+    void SendString(const std::string & sLine);
     
     
     /** string containing the webpage iteself*/
     std::string m_sWebPage;
-    /** Thread object which runs the servicing sequence of commands */
-    CMOOSThread m_ServeThread; 
     /** Socket which hold the Connection */
     XPCTcpSocket* m_pSocket;
     
@@ -210,5 +220,23 @@ protected:
     /** pointer to a lock which provides protected access to the MOOS comms client object*/
     CMOOSLock * m_pMOOSCommsLock;
 
+    /** the DB we are serving (if it is in this process)*/
+    CMOOSDB * m_pDB;
+
+    /** what has been read but not yet answered */
+    std::string m_sInput;
+
+    /** replies not yet sent and how much of them has been */
+    std::string m_sOutput;
+    size_t m_nSent;
+
+    /** body bytes of the last request still to be read and ignored */
+    size_t m_nToDiscard;
+
+    /** should the connection close once the reply is sent?*/
+    bool m_bCloseWhenSent;
+    bool m_bClosed;
+    double m_dfLastActivity;
+
 };
 #endif
@@ -31,23 +31,37 @@
 
 #include <string>
 #include <map>
+#include <list>
 #include <memory>
+#include <vector>
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#endif
 
 #include "MOOS/libMOOS/Utils/ProcessConfigReader.h"
 #include "MOOS/libMOOS/Utils/MOOSScopedPtr.h"
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Utils/LockFreeQueue.h"
+#include "MOOS/libMOOS/Thirdparty/PocoBits/AtomicCounter.h"
 
 #include "MOOS/libMOOS/Comms/CommsTypes.h"
 #include "MOOS/libMOOS/Comms/MOOSMsg.h"
+#include "MOOS/libMOOS/Comms/CompactMsg.h"
 #include "MOOS/libMOOS/Comms/ThreadedCommServer.h"
+#include "MOOS/libMOOS/Comms/EpollCommServer.h"
 #include "MOOS/libMOOS/Comms/SuicidalSleeper.h"
 
 #include "MOOS/libMOOS/DB/MOOSDBVar.h"
 #include "MOOS/libMOOS/DB/MOOSDBHTTPServer.h"
 #include "MOOS/libMOOS/DB/MsgFilter.h"
+#include "MOOS/libMOOS/DB/WildcardIndex.h"
 #include "MOOS/libMOOS/DB/MOOSDBLogger.h"
 
 #define HASH_MAP_TYPE std::map
-typedef HASH_MAP_TYPE<std::string,MOOSMSG_LIST> MOOSMSG_LIST_STRING_MAP;
 typedef HASH_MAP_TYPE<std::string,CMOOSDBVar> DBVAR_MAP;
 
 
@@ -67,6 +81,10 @@ public:
     entry back into this object by invoking OnRxPkt()*/
     static  bool OnRxPktCallBack(const std::string & sClient, MOOSMSG_LIST & MsgLstRx,MOOSMSG_LIST & MsgLstTx, void * pParam);
 
+    /** as above but hands us views into the received packet - used by servers
+    that support it to save copying every incoming message*/
+    static  bool OnRxPktViewCallBack(const std::string & sClient, MOOS::MsgViewVector & RxViews,MOOSMSG_LIST & MsgLstTx, void * pParam);
+
     /** called internally when a client disconnects */
     static bool OnDisconnectCallBack(std::string & sClient,void * pParam);
 
@@ -75,14 +93,34 @@ public:
 
     static bool OnFetchAllMailCallBack(const std::string & sWho,MOOSMSG_LIST & MsgListTx, void * pParam);
 
+    /** as above but hands over the held mail without copying it*/
+    static bool OnFetchAllSharedMailCallBack(const std::string & sWho,MOOSMSG_PTR_LIST & SharedListTx, void * pParam);
+
+    /** called by the server to find out who has been sent mail since it last asked*/
+    static bool OnFetchClientsWithMailCallBack(STRING_LIST & Clients, void * pParam);
+
     /** called internally when a MOOSPkt (a collection of MOOSMsg's ) is
     received by the server */
     bool OnRxPkt(const std::string & sClient,MOOSMSG_LIST & MsgLstRx,MOOSMSG_LIST & MsgLstTx);
 
+    /** called internally when a MOOSPkt has been decoded into views */
+    bool OnRxPkt(const std::string & sClient,MOOS::MsgViewVector & RxViews,MOOSMSG_LIST & MsgLstTx);
+
     bool OnFetchAllMail(const std::string & sWho,MOOSMSG_LIST & MsgListTx);
 
+    bool OnFetchAllSharedMail(const std::string & sWho,MOOSMSG_PTR_LIST & SharedListTx);
+
+    bool OnFetchClientsWithMail(STRING_LIST & Clients);
+
     bool SetQuiet(bool bQuiet);
 
+    /** split the variable store into nThreads shards each of which is
+    serviced by its own thread. Notifications and (un)registrations are
+    handed to the shard owning their key so writes to unrelated variables are
+    processed in parallel. With nThreads<=1 (the default) everything happens
+    on the comms server thread. Call before Run() */
+    bool SetDispatchThreads(unsigned int nThreads);
+
     /** called by the owning application to start the DB running. It launches threads
     and returns */
     bool Run(int argc = 0,  char * argv[] =0);
@@ -97,6 +135,20 @@ public:
      */
     std::string GetMissionFile(){return m_MissionReader.GetFileName();};
 
+    /** copies of every variable as messages (just what a server request
+    for "ALL" returns) without going through the comms */
+    void GetVariables(MOOSMSG_LIST & Vars);
+
+    /** the variables as a JSON document. If nSince is not zero only
+    variables changed after change number nSince are included. The document
+    (and nChange) gives the number of the last change it reflects. Whole
+    snapshots are kept and reused until something changes */
+    void GetVariablesAsJSON(uint64_t nSince, std::string & sJSON, uint64_t & nChange);
+
+    /** the number of the last change to any variable. Changes are numbered
+    from 1 as the DB runs */
+    uint64_t GetLastChange();
+
 
     CMOOSDB();
     virtual ~CMOOSDB();
@@ -105,7 +157,17 @@ protected:
 
     bool OnClearRequested(CMOOSMsg & Msg, MOOSMSG_LIST & MsgTxList);
     void Var2Msg(CMOOSDBVar & Var, CMOOSMsg &Msg);
-    bool AddMessageToClientBox(const std::string &sClient,CMOOSMsg & Msg);
+    struct Shard;
+
+    /** put a message in the mail a client collects from rShard (with its lock
+    held). nStamp orders it amongst the client's mail from other shards*/
+    bool AddMessageToClientBox(Shard & rShard, unsigned int nClientID, uint64_t nStamp,
+            const MOOSMSG_PTR & pMsg,bool bLatestOnly = false);
+
+    /** return the small integer by which we know a client, making one up
+    if this is the first time we have heard of them. Names map to the same
+    ID for the lifetime of the DB so a reconnecting client gets its old ID*/
+    unsigned int ClientID(const std::string & sClient);
     bool VariableExists(const std::string & sVar);
     bool DoVarLookup(CMOOSMsg & Msg, MOOSMSG_LIST &MsgTxList);
 
@@ -120,18 +182,124 @@ protected:
     void UpdateDBTimeVars();
     void UpdateDBClientsVar();
     void UpdateSummaryVar();
+
+    /** note that rVar's row of DB_VARSUMMARY needs making again (with
+    its shard lock held)*/
+    void MarkSummaryDirty(CMOOSDBVar & rVar);
+
+    /** put remade rows (row number, text) into m_sVarSummary*/
+    void SpliceSummaryRows(std::vector<std::pair<int,std::string> > & Rows);
     void UpdateQoSVar();
     void UpdateReadWriteSummaryVar();
+    std::string MakeReadWriteSummary(STRING_LIST & Clients);
 
     bool DoServerRequest(CMOOSMsg & Msg, MOOSMSG_LIST & MsgTxList);
     CMOOSDBVar & GetOrMakeVar(CMOOSMsg & Msg);
     bool OnRegister(CMOOSMsg & Msg);
     bool OnUnRegister(CMOOSMsg &Msg);
     bool OnNotify(CMOOSMsg & Msg);
+    bool OnNotify(const MOOS::MsgView & View);
+
+    /** these do the work for a single key and expect the lock of
+    the shard owning the key to be held*/
+    bool DoRegister(CMOOSMsg & Msg);
+    bool DoUnRegister(CMOOSMsg & Msg);
+    bool DoNotify(CMOOSMsg & Msg);
+    void UpdateWriteStatistics(CMOOSDBVar & rVar, double dfTimeNow);
+
+    /** number a change to a variable (with its shard lock held)*/
+    void StampChange(CMOOSDBVar & rVar);
+
+    /** record whether a client can fetch what peer to peer stubs stand in for */
+    void SetFollowsStubs(const std::string & sClient, bool bFollowsStubs);
+    bool FollowsStubs(unsigned int nClientID);
+
+    /** can every subscriber to rVar follow stubs? */
+    bool AllFollowStubs(CMOOSDBVar & rVar);
+
+    /** send a stub back to its writer */
+    bool RefuseStub(const CMOOSMsg & Stub);
+
+    /** the next change number */
+    uint64_t NextChange();
+
+    /** rVar's entry in a JSON snapshot (with its shard lock held)*/
+    const std::string & VarAsJSON(CMOOSDBVar & rVar);
+
+    /** make a JSON document of the variables changed after nSince which
+    reflects changes up to nChange*/
+    void MakeJSON(uint64_t nSince, uint64_t nChange, std::string & sJSON);
+    bool OnRxPktComplete(const std::string & sClient, bool bCollectMail, MOOSMSG_LIST & MsgLstTx);
     bool ProcessMsg(CMOOSMsg & MsgRx,MOOSMSG_LIST & MsgLstTx);
     double GetStartTime(){return m_dfStartTime;}
     void OnPrintVersionAndExit();
 
+    /**mail waiting for a client, each message stamped with the change
+    number which orders it amongst the client's mail from other shards*/
+    typedef std::list<std::pair<uint64_t,MOOSMSG_PTR> > STAMPED_MAIL;
+
+    /**for each client, where in its mail the pending message for each
+    variable it wants only the latest value of is (so it can be replaced)*/
+    typedef std::map<std::string,STAMPED_MAIL::iterator> LATEST_ONLY_SLOTS;
+
+    /** The variables are partitioned by a hash of their name into shards.
+    Each shard has its own lock and, when the DB dispatches on more than one
+    thread, a mailbox of keyed messages and a worker thread to process them.
+    Notifications of changes to a shard's variables wait, indexed by client
+    ID, in the shard's own mail boxes until the client collects them. It also
+    lists the variables whose DB_VARSUMMARY rows are out of date.
+    Locks are taken in the order shard, filters, client IDs and never more
+    than one shard lock is held at a time*/
+    struct Shard
+    {
+        Shard():pDB(NULL),nBarriersSent(0),nBarrierPassed(0){}
+
+        CMOOSDB * pDB;
+        DBVAR_MAP Vars;
+        CMOOSLock Lock;
+        MOOS::LockFreeQueue<MOOS::CompactMsg> MailBox;
+        CMOOSThread Worker;
+        std::vector<std::string> SummaryDirty;
+
+        //by client ID, guarded by Lock
+        std::vector<STAMPED_MAIL> ClientMail;
+        std::vector<LATEST_ONLY_SLOTS> LatestOnlySlots;
+        std::vector<bool> HasNewMail;
+        std::vector<unsigned int> ClientsWithMail;
+
+        //barriers put in MailBox (numbered under BarrierLock) and
+        //the number of the last one Worker has passed
+        CMOOSLock BarrierLock;
+        int nBarriersSent;
+        MOOS::Poco::AtomicCounter nBarrierPassed;
+    };
+
+    static bool ShardWorkerEntry(void * pParam);
+    bool ShardWorkerLoop(Shard * pShard);
+    unsigned int ShardIndex(const std::string & sKey) const;
+    Shard & ShardFor(const std::string & sKey);
+    bool IsShardedDispatch() const {return m_Shards.size()>1;}
+    bool IsKeyedMsg(char cMsgType) const;
+    void DispatchToShards(std::vector<MOOS::COMPACT_MSG_LIST> & Batches);
+
+    /** wait until every shard has processed all it has been handed so far.
+    Messages which look at more than one shard (a server request, a wildcard
+    registration...) wait for this so they see what came before them */
+    void WaitForShards();
+
+    /** Worker has reached a barrier put in its MailBox */
+    void OnShardBarrier(Shard & rShard, int nBarrier);
+    void StopShards();
+    void RemoveClientFromShard(Shard & rShard, std::string & sClient);
+
+    /** names of the variables in a shard whose names match Var and which
+    were last written by a client matching App (shard lock must be held)*/
+    void FindVarsMatching(Shard & rShard,
+            const MOOS::CompiledGlob & Var,
+            const MOOS::CompiledGlob & App,
+            std::vector<std::string> & Names);
+    bool ProcessShardMsg(Shard & rShard, CMOOSMsg & Msg);
+
 private:
     std::string m_sDBName;
     std::string m_sCommunityName;
@@ -141,19 +309,62 @@ private:
     bool m_bQuiet;
     double m_dfSummaryTime;
 
+    /**should the rows of DB_VARSUMMARY which changed also be
+    published on their own as DB_VARSUMMARY_DELTA?*/
+    bool m_bVarSummaryDeltas;
+
+    /**DB_VARSUMMARY as it stands, where each of its rows starts and a lock
+    to keep more than one thread from bringing it up to date*/
+    std::string m_sVarSummary;
+    std::vector<size_t> m_SummaryRowStart;
+    CMOOSLock m_SummaryLock;
 
-    /**a map of client name to a list of Msgs that will be sent
-    the next time a client calls in*/
-    MOOSMSG_LIST_STRING_MAP m_HeldMailMap;
-    DBVAR_MAP    m_VarMap;
+    /**bumped whenever who reads or writes what changes and the
+    value it had when m_sRWSummary (for m_RWSummaryClients) was made*/
+    MOOS::Poco::AtomicCounter m_RWSummaryChanges;
+    int m_nRWSummaryChanges;
+    std::string m_sRWSummary;
+    STRING_LIST m_RWSummaryClients;
 
 
+    /**client names to IDs and, indexed by ID, client names and whether they
+    can follow peer to peer stubs. All guarded by m_ClientIDLock (the mail
+    itself lives in the shards)*/
+    std::map<std::string,unsigned int> m_ClientIDs;
+    std::vector<std::string> m_ClientNames;
+    std::vector<bool> m_FollowsStubs;
+    CMOOSLock m_ClientIDLock;
 
-    HASH_MAP_TYPE<std::string,std::set< MOOS::MsgFilter > > m_ClientFilters;
+    /**all the variables we know about, split by key hash*/
+    std::vector<Shard*> m_Shards;
+
+
+    /**every client's wildcard subscriptions, guarded by m_FiltersLock*/
+    MOOS::WildcardIndex m_Wildcards;
+    CMOOSLock m_FiltersLock;
 
     //pointer to a webserver if one is needed
     MOOS::ScopedPtr<CMOOSDBHTTPServer> m_pWebServer;
 
+    /**the number of the last change to any variable*/
+#if __cplusplus >= 201103L
+    std::atomic<uint64_t> m_nLastChange;
+#else
+    uint64_t m_nLastChange;
+    CMOOSLock m_ChangeLock;
+#endif
+
+    /**woken when a shard passes a barrier (see WaitForShards())*/
+#if __cplusplus >= 201103L
+    std::mutex m_BarrierMutex;
+    std::condition_variable m_BarrierPassed;
+#endif
+
+    /**the last whole JSON snapshot made and the change it reflects*/
+    std::string m_sJSONSnapshot;
+    uint64_t m_nJSONSnapshotChange;
+    CMOOSLock m_JSONSnapshotLock;
+
     //pointer to the comms server (could be a threaded one but base class is CMOOSCommServer
     MOOS::ScopedPtr<CMOOSCommServer> m_pCommServer;
 
@@ -30,6 +30,7 @@
 class XPCTcpSocket;
 class CHTTPConnection;
 class CMOOSCommClient;
+class CMOOSDB;
 
 
 
@@ -44,6 +45,11 @@ public:
     /**this constructor allows the web server port to specified in
     addition to the DB Port */
     CMOOSDBHTTPServer(long lDBPort, long lWebServerPort);
+
+    /**this constructor is for a web server running inside the DB. Pages
+    are made from the DB's variables directly (and only then is the JSON
+    snapshot of the variables at /json available) */
+    CMOOSDBHTTPServer(long lDBPort, long lWebServerPort, CMOOSDB * pDB);
     
     virtual ~CMOOSDBHTTPServer(void);
 
@@ -57,12 +63,13 @@ public:
 private:
 
     /**start everything up*/
-    void Initialise(long lDBPort, long lWebServerPort);
+    void Initialise(long lDBPort, long lWebServerPort, CMOOSDB * pDB);
 
     /**print warm fuzzies*/
     void DoBanner();
 
-    /**do the listening*/
+    /**do the listening and serve every connection from one thread as
+    their sockets become ready*/
     bool Listen();   
 
     /**web server port*/
@@ -83,5 +90,8 @@ private:
     /**pointer to a single  lock object shared by all connection threads*/
     CMOOSLock *m_pMOOSCommsLock;
 
+    /**the DB we belong to (NULL if it is in another process)*/
+    CMOOSDB * m_pDB;
+
 };
 #endif
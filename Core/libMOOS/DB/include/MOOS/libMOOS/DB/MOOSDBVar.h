@@ -36,6 +36,8 @@
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
+#include <stdint.h>
 
 using namespace std;
 
@@ -44,7 +46,9 @@ typedef set<string> STRING_SET;
 #include "MOOSRegisterInfo.h"
 
 
-typedef map<string,CMOOSRegisterInfo> REGISTER_INFO_MAP;
+//subscribers are kept in a flat vector - it is walked on every write
+//but only searched when subscriptions change
+typedef vector<CMOOSRegisterInfo> REGISTER_INFO_VECTOR;
 
 
 class CMOOSDBVar  
@@ -57,8 +61,9 @@ public:
 
     bool Reset();
     void RemoveSubscriber(string & sWho);
-    bool AddSubscriber(const string & sClient, double dfPeriod);
+    bool AddSubscriber(const string & sClient, unsigned int nClientID, double dfPeriod, bool bLatestOnly = false);
     bool HasSubscriber(const string & sClient);
+    REGISTER_INFO_VECTOR::iterator FindSubscriber(const string & sClient);
     bool GetUpdatePeriod(const string & sClient, double & dfPeriod);
 
     char   m_cDataType;
@@ -81,8 +86,21 @@ public:
     // number of times written to
     int     m_nWrittenTo;
 
+    // which line of DB_VARSUMMARY is ours (-1 until we have one) and
+    // the value of m_nWrittenTo when it was made (-1 if it needs making
+    // again)
+    int    m_nSummaryRow;
+    int    m_nSummaryWrites;
 
-    REGISTER_INFO_MAP m_Subscribers;
+    // the DB wide change number of the last change to this variable (0
+    // if it hasn't changed since the DB started) and our entry in the
+    // web server's JSON snapshot as of change m_nJSONChange
+    uint64_t m_nChange;
+    string   m_sJSON;
+    uint64_t m_nJSONChange;
+
+
+    REGISTER_INFO_VECTOR m_Subscribers;
     STRING_SET m_Writers;
 
 };
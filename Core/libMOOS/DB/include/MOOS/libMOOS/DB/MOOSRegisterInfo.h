@@ -44,8 +44,15 @@ public:
     bool Expired(double dfTimeNow);
     double m_dfPeriod;
     string m_sClientName;
+
+    //small integer the DB has given this client (indexes its mail box)
+    unsigned int m_nClientID;
     double m_dfLastTimeSent;
 
+    //does the client only want the latest value waiting for it
+    //rather than every notification since it last called in?
+    bool m_bLatestOnly;
+
     CMOOSRegisterInfo();
     virtual ~CMOOSRegisterInfo();
 
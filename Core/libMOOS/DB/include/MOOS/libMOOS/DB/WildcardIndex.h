@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * WildcardIndex.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef WILDCARDINDEX_H_
+#define WILDCARDINDEX_H_
+
+#include "MOOS/libMOOS/DB/MsgFilter.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace MOOS
+{
+
+/**
+ * A wildcard pattern ('*' and '?', as understood by MOOSWildCmp) which has been
+ * taken apart once so that it can be matched many times without rescanning it.
+ * The pattern is held as the literal text before the first wildcard (used to
+ * index it) and the runs of text between '*'s which are then found left to
+ * right in the candidate string.
+ */
+class CompiledGlob
+{
+public:
+    CompiledGlob();
+    explicit CompiledGlob(const std::string & sPattern);
+
+    /** does the whole of sString match the pattern? */
+    bool Matches(const std::string & sString) const;
+
+    /** the literal characters every match must start with */
+    const std::string & Prefix() const {return m_sPrefix;}
+
+    /** true if the pattern has no '*' or '?' in it */
+    bool IsLiteral() const {return m_bLiteral;}
+
+    const std::string & Pattern() const {return m_sPattern;}
+
+private:
+    /** does sSegment ('?' matching anything) match sString at nPos? */
+    static bool SegmentAt(const std::string & sSegment,const std::string & sString,size_t nPos);
+
+    /** find sSegment in sString between nFrom and nTo. Returns npos if absent*/
+    static size_t FindSegment(const std::string & sSegment,const std::string & sString,size_t nFrom,size_t nTo);
+
+    std::string m_sPattern;
+    std::string m_sPrefix;
+    std::vector<std::string> m_Segments;
+    bool m_bLiteral;
+};
+
+/**
+ * All the wildcard subscriptions the DB knows about, indexed so that finding
+ * the ones interested in a newly written variable does not mean testing every
+ * filter of every client. Filters are hung off a trie keyed by the literal
+ * prefix of their variable pattern, so a lookup walks the key once and only
+ * tests filters whose prefix the key actually starts with.
+ */
+class WildcardIndex
+{
+public:
+    struct Match
+    {
+        std::string sClient;
+        MsgFilter Filter;
+    };
+
+    WildcardIndex();
+    ~WildcardIndex();
+
+    /** add a filter for sClient. Returns false if it already had it*/
+    bool Add(const std::string & sClient,const MsgFilter & Filter);
+
+    /** remove one filter from sClient. Returns false if it wasn't there*/
+    bool Remove(const std::string & sClient,const MsgFilter & Filter);
+
+    /** remove every filter belonging to sClient*/
+    void RemoveClient(const std::string & sClient);
+
+    /** append to Matches every filter which matches variable sVar written by sSrc*/
+    void Find(const std::string & sVar,const std::string & sSrc,std::vector<Match> & Matches) const;
+
+    /** how many filters are there in total?*/
+    unsigned int Size() const;
+
+private:
+    WildcardIndex(const WildcardIndex &);
+    WildcardIndex & operator=(const WildcardIndex &);
+
+    struct Entry
+    {
+        std::string sClient;
+        MsgFilter Filter;
+        CompiledGlob Var;
+        CompiledGlob App;
+    };
+
+    struct Node
+    {
+        std::map<char,Node*> Children;
+        std::vector<Entry> Entries;
+    };
+
+    /** the node for sPrefix, optionally making it (and its parents)*/
+    Node * NodeFor(const std::string & sPrefix,bool bMake);
+
+    /** remove any nodes left with nothing in or below them along sPrefix*/
+    void Prune(const std::string & sPrefix);
+
+    static void Delete(Node * pNode);
+
+    Node * m_pRoot;
+    std::map<std::string,std::set<MsgFilter> > m_ClientFilters;
+    unsigned int m_nSize;
+};
+
+}
+
+#endif /* WILDCARDINDEX_H_ */
@@ -0,0 +1,231 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * LZCompression.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Utils/LZCompression.h"
+
+#include <cstring>
+
+namespace
+{
+const unsigned int kMinMatch = 4;
+const unsigned int kMaxOffset = 65535;
+const unsigned int kHashBits = 13;
+
+//as per LZ4 the last few bytes are always literals which lets a decoder
+//run flat out without checking for the end of a match
+const unsigned int kLastLiterals = 5;
+const unsigned int kMatchFindLimit = 12;
+
+inline unsigned int Read32(const unsigned char * p)
+{
+    unsigned int n;
+    memcpy(&n,p,sizeof(n));
+    return n;
+}
+
+inline unsigned int Hash(unsigned int nSequence)
+{
+    return (nSequence*2654435761U)>>(32-kHashBits);
+}
+
+inline unsigned char * WriteLength(unsigned char * pOut, unsigned int nLength)
+{
+    while(nLength>=255)
+    {
+        *pOut++ = 255;
+        nLength-=255;
+    }
+    *pOut++ = (unsigned char)nLength;
+    return pOut;
+}
+
+//one literal run followed (unless nMatch is zero) by a back reference.
+//returns where the next sequence goes
+unsigned char * WriteSequence(unsigned char * pOut,
+        const unsigned char * pLiterals,
+        unsigned int nLiterals,
+        unsigned int nOffset,
+        unsigned int nMatch)
+{
+    unsigned int nMatchCode = nMatch ? nMatch-kMinMatch : 0;
+
+    *pOut++ = (unsigned char)( ((nLiterals<15 ? nLiterals : 15)<<4) |
+            (nMatchCode<15 ? nMatchCode : 15) );
+
+    if(nLiterals>=15)
+        pOut = WriteLength(pOut,nLiterals-15);
+
+    memcpy(pOut,pLiterals,nLiterals);
+    pOut+=nLiterals;
+
+    if(nMatch==0)
+        return pOut;
+
+    *pOut++ = (unsigned char)(nOffset & 0xFF);
+    *pOut++ = (unsigned char)(nOffset>>8);
+
+    if(nMatchCode>=15)
+        pOut = WriteLength(pOut,nMatchCode-15);
+
+    return pOut;
+}
+
+bool ReadLength(const unsigned char * & p, const unsigned char * pEnd, unsigned int & nLength)
+{
+    unsigned char c;
+    do
+    {
+        if(p==pEnd)
+            return false;
+        c = *p++;
+        nLength+=c;
+    }while(c==255);
+
+    return true;
+}
+
+}
+
+namespace MOOS
+{
+namespace LZ
+{
+
+unsigned int CompressBound(unsigned int nSize)
+{
+    return nSize+nSize/255+16;
+}
+
+unsigned int Compress(const unsigned char * pIn, unsigned int nSize, unsigned char * pOut)
+{
+    unsigned char * q = pOut;
+
+    unsigned int nAnchor = 0;
+
+    if(nSize>kMatchFindLimit)
+    {
+        //positions (plus one so zero means empty) of recently seen sequences
+        std::vector<unsigned int> Table(1<<kHashBits,0);
+
+        const unsigned int nSearchLimit = nSize-kMatchFindLimit;
+        const unsigned int nMatchLimit = nSize-kLastLiterals;
+
+        unsigned int i = 0;
+        while(i<nSearchLimit)
+        {
+            unsigned int nSequence = Read32(pIn+i);
+            unsigned int & rSlot = Table[Hash(nSequence)];
+            unsigned int nCandidate = rSlot;
+            rSlot = i+1;
+
+            if(nCandidate==0 || i+1-nCandidate>kMaxOffset || Read32(pIn+nCandidate-1)!=nSequence)
+            {
+                //skip faster through data which doesn't compress
+                i+=1+((i-nAnchor)>>6);
+                continue;
+            }
+
+            unsigned int nRef = nCandidate-1;
+            unsigned int nMatch = kMinMatch;
+            while(i+nMatch<nMatchLimit && pIn[nRef+nMatch]==pIn[i+nMatch])
+                nMatch++;
+
+            q = WriteSequence(q,pIn+nAnchor,i-nAnchor,i-nRef,nMatch);
+
+            i+=nMatch;
+            nAnchor = i;
+        }
+    }
+
+    //whatever is left goes as literals
+    q = WriteSequence(q,pIn+nAnchor,nSize-nAnchor,0,0);
+
+    return (unsigned int)(q-pOut);
+}
+
+void Compress(const unsigned char * pIn, unsigned int nSize, std::vector<unsigned char> & Out)
+{
+    Out.resize(CompressBound(nSize));
+    Out.resize(Compress(pIn,nSize,&Out[0]));
+}
+
+bool Decompress(const unsigned char * pIn, unsigned int nSize, unsigned char * pOut, unsigned int nOutSize)
+{
+    const unsigned char * p = pIn;
+    const unsigned char * pEnd = pIn+nSize;
+    unsigned char * q = pOut;
+    unsigned char * qEnd = pOut+nOutSize;
+
+    while(p<pEnd)
+    {
+        unsigned char Token = *p++;
+
+        unsigned int nLiterals = Token>>4;
+        if(nLiterals==15 && !ReadLength(p,pEnd,nLiterals))
+            return false;
+
+        if((unsigned int)(pEnd-p)<nLiterals || (unsigned int)(qEnd-q)<nLiterals)
+            return false;
+
+        memcpy(q,p,nLiterals);
+        p+=nLiterals;
+        q+=nLiterals;
+
+        //the last sequence has no match
+        if(p==pEnd)
+            break;
+
+        if(pEnd-p<2)
+            return false;
+
+        unsigned int nOffset = p[0] | (p[1]<<8);
+        p+=2;
+
+        if(nOffset==0 || nOffset>(unsigned int)(q-pOut))
+            return false;
+
+        unsigned int nMatch = Token & 0x0F;
+        if(nMatch==15 && !ReadLength(p,pEnd,nMatch))
+            return false;
+        nMatch+=kMinMatch;
+
+        if((unsigned int)(qEnd-q)<nMatch)
+            return false;
+
+        //matches may overlap what they are copying so go byte by byte
+        const unsigned char * r = q-nOffset;
+        for(unsigned int k = 0;k<nMatch;k++)
+            *q++ = *r++;
+    }
+
+    return q==qEnd;
+}
+
+}
+}
@@ -46,7 +46,6 @@
 #include "assert.h"
 #include "MOOS/libMOOS/Utils/MOOSLock.h"
 
-#define MAXLINESIZE 2000
 using namespace std;
 
 //////////////////////////////////////////////////////////////////////
@@ -55,86 +54,179 @@ using namespace std;
 
 CMOOSFileReader::CMOOSFileReader()
 {
+    m_pLock = new CMOOSLock();
+    m_bLoaded = false;
+
 	//by default we want to use quotes to allow verbatim
 	//strings
-	EnableVerbatimQuoting(true);
-    m_pLock = new CMOOSLock();
+	m_bEnableVerbatimQuoting = true;
 }
 
 CMOOSFileReader::~CMOOSFileReader()
 {
-    if(IsOpen())
-    {
-        GetFile()->close();
-    }
-
 	delete m_pLock;
 	m_pLock = NULL;
-
-	ClearFileMap();
 }
 
 bool CMOOSFileReader::SetFile(const std::string  & sFile)
 {
+    m_pLock->Lock();
+
     m_sFileName = sFile;
-    
-    //quick check that we can open a file
-    if(GetFile()==NULL)
+
+    bool bResult = LoadFile();
+
+    m_pLock->UnLock();
+
+    return bResult;
+}
+
+void CMOOSFileReader::EnableVerbatimQuoting(bool bEnable)
+{
+    m_pLock->Lock();
+
+    //quoting changes what a line says so the file has to be indexed again
+    if(bEnable!=m_bEnableVerbatimQuoting)
+    {
+        m_bEnableVerbatimQuoting = bEnable;
+
+        if(!m_sFileName.empty())
+            LoadFile();
+    }
+
+    m_pLock->UnLock();
+}
+
+bool CMOOSFileReader::LoadFile()
+{
+    m_bLoaded = false;
+    m_Lines.clear();
+    m_Values.clear();
+    m_Blocks.clear();
+    m_Cursors.clear();
+    m_LocalShellVariables.clear();
+
+    std::ifstream File(m_sFileName.c_str());
+    if(!File.is_open())
         return false;
 
-    THREAD2FILE_MAP::iterator p;
+    m_bLoaded = true;
 
-    for(p=m_FileMap.begin();p!=m_FileMap.end();++p)
+    //one pass to find the lines which say something...
+    std::string sLine;
+    unsigned int nLine = 0;
+    while(std::getline(File,sLine))
     {
-        std::ifstream * pFile = p->second;
+        nLine++;
+
+        if(IsComment(sLine) || sLine.empty())
+            continue;
+
+        ValidLine L;
+        L.nLine = nLine;
+        L.sText = StripComments(sLine);
+        m_Lines.push_back(L);
+    }
 
-        if(pFile!=NULL)
+    //...local variables can be defined anywhere so find them all before
+    //expanding anything, and then expand every line just the once
+    BuildLocalShellVars();
+
+    for(size_t i = 0;i<m_Lines.size();i++)
+    {
+        m_Lines[i].sExpanded = m_Lines[i].sText;
+        DoVariableExpansion(m_Lines[i].sExpanded);
+    }
+
+    //now index every "token = value" and the blocks they start
+    for(size_t i = 0;i<m_Lines.size();i++)
+    {
+        std::string sTok,sVal;
+        if(GetTokenValPair(m_Lines[i].sExpanded,sTok,sVal))
         {
-            if(pFile->is_open())
+            MOOSToUpper(sTok);
+
+            IndexedValue V;
+            V.nLine = m_Lines[i].nLine;
+            V.sVal = sVal;
+            m_Values[sTok].push_back(V);
+
+            //only the first block of any name is ever read
+            if(sTok=="PROCESSCONFIG")
             {
-                pFile->close();
+                MOOSToUpper(sVal);
+                if(m_Blocks.find(sVal)==m_Blocks.end())
+                    IndexBlock(sVal,i);
             }
-            delete pFile;
-            p->second = NULL;
         }
     }
-    
-	ClearFileMap();
-    
-    BuildLocalShellVars();
 
     return true;
-
 }
 
-
-std::string CMOOSFileReader::GetNextValidLine(bool bDoSubstitution)
+void CMOOSFileReader::IndexBlock(const std::string & sName,size_t nHeader)
 {
+    ConfigBlock & Block = m_Blocks[sName];
 
+    Block.bOpened = false;
+    Block.bClosed = false;
+    Block.nBegin = Block.nEnd = nHeader+1;
 
-    std::string sLine;
+    //the opening brace has to be on the line after the header...
+    if(Block.nBegin>=m_Lines.size() || !MOOSStartsWith(m_Lines[Block.nBegin].sExpanded,"{"))
+        return;
 
-    if(eof() || !IsOpen())
+    Block.bOpened = true;
+    Block.nBegin++;
+
+    //...and the block runs to the first line starting with a closing one
+    bool bIndexing = true;
+    size_t n;
+    for(n = Block.nBegin;n<m_Lines.size();n++)
     {
-        return sLine;
-    }
+        std::string sLine = m_Lines[n].sExpanded;
+        MOOSTrimWhiteSpace(sLine);
 
-    char Tmp[MAXLINESIZE];
+        if(MOOSStartsWith(sLine,"}"))
+        {
+            Block.bClosed = true;
+            break;
+        }
 
-    //skip white space
-    (*GetFile())>>std::ws;
+        if(!bIndexing)
+            continue;
 
+        std::string sVal(sLine);
+        std::string sTok = MOOSChomp(sVal,"=");
+        MOOSTrimWhiteSpace(sTok);
+        MOOSTrimWhiteSpace(sVal);
 
-    GetFile()->getline(Tmp,sizeof(Tmp));
-    sLine = std::string(Tmp);
+        if(sTok.empty())
+            continue;
 
-    while(GetFile()&& sLine.length()!=0 && IsComment(sLine))
-    {
-        (*GetFile())>>std::ws;
-        GetFile()->getline(Tmp,sizeof(Tmp));
-        sLine = std::string(Tmp);
+        if(sVal.empty())
+        {
+            //a bare line of a matrix has always stopped the search
+            //for parameters so nothing after it can be found
+            if(sLine.find_first_of("[]")!=std::string::npos)
+                bIndexing = false;
+
+            continue;
+        }
+
+        MOOSToUpper(sTok);
+
+        IndexedValue V;
+        V.nLine = m_Lines[n].nLine;
+        V.sVal = sVal;
+        Block.Params[sTok].push_back(V);
     }
 
+    Block.nEnd = n;
+}
+
+std::string CMOOSFileReader::StripComments(std::string sLine)
+{
     // jckerken 8-12-2004 (MIT)
     // remove comments made in line not at beginning
     size_t nC = sLine.find("//");
@@ -169,12 +261,36 @@ std::string CMOOSFileReader::GetNextValidLine(bool bDoSubstitution)
             sLine = "";
     } // end jckerken
 
-    
-    if(bDoSubstitution)
-        DoVariableExpansion(sLine);
-    
-    
-    
+    return sLine;
+}
+
+size_t & CMOOSFileReader::GetCursor()
+{
+#ifdef _WIN32
+    DWORD Me = GetCurrentThreadId(); 
+#else
+    pthread_t Me =  pthread_self();
+#endif
+
+    //a thread we haven't seen before starts at the top of the file
+    return m_Cursors[Me];
+}
+
+std::string CMOOSFileReader::GetNextValidLine(bool bDoSubstitution)
+{
+    std::string sLine;
+
+    m_pLock->Lock();
+
+    size_t & nCursor = GetCursor();
+    if(nCursor<m_Lines.size())
+    {
+        const ValidLine & L = m_Lines[nCursor++];
+        sLine = bDoSubstitution ? L.sExpanded : L.sText;
+    }
+
+    m_pLock->UnLock();
+
     return sLine;
 }
 
@@ -246,33 +362,71 @@ bool CMOOSFileReader::GetValue(std::string sName,int  & nResult)
 
 bool CMOOSFileReader::GetValue(std::string sName,std::string & sResult)
 {
+    MOOSToUpper(sName);
 
-    
-    if(IsOpen())
-    {
-        Reset();
-     
-        GetFile()->seekg(std::ios::beg);
+    m_pLock->Lock();
 
-        std::string sLine,sVal,sTok;
-        while(!GetFile()->eof())
-        {
-            sLine = GetNextValidLine();
+    //the first time a token appears in the file wins
+    TOKEN2VALUES_MAP::iterator p = m_Values.find(sName);
+    bool bFound = p!=m_Values.end();
+    if(bFound)
+        sResult = p->second.front().sVal;
 
-            if(GetTokenValPair(sLine, sTok, sVal))
-            {
-                if(MOOSStrCmp(sTok,sName))
-                {
-                    sResult = sVal;
-                    return true;
-                }
-            }       
+    m_pLock->UnLock();
+
+    return bFound;
+}
+
+bool CMOOSFileReader::GetBlockValue(const std::string & sBlock,const std::string & sName,std::string & sResult)
+{
+    std::string sKey(sBlock);
+    MOOSRemoveChars(sKey," \t\r");
+    MOOSToUpper(sKey);
+
+    m_pLock->Lock();
+
+    bool bFound = false;
+    std::map<std::string,ConfigBlock>::iterator q = m_Blocks.find(sKey);
+    if(q!=m_Blocks.end() && q->second.bClosed)
+    {
+        TOKEN2VALUES_MAP::iterator p = q->second.Params.find(MOOSToUpper(sName));
+        if(p!=q->second.Params.end())
+        {
+            sResult = p->second.front().sVal;
+            bFound = true;
         }
     }
- 
-    return false;
+
+    m_pLock->UnLock();
+
+    return bFound;
 }
 
+bool CMOOSFileReader::GetBlockLines(const std::string & sBlock,std::vector<std::string> & Lines,bool & bClosed)
+{
+    Lines.clear();
+    bClosed = false;
+
+    std::string sKey(sBlock);
+    MOOSRemoveChars(sKey," \t\r");
+    MOOSToUpper(sKey);
+
+    m_pLock->Lock();
+
+    std::map<std::string,ConfigBlock>::iterator q = m_Blocks.find(sKey);
+    bool bFound = q!=m_Blocks.end() && q->second.bOpened;
+    if(bFound)
+    {
+        for(size_t n = q->second.nBegin;n<q->second.nEnd;n++)
+            Lines.push_back(m_Lines[n].sExpanded);
+
+        bClosed = q->second.bClosed;
+    }
+
+    m_pLock->UnLock();
+
+    return bFound;
+}
 
 
 bool CMOOSFileReader::GetValue(std::string  sName,float & fResult)
@@ -318,157 +472,84 @@ bool CMOOSFileReader::GetValue(std::string sName,unsigned int  & nResult)
 
 bool CMOOSFileReader::Reset()
 {
-    bool bResult = true;
-//    m_pLock->Lock();
-    
+    m_pLock->Lock();
 
-    if(IsOpen())
+    bool bResult = m_bLoaded;
+    if(bResult)
     {
-        if(GetFile()->eof())
-        {
-            GetFile()->clear();
-            GetFile()->seekg(ios::beg);
-            
-        }
-        else
-        {
-            std::ifstream * pMyFile = GetFile();
-            pMyFile->seekg(ios::beg);
-        }
-        bResult = true;
-    }
-    else
-    {
-        bResult = false;
+        GetCursor() = 0;
     }
 
-//    m_pLock->UnLock();
+    m_pLock->UnLock();
 
     return bResult;
-
 }
 
 bool CMOOSFileReader::eof()
 {
-    return IsOpen() && GetFile()->eof();
-}
-
-bool CMOOSFileReader::GoTo(std::string sLine)
-{
-      
-    if(IsOpen())
-    {
-        MOOSRemoveChars(sLine," \t\r");
-
-        std::string sTmp;
-        while(!GetFile()->eof())
-        {
-            sTmp = GetNextValidLine();
-            MOOSRemoveChars(sTmp," \t\r");
+    m_pLock->Lock();
 
-            if(MOOSStrCmp(sTmp,sLine))
-            {               
-                return true;
-            }
+    bool bResult = m_bLoaded && GetCursor()>=m_Lines.size();
 
-        }
-    }     
-    else
-    {
-        //MOOSTrace("CMOOSFileReader::GoTo() file not open!\n");
-    }
+    m_pLock->UnLock();
 
-    return false;
+    return bResult;
 }
 
-std::ifstream * CMOOSFileReader::GetFile()
+bool CMOOSFileReader::GoTo(std::string sLine)
 {
-    m_pLock->Lock();
-#ifdef _WIN32
-    DWORD Me = GetCurrentThreadId(); 
-#else
-    pthread_t Me =  pthread_self();
-#endif
+    MOOSRemoveChars(sLine," \t\r");
 
-    THREAD2FILE_MAP::iterator p = m_FileMap.find(Me);
+    m_pLock->Lock();
 
-    if(p==m_FileMap.end())
+    bool bFound = false;
+    size_t & nCursor = GetCursor();
+    while(m_bLoaded && !bFound && nCursor<m_Lines.size())
     {
-        //MOOSTrace("\n::CMOOSFileReader Making mission file for thread[%d]\n",Me);
-        std::ifstream * pNewStream = new ifstream;
-        m_FileMap[Me] = pNewStream;
-        p = m_FileMap.find(Me);
-    }
+        std::string sTmp = m_Lines[nCursor++].sExpanded;
+        MOOSRemoveChars(sTmp," \t\r");
 
-    std::ifstream * pAnswer = p->second;
-
-    if(pAnswer!=NULL)
-    {
-        //now open the file as required...
-        if(!pAnswer->is_open() && !m_sFileName.empty())
-        {
-            pAnswer->open(m_sFileName.c_str());
-        }
-        
-        if(!pAnswer->is_open())
-        {
-            delete pAnswer;
-            pAnswer = NULL;
-            m_FileMap.erase(Me);
-        }
+        bFound = MOOSStrCmp(sTmp,sLine);
     }
 
     m_pLock->UnLock();
 
-    return pAnswer;
-   
-
+    return bFound;
 }
 
 bool CMOOSFileReader::IsOpen()
 {
-    if(GetFile()==NULL)
-        return false;
+    m_pLock->Lock();
+
+    bool bResult = m_bLoaded;
+
+    m_pLock->UnLock();
 
-    return GetFile()->is_open();
+    return bResult;
 }
 
 
 
 bool CMOOSFileReader::BuildLocalShellVars()
 {
-    
-    if(IsOpen())
+    //called by SetFile() once the valid lines have been read
+    for(size_t i = 0;i<m_Lines.size();i++)
     {
-        Reset();
-        
-        GetFile()->seekg(std::ios::beg);
-        
-        std::string sLine,sVal,sTok;
-        while(!GetFile()->eof())
-        {
-            sLine = GetNextValidLine(false);
+        std::string sLine = m_Lines[i].sText;
 
-            MOOSChomp(sLine,"define:");
+        MOOSChomp(sLine,"define:");
 
-            if(!sLine.empty())
+        if(!sLine.empty())
+        {
+            std::string sVarName,sVarVal;
+            if(GetTokenValPair(sLine,sVarName,sVarVal))
             {
-                std::string sVarName,sVarVal;
-                if(GetTokenValPair(sLine,sVarName,sVarVal))
-                {
-                    m_LocalShellVariables[sVarName] = sVarVal;    
-                }
+                m_LocalShellVariables[sVarName] = sVarVal;    
             }
-        }       
-        
-        Reset();
-        
-        
-        return true;
+        }
     }
-    
-    return false;
-    
+
+    return m_bLoaded;
 }
 
 
@@ -538,20 +619,15 @@ bool CMOOSFileReader::MakeOverloadedCopy(const std::string & sCopyName,std::map<
         if(!of.is_open())
             return false;
             
-            
-        Reset();
+        //the copy keeps comments so this goes back to the file itself
+        std::ifstream File(m_sFileName.c_str());
 
-        GetFile()->seekg(std::ios::beg);
+        if(!File.is_open())
+            return false;
         
         std::string sLine,sVal,sTok,sTmp;
-        while(!GetFile()->eof())
+        while(std::getline(File,sLine))
         {
-            
-            
-            char Tmp[MAXLINESIZE];
-                        
-            GetFile()->getline(Tmp,sizeof(Tmp));
-            sLine = std::string(Tmp);
             sTmp = sLine;
             
 			MOOSTrimWhiteSpace(sTmp);
@@ -577,8 +653,6 @@ bool CMOOSFileReader::MakeOverloadedCopy(const std::string & sCopyName,std::map<
             
         }       
         
-        Reset();
-        
         of.close();
         return true;
     }
@@ -587,4 +661,3 @@ bool CMOOSFileReader::MakeOverloadedCopy(const std::string & sCopyName,std::map<
     
     
 }
-
@@ -33,6 +33,7 @@
 #include "MOOS/libMOOS/Utils/MOOSLinuxSerialPort.h"
 
 #include <cstring>
+#include <cmath>
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
@@ -158,6 +159,28 @@ int CMOOSLinuxSerialPort::GrabN(char * pBuffer,int nRequired)
 
 
 
+bool CMOOSLinuxSerialPort::WaitForData(double dfTimeOut)
+{
+#ifndef _WIN32
+    if (m_nPortFD < 0)
+        return CMOOSSerialPort::WaitForData(dfTimeOut);
+
+    struct pollfd PortPoll;
+    PortPoll.fd = m_nPortFD;
+    PortPoll.events = POLLIN;
+    PortPoll.revents = 0;
+
+    //round up so we never spin on a sub millisecond remainder
+    int nMS = dfTimeOut>0.0 ? (int)ceil(dfTimeOut*1000.0) : 0;
+
+    //errors and hang ups count as readable so the read reports them
+    return poll(&PortPoll,1,nMS)>0;
+#else
+    return CMOOSSerialPort::WaitForData(dfTimeOut);
+#endif
+}
+
+
 /** Write a string out of the port. The time at which it was written is written
 to *pTime */
 int CMOOSLinuxSerialPort::Write(const char* Str,int nLen,double* pTime)
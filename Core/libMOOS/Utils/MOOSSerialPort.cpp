@@ -48,6 +48,7 @@
 
 #include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
 #include "MOOS/libMOOS/Utils/MOOSSerialPort.h"
+#include "MOOS/libMOOS/Utils/TelegramFramer.h"
 
 
 
@@ -270,110 +271,72 @@ void CMOOSSerialPort::SetIsCompleteReplyCallBack(bool (*pfn)(char *pData, int nL
 
 bool CMOOSSerialPort::CommsLoop()
 {
-    
-    
     char    pTmp[DEFAULT_COMMS_SPACE];
-    char    pAccumulator[2*DEFAULT_COMMS_SPACE];
-    int        nInStore = 0;
-    
-    double dfTimeOut = 0.1;
-    
+
+    //cuts what we read into telegrams, each stamped with the time its
+    //first character arrived
+    MOOS::TelegramFramer Framer(GetTermCharacter(),4*DEFAULT_COMMS_SPACE);
+    std::string sTelegram;
+    double dfTelegramTime;
+
+    double dfArrived = MOOSTime();
+
     while(!m_bQuit)
     {
-        int nRead = ReadNWithTimeOut(pTmp,DEFAULT_COMMS_SPACE,dfTimeOut);
-        
-        if(nRead!=-1)
+        //the termination character may be changed at any time
+        Framer.SetTerminator(GetTermCharacter());
+
+        int nRead = GrabN(pTmp,sizeof(pTmp));
+
+        if(nRead>0)
         {
-            
-            if((nInStore+nRead)>int(sizeof(pAccumulator)))
+            if(!Framer.Push(pTmp,nRead,dfArrived))
             {
                 //oops...
-                MOOSTrace("Comms Loop Accumulator Overflow, reseting\n");
-                nInStore = 0;
-                continue;
+                MOOSTrace("Comms Loop Accumulator Overflow, discarding\n");
             }
-            
-            //append to the accumulator
-            memcpy(pAccumulator+nInStore,pTmp,nRead);
-            
-            //we have more in the cupboard!
-            nInStore+=nRead;
-            
+
             //lock
             m_InBoxLock.Lock();
-            
-            char * pTelegramEnd = NULL;
-            
-            do    
+
+            while(Framer.Pop(sTelegram,dfTelegramTime))
             {
-               
-               
-                //A device will by default use the termination character <CR>
-                //But we now allow for setting of a termination character
-                //to allow for flexibility in a reply.
-                pTelegramEnd = (char*)memchr(pAccumulator,GetTermCharacter(),nInStore);
-                
-                if(pTelegramEnd!=NULL)
+                MOOSRemoveChars(sTelegram,"\r\n");
+
+                if(IsVerbose())
                 {
-                    //how long is the telegram?
-                    int nTelegramLength = pTelegramEnd - pAccumulator + 1;
-                    
-                    //make a buffer that is one larger to preserve the last character
-                    //in case we are interested in it.  
-                    char bBiggerBuff[2*DEFAULT_COMMS_SPACE+1];
-                    
-                    
-                    //copy the telegram to a buffer size that is 1 larger
-                    memcpy(bBiggerBuff, pAccumulator, nTelegramLength);
-                    
-                    //terminate it as a string
-                    //*pTelegramEnd = '\0';
-                    bBiggerBuff[nTelegramLength] = '\0';
-                    
-                    
-                    //copy it
-                    //std::string sTelegram((char*)pAccumulator);
-                    std::string sTelegram((char*)bBiggerBuff);
-                    
-                    MOOSRemoveChars(sTelegram,"\r\n");
-                    
-                    if(IsVerbose())
-                    {
-                        MOOSTrace("Telegram = %s\n",sTelegram.c_str());
-                    }
-                    
-                    //shuffle accumulator
-                    memmove(pAccumulator,
-                        pAccumulator+nTelegramLength,
-                        sizeof(pAccumulator)-nTelegramLength);
-                    
-                    //we have less in our store now!
-                    nInStore-=nTelegramLength;
-                    
-                    //make a telegram
-                    CMOOSSerialTelegram Tg(sTelegram,MOOSTime());
-                    
-                    //stuff it
-                    m_InBox.push_front(Tg);        
+                    MOOSTrace("Telegram = %s\n",sTelegram.c_str());
                 }
-            }while(pTelegramEnd !=NULL);
-            
-            
+
+                //stuff it
+                m_InBox.push_front(CMOOSSerialTelegram(sTelegram,dfTelegramTime));
+            }
+
             //whatch we don't exhibit disgraceful behaviour!
             while(m_InBox.size()>MOOS_SERIAL_INBOX_MAX_SIZE)
             {
                 m_InBox.pop_back();
             }
-            
+
             //and unlock
-            
             m_InBoxLock.UnLock();
-            
+
+            if(nRead==int(sizeof(pTmp)))
+            {
+                //there is probably more waiting
+                dfArrived = MOOSTime();
+                continue;
+            }
         }
-        else
+        else if(nRead<0)
         {
+            MOOSPause(10);
         }
-        
+
+        //sleep until there is something to read (or it is
+        //time to check whether we should quit)
+        WaitForData(0.1);
+        dfArrived = MOOSTime();
     }
     return true;
 }
@@ -447,6 +410,33 @@ char CMOOSSerialPort::GetTermCharacter()
 
 
 
+bool CMOOSSerialPort::WaitForData(double dfTimeOut)
+{
+    MOOS::DeliberatelyNotUsed(dfTimeOut);
+
+    //we can't do better than polling
+    MOOSPause(10);
+    return true;
+}
+
+
+int CMOOSSerialPort::GrabNOrWait(char * pBuffer,int nRequired,double dfMaxWait,double & dfArrived)
+{
+    dfArrived = MOOSTime();
+
+    int nGrabbed = GrabN(pBuffer,nRequired);
+    if(nGrabbed!=0 || dfMaxWait<=0.0)
+        return nGrabbed;
+
+    if(!WaitForData(dfMaxWait))
+        return 0;
+
+    //the characters arrived when we woke up, not when we read them
+    dfArrived = MOOSTime();
+    return GrabN(pBuffer,nRequired);
+}
+
+
 int CMOOSSerialPort::ReadNWithTimeOut(char *pData, int nLen, double dfTimeOut,double * pTime )
 {
         
@@ -461,14 +451,14 @@ int CMOOSSerialPort::ReadNWithTimeOut(char *pData, int nLen, double dfTimeOut,do
     while (MOOSLocalTime()<dfStopTime && !bQuit)
     {
 
-        
-        //try the read
-        int nGrabbed = GrabN(pData+nRead,nSpace);
+        double dfArrived;
+
+        //try the read, waiting (not spinning) until something turns up
+        int nGrabbed = GrabNOrWait(pData+nRead,nSpace,dfStopTime-MOOSLocalTime(),dfArrived);
         
         if (nGrabbed == 0)
         {
-            // wait a while...maybe it is on its way!
-            MOOSPause(10);           
+            // nothing yet...maybe it is on its way!
         }
         else if(nGrabbed<0)
         {
@@ -480,7 +470,7 @@ int CMOOSSerialPort::ReadNWithTimeOut(char *pData, int nLen, double dfTimeOut,do
             if(nRead==0 && pTime!=NULL)
             {
                 //grab the time..                        
-                *pTime = MOOSTime();
+                *pTime = dfArrived;
             }
             
             nSpace-=nGrabbed;
@@ -511,14 +501,14 @@ int CMOOSSerialPort::ReadNWithTimeOut2(char *pData, int nLen, double dfTimeOut,
     while (MOOSLocalTime()<dfStopTime && !bQuit)
     {
 
-        
-        //try the read
-        int nGrabbed = GrabN(pData+nRead,nSpace);
+        double dfArrived;
+
+        //try the read, waiting (not spinning) until something turns up
+        int nGrabbed = GrabNOrWait(pData+nRead,nSpace,dfStopTime-MOOSLocalTime(),dfArrived);
         
         if (nGrabbed == 0)
         {
-            // wait a while...maybe it is on its way!
-            MOOSPause(10);           
+            // nothing yet...maybe it is on its way!
         }
         else if(nGrabbed<0)
         {
@@ -530,7 +520,7 @@ int CMOOSSerialPort::ReadNWithTimeOut2(char *pData, int nLen, double dfTimeOut,
             if(nRead==0 && pTime!=NULL)
             {
                 //grab the time..                  
-                *pTime = MOOSTime();
+                *pTime = dfArrived;
             }
             
             //great, so increment out buffer pointer
@@ -560,30 +550,32 @@ bool CMOOSSerialPort::GetTelegram(std::string &sTelegram,double dfTimeOut,double
     
     char pData[TELEGRAM_LEN];
     double dfTimeWaited   = 0.0;              //haven't waited any tiome yet
-    double dfInterval =        0.01;             //10ms
     int nRead =            0;              //total number of chars read
     
     
-    while ((dfTimeWaited<dfTimeOut) && nRead<TELEGRAM_LEN)
+    //leave room for the terminating null
+    while ((dfTimeWaited<dfTimeOut) && nRead<TELEGRAM_LEN-1)
     {
-        int nGrabbed = 0;
-        
+        double dfArrived;
+        double dfWaitStart = MOOSLocalTime();
+
         //try the read
-        nGrabbed = GrabN(pData+nRead,1);
+        int nGrabbed = GrabNOrWait(pData+nRead,1,dfTimeOut-dfTimeWaited,dfArrived);
 
-        if (nGrabbed == 0)
+        if (nGrabbed <= 0)
         {
-            //OK wait a while...maybe it is on its way!
-            dfTimeWaited+=dfInterval;
-            
-            MOOSPause((int)(dfInterval*1000.0));
+            if(nGrabbed<0)
+                MOOSPause(10);
+
+            //OK we waited a while...maybe it is on its way!
+            dfTimeWaited+=MOOSLocalTime()-dfWaitStart;
         }
         else
         {
             if(nRead==0 && pTime!=NULL)
             {
                 //grab the time..                        
-                *pTime = MOOSTime();
+                *pTime = dfArrived;
             }
             
             
@@ -622,29 +614,31 @@ bool CMOOSSerialPort::GetTelegramOrAccumulate(std::string &sTelegram,double dfTi
     static int nTelegramBufferRead = 0;              //total number of chars read
     
     double dfTimeWaited = 0.0;              //haven't waited any time yet
-    double dfInterval = 0.01;             //10ms
     
     
-    while ((dfTimeWaited<dfTimeOut) && nTelegramBufferRead<TELEGRAM_LEN)
+    //leave room for the terminating null
+    while ((dfTimeWaited<dfTimeOut) && nTelegramBufferRead<TELEGRAM_LEN-1)
     {
-        int nGrabbed = 0;
-        
+        double dfArrived;
+        double dfWaitStart = MOOSLocalTime();
+
         //try the read
-        nGrabbed = GrabN(telegramBuffer+nTelegramBufferRead,1);
+        int nGrabbed = GrabNOrWait(telegramBuffer+nTelegramBufferRead,1,dfTimeOut-dfTimeWaited,dfArrived);
         
-        if (nGrabbed == 0)
+        if (nGrabbed <= 0)
         {
-            //OK wait a while...maybe it is on its way!
-            dfTimeWaited+=dfInterval;
-            
-            MOOSPause((int)(dfInterval*1000.0));
+            if(nGrabbed<0)
+                MOOSPause(10);
+
+            //OK we waited a while...maybe it is on its way!
+            dfTimeWaited+=MOOSLocalTime()-dfWaitStart;
         }
         else
         {
             if(nTelegramBufferRead==0 && pTime!=NULL)
             {
                 //grab the time..                        
-                *pTime = MOOSTime();
+                *pTime = dfArrived;
             }
             
             
@@ -33,6 +33,7 @@
 #endif
 #include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
 #include "MOOS/libMOOS/Utils/ProcessConfigReader.h"
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
 #include <iostream>
 
 //////////////////////////////////////////////////////////////////////
@@ -72,52 +73,42 @@ bool CProcessConfigReader::GetConfigurationAndPreserveSpace(std::string sAppName
 {
 	Params.clear();
 
-	Reset();
+	std::vector<std::string> Lines;
+	bool bClosed;
 
-	std::string sKey = "PROCESSCONFIG="+sAppName;
-
-	if(GoTo(sKey))
+	if(GetBlockLines(sAppName, Lines, bClosed))
 	{
-		std::string sBracket = GetNextValidLine();
-		if(MOOSStartsWith(sBracket, "{"))
+		for(size_t n = 0; n < Lines.size(); n++)
 		{
-			while(!GetFile()->eof())
+			std::string sLine = Lines[n];
+			MOOSTrimWhiteSpace(sLine);
+
+			std::string sVal(sLine);
+			std::string sTok = MOOSChomp(sVal, "=");
+			MOOSTrimWhiteSpace(sTok);
+			MOOSTrimWhiteSpace(sVal);
+
+			if (!sTok.empty())
 			{
-				std::string sLine = GetNextValidLine();
-				MOOSTrimWhiteSpace(sLine);
 
-				if(!MOOSStartsWith(sLine, "}"))
+				if (!sVal.empty())
 				{
-					std::string sVal(sLine);
-					std::string sTok = MOOSChomp(sVal, "=");
-					MOOSTrimWhiteSpace(sTok);
-					MOOSTrimWhiteSpace(sVal);
-
-					if (!sTok.empty())
-					{
-
-						if (!sVal.empty())
-						{
-							Params.push_back(sTok+"="+sVal);
-						}
-						else if(sLine.find("[")!=std::string::npos || sLine.find("]")!=std::string::npos)
-						{
-							Params.push_back(sLine);
-						}
-					}
+					Params.push_back(sTok+"="+sVal);
 				}
-				else
+				else if(sLine.find("[")!=std::string::npos || sLine.find("]")!=std::string::npos)
 				{
-					return true;
+					Params.push_back(sLine);
 				}
+			}
 
-				//quick error check - we don't allow nested { on single lines
-				if(MOOSStartsWith(sLine, "{"))
-				{
-					MOOSTrace("CProcessConfigReader::GetConfiguration() missing \"}\" syntax error in mission file\n");
-				}
+			//quick error check - we don't allow nested { on single lines
+			if(MOOSStartsWith(sLine, "{"))
+			{
+				MOOSTrace("CProcessConfigReader::GetConfiguration() missing \"}\" syntax error in mission file\n");
 			}
 		}
+
+		return bClosed;
 	}
 
 
@@ -132,67 +123,51 @@ bool CProcessConfigReader::GetConfiguration(std::string sAppName, STRING_LIST &P
     
     Params.clear();
     
-    Reset();
+    std::vector<std::string> Lines;
+    bool bClosed;
     
-    std::string sKey = "PROCESSCONFIG="+sAppName;
-    
-    if(GoTo(sKey))
+    if(GetBlockLines(sAppName,Lines,bClosed))
     {
-        std::string sBracket = GetNextValidLine();
-        if(sBracket.find("{")==0)
+        for(size_t n = 0;n<Lines.size();n++)
         {
-            while(!GetFile()->eof())
+            std::string sLine = Lines[n];
+            
+            MOOSRemoveChars(sLine," \t\r");
+            
+            // jckerken 8-12-2004
+            // ignore if param = <empty string>
+            std::string sTmp(sLine);
+            std::string sTok = MOOSChomp(sTmp, "=");
+
+            MOOSTrimWhiteSpace(sTok); // Handle potential whitespaces.
+            MOOSTrimWhiteSpace(sTmp);
+
+            if (sTok.size() > 0) 
             {
-                std::string sLine = GetNextValidLine();
-                
-                MOOSRemoveChars(sLine," \t\r");
+                MOOSTrimWhiteSpace(sTmp);
                 
-                if(sLine.find("}")!=0)
+                if (!sTmp.empty()) 
                 {
-#if(1)
-                    // jckerken 8-12-2004
-                    // ignore if param = <empty string>
-                    std::string sTmp(sLine);
-                    std::string sTok = MOOSChomp(sTmp, "=");
-
-                    MOOSTrimWhiteSpace(sTok); // Handle potential whitespaces.
-                    MOOSTrimWhiteSpace(sTmp);
-
-                    if (sTok.size() > 0) 
-                    {
-                        MOOSTrimWhiteSpace(sTmp);
-                        
-                        if (!sTmp.empty()) 
-                        {
-                            Params.push_front(sTok+std::string("=")+sTmp); // Was: sLine
-                        }
-                        else if(sLine.find("[")!=std::string::npos || sLine.find("]")!=std::string::npos) 
-                        {
-                            Params.push_front(sTok+std::string("=")+sTmp); // Was: sLine
-                        }
-                    } 
-                    else 
-                    {
-                        Params.push_front(sTok+std::string("=")+sTmp); // Was: sLine
-                    }
-#else            
-                    Params.push_front(sLine);
-#endif
+                    Params.push_front(sTok+std::string("=")+sTmp); // Was: sLine
                 }
-                else
+                else if(sLine.find("[")!=std::string::npos || sLine.find("]")!=std::string::npos) 
                 {
-                    return true;
+                    Params.push_front(sTok+std::string("=")+sTmp); // Was: sLine
                 }
-                
-                //quick error check - we don't allow nested { on single lines
-                if(sLine.find("{")==0)
-                {
-                    MOOSTrace("CProcessConfigReader::GetConfiguration() missing \"}\" syntax error in mission file\n");
-                }
-                
-                
+            } 
+            else 
+            {
+                Params.push_front(sTok+std::string("=")+sTmp); // Was: sLine
+            }
+            
+            //quick error check - we don't allow nested { on single lines
+            if(sLine.find("{")==0)
+            {
+                MOOSTrace("CProcessConfigReader::GetConfiguration() missing \"}\" syntax error in mission file\n");
             }
         }
+        
+        return bClosed;
     }
     
     
@@ -297,37 +272,16 @@ bool CProcessConfigReader::GetConfigurationParam(std::string sAppName,std::strin
 ///                               READ STRINGS
 bool CProcessConfigReader::GetConfigurationParam(std::string sAppName,std::string sParam, std::string &sVal)
 {
-    Reset();
-
     //remember all names we were asked for....
     std::string sl = sParam;
     MOOSToLower(sl);
-    m_Audit[sAppName].insert(sl);
 
-    STRING_LIST sParams;
-    
-    if(GetConfigurationAndPreserveSpace( sAppName, sParams))
-    {
-        STRING_LIST::iterator p;
-        for(p = sParams.begin();p!=sParams.end();++p)
-        {
-            std::string sTmp = *p;
-            std::string sTok = MOOSChomp(sTmp,"=");
-            MOOSTrimWhiteSpace(sTok);
-
-            if (sTmp.empty())
-                return false;
-            
-            if(MOOSStrCmp(sTok,sParam))
-            {
-                MOOSTrimWhiteSpace(sTmp);
+    m_pLock->Lock();
+    m_Audit[sAppName].insert(sl);
+    m_pLock->UnLock();
 
-            	sVal=sTmp;
-                return true;
-            }
-        }
-    }
-    return false;
+    //the block was indexed when the file was read
+    return GetBlockValue(sAppName,sParam,sVal);
 }
 
 
@@ -439,11 +393,13 @@ bool CProcessConfigReader::GetConfigurationParam(std::string sParam, std::vector
 std::list<std::string> CProcessConfigReader::GetSearchedParameters(const std::string & sAppName)
 {
     std::list<std::string> L;
+    m_pLock->Lock();
     std::map<std::string, std::set<std::string>  >::iterator q = m_Audit.find(sAppName);
     if(q!=m_Audit.end())
     {
         std::copy(q->second.begin(),q->second.end(), std::back_inserter(L));
     }
+    m_pLock->UnLock();
     return L;
 }
 
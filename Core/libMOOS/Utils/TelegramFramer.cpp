@@ -0,0 +1,128 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * TelegramFramer.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MOOS/libMOOS/Utils/TelegramFramer.h"
+
+namespace MOOS
+{
+
+TelegramFramer::TelegramFramer(char cTerminator, unsigned int nCapacity)
+    :m_cTerminator(cTerminator),
+     m_nRead(0),
+     m_nWrite(0),
+     m_bInTelegram(false),
+     m_dfTelegramStart(0.0),
+     m_nDiscarded(0)
+{
+    size_t n = 2;
+    while(n<nCapacity)
+        n<<=1;
+    m_Ring.resize(n);
+    m_nMask = n-1;
+}
+
+bool TelegramFramer::Push(const char * pData, unsigned int nLength, double dfTime)
+{
+    unsigned int nDiscarded = m_nDiscarded;
+
+    for(unsigned int i = 0;i<nLength;i++)
+    {
+        if(m_nWrite-m_nRead==m_Ring.size())
+            MakeRoom();
+
+        if(!m_bInTelegram)
+        {
+            m_bInTelegram = true;
+            m_dfTelegramStart = dfTime;
+        }
+
+        m_Ring[m_nWrite & m_nMask] = pData[i];
+        m_nWrite++;
+
+        if(pData[i]==m_cTerminator)
+        {
+            Telegram T;
+            T.nEnd = m_nWrite;
+            T.dfTime = m_dfTelegramStart;
+            m_Telegrams.push_back(T);
+            m_bInTelegram = false;
+        }
+    }
+
+    return m_nDiscarded==nDiscarded;
+}
+
+void TelegramFramer::MakeRoom()
+{
+    size_t nFrom = m_nRead;
+    if(!m_Telegrams.empty())
+    {
+        //lose the oldest telegram nobody has collected
+        m_nRead = m_Telegrams.front().nEnd;
+        m_Telegrams.pop_front();
+    }
+    else
+    {
+        //a telegram longer than the whole ring - it is junk
+        m_nRead = m_nWrite;
+    }
+    m_nDiscarded+=(unsigned int)(m_nRead-nFrom);
+}
+
+bool TelegramFramer::Pop(std::string & sTelegram, double & dfTime)
+{
+    if(m_Telegrams.empty())
+        return false;
+
+    const Telegram & T = m_Telegrams.front();
+    size_t nLength = T.nEnd-m_nRead;
+    size_t nStart = m_nRead & m_nMask;
+    size_t nFirst = m_Ring.size()-nStart;
+    if(nFirst>nLength)
+        nFirst = nLength;
+
+    //the telegram may wrap round the end of the ring
+    sTelegram.assign(&m_Ring[nStart],nFirst);
+    if(nFirst<nLength)
+        sTelegram.append(&m_Ring[0],nLength-nFirst);
+
+    dfTime = T.dfTime;
+    m_nRead = T.nEnd;
+    m_Telegrams.pop_front();
+    return true;
+}
+
+void TelegramFramer::Clear()
+{
+    m_nRead = m_nWrite;
+    m_Telegrams.clear();
+    m_bInTelegram = false;
+}
+
+}
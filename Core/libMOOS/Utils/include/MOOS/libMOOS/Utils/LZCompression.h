@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * LZCompression.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LZCOMPRESSION_H_
+#define LZCOMPRESSION_H_
+
+#include <vector>
+
+namespace MOOS
+{
+
+/**
+ * A small, fast, dictionary-free LZ77 style compressor used to squeeze comms
+ * packets. It uses the LZ4 block layout (token, literals, 16 bit offset,
+ * match length) and so trades ratio for speed - it is intended for packets
+ * carrying large, redundant payloads (images, sonar returns, text) rather than
+ * for squeezing every last byte.
+ */
+namespace LZ
+{
+    /** the most bytes compressing nSize bytes can produce */
+    unsigned int CompressBound(unsigned int nSize);
+
+    /** compress nSize bytes at pIn to pOut, which must have room for at least
+     * CompressBound(nSize) bytes. Returns the number of bytes written */
+    unsigned int Compress(const unsigned char * pIn, unsigned int nSize, unsigned char * pOut);
+
+    /** compress nSize bytes at pIn, replacing the contents of Out.
+     * Never fails but the output may be larger than the input */
+    void Compress(const unsigned char * pIn, unsigned int nSize, std::vector<unsigned char> & Out);
+
+    /** decompress nSize bytes at pIn into exactly nOutSize bytes at pOut. Returns
+     * false if the input is malformed or does not expand to exactly nOutSize bytes */
+    bool Decompress(const unsigned char * pIn, unsigned int nSize, unsigned char * pOut, unsigned int nOutSize);
+}
+
+}
+
+#endif /* LZCOMPRESSION_H_ */
@@ -0,0 +1,437 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * LockFreeQueue.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LOCKFREEQUEUE_H_
+#define LOCKFREEQUEUE_H_
+
+#include "MOOS/libMOOS/Utils/SafeList.h"
+
+#if __cplusplus >= 201103L
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#endif
+
+namespace MOOS
+{
+
+#if __cplusplus >= 201103L
+
+/**
+ * A drop in replacement for SafeList (as far as Push, Pull, Pop, WaitForPush,
+ * IsEmpty, Size and the Append functions go) for busy paths. Elements live in
+ * a fixed ring of slots claimed with compare and swap (after Dmitry Vyukov's
+ * bounded MPMC queue) so pushing and pulling takes no lock and allocates
+ * nothing beyond what copying T does. Waiting consumers are counted and
+ * producers only touch the mutex/condition variable when someone is
+ * actually parked in WaitForPush().
+ *
+ * Unlike a plain bounded queue nothing is ever refused: should the ring fill
+ * up, elements spill into a locked overflow list and everyone uses that until
+ * the consumer has emptied it, so each producer's elements still come out in
+ * the order they went in.
+ *
+ * A list appended with AppendToMeInConstantTime() goes in as one batch: it
+ * claims all its slots with a single compare and swap and publishes its
+ * first slot last, so a consumer draining the queue either gets all of it
+ * or none of it.
+ */
+template<class T>
+class LockFreeQueue
+{
+public:
+    /** @param nCapacity number of slots in the ring (rounded up to a power of two)*/
+    explicit LockFreeQueue(unsigned int nCapacity = 1024)
+    {
+        size_t n = 2;
+        while(n<nCapacity)
+            n<<=1;
+
+        m_nMask = n-1;
+        m_pSlots = new Slot[n];
+        for(size_t i = 0;i<n;i++)
+            m_pSlots[i].Sequence.store(i,std::memory_order_relaxed);
+
+        m_nEnqueuePos.store(0,std::memory_order_relaxed);
+        m_nDequeuePos.store(0,std::memory_order_relaxed);
+        m_nOverflow.store(0,std::memory_order_relaxed);
+        m_nWaiting.store(0,std::memory_order_relaxed);
+        m_nPushes.store(0,std::memory_order_relaxed);
+    }
+
+    ~LockFreeQueue()
+    {
+        delete [] m_pSlots;
+    }
+
+    bool Push(const T & Element)
+    {
+        Enqueue(Element);
+        WakeWaiters();
+        return true;
+    }
+
+    bool Pull(T & Element)
+    {
+        if(PullFromRing(Element))
+            return true;
+
+        if(m_nOverflow.load(std::memory_order_acquire)==0)
+            return false;
+
+        std::lock_guard<std::mutex> L(m_OverflowMutex);
+
+        //the ring may have been refilled before the overflow started
+        if(PullFromRing(Element))
+            return true;
+
+        if(m_Overflow.empty())
+            return false;
+
+        std::swap(Element,m_Overflow.front());
+        m_Overflow.pop_front();
+        m_nOverflow.fetch_sub(1,std::memory_order_release);
+        return true;
+    }
+
+    void Pop()
+    {
+        T Discard;
+        Pull(Discard);
+    }
+
+    /** push every element of ThingToAppend (which is emptied) as one batch
+     * which no consumer can see only part of */
+    bool AppendToMeInConstantTime(std::list<T> & ThingToAppend)
+    {
+        if(ThingToAppend.empty())
+            return true;
+
+        size_t nCount = ThingToAppend.size();
+        if(m_nOverflow.load(std::memory_order_acquire)>0 || !PushBatchToRing(ThingToAppend,nCount))
+        {
+            std::lock_guard<std::mutex> L(m_OverflowMutex);
+            m_Overflow.splice(m_Overflow.end(),ThingToAppend);
+            m_nOverflow.fetch_add((unsigned int)nCount,std::memory_order_release);
+        }
+        ThingToAppend.clear();
+
+        WakeWaiters();
+        return true;
+    }
+
+    /** move everything currently queued on to the end of ThingToAppendTo.
+     * Batches are never split between calls */
+    bool AppendToOtherInConstantTime(std::list<T> & ThingToAppendTo)
+    {
+        T Element;
+        while(Pull(Element))
+        {
+            ThingToAppendTo.push_back(T());
+            std::swap(ThingToAppendTo.back(),Element);
+        }
+        return true;
+    }
+
+    /** wait until there is something to pull. Returns false on time out */
+    bool WaitForPush(long milliseconds = -1)
+    {
+        if(!IsEmpty())
+            return true;
+
+        std::unique_lock<std::mutex> L(m_WaitMutex);
+
+        //pairs with the fence in WakeWaiters - either we see the
+        //element or the producer sees us waiting
+        m_nWaiting.fetch_add(1,std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if(milliseconds<0)
+        {
+            while(IsEmpty())
+                m_WaitCondition.wait(L);
+        }
+        else
+        {
+            std::chrono::steady_clock::time_point Deadline =
+                    std::chrono::steady_clock::now()+std::chrono::milliseconds(milliseconds);
+            while(IsEmpty())
+            {
+                if(m_WaitCondition.wait_until(L,Deadline)==std::cv_status::timeout)
+                    break;
+            }
+        }
+
+        m_nWaiting.fetch_sub(1,std::memory_order_relaxed);
+
+        return !IsEmpty();
+    }
+
+    /** how many pushes and appends there have been (for WaitForPushSince)*/
+    uint64_t GetPushCount()
+    {
+        return m_nPushes.load(std::memory_order_acquire);
+    }
+
+    /** wait up to nMicroSeconds for a push or append after the nPushes'th.
+     * Returns false on time out */
+    bool WaitForPushSince(uint64_t nPushes, long nMicroSeconds)
+    {
+        if(GetPushCount()!=nPushes)
+            return true;
+
+        std::unique_lock<std::mutex> L(m_WaitMutex);
+
+        //as in WaitForPush() either we see the push or the producer sees us
+        m_nWaiting.fetch_add(1,std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::chrono::steady_clock::time_point Deadline =
+                std::chrono::steady_clock::now()+std::chrono::microseconds(nMicroSeconds);
+        while(GetPushCount()==nPushes)
+        {
+            if(m_WaitCondition.wait_until(L,Deadline)==std::cv_status::timeout)
+                break;
+        }
+
+        m_nWaiting.fetch_sub(1,std::memory_order_relaxed);
+
+        return GetPushCount()!=nPushes;
+    }
+
+    bool IsEmpty()
+    {
+        size_t nPos = m_nDequeuePos.load(std::memory_order_relaxed);
+        size_t nSeq = m_pSlots[nPos & m_nMask].Sequence.load(std::memory_order_acquire);
+        return nSeq!=nPos+1 && m_nOverflow.load(std::memory_order_acquire)==0;
+    }
+
+    /** roughly how many elements are queued (exact when nobody else is busy)*/
+    unsigned int Size()
+    {
+        size_t nIn = m_nEnqueuePos.load(std::memory_order_acquire);
+        size_t nOut = m_nDequeuePos.load(std::memory_order_acquire);
+        size_t nRing = nIn>nOut ? nIn-nOut : 0;
+        return (unsigned int)(nRing+m_nOverflow.load(std::memory_order_acquire));
+    }
+
+    void Clear()
+    {
+        T Discard;
+        while(Pull(Discard))
+        {
+        }
+    }
+
+private:
+    //not copyable
+    LockFreeQueue(const LockFreeQueue &);
+    LockFreeQueue & operator=(const LockFreeQueue &);
+
+    struct Slot
+    {
+        std::atomic<size_t> Sequence;
+        T Data;
+    };
+
+    bool PushToRing(const T & Element)
+    {
+        Slot * pSlot;
+        size_t nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            pSlot = &m_pSlots[nPos & m_nMask];
+            size_t nSeq = pSlot->Sequence.load(std::memory_order_acquire);
+            intptr_t nDiff = (intptr_t)nSeq-(intptr_t)nPos;
+            if(nDiff==0)
+            {
+                if(m_nEnqueuePos.compare_exchange_weak(nPos,nPos+1,std::memory_order_relaxed))
+                    break;
+            }
+            else if(nDiff<0)
+            {
+                //full
+                return false;
+            }
+            else
+            {
+                nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        pSlot->Data = Element;
+        pSlot->Sequence.store(nPos+1,std::memory_order_release);
+        return true;
+    }
+
+    bool PullFromRing(T & Element)
+    {
+        Slot * pSlot;
+        size_t nPos = m_nDequeuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            pSlot = &m_pSlots[nPos & m_nMask];
+            size_t nSeq = pSlot->Sequence.load(std::memory_order_acquire);
+            intptr_t nDiff = (intptr_t)nSeq-(intptr_t)(nPos+1);
+            if(nDiff==0)
+            {
+                if(m_nDequeuePos.compare_exchange_weak(nPos,nPos+1,std::memory_order_relaxed))
+                    break;
+            }
+            else if(nDiff<0)
+            {
+                //empty
+                return false;
+            }
+            else
+            {
+                nPos = m_nDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        //swapping rather than copying means the slot doesn't keep hold of
+        //anything (shared packets for example) until it is next written
+        std::swap(Element,pSlot->Data);
+        pSlot->Sequence.store(nPos+m_nMask+1,std::memory_order_release);
+        return true;
+    }
+
+    /** claim nCount slots in one go (or none if they aren't all free), fill
+     * them from Batch and publish the first one last */
+    bool PushBatchToRing(std::list<T> & Batch, size_t nCount)
+    {
+        if(nCount>m_nMask+1)
+            return false;
+
+        size_t nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            bool bStale = false;
+            for(size_t i = 0;i<nCount && !bStale;i++)
+            {
+                size_t nSeq = m_pSlots[(nPos+i) & m_nMask].Sequence.load(std::memory_order_acquire);
+                intptr_t nDiff = (intptr_t)nSeq-(intptr_t)(nPos+i);
+                if(nDiff<0)
+                {
+                    //not enough room
+                    return false;
+                }
+                bStale = nDiff>0;
+            }
+
+            if(bStale)
+                nPos = m_nEnqueuePos.load(std::memory_order_relaxed);
+            else if(m_nEnqueuePos.compare_exchange_weak(nPos,nPos+nCount,std::memory_order_relaxed))
+                break;
+        }
+
+        typename std::list<T>::iterator q = Batch.begin();
+        for(size_t i = 0;i<nCount;i++,++q)
+            std::swap(m_pSlots[(nPos+i) & m_nMask].Data,*q);
+
+        //consumers take slots in order so holding back the first keeps
+        //them off the rest until every one is ready
+        for(size_t i = nCount-1;i>0;i--)
+            m_pSlots[(nPos+i) & m_nMask].Sequence.store(nPos+i+1,std::memory_order_release);
+        m_pSlots[nPos & m_nMask].Sequence.store(nPos+1,std::memory_order_release);
+
+        return true;
+    }
+
+    void Enqueue(const T & Element)
+    {
+        //once anything has overflowed everyone queues behind it
+        if(m_nOverflow.load(std::memory_order_acquire)>0 || !PushToRing(Element))
+        {
+            std::lock_guard<std::mutex> L(m_OverflowMutex);
+            m_Overflow.push_back(Element);
+            m_nOverflow.fetch_add(1,std::memory_order_release);
+        }
+    }
+
+    void WakeWaiters()
+    {
+        m_nPushes.fetch_add(1,std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(m_nWaiting.load(std::memory_order_relaxed)==0)
+            return;
+
+        std::lock_guard<std::mutex> L(m_WaitMutex);
+        m_WaitCondition.notify_all();
+    }
+
+    Slot * m_pSlots;
+    size_t m_nMask;
+
+    //producers and consumers hammer these so keep them apart
+    char m_Pad0[64];
+    std::atomic<size_t> m_nEnqueuePos;
+    char m_Pad1[64];
+    std::atomic<size_t> m_nDequeuePos;
+    char m_Pad2[64];
+
+    std::atomic<unsigned int> m_nOverflow;
+    std::mutex m_OverflowMutex;
+    std::list<T> m_Overflow;
+
+    std::atomic<int> m_nWaiting;
+    std::atomic<uint64_t> m_nPushes;
+    std::mutex m_WaitMutex;
+    std::condition_variable m_WaitCondition;
+};
+
+#else
+
+/**
+ * without C++11 atomics we fall back to the locked list
+ */
+template<class T>
+class LockFreeQueue : public SafeList<T>
+{
+public:
+    explicit LockFreeQueue(unsigned int /*nCapacity*/ = 1024){}
+
+    /** the locked list doesn't count pushes...*/
+    unsigned long long GetPushCount(){return 0;}
+
+    /** ...so this waits (to the nearest ms) for whatever push comes next*/
+    bool WaitForPushSince(unsigned long long /*nPushes*/, long nMicroSeconds)
+    {
+        return SafeList<T>::WaitForPush(nMicroSeconds>1000 ? nMicroSeconds/1000 : 1);
+    }
+};
+
+#endif
+
+}
+
+#endif /* LOCKFREEQUEUE_H_ */
@@ -39,11 +39,16 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 #ifdef _WIN32
-    typedef std::map<int,std::ifstream*> THREAD2FILE_MAP;
+    typedef std::map<unsigned long,size_t> THREAD2CURSOR_MAP;
 #else
-    typedef std::map<pthread_t,std::ifstream *> THREAD2FILE_MAP;
+    typedef std::map<pthread_t,size_t> THREAD2CURSOR_MAP;
 #endif
         
 
@@ -51,6 +56,11 @@
 class CMOOSLock;
 
 //! Base class for reading ascii files
+/** The file is read and indexed once when SetFile() is called: comments are
+stripped and ${} variables expanded a single time, every "token = value"
+is indexed by (case insensitive) token and every "ProcessConfig = name"
+block by name, so look ups never touch the disk. Any number of threads may
+share one reader.*/
 class CMOOSFileReader  
 {
 public:
@@ -95,39 +105,73 @@ public:
     /**static helper which splits a line into token = value and by deafult removes white space*/
     static bool    GetTokenValPair(std::string  sLine, std::string &sTok, std::string & sVal,bool bPreserveWhiteSpace = false);
 
-    /** returns a string of the next non comment line (and removs trailing comments)*/
+    /** returns a string of the next non comment line (and removs trailing comments).
+    Each thread has its own position in the file*/
     std::string  GetNextValidLine(bool bDoShellSubstitution = true);
 
 	    
     bool DoVariableExpansion(std::string & sVal);
     bool BuildLocalShellVars();
     bool MakeOverloadedCopy(const std::string & sCopyName,std::map<std::string, std::string> & OverLoads);
-	void EnableVerbatimQuoting(bool bEnable=true){m_bEnableVerbatimQuoting = bEnable;};
+	void EnableVerbatimQuoting(bool bEnable=true);
 
 
 protected:
-	/** iterates through filemap freeing up resources then calls filemap's clear method */
-	void ClearFileMap()
-	{
-		for(THREAD2FILE_MAP::iterator iter = m_FileMap.begin(); iter != m_FileMap.end(); iter++)
-		{
-            std::ifstream * pFile = iter->second;
-            if(pFile)
-				delete pFile;
-		}
-		m_FileMap.clear();
-	}
-	
-	
-    std::ifstream * GetFile();
+    /** a non comment line of the file with any trailing comment removed*/
+    struct ValidLine
+    {
+        unsigned int nLine;
+        std::string sText;
+        std::string sExpanded;
+    };
+
+    /** a value given to a token and the line it was given on*/
+    struct IndexedValue
+    {
+        unsigned int nLine;
+        std::string sVal;
+    };
+
+    /** upper case token -> every value it is given, in file order*/
+    typedef std::map<std::string, std::vector<IndexedValue> > TOKEN2VALUES_MAP;
+
+    /** a "ProcessConfig = name" block, its lines are m_Lines[nBegin,nEnd)*/
+    struct ConfigBlock
+    {
+        bool bOpened;
+        bool bClosed;
+        size_t nBegin;
+        size_t nEnd;
+        TOKEN2VALUES_MAP Params;
+    };
+
+    /** finds the first value of sName in the "ProcessConfig = sBlock" block */
+    bool GetBlockValue(const std::string & sBlock,const std::string & sName,std::string & sResult);
+
+    /** copies the (expanded) lines between the braces of "ProcessConfig = sBlock",
+    bClosed is false if the closing brace is missing*/
+    bool GetBlockLines(const std::string & sBlock,std::vector<std::string> & Lines,bool & bClosed);
+
+    /** reads and indexes m_sFileName, call with m_pLock held*/
+    bool LoadFile();
+    void IndexBlock(const std::string & sName,size_t nHeader);
+    std::string StripComments(std::string sLine);
+    size_t & GetCursor();
+
     CMOOSLock *m_pLock;
     static bool    IsComment(std::string & sLine);
     std::string    m_sFileName;
-    std::ifstream m_File;
 
     std::map<std::string,std::string> m_LocalShellVariables;
-    /** every thread get its own pointer to a stream*/
-    THREAD2FILE_MAP m_FileMap;
+
+    //true if the file was read by the last SetFile()
+    bool m_bLoaded;
+    std::vector<ValidLine> m_Lines;
+    TOKEN2VALUES_MAP m_Values;
+    std::map<std::string,ConfigBlock> m_Blocks;
+
+    /** every thread gets its own position for GetNextValidLine() and friends*/
+    THREAD2CURSOR_MAP m_Cursors;
 
     //true if quoted strings are treated as literals - quotes will be removed and comment "//"
 	//characters not treated as comments
@@ -42,6 +42,7 @@
     #include <signal.h>
     #include <sys/types.h>
     #include <termios.h>
+    #include <poll.h>
         #include <unistd.h>
 
         #include <stdio.h>
@@ -80,6 +81,9 @@ protected:
     /** Just grab N characters NOW */
     virtual int GrabN(char * pBuffer,int nRequired);
 
+    /** sleep in poll() until the port is readable */
+    virtual bool WaitForData(double dfTimeOut);
+
     #ifndef _WIN32
       struct termios m_OldPortOptions;
       struct termios m_PortOptions;
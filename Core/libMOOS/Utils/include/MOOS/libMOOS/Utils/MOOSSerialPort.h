@@ -147,6 +147,16 @@ protected:
 
     virtual int GrabN(char * pBuffer,int nRequired)=0;
 
+    /** block until there may be something to read or dfTimeOut seconds
+     * pass. Returns false if it is known nothing arrived. Ports which can't
+     * wait on their device just sleep for 10ms */
+    virtual bool WaitForData(double dfTimeOut);
+
+    /** GrabN, but if nothing is there wait up to dfMaxWait seconds for
+     * something to arrive and try again. dfArrived is set to the time the
+     * characters were known to be there */
+    int GrabNOrWait(char * pBuffer,int nRequired,double dfMaxWait,double & dfArrived);
+
     bool (*m_pfnUserIsCompleteReplyCallBack)( char *pData, int nLen, int nRead);
 
     bool IsCompleteReply(char * pData,int nLen, int nRead);
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * TelegramFramer.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef TELEGRAMFRAMER_H_
+#define TELEGRAMFRAMER_H_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+namespace MOOS
+{
+
+/**
+ * Cuts a stream of characters arriving from a device into telegrams, each
+ * ending in a terminating character. Characters are pushed in whatever lumps
+ * they are read in, along with the time they arrived, and kept in a ring so
+ * nothing is shuffled as telegrams are taken out. Each telegram comes out
+ * with the arrival time of its first character.
+ */
+class TelegramFramer
+{
+public:
+    /** @param nCapacity most characters held at once (rounded up to a power of two)*/
+    explicit TelegramFramer(char cTerminator = '\r', unsigned int nCapacity = 4096);
+
+    void SetTerminator(char cTerminator){m_cTerminator = cTerminator;}
+    char GetTerminator() const {return m_cTerminator;}
+
+    /** add nLength characters which arrived at dfTime. Should the ring fill up
+     * the oldest complete telegrams are thrown away to make room, or if there
+     * are none the partial telegram is. Returns false if anything was lost */
+    bool Push(const char * pData, unsigned int nLength, double dfTime);
+
+    /** take out the oldest complete telegram (including its terminator) and
+     * the time its first character arrived. False if there isn't one */
+    bool Pop(std::string & sTelegram, double & dfTime);
+
+    /** how many complete telegrams are waiting */
+    unsigned int GetNumTelegrams() const {return (unsigned int)m_Telegrams.size();}
+
+    /** how many characters are held (in complete telegrams or not) */
+    unsigned int GetNumBuffered() const {return (unsigned int)(m_nWrite-m_nRead);}
+
+    /** how many characters have been thrown away for want of room */
+    unsigned int GetNumDiscarded() const {return m_nDiscarded;}
+
+    /** forget everything held */
+    void Clear();
+
+private:
+    void MakeRoom();
+
+    //where a complete telegram ends (one past its terminator) and
+    //when its first character arrived
+    struct Telegram
+    {
+        size_t nEnd;
+        double dfTime;
+    };
+
+    char m_cTerminator;
+    std::vector<char> m_Ring;
+    size_t m_nMask;
+
+    //these only ever increase - positions in the ring are found by masking
+    size_t m_nRead;
+    size_t m_nWrite;
+
+    std::deque<Telegram> m_Telegrams;
+
+    bool m_bInTelegram;
+    double m_dfTelegramStart;
+    unsigned int m_nDiscarded;
+};
+
+}
+
+#endif /* TELEGRAMFRAMER_H_ */
@@ -0,0 +1,114 @@
+/*
+ * CompactMsgTest.cpp
+ * converts messages to and from CompactMsg and checks copies share storage
+ */
+
+#include "MOOS/libMOOS/Comms/CompactMsg.h"
+#include "MOOS/libMOOS/Utils/LockFreeQueue.h"
+#include "TestReport.h"
+#include <iostream>
+#include <iomanip>
+
+bool Same(const CMOOSMsg & A, const CMOOSMsg & B)
+{
+	return A.m_cMsgType==B.m_cMsgType && A.m_cDataType==B.m_cDataType &&
+			A.m_nID==B.m_nID && A.m_dfTime==B.m_dfTime &&
+			A.m_dfVal==B.m_dfVal && A.m_dfVal2==B.m_dfVal2 &&
+			A.m_sKey==B.m_sKey && A.m_sVal==B.m_sVal && A.m_sSrc==B.m_sSrc &&
+			A.m_sSrcAux==B.m_sSrcAux &&
+			A.m_sOriginatingCommunity==B.m_sOriginatingCommunity;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	CMOOSMsg Nav(MOOS_NOTIFY,"NAV_X_WITH_A_LONG_NAME",12.5,100.0);
+	Nav.m_sSrc = "pNavigationManager";
+	Nav.m_sSrcAux = "a source aux which is long enough to share";
+	Nav.m_sOriginatingCommunity = "alpha_community";
+	Nav.m_dfVal2 = 3.0;
+	Nav.m_nID = 42;
+
+	CMOOSMsg Status(MOOS_NOTIFY,"STATUS",std::string(1000,'s'),101.0);
+	Status.m_sSrc = "pNavigationManager";
+
+	CMOOSMsg Binary(MOOS_NOTIFY,"PING",std::string("a\0b",3),102.0);
+	Binary.MarkAsBinary();
+
+	//round trips
+	{
+		bool bPassed = true;
+		CMOOSMsg Back;
+		MOOS::CompactMsg C(Nav);
+		C.ToMsg(Back);
+		bPassed &= Same(Nav,Back);
+		MOOS::CompactMsg(Status).ToMsg(Back);
+		bPassed &= Same(Status,Back);
+		MOOS::CompactMsg(Binary).ToMsg(Back);
+		bPassed &= Same(Binary,Back) && Back.IsDataType(MOOS_BINARY_STRING);
+		MOOS::CompactMsg().ToMsg(Back);
+		bPassed &= Same(CMOOSMsg(),Back);
+		Report("round trip",bPassed,bOK);
+	}
+
+	//straight from a serialised message
+	{
+		unsigned char Buffer[2048];
+		int nLength = Nav.Serialize(Buffer,sizeof(Buffer));
+		MOOS::MsgView View;
+		CMOOSMsg Back;
+		bool bPassed = View.Decode(Buffer,nLength)==nLength;
+		MOOS::CompactMsg(View).ToMsg(Back);
+		Report("from view",bPassed && Same(Nav,Back),bOK);
+	}
+
+	//names are interned so every copy of them is the same block
+	{
+		MOOS::CompactMsg A(Nav);
+		MOOS::CompactMsg B(Nav);
+		bool bPassed = A.GetKey().IsInterned() && A.GetSource().IsInterned() &&
+				A.GetKey().data()==B.GetKey().data() &&
+				A.GetSource().data()==B.GetSource().data() &&
+				!A.GetSourceAux().IsInterned();
+		Report("interned",bPassed,bOK);
+	}
+
+	//copies share the value rather than copying it
+	{
+		MOOS::CompactMsg A(Status);
+		MOOS::CompactMsg B(A);
+		MOOS::CompactMsg C;
+		C = B;
+		bool bPassed = A.GetString().data()==B.GetString().data() &&
+				A.GetString().data()==C.GetString().data() &&
+				A.GetString()==C.GetString();
+
+		//and outlive the original
+		const char * pData = A.GetString().data();
+		A = MOOS::CompactMsg();
+		bPassed &= C.GetString().data()==pData && C.GetString().size()==1000 &&
+				A.GetString().empty();
+		Report("shared value",bPassed,bOK);
+	}
+
+	//and pass through a queue intact
+	{
+		MOOS::LockFreeQueue<MOOS::CompactMsg> Q(4);
+		for(int i = 0;i<10;i++)
+			Q.Push(MOOS::CompactMsg(i%2 ? Nav : Status));
+
+		bool bPassed = true;
+		MOOS::CompactMsg C;
+		CMOOSMsg Back;
+		for(int i = 0;i<10;i++)
+		{
+			bPassed &= Q.Pull(C);
+			C.ToMsg(Back);
+			bPassed &= Same(i%2 ? Nav : Status,Back);
+		}
+		Report("queued",bPassed && Q.IsEmpty(),bOK);
+	}
+
+	return Finish(bOK);
+}
@@ -0,0 +1,95 @@
+/*
+ * CompressionTest.cpp
+ * round trips packets of various sorts through CMOOSCommPkt compression
+ */
+
+#include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+
+//send Pkt "over the wire" and read it back
+bool RoundTrip(const std::string & sName, MOOSMSG_LIST & Out, unsigned int nThreshold)
+{
+	CMOOSCommPkt PktTx;
+	PktTx.Serialize(Out,true);
+	bool bCompressed = PktTx.Compress(nThreshold);
+
+	CMOOSCommPkt PktRx;
+	while(PktRx.GetBytesRequired()>0)
+	{
+		int n = PktRx.GetBytesRequired();
+		memcpy(PktRx.NextWrite(),PktTx.Stream()+PktRx.GetStreamLength(),n);
+		PktRx.OnBytesWritten(PktRx.NextWrite(),n);
+	}
+
+	MOOSMSG_LIST In;
+	PktRx.Serialize(In,false);
+
+	bool bOK = In.size()==Out.size();
+	MOOSMSG_LIST::iterator p,q;
+	for(p=In.begin(),q=Out.begin();bOK && p!=In.end();++p,++q)
+	{
+		bOK = p->GetKey()==q->GetKey() &&
+				p->GetString()==q->GetString() &&
+				p->GetDouble()==q->GetDouble();
+	}
+
+	std::ostringstream ss;
+	ss<<std::setw(20)<<sName
+			<<std::setw(10)<<PktRx.GetUncompressedLength()
+			<<std::setw(10)<<PktTx.GetWireLength()
+			<<std::setw(10)<<std::setprecision(3)<<PktTx.GetCompression()
+			<<(bCompressed ? "  compressed" : "  raw");
+
+	bool bAll = true;
+	return Report(ss.str(),bOK,bAll);
+}
+
+int main()
+{
+	bool bOK = true;
+
+	//lots of small doubles
+	MOOSMSG_LIST Doubles;
+	for(int i = 0;i<500;i++)
+		Doubles.push_back(CMOOSMsg(MOOS_NOTIFY,MOOSFormat("X_%d",i%10),(double)i));
+	bOK &= RoundTrip("doubles",Doubles,1024);
+
+	//a big repetitive text payload
+	MOOSMSG_LIST Text;
+	std::string sText;
+	for(int i = 0;i<2000;i++)
+		sText+=MOOSFormat("x=%d,y=%d,status=nominal;",i%7,i%13);
+	Text.push_back(CMOOSMsg(MOOS_NOTIFY,"TEXT",sText));
+	bOK &= RoundTrip("text",Text,1024);
+
+	//random binary data won't compress so should go raw
+	MOOSMSG_LIST Random;
+	std::string sRandom(100000,' ');
+	for(unsigned int i = 0;i<sRandom.size();i++)
+		sRandom[i] = (char)(rand()&0xFF);
+	Random.push_back(CMOOSMsg(MOOS_NOTIFY,"RANDOM",sRandom));
+	Random.back().MarkAsBinary();
+	bOK &= RoundTrip("random",Random,1024);
+
+	//a small packet under the threshold
+	MOOSMSG_LIST Small;
+	Small.push_back(CMOOSMsg(MOOS_NOTIFY,"SMALL",std::string(100,'a')));
+	bOK &= RoundTrip("small",Small,1024);
+
+	//a sonar-like image - smooth with a bit of noise
+	MOOSMSG_LIST Image;
+	std::string sImage(640*480,' ');
+	for(unsigned int i = 0;i<sImage.size();i++)
+		sImage[i] = (char)(((i%640)/8 + (rand()%3==0)) & 0xFF);
+	Image.push_back(CMOOSMsg(MOOS_NOTIFY,"IMAGE",sImage));
+	Image.back().MarkAsBinary();
+	bOK &= RoundTrip("image",Image,1024);
+
+	return Finish(bOK);
+}
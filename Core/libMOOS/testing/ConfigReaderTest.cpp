@@ -0,0 +1,168 @@
+/*
+ * ConfigReaderTest.cpp
+ * checks look ups against the mission file index built by SetFile()
+ */
+
+#include "MOOS/libMOOS/Utils/ProcessConfigReader.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "TestReport.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdio>
+#include <vector>
+
+const char * kMissionFile = "config_reader_test.moos";
+
+CProcessConfigReader gReader;
+const int kReaders = 4;
+
+bool Read(void * pParam)
+{
+	bool & bPassed = *static_cast<bool*>(pParam);
+	for(int i = 0;i<2000;i++)
+	{
+		std::string sVal;
+		bPassed &= gReader.GetConfigurationParam("uTest","Name",sVal) && sVal=="hello world";
+		bPassed &= gReader.GetValue("ServerPort",sVal) && sVal=="9000";
+
+		STRING_LIST Params;
+		bPassed &= gReader.GetConfiguration("pAntler",Params) && Params.size()==3;
+	}
+	return true;
+}
+
+int main()
+{
+	{
+		std::ofstream of(kMissionFile);
+		of<<"// a comment\n"
+			"  ServerHost = localhost\n"
+			"ServerPort = 9000 // trailing comment\n"
+			"define: VEHICLE = alpha\n"
+			"Community = ${VEHICLE}\n"
+			"\n"
+			"ProcessConfig = pAntler\n"
+			"{\n"
+			"  Run = MOOSDB @ NewConsole = false\n"
+			"  Run = uTest @ NewConsole = true\n"
+			"  MSBetweenLaunches = 200\n"
+			"}\n"
+			"\n"
+			"ProcessConfig = uTest\n"
+			"{\n"
+			"   AppTick = 4\n"
+			"   Name = hello world   // spaced\n"
+			"   Quoted = \"x // y\"\n"
+			"   Flag = true\n"
+			"   Where = ${VEHICLE}_base\n"
+			"   M = [2x1]{1,\n"
+			"   2]\n"
+			"   After = 7\n"
+			"}\n"
+			"\n"
+			"ProcessConfig = uBroken\n"
+			"{\n"
+			"   a = 1\n";
+	}
+
+	bool bOK = true;
+
+	CProcessConfigReader Missing;
+	Report("missing file",!Missing.SetFile("no_such_file.moos") && !Missing.IsOpen(),bOK);
+
+	Report("set file",gReader.SetFile(kMissionFile) && gReader.IsOpen(),bOK);
+
+	//tokens anywhere in the file
+	{
+		std::string sVal;
+		double dfVal = 0;
+		bool bPassed = gReader.GetValue("serverhost",sVal) && sVal=="localhost";
+		bPassed &= gReader.GetValue("SERVERPORT",dfVal) && dfVal==9000;
+		bPassed &= gReader.GetValue("Community",sVal) && sVal=="alpha";
+		bPassed &= gReader.GetValue("Run",sVal) && sVal=="MOOSDB@NewConsole=false";
+		bPassed &= !gReader.GetValue("NotThere",sVal);
+		Report("global values",bPassed,bOK);
+	}
+
+	//parameters in blocks
+	{
+		gReader.SetAppName("uTest");
+		std::string sVal;
+		int nVal = 0;
+		bool bVal = false;
+		bool bPassed = gReader.GetConfigurationParam("apptick",nVal) && nVal==4;
+		bPassed &= gReader.GetConfigurationParam("Name",sVal) && sVal=="hello world";
+		bPassed &= gReader.GetConfigurationParam("Quoted",sVal) && sVal=="x // y";
+		bPassed &= gReader.GetConfigurationParam("Flag",bVal) && bVal;
+		bPassed &= gReader.GetConfigurationParam("Where",sVal) && sVal=="alpha_base";
+		bPassed &= gReader.GetConfigurationParam("UTEST","M",sVal) && sVal=="[2x1]{1,";
+		bPassed &= gReader.GetConfigurationParam("pAntler","Run",sVal) && sVal=="MOOSDB @ NewConsole = false";
+		bPassed &= !gReader.GetConfigurationParam("pAntler","AppTick",sVal);
+		bPassed &= !gReader.GetConfigurationParam("nope","AppTick",sVal);
+		Report("block values",bPassed,bOK);
+	}
+
+	//a bare matrix line has always hidden what follows it, and a block
+	//without a closing brace can't be read
+	{
+		std::string sVal;
+		bool bPassed = !gReader.GetConfigurationParam("uTest","After",sVal);
+		bPassed &= !gReader.GetConfigurationParam("uBroken","a",sVal);
+		Report("quirks",bPassed,bOK);
+	}
+
+	//whole blocks
+	{
+		STRING_LIST Params;
+		bool bPassed = gReader.GetConfiguration("pAntler",Params) && Params.size()==3;
+		bPassed &= Params.front()=="MSBetweenLaunches=200";
+		bPassed &= gReader.GetConfigurationAndPreserveSpace("pAntler",Params) && Params.size()==3;
+		bPassed &= Params.front()=="Run=MOOSDB @ NewConsole = false";
+		bPassed &= !gReader.GetConfiguration("nope",Params) && Params.empty();
+		Report("blocks",bPassed,bOK);
+	}
+
+	//stepping through the file line by line
+	{
+		bool bPassed = gReader.Reset() && gReader.GoTo("ProcessConfig=uTest");
+		bPassed &= gReader.GetNextValidLine()=="{";
+		bPassed &= gReader.GetNextValidLine()=="AppTick = 4";
+		int nLines = 0;
+		gReader.Reset();
+		while(!gReader.eof())
+		{
+			gReader.GetNextValidLine();
+			nLines++;
+		}
+		bPassed &= nLines==24;
+		Report("valid lines",bPassed,bOK);
+	}
+
+	//many threads sharing one reader
+	{
+		bool bResults[kReaders];
+		std::vector<CMOOSThread*> Threads;
+		for(int i = 0;i<kReaders;i++)
+		{
+			bResults[i] = true;
+			Threads.push_back(new CMOOSThread);
+			Threads.back()->Initialise(Read,&bResults[i]);
+			Threads.back()->Start();
+		}
+
+		bool bPassed = true;
+		for(int i = 0;i<kReaders;i++)
+		{
+			while(Threads[i]->IsThreadRunning())
+				MOOSPause(10);
+			bPassed &= bResults[i];
+			delete Threads[i];
+		}
+		Report("threads",bPassed,bOK);
+	}
+
+	std::remove(kMissionFile);
+
+	return Finish(bOK);
+}
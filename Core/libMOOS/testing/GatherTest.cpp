@@ -0,0 +1,100 @@
+/*
+ * GatherTest.cpp
+ * checks packets which send big payloads from where they lie look,
+ * on the wire, just like ones which copy everything
+ */
+
+#include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+
+//what would go on the wire starting nFrom bytes in
+std::string Wire(CMOOSCommPkt & Pkt, int nFrom = 0)
+{
+	std::vector<CMOOSCommPkt::WireSegment> Segments;
+	Pkt.GetWireSegments(Segments,nFrom);
+
+	std::string sWire;
+	for(unsigned int i = 0;i<Segments.size();i++)
+		sWire.append((const char*)Segments[i].pData,Segments[i].nLength);
+	return sWire;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	//a mixture of small messages and big binary ones
+	MOOSMSG_LIST Small;
+	MOOSMSG_PTR_LIST Shared;
+	for(int i = 0;i<10;i++)
+	{
+		Small.push_back(CMOOSMsg(MOOS_NOTIFY,MOOSFormat("X_%d",i),(double)i));
+
+		std::string sImage(i%2 ? 100 : 100000+i,' ');
+		for(unsigned int j = 0;j<sImage.size();j++)
+			sImage[j] = (char)(rand()&0xFF);
+		MOOSMSG_PTR pMsg(new CMOOSMsg(MOOS_NOTIFY,MOOSFormat("IMAGE_%d",i),sImage));
+		pMsg->MarkAsBinary();
+		Shared.push_back(pMsg);
+	}
+
+	//the old way - everything copied
+	MOOSMSG_LIST All(Small);
+	for(MOOSMSG_PTR_LIST::iterator q = Shared.begin();q!=Shared.end();++q)
+		All.push_back(**q);
+	CMOOSCommPkt Flat;
+	Flat.Serialize(All,true);
+	std::string sExpected(( const char*)Flat.Stream(),Flat.GetStreamLength());
+
+	CMOOSCommPkt Gathered;
+	Gathered.Serialize(Small,Shared);
+	Report("is gathered",Gathered.IsGathered() && !Flat.IsGathered(),bOK);
+	Report("same length",Gathered.GetStreamLength()==Flat.GetStreamLength(),bOK);
+	Report("same bytes",Wire(Gathered)==sExpected,bOK);
+
+	//as if the socket took the packet in dribs and drabs
+	bool bPartialOK = true;
+	for(int nFrom = 0;nFrom<Gathered.GetStreamLength();nFrom+=997)
+		bPartialOK &= Wire(Gathered,nFrom)==sExpected.substr(nFrom);
+	Report("partial sends",bPartialOK,bOK);
+
+	//the packet must keep the shared messages alive
+	Shared.clear();
+	Report("outlives messages",Wire(Gathered)==sExpected,bOK);
+
+	//and read back in
+	CMOOSCommPkt PktRx;
+	while(PktRx.GetBytesRequired()>0)
+	{
+		int n = PktRx.GetBytesRequired();
+		memcpy(PktRx.NextWrite(),sExpected.data()+PktRx.GetStreamLength(),n);
+		PktRx.OnBytesWritten(PktRx.NextWrite(),n);
+	}
+	MOOSMSG_LIST In;
+	PktRx.Serialize(In,false);
+	bool bSame = In.size()==All.size();
+	MOOSMSG_LIST::iterator p,q;
+	for(p=In.begin(),q=All.begin();bSame && p!=In.end();++p,++q)
+		bSame = p->GetKey()==q->GetKey() && p->GetString()==q->GetString();
+	Report("decodes",bSame,bOK);
+
+	//flattening gives the old stream
+	Gathered.Flatten();
+	Report("flattens",!Gathered.IsGathered() &&
+			std::string((const char*)Gathered.Stream(),Gathered.GetStreamLength())==sExpected,bOK);
+
+	//and compression still works on gathered packets
+	CMOOSCommPkt Compressed;
+	MOOSMSG_PTR_LIST Text;
+	Text.push_back(MOOSMSG_PTR(new CMOOSMsg(MOOS_NOTIFY,"TEXT",std::string(100000,'a'))));
+	Compressed.Serialize(MOOSMSG_LIST(),Text);
+	Report("compresses",Compressed.IsGathered() && Compressed.Compress(1024) &&
+			!Compressed.IsGathered() && Compressed.GetWireLength()<1000,bOK);
+
+	return Finish(bOK);
+}
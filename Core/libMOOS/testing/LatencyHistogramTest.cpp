@@ -0,0 +1,223 @@
+/*
+ * LatencyHistogramTest.cpp
+ * checks latency histograms and the summaries EndToEndAudit publishes
+ */
+
+#include "MOOS/libMOOS/Comms/LatencyHistogram.h"
+#include "MOOS/libMOOS/Comms/EndToEndAudit.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "TestReport.h"
+#include <iostream>
+#include <iomanip>
+
+//is the bucket's top no more than ~6% above the value?
+bool Close(uint64_t nReported, uint64_t nValue)
+{
+	return nReported>=nValue && nReported<=nValue+nValue/16+1;
+}
+
+//what the recording threads below count into
+MOOS::EndToEndAudit * gpAudit = NULL;
+
+bool RecordX(void *)
+{
+	double dfNow = MOOSLocalTime();
+	CMOOSMsg X(MOOS_NOTIFY,"X",1.0,dfNow-0.002);
+	X.m_sSrc = "a";
+	for(int i = 0;i<50;i++)
+		gpAudit->AddForAudit(X,"me",dfNow);
+	return true;
+}
+
+//run nThreads threads recording X and wait for them to exit
+void RecordOnThreads(int nThreads)
+{
+	std::vector<CMOOSThread*> Threads;
+	for(int i = 0;i<nThreads;i++)
+	{
+		Threads.push_back(new CMOOSThread);
+		Threads.back()->Initialise(RecordX,NULL);
+		Threads.back()->Start();
+	}
+	for(int i = 0;i<nThreads;i++)
+	{
+		while(Threads[i]->IsThreadRunning())
+			MOOSPause(1);
+		delete Threads[i];
+	}
+}
+
+int main()
+{
+	bool bOK = true;
+
+	//every bucket starts where the last one ended
+	{
+		bool bPassed = MOOS::LatencyHistogram::BucketLowest(0)==0;
+		for(unsigned int i = 1;i<MOOS::LatencyHistogram::kNumBuckets;i++)
+		{
+			bPassed &= MOOS::LatencyHistogram::BucketLowest(i)==
+					MOOS::LatencyHistogram::BucketHighest(i-1)+1;
+			bPassed &= MOOS::LatencyHistogram::BucketFor(
+					MOOS::LatencyHistogram::BucketLowest(i))==i;
+			bPassed &= MOOS::LatencyHistogram::BucketFor(
+					MOOS::LatencyHistogram::BucketHighest(i))==i;
+		}
+		bPassed &= MOOS::LatencyHistogram::BucketFor(-5)==0;
+		bPassed &= MOOS::LatencyHistogram::BucketFor(int64_t(1)<<50)==
+				MOOS::LatencyHistogram::kNumBuckets-1;
+		Report("buckets",bPassed,bOK);
+	}
+
+	//percentiles of 1..1000us
+	MOOS::LatencyHistogram H;
+	{
+		for(int i = 1;i<=1000;i++)
+			H.Record(i);
+		bool bPassed = H.GetCount()==1000;
+		bPassed &= Close(H.GetPercentile(50),500);
+		bPassed &= Close(H.GetPercentile(99),990);
+		bPassed &= Close(H.GetMax(),1000);
+		bPassed &= H.GetMean()==500.5;
+		Report("percentiles",bPassed,bOK);
+	}
+
+	//merging
+	{
+		MOOS::LatencyHistogram A,B;
+		A.Record(10,5);
+		B.Record(1000000,5);
+		A.Merge(B);
+		bool bPassed = A.GetCount()==10;
+		bPassed &= Close(A.GetPercentile(50),10);
+		bPassed &= Close(A.GetMax(),1000000);
+		Report("merge",bPassed,bOK);
+	}
+
+	//encoding
+	{
+		std::string s;
+		H.Encode(s);
+		MOOS::LatencyHistogram Back;
+		size_t nPos = 0;
+		bool bPassed = Back.Decode(s,nPos) && nPos==s.size();
+		for(unsigned int i = 0;i<MOOS::LatencyHistogram::kNumBuckets;i++)
+			bPassed &= Back.GetBucketCount(i)==H.GetBucketCount(i);
+		bPassed &= Back.GetMean()==H.GetMean();
+		nPos = 0;
+		bPassed &= !Back.Decode(s.substr(0,s.size()-1),nPos);
+		Report("encode",bPassed,bOK);
+	}
+
+	//the audit only reports what arrived since it was last asked
+	{
+		MOOS::EndToEndAudit Audit;
+		double dfNow = MOOSLocalTime();
+		CMOOSMsg X(MOOS_NOTIFY,"X",1.0,dfNow-0.002);
+		X.m_sSrc = "a";
+		CMOOSMsg Y(MOOS_NOTIFY,"Y","hello",dfNow-0.5);
+		Y.m_sSrc = "b";
+		for(int i = 0;i<100;i++)
+			Audit.AddForAudit(X,"me",dfNow);
+		Audit.AddForAudit(Y,"me",dfNow);
+
+		std::vector<MOOS::EndToEndAudit::LatencySummary> Summaries;
+		Audit.Collect(Summaries);
+		bool bPassed = Summaries.size()==1 && Summaries[0].channels.size()==2;
+		for(unsigned int i = 0;bPassed && i<Summaries[0].channels.size();i++)
+		{
+			const MOOS::EndToEndAudit::LatencySummary::Channel & C = Summaries[0].channels[i];
+			if(C.message_name=="X")
+				bPassed &= C.source_client=="a" && C.latency.GetCount()==100 &&
+					Close(C.latency.GetPercentile(50),2000) &&
+					C.bytes==100*X.GetSizeInBytesWhenSerialised();
+			else
+				bPassed &= C.source_client=="b" && C.latency.GetCount()==1 &&
+					Close(C.latency.GetMax(),500000);
+		}
+		bPassed &= Summaries[0].destination_client=="me";
+
+		Audit.AddForAudit(Y,"me",dfNow);
+		Summaries.clear();
+		Audit.Collect(Summaries);
+		bPassed &= Summaries.size()==1 && Summaries[0].channels.size()==1 &&
+				Summaries[0].channels[0].latency.GetCount()==1;
+
+		Summaries.clear();
+		Audit.Collect(Summaries);
+		bPassed &= Summaries.empty();
+		Report("audit",bPassed,bOK);
+	}
+
+	//threads recording the same channel make one channel between them
+	//and what threads which have gone recorded is still published
+	{
+		MOOS::EndToEndAudit Audit;
+		gpAudit = &Audit;
+
+		RecordOnThreads(4);
+		std::vector<MOOS::EndToEndAudit::LatencySummary> Summaries;
+		Audit.Collect(Summaries);
+		bool bPassed = Summaries.size()==1 && Summaries[0].channels.size()==1 &&
+				Summaries[0].channels[0].latency.GetCount()==200;
+
+		//and once it has been their recorders are let go
+		Summaries.clear();
+		Audit.Collect(Summaries);
+		bPassed &= Summaries.empty();
+
+		RecordOnThreads(2);
+		Audit.AddForAudit(CMOOSMsg(MOOS_NOTIFY,"X",1.0,MOOSLocalTime()),"me",MOOSLocalTime());
+		Summaries.clear();
+		Audit.Collect(Summaries);
+		bPassed &= Summaries.size()==1 && Summaries[0].channels.size()==2;
+		for(unsigned int i = 0;bPassed && i<Summaries[0].channels.size();i++)
+		{
+			const MOOS::EndToEndAudit::LatencySummary::Channel & C = Summaries[0].channels[i];
+			bPassed &= C.latency.GetCount()==(C.source_client=="a" ? 100u : 1u);
+		}
+		Report("threads",bPassed,bOK);
+		gpAudit = NULL;
+	}
+
+	//summaries too big for one datagram are split
+	{
+		MOOS::EndToEndAudit::LatencySummary S;
+		S.destination_client = "me";
+		S.time = 123456789;
+		S.cpu_load = 12.5;
+		S.channels.resize(200);
+		for(unsigned int i = 0;i<S.channels.size();i++)
+		{
+			S.channels[i].source_client = "src";
+			S.channels[i].message_name = MOOSFormat("VAR_%d",i);
+			S.channels[i].bytes = i;
+			S.channels[i].latency.Record(i*100,i+1);
+		}
+
+		std::vector<std::string> Datagrams;
+		S.Encode(Datagrams,1000);
+		bool bPassed = Datagrams.size()>1;
+		unsigned int nChannel = 0;
+		for(unsigned int i = 0;i<Datagrams.size();i++)
+		{
+			MOOS::EndToEndAudit::LatencySummary Back;
+			bPassed &= Datagrams[i].size()<=1000 && Back.Decode(Datagrams[i]);
+			bPassed &= Back.destination_client=="me" && Back.time==S.time &&
+					Back.cpu_load==S.cpu_load;
+			for(unsigned int j = 0;j<Back.channels.size();j++,nChannel++)
+			{
+				bPassed &= Back.channels[j].message_name==S.channels[nChannel].message_name;
+				bPassed &= Back.channels[j].bytes==S.channels[nChannel].bytes;
+				bPassed &= Back.channels[j].latency.GetCount()==nChannel+1;
+			}
+		}
+		bPassed &= nChannel==S.channels.size();
+
+		MOOS::EndToEndAudit::LatencySummary Back;
+		bPassed &= !Back.Decode("src=a,dest=b,name=X");
+		Report("datagrams",bPassed,bOK);
+	}
+
+	return Finish(bOK);
+}
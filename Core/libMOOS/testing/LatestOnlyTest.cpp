@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * LatestOnlyTest.cpp
+ * a client which calls in slowly and asked for latest values only gets
+ * one, freshest, notification per variable however many changes it missed
+ */
+
+#include "MOOS/libMOOS/DB/MOOSDB.h"
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <vector>
+
+const int kPort = 9371;
+const int kNumWrites = 50;
+
+bool WaitForConnection(CMOOSCommClient & Client)
+{
+	for(int i = 0;i<300 && !Client.IsConnected();i++)
+		MOOSPause(10);
+	return Client.IsConnected();
+}
+
+int main()
+{
+	bool bOK = true;
+
+	CMOOSDB DB;
+	DB.SetQuiet(true);
+	const char * Args[] = {"latest_only_test","--moos_port=9371",
+			"--moos_suicide_disable","--moos_no_colour"};
+	DB.Run(4,const_cast<char**>(Args));
+
+	//a synchronous client calling in once a second, so mail piles up
+	CMOOSCommClient Slow;
+	Slow.SetQuiet(true);
+	Slow.Run("localhost",kPort,"slow",1);
+
+	MOOS::MOOSAsyncCommClient Poster;
+	Poster.SetQuiet(true);
+	Poster.Run("localhost",kPort,"poster");
+
+	if(!Report("connect",WaitForConnection(Slow) && WaitForConnection(Poster),bOK))
+		return Finish(false);
+
+	Slow.Register("EVERY",0.0);
+	Slow.Register("LATEST",0.0,true);
+
+	//registrations go with the next call in
+	MOOSPause(2500);
+
+	for(int k = 0;k<kNumWrites;k++)
+	{
+		Poster.Notify("EVERY",(double)k);
+		Poster.Notify("LATEST",(double)k);
+	}
+
+	//and the mail with the one after
+	MOOSPause(2500);
+
+	std::vector<double> Every,Latest;
+	MOOSMSG_LIST Mail;
+	Slow.Fetch(Mail);
+	for(MOOSMSG_LIST::iterator q = Mail.begin();q!=Mail.end();++q)
+	{
+		if(q->IsName("EVERY"))
+			Every.push_back(q->GetDouble());
+		else if(q->IsName("LATEST"))
+			Latest.push_back(q->GetDouble());
+	}
+
+	std::cout<<"  EVERY: "<<Every.size()<<" LATEST: "<<Latest.size()<<"\n";
+
+	bool bEvery = (int)Every.size()==kNumWrites;
+	for(unsigned int i = 1;i<Every.size();i++)
+		bEvery &= Every[i]>Every[i-1];
+	Report("every change of an ordinary subscription",bEvery,bOK);
+
+	//the writes might straddle a call in, so at most one each side of it
+	Report("only the latest of a latest only subscription",
+			!Latest.empty() && Latest.size()<=2 && Latest.back()==kNumWrites-1,bOK);
+
+	Slow.Close();
+	Poster.Close();
+
+	return Finish(bOK);
+}
@@ -0,0 +1,160 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * LockFreeQueueTest.cpp
+ * several producers push through one LockFreeQueue to a single consumer
+ */
+
+#include "MOOS/libMOOS/Utils/LockFreeQueue.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+//a small ring so the overflow path gets a good work out
+MOOS::LockFreeQueue<std::pair<int,int> > gQueue(64);
+
+const int kProducers = 4;
+const int kPerProducer = 200000;
+
+//elements are (producer*2 + 1 if it ends a batch, sequence number)
+bool Produce(void * pParam)
+{
+	int nProducer = *static_cast<int*>(pParam);
+	for(int i = 0;i<kPerProducer;i++)
+		gQueue.Push(std::make_pair(nProducer*2+1,i));
+	return true;
+}
+
+//batches of 1 to 100 elements, some too big for the ring
+bool ProduceBatches(void * pParam)
+{
+	int nProducer = *static_cast<int*>(pParam);
+	int i = 0;
+	while(i<kPerProducer)
+	{
+		std::list<std::pair<int,int> > Batch;
+		int nSize = std::min(1+(i*7)%100,kPerProducer-i);
+		for(int j = 0;j<nSize;j++,i++)
+			Batch.push_back(std::make_pair(nProducer*2+(j==nSize-1),i));
+		gQueue.AppendToMeInConstantTime(Batch);
+	}
+	return true;
+}
+
+//run the producers and check what comes out. Each producer's elements
+//must come out in order, none may be lost and a drain must never stop
+//part way through a batch
+bool Run(bool (*pfnProduce)(void*), double & dfTaken)
+{
+	std::vector<int> Ids(kProducers);
+	std::vector<CMOOSThread*> Threads;
+	for(int i = 0;i<kProducers;i++)
+	{
+		Ids[i] = i;
+		Threads.push_back(new CMOOSThread);
+		Threads.back()->Initialise(pfnProduce,&Ids[i]);
+	}
+
+	double dfStart = MOOSLocalTime();
+	for(int i = 0;i<kProducers;i++)
+		Threads[i]->Start();
+
+	std::vector<int> Next(kProducers,0);
+	int nReceived = 0;
+	bool bOK = true;
+	while(bOK && nReceived<kProducers*kPerProducer)
+	{
+		if(!gQueue.WaitForPush(1000))
+		{
+			std::cout<<"timed out waiting for a push\n";
+			bOK = false;
+			break;
+		}
+
+		std::list<std::pair<int,int> > Drained;
+		gQueue.AppendToOtherInConstantTime(Drained);
+		std::vector<int> LastFlag(kProducers,1);
+		std::list<std::pair<int,int> >::iterator q;
+		for(q = Drained.begin();q!=Drained.end();++q)
+		{
+			int nProducer = q->first/2;
+			if(q->second!=Next[nProducer]++)
+			{
+				std::cout<<"producer "<<nProducer<<" out of order at "<<q->second<<"\n";
+				bOK = false;
+			}
+			LastFlag[nProducer] = q->first%2;
+			nReceived++;
+		}
+
+		for(int i = 0;i<kProducers;i++)
+		{
+			if(!LastFlag[i])
+			{
+				std::cout<<"producer "<<i<<" had a batch split at "<<Next[i]<<"\n";
+				bOK = false;
+			}
+		}
+	}
+	dfTaken = MOOSLocalTime()-dfStart;
+
+	for(int i = 0;i<kProducers;i++)
+	{
+		Threads[i]->Stop();
+		delete Threads[i];
+	}
+
+	return bOK && gQueue.IsEmpty();
+}
+
+int main()
+{
+	bool bOK = true;
+	double dfTaken;
+
+	Report("single pushes",Run(Produce,dfTaken),bOK);
+	std::cout<<kProducers*kPerProducer<<" elements in "<<dfTaken<<"s\n";
+
+	Report("whole batches",Run(ProduceBatches,dfTaken),bOK);
+	std::cout<<kProducers*kPerProducer<<" elements in "<<dfTaken<<"s\n";
+
+	//waiting for the next push
+	{
+		uint64_t nPushes = gQueue.GetPushCount();
+		double dfStart = MOOSLocalTime();
+		bool bPassed = !gQueue.WaitForPushSince(nPushes,20000);
+		double dfWaited = MOOSLocalTime()-dfStart;
+		bPassed &= dfWaited>0.015 && dfWaited<0.5;
+		gQueue.Push(std::make_pair(0,0));
+		bPassed &= gQueue.WaitForPushSince(nPushes,20000);
+		bPassed &= gQueue.GetPushCount()==nPushes+1;
+		gQueue.Clear();
+		Report("push count",bPassed,bOK);
+	}
+
+	return Finish(bOK);
+}
@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * NotifyBatchTest.cpp
+ * a committed NotifyBatch reaches the server in one packet, whole and in
+ * order, even while another thread is busy notifying through the same client
+ */
+
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/Comms/NotifyBatch.h"
+#include "MOOS/libMOOS/Comms/ThreadedCommServer.h"
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <map>
+#include <vector>
+
+const int kPort = 9381;
+const int kNumBatches = 20;
+const int kBatchSize = 200;
+
+CMOOSLock gLock;
+
+//for each batch the size of every piece of it that arrived, in order, and
+//whether its messages came in the order they were added
+std::map<int,std::vector<int> > gPieces;
+bool gbInOrder = true;
+int gnBatchMsgs = 0;
+
+bool OnRx(const std::string & /*sClient*/, MOOSMSG_LIST & Rx, MOOSMSG_LIST & /*Tx*/, void *)
+{
+	MOOS::ScopedLock Lock(gLock);
+	std::map<int,int> InThisPkt;
+	std::map<int,int> LastIndex;
+	for(MOOSMSG_LIST::iterator q = Rx.begin();q!=Rx.end();++q)
+	{
+		if(!q->IsType(MOOS_NOTIFY) || !q->IsName("BATCH"))
+			continue;
+
+		int nBatch = (int)q->GetDouble()/kBatchSize;
+		int nIndex = (int)q->GetDouble()%kBatchSize;
+		if(InThisPkt[nBatch]>0 && nIndex!=LastIndex[nBatch]+1)
+			gbInOrder = false;
+		LastIndex[nBatch] = nIndex;
+		InThisPkt[nBatch]++;
+		gnBatchMsgs++;
+	}
+
+	for(std::map<int,int>::iterator p = InThisPkt.begin();p!=InThisPkt.end();++p)
+		gPieces[p->first].push_back(p->second);
+
+	return true;
+}
+
+CMOOSThread gChatterThread;
+
+//notifies one message at a time until told to stop
+bool Chatter(void * pParam)
+{
+	MOOS::MOOSAsyncCommClient * pClient = static_cast<MOOS::MOOSAsyncCommClient*>(pParam);
+	for(int i = 0;!gChatterThread.IsQuitRequested();i++)
+	{
+		pClient->Notify("CHATTER",(double)i);
+		if(i%10==9)
+			MOOSPause(1);
+	}
+	return true;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	MOOS::ThreadedCommServer Server;
+	Server.SetQuiet(true);
+	Server.SetOnRxCallBack(OnRx,NULL);
+	if(!Server.Run(kPort,"notify_batch_test",true))
+	{
+		std::cout<<"could not start server\n";
+		return 1;
+	}
+
+	MOOS::MOOSAsyncCommClient Client;
+	Client.SetQuiet(true);
+	Client.Run("localhost",kPort,"batcher");
+	for(int i = 0;i<300 && !Client.IsConnected();i++)
+		MOOSPause(10);
+	if(!Report("connect",Client.IsConnected(),bOK))
+		return Finish(false);
+
+	gChatterThread.Initialise(Chatter,&Client);
+	gChatterThread.Start();
+
+	MOOS::NotifyBatch Batch(Client);
+	for(int k = 0;k<kNumBatches;k++)
+	{
+		for(int i = 0;i<kBatchSize;i++)
+			Batch.Notify("BATCH",(double)(k*kBatchSize+i));
+		Batch.Commit();
+		MOOSPause(5);
+	}
+	Report("committed batches are emptied",Batch.Size()==0,bOK);
+
+	for(int i = 0;i<500;i++)
+	{
+		{
+			MOOS::ScopedLock Lock(gLock);
+			if(gnBatchMsgs>=kNumBatches*kBatchSize)
+				break;
+		}
+		MOOSPause(10);
+	}
+
+	gChatterThread.Stop();
+
+	{
+		MOOS::ScopedLock Lock(gLock);
+		Report("every batch arrives",gnBatchMsgs==kNumBatches*kBatchSize,bOK);
+
+		bool bWhole = (int)gPieces.size()==kNumBatches;
+		for(std::map<int,std::vector<int> >::iterator p = gPieces.begin();p!=gPieces.end();++p)
+		{
+			if(p->second.size()!=1)
+				std::cout<<"  batch "<<p->first<<" came in "<<p->second.size()<<" packets\n";
+			bWhole &= p->second.size()==1 && p->second.front()==kBatchSize;
+		}
+		Report("each batch in one packet",bWhole,bOK);
+		Report("each batch in order",gbInOrder,bOK);
+	}
+
+	Client.Close();
+
+	return Finish(bOK);
+}
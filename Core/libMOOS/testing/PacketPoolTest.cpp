@@ -0,0 +1,110 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * PacketPoolTest.cpp
+ * packets made with CMOOSCommPkt::Make() are recycled through their pool
+ */
+
+#include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
+#include "MOOS/libMOOS/Utils/LockFreeQueue.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+
+const int kPkts = 100000;
+
+MOOS::SharedPacketBufferPool gpPool(new MOOS::PacketBufferPool);
+MOOS::LockFreeQueue<MOOS::SharedCommPkt> gQueue;
+
+bool Fill(CMOOSCommPkt & Pkt, int n)
+{
+	MOOSMSG_LIST Mail;
+	Mail.push_back(CMOOSMsg(MOOS_NOTIFY,"X",(double)n));
+	return Pkt.Serialize(Mail);
+}
+
+bool Read(CMOOSCommPkt & Pkt, int n)
+{
+	MOOSMSG_LIST Mail;
+	return Pkt.Serialize(Mail,false) && Mail.size()==1 && Mail.front().GetDouble()==n;
+}
+
+//like a server's reading thread, makes packets another thread finishes with
+//(and like a socket never gets far ahead of it)
+bool Produce(void *)
+{
+	for(int i = 0;i<kPkts;i++)
+	{
+		while(gQueue.Size()>8)
+			MOOSPause(0);
+		MOOS::SharedCommPkt pPkt = CMOOSCommPkt::Make(gpPool);
+		Fill(*pPkt,i);
+		gQueue.Push(pPkt);
+	}
+	return true;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	CMOOSCommPkt * pFirst;
+	{
+		MOOS::SharedCommPkt pPkt = CMOOSCommPkt::Make(gpPool);
+		pFirst = pPkt.get();
+		Fill(*pPkt,1);
+	}
+	MOOS::SharedCommPkt pAgain = CMOOSCommPkt::Make(gpPool);
+	Report("recycled",pAgain.get()==pFirst,bOK);
+	Report("emptied",pAgain->GetStreamLength()==0,bOK);
+	Report("reusable",Fill(*pAgain,2) && Read(*pAgain,2),bOK);
+
+	//a packet may outlive everything else which refers to its pool
+	{
+		MOOS::SharedPacketBufferPool pPool(new MOOS::PacketBufferPool);
+		MOOS::SharedCommPkt pPkt = CMOOSCommPkt::Make(pPool);
+		pPool = MOOS::SharedPacketBufferPool();
+		Report("outlives pool",Fill(*pPkt,3) && Read(*pPkt,3),bOK);
+	}
+
+	//made on one thread, finished with on another
+	unsigned int nAllocated = gpPool->GetAllocationCount();
+	CMOOSThread Producer;
+	Producer.Initialise(Produce,NULL);
+	Producer.Start();
+	bool bInOrder = true;
+	for(int i = 0;i<kPkts;i++)
+	{
+		MOOS::SharedCommPkt pPkt;
+		while(!gQueue.Pull(pPkt))
+			gQueue.WaitForPush(10);
+		bInOrder &= Read(*pPkt,i);
+	}
+	Producer.Stop();
+	Report("across threads",bInOrder,bOK);
+	Report("few allocations",gpPool->GetAllocationCount()-nAllocated<1000,bOK);
+
+	return Finish(bOK);
+}
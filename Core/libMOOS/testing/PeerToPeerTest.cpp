@@ -0,0 +1,272 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * PeerToPeerTest.cpp
+ * sends stubs and payloads between PeerToPeer links, and through a DB
+ */
+
+#include "MOOS/libMOOS/Comms/PeerToPeer.h"
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/DB/MOOSDB.h"
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+
+const unsigned int kPayloadSize = 1000*1000;
+int gnPort = 9361;
+
+CMOOSLock gLock;
+MOOSMSG_LIST gMail;
+
+bool OnMail(MOOSMSG_LIST & Mail, void *)
+{
+	MOOS::ScopedLock Lock(gLock);
+	gMail.splice(gMail.end(),Mail);
+	return true;
+}
+
+//wait a while for nMessages to have arrived
+bool WaitForMail(unsigned int nMessages)
+{
+	for(int i = 0;i<200;i++)
+	{
+		{
+			MOOS::ScopedLock Lock(gLock);
+			if(gMail.size()>=nMessages)
+				return true;
+		}
+		MOOSPause(10);
+	}
+	return false;
+}
+
+CMOOSMsg MakeFrame(char cFill)
+{
+	CMOOSMsg Msg(MOOS_NOTIFY,"FRAME",std::string(kPayloadSize,cFill),MOOSLocalTime());
+	Msg.MarkAsBinary();
+	Msg.m_sSrc = "camera";
+	Msg.m_sSrcAux = "lens=wide";
+	return Msg;
+}
+
+//the frames (by fill character) in Client's mail so far, and whether
+//any of them came without their payload
+std::string CollectFrames(CMOOSCommClient & Client, std::string & sFrames, bool & bAllFull)
+{
+	MOOSMSG_LIST Mail;
+	Client.Fetch(Mail);
+	for(MOOSMSG_LIST::iterator q = Mail.begin();q!=Mail.end();++q)
+	{
+		if(q->GetKey()!="FRAME")
+			continue;
+		bAllFull &= q->m_sVal.size()==kPayloadSize;
+		if(!q->m_sVal.empty())
+			sFrames+=q->m_sVal[0];
+	}
+	return sFrames;
+}
+
+template<class Client> bool Connect(Client & C, const std::string & sName)
+{
+	C.SetQuiet(true);
+	C.Run("localhost",gnPort,sName);
+	for(int i = 0;i<300 && !C.IsConnected();i++)
+		MOOSPause(10);
+	return C.IsConnected();
+}
+
+bool LinksOnly()
+{
+	bool bOK = true;
+
+	MOOS::PeerServer Server;
+	if(!Report("server runs",Server.Run(),bOK))
+		return false;
+
+	//stubs say where, which and how much but carry nothing
+	CMOOSMsg First = MakeFrame('a');
+	CMOOSMsg Stub;
+	bool bStub = Server.Publish(First,Stub);
+	std::string sHost;
+	int nPort;
+	bStub &= MOOS::P2P::IsStub(Stub) && !MOOS::P2P::IsStub(First);
+	bStub &= Stub.m_sVal.empty() && MOOS::P2P::GetPayloadSize(Stub)==kPayloadSize;
+	bStub &= MOOS::P2P::GetPublisher(Stub,sHost,nPort) && nPort==Server.GetPort();
+	bStub &= Stub.GetSource()=="camera";
+	Report("stub",bStub,bOK);
+
+	//following a stub gets us what it stands in for, as the writer sent it
+	MOOS::PeerLinks Links;
+	Links.SetMailCallBack(OnMail,NULL);
+	bool bFetched = Links.OnStub(Stub) && WaitForMail(1);
+	{
+		MOOS::ScopedLock Lock(gLock);
+		bFetched &= gMail.size()==1 && gMail.front().m_sVal==First.m_sVal;
+		bFetched &= gMail.front().GetSource()=="camera";
+		bFetched &= gMail.front().GetSourceAux()=="lens=wide";
+		gMail.clear();
+	}
+	Report("fetch",bFetched,bOK);
+
+	//nothing comes unasked...
+	CMOOSMsg Second;
+	Server.Publish(MakeFrame('b'),Second);
+	Report("no push",!WaitForMail(1),bOK);
+
+	//...and readers can ask for a sample which is no longer the latest
+	CMOOSMsg Third;
+	Server.Publish(MakeFrame('c'),Third);
+	bool bOlder = Links.OnStub(Second) && WaitForMail(1);
+	{
+		MOOS::ScopedLock Lock(gLock);
+		bOlder &= gMail.size()==1 && gMail.front().m_sVal[0]=='b';
+		gMail.clear();
+	}
+	Report("older sample",bOlder,bOK);
+
+	Report("one link",Server.GetNumPeers()==1 && Links.GetNumLinks()==1,bOK);
+
+	//a reader without the key in our stubs gets nothing but the stub
+	CMOOSMsg Forged = Third;
+	std::string::size_type n = Forged.m_sSrcAux.find("p2p_key=");
+	Forged.m_sSrcAux.replace(n+8,std::string::npos,"guess");
+	bool bRefused = Links.OnStub(Forged) && WaitForMail(1);
+	{
+		MOOS::ScopedLock Lock(gLock);
+		bRefused &= gMail.size()==1 && gMail.front().m_sVal.empty();
+		gMail.clear();
+	}
+	Report("wrong key",bRefused,bOK);
+
+	//and a writer which has gone away leaves us with the stub
+	Server.Stop();
+	MOOSPause(200);
+	Report("writer gone",!Links.OnStub(Third),bOK);
+
+	Links.Close();
+
+	return bOK;
+}
+
+//does the DB hold only a stub for the latest frame (so the frames went
+//straight from writer to readers)? Ask with a client which subscribes to
+//nothing - followers take any stub which comes their way
+bool DBHoldsStub(CMOOSCommClient & Client)
+{
+	MOOSMSG_LIST Reply;
+	CMOOSMsg Frame;
+	return Client.ServerRequest("ALL",Reply,2.0,false) &&
+			CMOOSCommClient::PeekMail(Reply,"FRAME",Frame) &&
+			MOOS::P2P::IsStub(Frame);
+}
+
+bool ThroughDB(int nPort, int nDispatchThreads)
+{
+	bool bOK = true;
+
+	std::cout<<"through a DB with "<<nDispatchThreads<<" dispatch thread(s)\n";
+
+	gnPort = nPort;
+	std::string sPort = MOOSFormat("--moos_port=%d",nPort);
+	std::string sDispatch = MOOSFormat("--dispatch_threads=%d",nDispatchThreads);
+
+	CMOOSDB DB;
+	DB.SetQuiet(true);
+	const char * Args[] = {"peer_to_peer_test",sPort.c_str(),sDispatch.c_str(),
+			"--moos_suicide_disable","--moos_no_colour"};
+	DB.Run(5,const_cast<char**>(Args));
+
+	MOOS::MOOSAsyncCommClient Camera,Viewer,Sampler;
+	CMOOSCommClient Legacy,Inspector;
+	bool bConnected = Connect(Camera,"camera") && Connect(Viewer,"viewer") &&
+			Connect(Sampler,"sampler") && Connect(Inspector,"inspector");
+	if(!Report("connect",bConnected,bOK))
+		return false;
+
+	Camera.SetPeerToPeerThreshold(1000);
+	Viewer.Register("FRAME",0.0);
+	Sampler.Register("FRAME",0.2);
+	MOOSPause(500);
+
+	//every frame the DB says the viewer should have, from the first
+	std::string sViewed,sSampled;
+	bool bViewedFull = true,bSampledFull = true;
+	for(char c = 'a';c<'a'+20;c++)
+	{
+		CMOOSMsg Frame = MakeFrame(c);
+		Camera.Post(Frame);
+		MOOSPause(50);
+		CollectFrames(Viewer,sViewed,bViewedFull);
+		CollectFrames(Sampler,sSampled,bSampledFull);
+	}
+	MOOSPause(300);
+	CollectFrames(Viewer,sViewed,bViewedFull);
+	CollectFrames(Sampler,sSampled,bSampledFull);
+
+	Report("all frames",sViewed=="abcdefghijklmnopqrst" && bViewedFull,bOK);
+	Report("intervals",sSampled.size()>=3 && sSampled.size()<=7 && bSampledFull,bOK);
+	Report("peer to peer",DBHoldsStub(Inspector),bOK);
+
+	//someone who can't follow stubs still gets the data
+	bool bLegacy = Connect(Legacy,"legacy");
+	Legacy.Register("FRAME",0.0);
+	MOOSPause(500);
+
+	std::string sLegacy;
+	bool bLegacyFull = true;
+	sViewed.clear();
+	for(char c = 'A';c<'A'+5;c++)
+	{
+		CMOOSMsg Frame = MakeFrame(c);
+		Camera.Post(Frame);
+		MOOSPause(50);
+		CollectFrames(Viewer,sViewed,bViewedFull);
+	}
+	MOOSPause(500);
+	CollectFrames(Viewer,sViewed,bViewedFull);
+	CollectFrames(Legacy,sLegacy,bLegacyFull);
+
+	//(the legacy client is first sent the latest frame it missed)
+	Report("legacy reader",bLegacy && sLegacy.find("ABCDE")!=std::string::npos && bLegacyFull,bOK);
+	Report("others too",sViewed.find("ABCDE")!=std::string::npos && bViewedFull,bOK);
+
+	Legacy.Close();
+	Inspector.Close();
+	Sampler.Close();
+	Viewer.Close();
+	Camera.Close();
+
+	return bOK;
+}
+
+int main()
+{
+	bool bOK = LinksOnly();
+	bOK &= ThroughDB(9361,1);
+	bOK &= ThroughDB(9362,4);
+
+	return Finish(bOK);
+}
@@ -0,0 +1,181 @@
+/*
+ * SerialPortTest.cpp
+ * reads telegrams from a pseudo terminal and checks how quickly they arrive
+ */
+
+#include "MOOS/libMOOS/Utils/MOOSLinuxSerialPort.h"
+#include "MOOS/libMOOS/Utils/TelegramFramer.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cmath>
+
+//a device at the far end of the pty which says something after a while
+struct Device
+{
+	int nFD;
+	int nDelayMS;
+	std::string sSay;
+	double dfSaidAt;
+};
+
+bool Speak(void * pParam)
+{
+	Device * pDevice = static_cast<Device*>(pParam);
+	MOOSPause(pDevice->nDelayMS);
+	pDevice->dfSaidAt = MOOSTime();
+	return write(pDevice->nFD,pDevice->sSay.data(),pDevice->sSay.size())==(int)pDevice->sSay.size();
+}
+
+void SpeakLater(CMOOSThread & Thread, Device & D, const std::string & sSay, int nDelayMS)
+{
+	D.sSay = sSay;
+	D.nDelayMS = nDelayMS;
+	Thread.Initialise(Speak,&D);
+	Thread.Start();
+}
+
+bool TestFramer()
+{
+	bool bOK = true;
+	std::string sT;
+	double dfT;
+
+	//telegrams split across reads come out whole and stamped with
+	//the arrival of their first character
+	{
+		MOOS::TelegramFramer F('\r',16);
+		F.Push("$A,1",4,1.0);
+		bool bPassed = !F.Pop(sT,dfT);
+		F.Push("\r$B,",4,2.0);
+		F.Push("22\r$C",5,3.0);
+		bPassed &= F.GetNumTelegrams()==2;
+		bPassed &= F.Pop(sT,dfT) && sT=="$A,1\r" && dfT==1.0;
+		bPassed &= F.Pop(sT,dfT) && sT=="$B,22\r" && dfT==2.0;
+		bPassed &= !F.Pop(sT,dfT) && F.GetNumBuffered()==2;
+
+		//round and round the ring
+		for(int i = 0;i<20 && bPassed;i++)
+		{
+			F.Push("xyz\r$C",6,4.0+i);
+			bPassed &= F.Pop(sT,dfT) && sT=="$Cxyz\r" && dfT==(i==0 ? 3.0 : 3.0+i);
+		}
+		Report("framer",bPassed && F.GetNumDiscarded()==0,bOK);
+	}
+
+	//a full ring loses the oldest telegram, then junk
+	{
+		MOOS::TelegramFramer F('\n',8);
+		bool bPassed = F.Push("abc\n",4,1.0) && F.Push("defg\n",5,2.0)==false;
+		bPassed &= F.Pop(sT,dfT) && sT=="defg\n" && F.GetNumDiscarded()==4;
+		bPassed &= !F.Push("0123456789",10,3.0) && !F.Pop(sT,dfT);
+		F.Clear();
+		bPassed &= F.Push("ok\n",3,4.0) && F.Pop(sT,dfT) && sT=="ok\n";
+		Report("framer overflow",bPassed,bOK);
+	}
+
+	return bOK;
+}
+
+int main()
+{
+	bool bOK = TestFramer();
+
+	int nMaster = posix_openpt(O_RDWR | O_NOCTTY);
+	if(nMaster<0 || grantpt(nMaster)!=0 || unlockpt(nMaster)!=0)
+	{
+		std::cout<<"no pseudo terminals here\n";
+		return bOK ? 0 : 1;
+	}
+	std::string sSlave = ptsname(nMaster);
+
+	Device D;
+	D.nFD = nMaster;
+
+	//reads wake as soon as characters arrive rather than up to 10ms later
+	//and are stamped with when they arrived
+	{
+		CMOOSLinuxSerialPort Port;
+		bool bPassed = Port.Create(sSlave.c_str(),115200);
+		double dfWorstLatency = 0.0;
+		double dfWorstStamp = 0.0;
+		for(int i = 0;i<10 && bPassed;i++)
+		{
+			CMOOSThread Thread;
+			SpeakLater(Thread,D,"hello",20+i);
+			char Buffer[5];
+			double dfStamp = 0.0;
+			bPassed &= Port.ReadNWithTimeOut(Buffer,sizeof(Buffer),1.0,&dfStamp)==5;
+			double dfDone = MOOSTime();
+			Thread.Stop();
+			dfWorstLatency = std::max(dfWorstLatency,dfDone-D.dfSaidAt);
+			dfWorstStamp = std::max(dfWorstStamp,fabs(dfStamp-D.dfSaidAt));
+		}
+		std::cout<<std::setw(20)<<"worst latency"<<"  "<<dfWorstLatency*1e3<<" ms\n";
+		std::cout<<std::setw(20)<<"worst stamp error"<<"  "<<dfWorstStamp*1e3<<" ms\n";
+		Report("read",bPassed && dfWorstLatency<0.005 && dfWorstStamp<0.005,bOK);
+
+		//time outs still time out
+		char Byte;
+		double dfStart = MOOSLocalTime();
+		bPassed = Port.ReadNWithTimeOut(&Byte,1,0.1)==0;
+		double dfTaken = MOOSLocalTime()-dfStart;
+		Report("read time out",bPassed && dfTaken>=0.099 && dfTaken<0.15,bOK);
+
+		//telegrams from a request/response device
+		CMOOSThread Thread;
+		SpeakLater(Thread,D,"$DVL,1.0,2.0\r\n",30);
+		std::string sTelegram;
+		double dfStamp = 0.0;
+		bPassed = Port.GetTelegram(sTelegram,1.0,&dfStamp);
+		double dfDone = MOOSTime();
+		Thread.Stop();
+		bPassed &= sTelegram=="$DVL,1.0,2.0" && dfDone-D.dfSaidAt<0.005 &&
+				fabs(dfStamp-D.dfSaidAt)<0.005;
+		Report("get telegram",bPassed,bOK);
+
+		//the line feed is still to be read
+		bPassed = Port.ReadNWithTimeOut(&Byte,1,0.1)==1 && Byte=='\n';
+		bPassed &= !Port.GetTelegram(sTelegram,0.05);
+		Report("telegram time out",bPassed,bOK);
+
+		Port.Close();
+	}
+
+	//streaming devices
+	{
+		CMOOSLinuxSerialPort Port;
+		STRING_LIST Params;
+		Params.push_back("PORT="+sSlave);
+		Params.push_back("BAUDRATE=115200");
+		Params.push_back("STREAMING=TRUE");
+		bool bPassed = Port.Configure(Params);
+
+		CMOOSThread Thread;
+		SpeakLater(Thread,D,"$INS,1\r$INS,2\r$INS,",20);
+		Thread.Stop();
+		double dfFirst = D.dfSaidAt;
+		SpeakLater(Thread,D,"3\r",20);
+		Thread.Stop();
+		MOOSPause(20);
+
+		std::string sTelegram;
+		double dfStamp;
+		bPassed &= Port.GetEarliest(sTelegram,dfStamp) && sTelegram=="$INS,1" &&
+				fabs(dfStamp-dfFirst)<0.005;
+		bPassed &= Port.GetEarliest(sTelegram,dfStamp) && sTelegram=="$INS,2";
+		bPassed &= Port.GetEarliest(sTelegram,dfStamp) && sTelegram=="$INS,3" &&
+				fabs(dfStamp-dfFirst)<0.005;
+		bPassed &= !Port.GetEarliest(sTelegram,dfStamp);
+		Report("streaming",bPassed,bOK);
+
+		Port.Close();
+	}
+
+	close(nMaster);
+
+	return Finish(bOK);
+}
@@ -0,0 +1,138 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * ServerRequestTest.cpp
+ * server requests made at the same time from several threads sharing a
+ * client each get their own reply, promptly
+ */
+
+#include "MOOS/libMOOS/DB/MOOSDB.h"
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+
+const int kPort = 9391;
+const int kNumVars = 10;
+const int kNumThreads = 4;
+const int kNumRequests = 20;
+
+//what one thread asks and how many of the answers were its own
+struct Asker
+{
+	CMOOSCommClient * pClient;
+	int nRightReplies;
+	CMOOSThread Thread;
+};
+
+//a reply to "ALL" holds the variables, a reply to "VAR_SUMMARY" only that
+bool IsReplyTo(const std::string & sWhat, MOOSMSG_LIST & Reply)
+{
+	if(Reply.empty())
+		return false;
+
+	for(MOOSMSG_LIST::iterator q = Reply.begin();q!=Reply.end();++q)
+	{
+		if(q->IsName("VAR_SUMMARY")!=(sWhat=="VAR_SUMMARY"))
+			return false;
+	}
+	return sWhat=="VAR_SUMMARY" || Reply.size()>=(unsigned int)kNumVars;
+}
+
+bool Ask(void * pParam)
+{
+	Asker * pAsker = static_cast<Asker*>(pParam);
+	for(int i = 0;i<kNumRequests;i++)
+	{
+		std::string sWhat = i%2 ? "ALL" : "VAR_SUMMARY";
+		MOOSMSG_LIST Reply;
+		if(pAsker->pClient->ServerRequest(sWhat,Reply,2.0,false) && IsReplyTo(sWhat,Reply))
+			pAsker->nRightReplies++;
+	}
+	return true;
+}
+
+void Check(CMOOSCommClient & Client, const std::string & sName, bool & bOK)
+{
+	Client.SetQuiet(true);
+	Client.Run("localhost",kPort,sName);
+	for(int i = 0;i<300 && !Client.IsConnected();i++)
+		MOOSPause(10);
+	if(!Report(sName+" connect",Client.IsConnected(),bOK))
+		return;
+
+	for(int i = 0;i<kNumVars;i++)
+		Client.Notify(MOOSFormat("%s_%d",sName.c_str(),i),(double)i);
+	MOOSPause(500);
+
+	//the reply is handed over as it arrives rather than polled for
+	double dfStart = MOOSLocalTime();
+	MOOSMSG_LIST Reply;
+	bool bReplied = Client.ServerRequest("ALL",Reply,2.0,false) && IsReplyTo("ALL",Reply);
+	Report(sName+" single request",bReplied && MOOSLocalTime()-dfStart<0.1,bOK);
+
+	Asker Askers[kNumThreads];
+	for(int i = 0;i<kNumThreads;i++)
+	{
+		Askers[i].pClient = &Client;
+		Askers[i].nRightReplies = 0;
+		Askers[i].Thread.Initialise(Ask,&Askers[i]);
+		Askers[i].Thread.Start();
+	}
+
+	bool bAllRight = true;
+	for(int i = 0;i<kNumThreads;i++)
+	{
+		Askers[i].Thread.Stop();
+		bAllRight &= Askers[i].nRightReplies==kNumRequests;
+	}
+	Report(sName+" concurrent requests",bAllRight,bOK);
+
+	//and none of the replies strayed into the inbox
+	MOOSMSG_LIST Mail;
+	Client.Fetch(Mail);
+	Report(sName+" nothing left over",Mail.empty(),bOK);
+
+	Client.Close();
+}
+
+int main()
+{
+	bool bOK = true;
+
+	CMOOSDB DB;
+	DB.SetQuiet(true);
+	const char * Args[] = {"server_request_test","--moos_port=9391",
+			"--moos_suicide_disable","--moos_no_colour"};
+	DB.Run(4,const_cast<char**>(Args));
+
+	MOOS::MOOSAsyncCommClient Async;
+	Check(Async,"async",bOK);
+
+	CMOOSCommClient Sync;
+	Check(Sync,"sync",bOK);
+
+	return Finish(bOK);
+}
@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * ShardOrderTest.cpp
+ * with the variables spread over shard workers a client still sees its
+ * own writes, and every variable's changes arrive in the order made
+ */
+
+#include "MOOS/libMOOS/DB/MOOSDB.h"
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <map>
+#include <vector>
+
+const int kPort = 9351;
+const int kNumVars = 16;
+const int kNumWrites = 400;
+
+bool Connect(MOOS::MOOSAsyncCommClient & Client, const std::string & sName)
+{
+	Client.SetQuiet(true);
+	Client.Run("localhost",kPort,sName);
+	for(int i = 0;i<300 && !Client.IsConnected();i++)
+		MOOSPause(10);
+	return Client.IsConnected();
+}
+
+int main()
+{
+	bool bOK = true;
+
+	CMOOSDB DB;
+	DB.SetQuiet(true);
+	const char * Args[] = {"shard_order_test","--moos_port=9351","--dispatch_threads=4",
+			"--moos_suicide_disable","--moos_no_colour"};
+	DB.Run(5,const_cast<char**>(Args));
+
+	MOOS::MOOSAsyncCommClient Poster,Listener;
+	bool bConnected = Connect(Poster,"poster") && Connect(Listener,"listener");
+	if(!Report("connect",bConnected,bOK))
+		return Finish(false);
+
+	for(int j = 0;j<kNumVars;j++)
+		Listener.Register(MOOSFormat("V%d",j),0.0);
+	MOOSPause(500);
+
+	//every write is followed at once by a question answered in line
+	//(not by a shard) which must see it
+	bool bSeen = true;
+	for(int k = 0;k<kNumWrites;k++)
+	{
+		Poster.Notify(MOOSFormat("V%d",k%kNumVars),(double)k);
+		if(k%(kNumWrites/10)!=kNumWrites/10-1)
+			continue;
+
+		MOOSMSG_LIST Reply;
+		CMOOSMsg Msg;
+		bSeen &= Poster.ServerRequest("ALL",Reply,2.0,false) &&
+				CMOOSCommClient::PeekMail(Reply,MOOSFormat("V%d",k%kNumVars),Msg) &&
+				Msg.GetDouble()==k;
+	}
+	Report("own writes seen",bSeen,bOK);
+
+	//the listener's mail comes from every shard but each variable's
+	//changes come in the order they were written
+	std::map<std::string,std::vector<double> > Values;
+	int nReceived = 0;
+	for(int i = 0;i<200 && nReceived<kNumWrites;i++)
+	{
+		MOOSMSG_LIST Mail;
+		Listener.Fetch(Mail);
+		for(MOOSMSG_LIST::iterator q = Mail.begin();q!=Mail.end();++q)
+		{
+			if(q->IsDouble())
+			{
+				Values[q->GetKey()].push_back(q->GetDouble());
+				nReceived++;
+			}
+		}
+		MOOSPause(20);
+	}
+
+	bool bInOrder = nReceived==kNumWrites && (int)Values.size()==kNumVars;
+	std::map<std::string,std::vector<double> >::iterator q;
+	for(q = Values.begin();q!=Values.end();++q)
+	{
+		for(unsigned int i = 1;i<q->second.size();i++)
+			bInOrder &= q->second[i]>q->second[i-1];
+	}
+	Report("all mail in order",bInOrder,bOK);
+
+	Poster.Close();
+	Listener.Close();
+
+	return Finish(bOK);
+}
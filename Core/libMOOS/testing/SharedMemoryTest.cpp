@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * SharedMemoryTest.cpp
+ * streams bytes from a client to a DB through a SharedMemoryChannel
+ */
+
+#include "MOOS/libMOOS/Comms/SharedMemoryChannel.h"
+#include "MOOS/libMOOS/Utils/MOOSThread.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+//a ring much smaller than what goes through it so it wraps and fills
+const unsigned int kRingSize = 4096;
+const int kBytes = 20*1000*1000;
+
+//the byte at position i of the stream
+unsigned char Expected(int i)
+{
+	return (unsigned char)((i*31+i/7)&0xFF);
+}
+
+bool Produce(void * pParam)
+{
+	MOOS::SharedMemoryChannel * pChannel = static_cast<MOOS::SharedMemoryChannel*>(pParam);
+
+	std::vector<unsigned char> Chunk(3000);
+	int nSent = 0;
+	while(nSent<kBytes)
+	{
+		int nChunk = std::min((int)Chunk.size(),kBytes-nSent);
+		for(int i = 0;i<nChunk;i++)
+			Chunk[i] = Expected(nSent+i);
+
+		int nDone = 0;
+		while(nDone<nChunk)
+		{
+			int n = pChannel->Write(&Chunk[nDone],nChunk-nDone,5.0);
+			if(n<=0)
+				return false;
+			nDone+=n;
+		}
+		nSent+=nChunk;
+	}
+	return true;
+}
+
+int main()
+{
+	MOOS::SharedMemoryChannel * pClient = MOOS::SharedMemoryChannel::Create(kRingSize);
+	if(pClient==NULL)
+	{
+		std::cout<<"shared memory is not supported here\n";
+		return 0;
+	}
+
+	bool bOK = true;
+
+	//the wrong key must not get in
+	MOOS::SharedMemoryChannel * pImposter = MOOS::SharedMemoryChannel::Attach(pClient->GetName(),
+			std::string(pClient->GetKey().size(),'0'));
+	bOK &= pImposter==NULL;
+	delete pImposter;
+
+	MOOS::SharedMemoryChannel * pDB = MOOS::SharedMemoryChannel::Attach(pClient->GetName(),pClient->GetKey());
+	pClient->Unlink();
+	if(pDB==NULL)
+	{
+		std::cout<<"failed to attach\n";
+		return 1;
+	}
+
+	//nothing to read yet
+	unsigned char Byte;
+	bOK &= pDB->Read(&Byte,1,0.01)==0;
+
+	CMOOSThread Producer;
+	Producer.Initialise(Produce,pClient);
+
+	double dfStart = MOOSLocalTime();
+	Producer.Start();
+
+	//everything must arrive, in order, through a ring a fraction of the size
+	std::vector<unsigned char> Buffer(5000);
+	int nReceived = 0;
+	while(bOK && nReceived<kBytes)
+	{
+		int n = pDB->Read(&Buffer[0],Buffer.size(),5.0);
+		if(n<=0)
+		{
+			std::cout<<"read failed after "<<nReceived<<" bytes\n";
+			bOK = false;
+			break;
+		}
+		for(int i = 0;i<n && bOK;i++)
+			bOK = Buffer[i]==Expected(nReceived+i);
+		nReceived+=n;
+	}
+	double dfTaken = MOOSLocalTime()-dfStart;
+
+	Producer.Stop();
+
+	//and the other way
+	const unsigned char Reply[] = "welcome";
+	bOK &= pDB->Write(Reply,sizeof(Reply))==(int)sizeof(Reply);
+	bOK &= pClient->Read(&Buffer[0],Buffer.size(),1.0)==(int)sizeof(Reply);
+
+	//once one side closes the other finds out
+	pClient->Close();
+	bOK &= pDB->IsClosed() && pDB->Read(&Byte,1,1.0)==-1 && pDB->Write(&Byte,1,1.0)==-1;
+
+	delete pDB;
+	delete pClient;
+
+	std::cout<<nReceived<<" bytes in "<<dfTaken<<"s\n";
+
+	return Finish(bOK);
+}
@@ -0,0 +1,28 @@
+/*
+ * TestReport.h
+ * how the library tests print the outcome of each check and of a run
+ */
+
+#ifndef MOOS_TESTING_TESTREPORT_H
+#define MOOS_TESTING_TESTREPORT_H
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+/** prints sName followed by [ok] or [FAIL] and folds bPassed into bOK*/
+inline bool Report(const std::string & sName, bool bPassed, bool & bOK)
+{
+	std::cout<<std::setw(20)<<sName<<(bPassed ? "  [ok]" : "  [FAIL]")<<"\n";
+	bOK &= bPassed;
+	return bPassed;
+}
+
+/** prints the outcome of the whole run and returns what main() should*/
+inline int Finish(bool bOK)
+{
+	std::cout<<(bOK ? "all passed\n" : "FAILED\n");
+	return bOK ? 0 : 1;
+}
+
+#endif
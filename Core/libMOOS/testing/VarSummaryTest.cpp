@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * VarSummaryTest.cpp
+ * DB_VARSUMMARY is brought up to date one dirty row at a time
+ */
+
+#include "MOOS/libMOOS/DB/MOOSDB.h"
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <sstream>
+#include <map>
+
+const int kPort = 9341;
+
+MOOS::MOOSAsyncCommClient gClient;
+std::string gsSummary;
+
+//the rows of a summary by variable name (and whether any name repeats)
+std::map<std::string,std::string> Rows(const std::string & sSummary, bool & bUnique)
+{
+	std::map<std::string,std::string> Rows;
+	std::istringstream ss(sSummary);
+	std::string sRow;
+	bUnique = true;
+	while(std::getline(ss,sRow))
+	{
+		std::string sName = sRow.substr(0,sRow.find(' '));
+		bUnique &= Rows.find(sName)==Rows.end();
+		Rows[sName] = sRow;
+	}
+	return Rows;
+}
+
+//wait for the next DB_VARSUMMARY_DELTA which pfnWanted likes
+std::string WaitForDelta(bool (*pfnWanted)(const std::string &))
+{
+	for(int i = 0;i<100;i++)
+	{
+		MOOSMSG_LIST Mail;
+		gClient.Fetch(Mail);
+		std::string sDelta;
+		for(MOOSMSG_LIST::iterator q = Mail.begin();q!=Mail.end();++q)
+		{
+			if(q->GetKey()=="DB_VARSUMMARY")
+				gsSummary = q->GetString();
+			else if(q->GetKey()=="DB_VARSUMMARY_DELTA" && pfnWanted(q->GetString()))
+				sDelta = q->GetString();
+		}
+		if(!sDelta.empty())
+			return sDelta;
+		MOOSPause(100);
+	}
+	return "";
+}
+
+bool HasAandB(const std::string & sDelta)
+{
+	bool bUnique;
+	std::map<std::string,std::string> R = Rows(sDelta,bUnique);
+	return R.count("A") && R.count("B");
+}
+
+bool HasLongB(const std::string & sDelta)
+{
+	return sDelta.find("a much longer value")!=std::string::npos;
+}
+
+bool Anything(const std::string &)
+{
+	return true;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	CMOOSDB DB;
+	DB.SetQuiet(true);
+	const char * Args[] = {"var_summary_test","--moos_port=9341","--var_summary_deltas",
+			"--moos_suicide_disable","--moos_no_colour"};
+	DB.Run(5,const_cast<char**>(Args));
+
+	gClient.SetQuiet(true);
+	gClient.Run("localhost",kPort,"summary_test");
+	for(int i = 0;i<300 && !gClient.IsConnected();i++)
+		MOOSPause(10);
+	if(!Report("connect",gClient.IsConnected(),bOK))
+		return Finish(false);
+
+	gClient.Register("DB_VARSUMMARY",0.0);
+	gClient.Register("DB_VARSUMMARY_DELTA",0.0);
+
+	//B's row comes first so when it grows A's has to move
+	gClient.Notify("B","short");
+	gClient.Notify("A",1.0);
+	Report("new rows",!WaitForDelta(HasAandB).empty(),bOK);
+
+	gClient.Notify("B","a much longer value");
+	std::string sDelta = WaitForDelta(HasLongB);
+	bool bUnique;
+	std::map<std::string,std::string> R = Rows(sDelta,bUnique);
+	Report("only B dirty",R.count("B") && !R.count("A"),bOK);
+
+	R = Rows(gsSummary,bUnique);
+	Report("summary unique",bUnique,bOK);
+	Report("summary B",R.count("B") && HasLongB(R["B"]),bOK);
+	Report("summary A",R.count("A") && R["A"].find(" 1")!=std::string::npos,bOK);
+	Report("summary DB vars",R.count("DB_TIME") && R.count("DB_VARSUMMARY"),bOK);
+
+	//nothing written so neither row is made again
+	sDelta = WaitForDelta(Anything);
+	R = Rows(sDelta,bUnique);
+	Report("quiet rows",!sDelta.empty() && !R.count("A") && !R.count("B"),bOK);
+
+	gClient.Close();
+
+	return Finish(bOK);
+}
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * WebJSONTest.cpp
+ * the DB's web server hands out its variables as JSON at /json, just the
+ * changes at /json?since=N, and says when nothing has changed
+ */
+
+#include "MOOS/libMOOS/DB/MOOSDB.h"
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/Comms/XPCTcpSocket.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <cstdlib>
+
+const int kPort = 9401;
+const long kWebPort = 9402;
+
+//one keep alive connection to the web server
+class WebClient
+{
+public:
+	WebClient() : m_pSocket(NULL) {}
+	~WebClient() {delete m_pSocket;}
+
+	//the server starts up after the DB so give it a moment
+	bool Connect()
+	{
+		for(int i = 0;i<50;i++)
+		{
+			m_pSocket = new XPCTcpSocket(kWebPort);
+			try
+			{
+				m_pSocket->vConnect("localhost");
+				return true;
+			}
+			catch(XPCException & e)
+			{
+				MOOS::DeliberatelyNotUsed(e);
+				delete m_pSocket;
+				m_pSocket = NULL;
+				MOOSPause(100);
+			}
+		}
+		return false;
+	}
+
+	//ask for sPath and read the reply: the status and header lines into
+	//sHeader and the Content-Length bytes which follow into sBody
+	bool Get(const std::string & sPath, const std::string & sExtraHeaders,
+			std::string & sHeader, std::string & sBody)
+	{
+		std::string sRequest = "GET "+sPath+" HTTP/1.1\r\nHost: localhost\r\n"+sExtraHeaders+"\r\n";
+		if(m_pSocket->iSendMessage(sRequest.data(),sRequest.size())!=(int)sRequest.size())
+			return false;
+
+		size_t nEnd;
+		while((nEnd = m_sInput.find("\r\n\r\n"))==std::string::npos)
+		{
+			if(!Read())
+				return false;
+		}
+		sHeader = m_sInput.substr(0,nEnd);
+		m_sInput.erase(0,nEnd+4);
+
+		size_t nLength = atoi(HeaderValue(sHeader,"Content-Length").c_str());
+		while(m_sInput.size()<nLength)
+		{
+			if(!Read())
+				return false;
+		}
+		sBody = m_sInput.substr(0,nLength);
+		m_sInput.erase(0,nLength);
+
+		return true;
+	}
+
+	static std::string HeaderValue(const std::string & sHeader, const std::string & sName)
+	{
+		std::string sLines = sHeader;
+		while(!sLines.empty())
+		{
+			std::string sLine = MOOSChomp(sLines,"\r\n");
+			std::string sToken = MOOSChomp(sLine,":");
+			if(MOOSStrCmp(sToken,sName))
+			{
+				MOOSTrimWhiteSpace(sLine);
+				return sLine;
+			}
+		}
+		return "";
+	}
+
+private:
+	bool Read()
+	{
+		char Buffer[4096];
+		int nRead = m_pSocket->iReadMessageWithTimeOut(Buffer,sizeof(Buffer),2.0);
+		if(nRead<=0)
+			return false;
+		m_sInput.append(Buffer,nRead);
+		return true;
+	}
+
+	XPCTcpSocket * m_pSocket;
+	std::string m_sInput;
+};
+
+bool Contains(const std::string & s, const std::string & sWhat)
+{
+	return s.find(sWhat)!=std::string::npos;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	CMOOSDB DB;
+	DB.SetQuiet(true);
+	const char * Args[] = {"web_json_test","--moos_port=9401","--webserver_port=9402",
+			"--moos_suicide_disable","--moos_no_colour"};
+	DB.Run(5,const_cast<char**>(Args));
+
+	MOOS::MOOSAsyncCommClient Client;
+	Client.SetQuiet(true);
+	Client.Run("localhost",kPort,"web_json_test_client");
+	for(int i = 0;i<300 && !Client.IsConnected();i++)
+		MOOSPause(10);
+	if(!Report("connect",Client.IsConnected(),bOK))
+		return Finish(false);
+
+	Client.Notify("WEB_X",1.5);
+	Client.Notify("WEB_S","say \"hi\"\n");
+	MOOSPause(500);
+
+	WebClient Web;
+	if(!Report("web server",Web.Connect(),bOK))
+		return Finish(false);
+
+	std::string sHeader,sBody;
+	bool bGot = Web.Get("/json","",sHeader,sBody);
+	std::string sETag = WebClient::HeaderValue(sHeader,"ETag");
+	Report("snapshot served",bGot && Contains(sHeader,"200 OK") &&
+			WebClient::HeaderValue(sHeader,"Content-Type")=="application/json" &&
+			!sETag.empty(),bOK);
+	Report("snapshot holds the variables",
+			Contains(sBody,"{\"name\":\"WEB_X\",\"type\":\"double\",\"value\":1.5,") &&
+			Contains(sBody,"{\"name\":\"WEB_S\",\"type\":\"string\",\"value\":\"say \\\"hi\\\"\\n\","),bOK);
+
+	//asking again over the same connection, nothing has changed
+	bGot = Web.Get("/json","If-None-Match: "+sETag+"\r\n",sHeader,sBody);
+	Report("unchanged snapshot not resent",bGot && Contains(sHeader,"304 Not Modified") &&
+			sBody.empty(),bOK);
+
+	//only what changed after the snapshot comes with since=
+	Client.Notify("WEB_X",2.5);
+	MOOSPause(500);
+
+	std::string sSince = sETag.substr(1,sETag.size()-2);
+	bGot = Web.Get("/json?since="+sSince,"",sHeader,sBody);
+	Report("changes served",bGot && Contains(sHeader,"200 OK") &&
+			WebClient::HeaderValue(sHeader,"ETag")!=sETag,bOK);
+	Report("changes hold only what changed",
+			Contains(sBody,"{\"name\":\"WEB_X\",\"type\":\"double\",\"value\":2.5,") &&
+			!Contains(sBody,"WEB_S"),bOK);
+
+	//and the old tag no longer matches
+	bGot = Web.Get("/json","If-None-Match: "+sETag+"\r\n",sHeader,sBody);
+	Report("changed snapshot resent",bGot && Contains(sHeader,"200 OK") &&
+			Contains(sBody,"\"value\":2.5,"),bOK);
+
+	Client.Close();
+
+	return Finish(bOK);
+}
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * WildcardIndexTest.cpp
+ * checks the wildcard index finds what matching every filter finds
+ */
+
+#include "MOOS/libMOOS/DB/WildcardIndex.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//short strings from a small alphabet so that plenty of them match
+std::string RandomString(const char * sAlphabet,int nMaxLength)
+{
+	std::string s;
+	int n = rand()%(nMaxLength+1);
+	int nAlphabet = (int)strlen(sAlphabet);
+	for(int i = 0;i<n;i++)
+		s+=sAlphabet[rand()%nAlphabet];
+	return s;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	//a compiled glob must agree with MOOSWildCmp
+	int nMatched = 0;
+	for(int i = 0;i<200000 && bOK;i++)
+	{
+		std::string sPattern = RandomString("ab*?",6);
+		std::string sString = RandomString("ab",6);
+		bool bExpected = MOOSWildCmp(sPattern,sString);
+		if(MOOS::CompiledGlob(sPattern).Matches(sString)!=bExpected)
+		{
+			std::cout<<"\""<<sPattern<<"\" vs \""<<sString<<"\" should be "<<bExpected<<"\n";
+			bOK = false;
+		}
+		nMatched+=bExpected;
+	}
+	Report(MOOSFormat("globs agree (%d matches)",nMatched),bOK,bOK);
+
+	//and the index must find exactly what checking every filter finds
+	MOOS::WildcardIndex Index;
+	std::vector<std::pair<std::string,MOOS::MsgFilter> > All;
+	for(int i = 0;i<500;i++)
+	{
+		std::string sClient = MOOSFormat("client_%d",i%20);
+		MOOS::MsgFilter F(RandomString("pq*",2),RandomString("XYZ_*?",5),0.0);
+		if(Index.Add(sClient,F))
+			All.push_back(std::make_pair(sClient,F));
+	}
+
+	//drop a couple of clients and some filters to exercise removal
+	Index.RemoveClient("client_3");
+	Index.RemoveClient("client_7");
+	std::vector<std::pair<std::string,MOOS::MsgFilter> > Left;
+	for(unsigned int i = 0;i<All.size();i++)
+	{
+		if(All[i].first=="client_3" || All[i].first=="client_7")
+			continue;
+		if(i%5==0)
+			Index.Remove(All[i].first,All[i].second);
+		else
+			Left.push_back(All[i]);
+	}
+
+	bool bIndexOK = Index.Size()==Left.size();
+	for(int i = 0;i<20000 && bIndexOK;i++)
+	{
+		std::string sVar = RandomString("XYZ_",6);
+		std::string sSrc = RandomString("pq",2);
+
+		std::vector<MOOS::WildcardIndex::Match> Found;
+		Index.Find(sVar,sSrc,Found);
+
+		unsigned int nExpected = 0;
+		for(unsigned int j = 0;j<Left.size();j++)
+		{
+			nExpected+=MOOSWildCmp(Left[j].second.var_filter(),sVar) &&
+					MOOSWildCmp(Left[j].second.app_filter(),sSrc);
+		}
+
+		if(Found.size()!=nExpected)
+		{
+			std::cout<<sVar<<":"<<sSrc<<" found "<<Found.size()<<" expected "<<nExpected<<"\n";
+			bIndexOK = false;
+		}
+	}
+	Report(MOOSFormat("index of %d filters agrees",(int)Index.Size()),bIndexOK,bOK);
+
+	return Finish(bOK);
+}
@@ -0,0 +1,225 @@
+/*
+ * WireFormatTest.cpp
+ * round trips packets through the compact wire format
+ */
+
+#include "MOOS/libMOOS/Comms/MOOSCommPkt.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+
+//both ends of one direction of a connection
+MOOS::WireDictionary TxDictionary;
+MOOS::WireDictionary RxDictionary;
+
+//send PktTx "over the wire" into PktRx
+void Transfer(CMOOSCommPkt & PktTx, CMOOSCommPkt & PktRx)
+{
+	PktTx.Flatten();
+	while(PktRx.GetBytesRequired()>0)
+	{
+		int n = PktRx.GetBytesRequired();
+		memcpy(PktRx.NextWrite(),PktTx.Stream()+PktRx.GetStreamLength(),n);
+		PktRx.OnBytesWritten(PktRx.NextWrite(),n);
+	}
+}
+
+bool Same(const CMOOSMsg & A, const CMOOSMsg & B)
+{
+	return A.GetKey()==B.GetKey() &&
+			A.GetType()==B.GetType() &&
+			A.IsDouble()==B.IsDouble() &&
+			A.IsBinary()==B.IsBinary() &&
+			A.GetString()==B.GetString() &&
+			A.GetDouble()==B.GetDouble() &&
+			A.GetDoubleAux()==B.GetDoubleAux() &&
+			A.GetTime()==B.GetTime() &&
+			A.GetSource()==B.GetSource() &&
+			A.GetSourceAux()==B.GetSourceAux() &&
+			A.GetCommunity()==B.GetCommunity() &&
+			A.m_nID==B.m_nID;
+}
+
+//write Out and Shared compactly, send them over the wire and read them
+//back both as messages and as views
+bool RoundTrip(const std::string & sName, const MOOSMSG_LIST & Out,
+		const MOOSMSG_PTR_LIST & Shared = MOOSMSG_PTR_LIST(),
+		unsigned int nCompressionThreshold = 0)
+{
+	//how big it would be the old way
+	CMOOSCommPkt PktLegacy;
+	PktLegacy.Serialize(Out,Shared);
+	int nLegacy = PktLegacy.GetStreamLength();
+
+	CMOOSCommPkt PktTx;
+	PktTx.SetWireDictionary(&TxDictionary);
+	PktTx.Serialize(Out,Shared);
+	if(nCompressionThreshold>0)
+		PktTx.Compress(nCompressionThreshold);
+
+	CMOOSCommPkt PktRx;
+	Transfer(PktTx,PktRx);
+
+	bool bOK = PktRx.ReadCompact(RxDictionary);
+
+	MOOSMSG_LIST In;
+	MOOS::MsgViewVector Views;
+	bOK = bOK && PktRx.Deserialize(Views) && PktRx.Serialize(In,false);
+
+	MOOSMSG_LIST Expected = Out;
+	for(MOOSMSG_PTR_LIST::const_iterator r = Shared.begin();r!=Shared.end();++r)
+		Expected.push_back(**r);
+
+	bOK = bOK && In.size()==Expected.size() && Views.size()==Expected.size();
+	MOOSMSG_LIST::iterator p,q;
+	unsigned int i = 0;
+	for(p=In.begin(),q=Expected.begin();bOK && p!=In.end();++p,++q,++i)
+	{
+		CMOOSMsg FromView;
+		Views[i].ToMsg(FromView);
+		bOK = Same(*p,*q) && Same(FromView,*q);
+	}
+
+	//the reader should see how big it really was
+	bOK = bOK && PktRx.GetWireLength()==PktTx.GetStreamLength();
+
+	std::ostringstream ss;
+	ss<<std::setw(20)<<sName
+			<<std::setw(10)<<nLegacy
+			<<std::setw(10)<<PktRx.GetWireLength();
+
+	bool bAll = true;
+	return Report(ss.str(),bOK,bAll);
+}
+
+//a typical pNav-like notification
+CMOOSMsg NavMsg(const std::string & sKey, double dfVal, double dfTime)
+{
+	CMOOSMsg Msg(MOOS_NOTIFY,sKey,dfVal,dfTime);
+	Msg.SetSource("pNav");
+	Msg.m_sOriginatingCommunity = "AUV";
+	return Msg;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	//the first packet of navigation teaches the dictionaries the names
+	double dfTime = 1792224000.0;
+	MOOSMSG_LIST Nav;
+	const char * Keys[] = {"NAV_X","NAV_Y","NAV_DEPTH","NAV_HEADING","NAV_SPEED"};
+	for(int i = 0;i<5;i++)
+		Nav.push_back(NavMsg(Keys[i],i*10.5,dfTime));
+	bOK &= RoundTrip("nav (first)",Nav);
+
+	//after which names cost a byte or so
+	bOK &= RoundTrip("nav (again)",Nav);
+
+	//a single NAV_X should be well under half its old size
+	MOOSMSG_LIST X;
+	X.push_back(NavMsg("NAV_X",3.14159,dfTime+0.1));
+	{
+		CMOOSCommPkt Legacy,Pkt;
+		Legacy.Serialize(X,true);
+		Pkt.SetWireDictionary(&TxDictionary);
+		Pkt.Serialize(X,true);
+		CMOOSCommPkt PktRx;
+		Transfer(Pkt,PktRx);
+		PktRx.ReadCompact(RxDictionary);
+		std::ostringstream ss;
+		ss<<std::setw(20)<<"NAV_X"<<std::setw(10)<<Legacy.GetStreamLength()
+				<<std::setw(10)<<Pkt.GetWireLength();
+		Report(ss.str(),2*Pkt.GetWireLength()<Legacy.GetStreamLength(),bOK);
+	}
+
+	//every field set, odd ids and binary payloads survive
+	MOOSMSG_LIST Odd;
+	Odd.push_back(CMOOSMsg(MOOS_NOTIFY,"BINARY",std::string("a\0b\0c",5),dfTime));
+	Odd.back().MarkAsBinary();
+	Odd.back().SetSourceAux("file.cpp:42");
+	Odd.back().m_nID = 123456;
+	Odd.push_back(CMOOSMsg(MOOS_REGISTER,"NAV_X",0.25,dfTime));
+	Odd.back().m_nID = -77;
+	Odd.back().m_dfVal2 = 9.75;
+	Odd.push_back(CMOOSMsg(MOOS_NULL_MSG,"",0.0));
+	Odd.push_back(CMOOSMsg(MOOS_NOTIFY,std::string(1000,'k'),"too long to remember"));
+	bOK &= RoundTrip("odd",Odd);
+	bOK &= RoundTrip("odd (again)",Odd);
+
+	//big payloads are sent from where they lie, around compact headers
+	MOOSMSG_PTR_LIST Shared;
+	Shared.push_back(MOOSMSG_PTR(new CMOOSMsg(MOOS_NOTIFY,"IMAGE",std::string(100000,'i'))));
+	Shared.back()->SetSource("pCamera");
+	bOK &= RoundTrip("gathered",Nav,Shared);
+	{
+		CMOOSCommPkt Pkt;
+		Pkt.SetWireDictionary(&TxDictionary);
+		Pkt.Serialize(Nav,Shared);
+		Report("gathered isn't copied",Pkt.IsGathered(),bOK);
+		Pkt.Flatten();
+		CMOOSCommPkt PktRx;
+		Transfer(Pkt,PktRx);
+		PktRx.ReadCompact(RxDictionary);
+	}
+
+	//and compact packets can be compressed too
+	MOOSMSG_LIST Big;
+	Big.push_back(CMOOSMsg(MOOS_NOTIFY,"IMAGE",std::string(100000,'i')));
+	bOK &= RoundTrip("compressed",Big,MOOSMSG_PTR_LIST(),1024);
+
+	//old style packets pass straight through
+	{
+		MOOS::WireDictionary Unused;
+		CMOOSCommPkt Pkt;
+		Pkt.Serialize(Nav,true);
+		int nLength = Pkt.GetStreamLength();
+		CMOOSCommPkt PktRx;
+		Transfer(Pkt,PktRx);
+		MOOSMSG_LIST In;
+		bool bPassed = PktRx.ReadCompact(Unused) && PktRx.GetStreamLength()==nLength &&
+				PktRx.Serialize(In,false) && In.size()==Nav.size() && Unused.Size()==0;
+		Report("legacy",bPassed,bOK);
+	}
+
+	//a reader which has missed a packet can't make sense of tokens
+	{
+		MOOS::WireDictionary Fresh;
+		CMOOSCommPkt Pkt;
+		Pkt.SetWireDictionary(&TxDictionary);
+		Pkt.Serialize(Nav,true);
+		CMOOSCommPkt PktRx;
+		Transfer(Pkt,PktRx);
+		bool bRejected = !PktRx.ReadCompact(Fresh);
+		Report("out of step",bRejected,bOK);
+	}
+
+	//and one which hasn't been given a dictionary reads nothing
+	{
+		CMOOSCommPkt Pkt;
+		Pkt.SetWireDictionary(&TxDictionary);
+		Pkt.Serialize(Nav,true);
+		CMOOSCommPkt PktRx;
+		Transfer(Pkt,PktRx);
+		MOOS::MsgViewVector Views;
+		PktRx.Deserialize(Views);
+		Report("no dictionary",Views.empty(),bOK);
+	}
+
+	//lengths off the wire which can't be right are refused
+	int Lengths[] = {3,-1,MOOS_PKT_MAX_SIZE+1};
+	for(int i = 0;i<3;i++)
+	{
+		CMOOSCommPkt PktRx;
+		int nLength = IsLittleEndian() ? Lengths[i] : SwapByteOrder<int>(Lengths[i]);
+		memcpy(PktRx.NextWrite(),&nLength,sizeof(nLength));
+		std::ostringstream ss;
+		ss<<"length "<<Lengths[i]<<" refused";
+		Report(ss.str(),!PktRx.OnBytesWritten(PktRx.NextWrite(),sizeof(nLength)),bOK);
+	}
+
+	return Finish(bOK);
+}
@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////////////////
+//
+//   This file is part of the MOOS project
+//
+//   MOOS : Mission Oriented Operating Suite A suit of
+//   Applications and Libraries for Mobile Robotics Research
+//   Copyright (C) Paul Newman
+//
+//   This software was written by Paul Newman at MIT 2001-2002 and
+//   the University of Oxford 2003-2013
+//
+//   email: pnewman@robots.ox.ac.uk.
+//
+//   This source code and the accompanying materials
+//   are made available under the terms of the GNU Lesser Public License v2.1
+//   which accompanies this distribution, and is available at
+//   http://www.gnu.org/licenses/lgpl.txt
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+////////////////////////////////////////////////////////////////////////////
+/*
+ * WriteBatchTest.cpp
+ * an asynchronous client with write batching sends a slow trickle straight
+ * away and a burst as a few full packets
+ */
+
+#include "MOOS/libMOOS/Comms/MOOSAsyncCommClient.h"
+#include "MOOS/libMOOS/Comms/ThreadedCommServer.h"
+#include "MOOS/libMOOS/Utils/MOOSLock.h"
+#include "MOOS/libMOOS/Utils/MOOSScopedLock.h"
+#include "MOOS/libMOOS/Utils/MOOSUtilityFunctions.h"
+#include "TestReport.h"
+#include <iostream>
+
+const int kPort = 9331;
+const double kDelay = 0.02;
+
+CMOOSLock gLock;
+unsigned int gnPkts = 0; //packets which carried any of our mail
+unsigned int gnMsgs = 0;
+double gdfWorstLatency = 0.0;
+
+bool OnRx(const std::string & /*sClient*/, MOOSMSG_LIST & Rx, MOOSMSG_LIST & /*Tx*/, void *)
+{
+	MOOS::ScopedLock Lock(gLock);
+	unsigned int nOurs = 0;
+	for(MOOSMSG_LIST::iterator q = Rx.begin();q!=Rx.end();++q)
+	{
+		if(!q->IsType(MOOS_NOTIFY))
+			continue;
+		nOurs++;
+		gdfWorstLatency = std::max(gdfWorstLatency,MOOSLocalTime()-q->GetTime());
+	}
+	gnMsgs+=nOurs;
+	gnPkts+= nOurs>0 ? 1 : 0;
+	return true;
+}
+
+void Reset()
+{
+	MOOS::ScopedLock Lock(gLock);
+	gnPkts = gnMsgs = 0;
+	gdfWorstLatency = 0.0;
+}
+
+//wait a while for nMessages to have arrived
+bool WaitForMsgs(unsigned int nMessages)
+{
+	for(int i = 0;i<500;i++)
+	{
+		{
+			MOOS::ScopedLock Lock(gLock);
+			if(gnMsgs>=nMessages)
+				return true;
+		}
+		MOOSPause(10);
+	}
+	return false;
+}
+
+int main()
+{
+	bool bOK = true;
+
+	MOOS::ThreadedCommServer Server;
+	Server.SetQuiet(true);
+	Server.SetOnRxCallBack(OnRx,NULL);
+	if(!Server.Run(kPort,"write_batch_test",true))
+	{
+		std::cout<<"could not start server\n";
+		return 1;
+	}
+
+	MOOS::MOOSAsyncCommClient Client;
+	Client.SetQuiet(true);
+	Client.SetWriteBatching(kDelay,4096);
+	Client.Run("localhost",kPort,"batcher");
+	for(int i = 0;i<300 && !Client.IsConnected();i++)
+		MOOSPause(10);
+	if(!Report("connect",Client.IsConnected(),bOK))
+		return Finish(false);
+
+	//a message every 50ms never finds the writer busy so nothing waits
+	Reset();
+	uint64_t nWaits = Client.GetNumBatchWaits();
+	const unsigned int kTrickle = 20;
+	for(unsigned int i = 0;i<kTrickle;i++)
+	{
+		Client.Notify("TRICKLE",(double)i);
+		MOOSPause(50);
+	}
+	Report("trickle arrives",WaitForMsgs(kTrickle),bOK);
+	{
+		MOOS::ScopedLock Lock(gLock);
+		Report("trickle unbatched",gnPkts==kTrickle,bOK);
+		Report("trickle latency",gdfWorstLatency<kDelay,bOK);
+	}
+	Report("trickle no waits",Client.GetNumBatchWaits()-nWaits<=1,bOK);
+
+	//a sustained burst, 20 messages a millisecond, fills 4096 byte packets
+	//rather than sleeping out the delay
+	Reset();
+	nWaits = Client.GetNumBatchWaits();
+	uint64_t nFull = Client.GetNumFullBatches();
+	double dfWaitTime = Client.GetBatchWaitTime();
+	const unsigned int kBurst = 2000;
+	std::string sPayload(100,'x');
+	for(unsigned int i = 0;i<kBurst;i++)
+	{
+		Client.Notify("BURST",sPayload);
+		if(i%20==19)
+			MOOSPause(1);
+	}
+	Report("burst arrives",WaitForMsgs(kBurst),bOK);
+	{
+		MOOS::ScopedLock Lock(gLock);
+		Report("burst batched",gnPkts<kBurst/10,bOK);
+	}
+	uint64_t nBurstWaits = Client.GetNumBatchWaits()-nWaits;
+	Report("burst fills",Client.GetNumFullBatches()>nFull,bOK);
+	Report("burst waits bounded",
+			Client.GetBatchWaitTime()-dfWaitTime<=(nBurstWaits+1)*kDelay*2,bOK);
+
+	Client.Close();
+
+	return Finish(bOK);
+}
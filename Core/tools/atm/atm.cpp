@@ -28,7 +28,8 @@ const std::string kDefaultAuditDirectory = "moos_comms_audits";
 std::string multicast_address = "224.1.1.8";
 int multicast_port = 4000;
 std::string name_pattern;
-double kBandwidthFIRConstant = 0.01;
+//summaries arrive once a second so not much smoothing is needed
+double kBandwidthFIRConstant = 0.5;
 
 
 struct atm_stat{
@@ -37,6 +38,8 @@ struct atm_stat{
     std::string destination;
     std::string name;
     int64_t last_write_time;
+    //latencies heard since the statistics were last printed
+    MOOS::LatencyHistogram latency;
 };
 std::map<std::string, atm_stat> atm_stats;
 
@@ -56,7 +59,7 @@ std::string FormatBytes(int n) {
     } else if (n > (1 << 10)) {
         ss << (n >> 10) << " kB/s";
     } else {
-        ss << " B/s";
+        ss << n << " B/s";
     }
 
     return ss.str();
@@ -64,12 +67,13 @@ std::string FormatBytes(int n) {
 
 
 void PrintStatistics(){
-    std::cerr<<"bandwidth by channel\n";
+    std::cerr<<"bandwidth and latency (count p50 p90 p99 max in ms) by channel\n";
 
     std::list<atm_stat> stat_list;
     std::map<std::string ,atm_stat>::iterator p;
     for(p=atm_stats.begin();p!=atm_stats.end();++p){
         stat_list.push_back(p->second);
+        p->second.latency.Clear();
     }
 
     stat_list.sort(sort_on_bw);
@@ -79,6 +83,11 @@ void PrintStatistics(){
         std::stringstream ss;
 
         ss<<std::setw(8)<<FormatBytes(int(q->average_bandwidth))<<" ";
+        ss<<std::setw(8)<<q->latency.GetCount()<<" "<<std::setprecision(4);
+        ss<<std::setw(7)<<q->latency.GetPercentile(50)/1000.0<<" ";
+        ss<<std::setw(7)<<q->latency.GetPercentile(90)/1000.0<<" ";
+        ss<<std::setw(7)<<q->latency.GetPercentile(99)/1000.0<<" ";
+        ss<<std::setw(7)<<q->latency.GetMax()/1000.0<<" ";
         ss<<std::setw(15)<<"\""<<q->name<<"\""
          <<" from "<<q->source
          <<" to "<<q->destination<<"\n";
@@ -86,25 +95,28 @@ void PrintStatistics(){
     }
 }
 
-void AccummulateStatistic(MOOS::EndToEndAudit::MessageStatistic & ms){
-    std::string key= ms.message_name+":"+ms.source_client+":"+ms.destination_client;
+void AccummulateStatistic(const MOOS::EndToEndAudit::LatencySummary & summary,
+                          const MOOS::EndToEndAudit::LatencySummary::Channel & channel){
+    std::string key= channel.message_name+":"+channel.source_client+":"+summary.destination_client;
     std::map<std::string, atm_stat>::iterator q;
     q = atm_stats.find(key);
     if(q==atm_stats.end()){
         atm_stat new_statistic;
-        new_statistic.name = ms.message_name;
-        new_statistic.destination = ms.destination_client;
-        new_statistic.source = ms.source_client;
+        new_statistic.name = channel.message_name;
+        new_statistic.destination = summary.destination_client;
+        new_statistic.source = channel.source_client;
         new_statistic.average_bandwidth = 0.0;
-        new_statistic.last_write_time = ms.receive_time;
+        new_statistic.last_write_time = summary.time;
+        new_statistic.latency = channel.latency;
         atm_stats[key] = new_statistic;
     }else{
         atm_stat & stat=q->second;
-        int64_t dt = ms.receive_time-stat.last_write_time+1;
-        double point_estimate_bandwidth = (1e6*ms.message_size)/dt;
-        stat.last_write_time = ms.receive_time;
+        int64_t dt = summary.time-stat.last_write_time+1;
+        double point_estimate_bandwidth = (1e6*channel.bytes)/dt;
+        stat.last_write_time = summary.time;
         stat.average_bandwidth = (1.0-kBandwidthFIRConstant)*stat.average_bandwidth+
                 kBandwidthFIRConstant*point_estimate_bandwidth;
+        stat.latency.Merge(channel.latency);
     }
 
 
@@ -117,7 +129,7 @@ void PrintHelpAndExit()
     std::cerr<<"audit the MOOS (atm)\n";
     std::cerr<<"--channel=<address>     address to listen  for audit comms on \n";
     std::cerr<<"--port=<int>            port to listen on \n";
-    std::cerr<<"--ignore_delay_below_us ignore delays less than this in uS\n";
+    std::cerr<<"--ignore_delay_below_us ignore channels whose worst delay is less than this in uS\n";
     std::cerr<<"--log                   log statistics\n";
     std::cerr<<"--log_directory=<dir>   log directory";
     std::cerr<<"--log_name=<name>       log file name";
@@ -154,34 +166,50 @@ void OpenLogFile(std::ofstream & ofs,
 }
 
 
-void PrettyPrint(std::ostream & output_stream,const MOOS::EndToEndAudit::MessageStatistic & ms){
-    static double last = ms.source_time;
-    output_stream<<std::left<<std::setw(7)<<std::setprecision(12)<<ms.source_time-last<<" ";
+void PrettyPrint(std::ostream & output_stream,
+                 const MOOS::EndToEndAudit::LatencySummary & summary,
+                 const MOOS::EndToEndAudit::LatencySummary::Channel & channel){
+    output_stream<<std::left<<std::setw(7)<<channel.latency.GetCount()<<" ";
     output_stream<<std::left<<std::setw(7)<<std::setprecision(4);
-    output_stream<<(ms.receive_time-ms.source_time)/1000.0<<" ms delay ";
-    output_stream<<ms.source_client<<" |----  "<<ms.message_name<<"["<<ms.message_size<<"]  ----> "<<ms.destination_client<<std::endl;
-    last = ms.source_time;
+    output_stream<<channel.latency.GetPercentile(50)/1000.0<<" ms typical ";
+    output_stream<<std::left<<std::setw(7)<<std::setprecision(4);
+    output_stream<<channel.latency.GetMax()/1000.0<<" ms worst ";
+    output_stream<<channel.source_client<<" |----  "<<channel.message_name<<"["<<channel.bytes<<"]  ----> "<<summary.destination_client<<std::endl;
 }
 
-void LogToFile(std::ofstream & output_stream,const MOOS::EndToEndAudit::MessageStatistic & ms){
+void LogToFile(std::ofstream & output_stream,
+               const MOOS::EndToEndAudit::LatencySummary & summary,
+               const MOOS::EndToEndAudit::LatencySummary::Channel & channel){
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<channel.latency.GetCount()<<",";
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<channel.latency.GetPercentile(50)<<",";
 
     output_stream<<std::left<<std::setw(15);
-    output_stream<<ms.receive_time-ms.source_time<<",";
+    output_stream<<channel.latency.GetPercentile(99)<<",";
 
     output_stream<<std::left<<std::setw(15);
-    output_stream<<ms.message_name<<",";
+    output_stream<<channel.latency.GetMax()<<",";
 
     output_stream<<std::left<<std::setw(15);
-    output_stream<<ms.source_client<<",";
+    output_stream<<channel.bytes<<",";
 
     output_stream<<std::left<<std::setw(15);
-    output_stream<<ms.destination_client<<",";
+    output_stream<<channel.message_name<<",";
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<channel.source_client<<",";
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<summary.destination_client<<",";
 
     output_stream<<std::left<<std::setw(20);
-    output_stream<<ms.receive_time<<",";
+    output_stream<<summary.time<<",";
 
     output_stream<<std::left<<std::setw(15);
-    output_stream<<ms.cpu_load<<"\n";
+    output_stream<<summary.cpu_load<<"\n";
 
     static int lines_logged = 0;
     if(lines_logged++%kFlusheveryN==0){
@@ -195,7 +223,19 @@ void LogToFile(std::ofstream & output_stream,const MOOS::EndToEndAudit::MessageS
 
 void WriteHeader(std::ofstream & output_stream){
     output_stream<<std::left<<std::setw(15);
-    output_stream<<"%delay(uS)"<<",";
+    output_stream<<"%count"<<",";
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<"p50(uS)"<<",";
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<"p99(uS)"<<",";
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<"max(uS)"<<",";
+
+    output_stream<<std::left<<std::setw(15);
+    output_stream<<"bytes"<<",";
 
     output_stream<<std::left<<std::setw(15);
     output_stream<<"name"<<",";
@@ -214,12 +254,10 @@ void WriteHeader(std::ofstream & output_stream){
 }
 
 
-bool ShouldBeLogged(const MOOS::EndToEndAudit::MessageStatistic & message_statistic,
+bool ShouldBeLogged(const MOOS::EndToEndAudit::LatencySummary::Channel & channel,
                     int64_t ignore_delays_below){
 
-    int64_t delta = message_statistic.receive_time-message_statistic.source_time;
-
-    if(delta<ignore_delays_below)
+    if(int64_t(channel.latency.GetMax())<ignore_delays_below)
         return false;
 
     return true;
@@ -263,31 +301,32 @@ int main(int argc, char *argv[])
     int number_messages_rxed = 0;
     int number_messages_logged = 0;
     double last_display_time = MOOSTime();
-    double average_latency_us = 0;
-    double alpha = 0.01;
+    MOOS::LatencyHistogram overall_latency;
     while(1)
     {
 
         std::string sReply;
 
-        if(multicast_listener.Read(sReply,1000)){
-            MOOS::EndToEndAudit::MessageStatistic ms;
-            ms.FromString(sReply);
+        MOOS::EndToEndAudit::LatencySummary summary;
+        if(multicast_listener.Read(sReply,1000) && summary.Decode(sReply)){
+
+            std::vector<MOOS::EndToEndAudit::LatencySummary::Channel>::iterator q;
+            for(q = summary.channels.begin();q!=summary.channels.end();++q){
 
-            number_messages_rxed++;
-            int64_t latency = ms.receive_time-ms.source_time;
-            average_latency_us=alpha*latency+(1.0-alpha)*average_latency_us;
+                number_messages_rxed+=int(q->latency.GetCount());
+                overall_latency.Merge(q->latency);
 
-            if(ShouldBeLogged(ms,ignore_delay_below_us)){
-                if(logging){
-                    LogToFile(output_stream,ms);
-                    number_messages_logged++;
-                }else{
-                    PrettyPrint(std::cerr,ms);
+                if(ShouldBeLogged(*q,ignore_delay_below_us)){
+                    if(logging){
+                        LogToFile(output_stream,summary,*q);
+                        number_messages_logged++;
+                    }else{
+                        PrettyPrint(std::cerr,summary,*q);
+                    }
                 }
-            }
 
-            AccummulateStatistic(ms);
+                AccummulateStatistic(summary,*q);
+            }
         }
 
         if(MOOSTime()-last_display_time>3.0){
@@ -296,7 +335,8 @@ int main(int argc, char *argv[])
                                   "Mean delay %.2fuS\n",
                                   number_messages_rxed,
                                   number_messages_logged,
-                                  average_latency_us);
+                                  overall_latency.GetMean());
+            overall_latency.Clear();
 
             PrintStatistics();
         }
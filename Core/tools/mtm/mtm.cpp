@@ -26,10 +26,16 @@ class MonitorTheMOOS :  public CMOOSApp
 {
     bool OnConnectToServer()
     {
+        if(deltas_ && !Register("DB_VARSUMMARY_DELTA",0.0))
+            return false;
         return Register("DB_VARSUMMARY",0.0);
     }
     bool OnSummary(CMOOSMsg & M)
     {
+        //with deltas we only need the full summary once to get going
+        if(deltas_ && M.GetKey()=="DB_VARSUMMARY")
+            UnRegister("DB_VARSUMMARY");
+
         std::string sAll = M.GetString();
         while(!sAll.empty())
         {
@@ -65,20 +71,25 @@ class MonitorTheMOOS :  public CMOOSApp
     void OnPrintHelpAndExit()
     {
         std::cout<<"  --live_only                 : only display updating variables\n";
+        std::cout<<"  --deltas                    : only receive changed rows (needs MOOSDB --var_summary_deltas)\n";
     }
 
     bool OnStartUp()
     {
         live_only_=m_CommandLineParser.GetFlag("--live_only");
+        deltas_=m_CommandLineParser.GetFlag("--deltas");
         SetIterateMode(REGULAR_ITERATE_AND_COMMS_DRIVEN_MAIL);
 
         AddActiveQueue("summary",this,&MonitorTheMOOS::OnSummary);
+        if(deltas_ && !AddMessageRouteToActiveQueue("summary","DB_VARSUMMARY_DELTA"))
+            return false;
         return AddMessageRouteToActiveQueue("summary","DB_VARSUMMARY");
     }
 
 protected:
     std::map<std::string,std::string> known_;
     bool live_only_;
+    bool deltas_;
 
 };
 